@@ -26,6 +26,7 @@
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 #include <trident/model/table.h>
+#include <trident/utils/queryarena.h>
 #include <kognac/stringscol.h>
 #include <dblayer.hpp>
 
@@ -33,7 +34,7 @@
 #define SMALLREL 20
 #define LIMIT_SAMPLE 100
 
-class TridentScan : public DBLayer::Scan {
+class TridentScan : public DBLayer::Scan, public ArenaObject {
     private:
         const DBLayer::Aggr_t a;
         const int perm;
@@ -41,6 +42,20 @@ class TridentScan : public DBLayer::Scan {
         Querier *q;
         DBLayer::Hint *hint;
         size_t countHint;
+        //Range of the first value (only for first())
+        uint64_t rangeFrom, rangeTo;
+        //Keys of a hash join on this scan, the column (1-3) that holds
+        //them and the number of bound values that prefix the scan
+        const SemiJoinFilter *keyFilter;
+        unsigned keyColumn;
+        unsigned nprefix;
+        uint64_t prefix1, prefix2;
+
+        bool checkRange();
+
+        void prepareKeys(unsigned nprefix, uint64_t prefix1, uint64_t prefix2);
+
+        bool skipKeys();
 
     public:
         TridentScan(const int perm, const DBLayer::Aggr_t a,
@@ -48,7 +63,14 @@ class TridentScan : public DBLayer::Scan {
         itr(NULL),
         q(q),
         hint(hint),
-        countHint(0) {
+        countHint(0),
+        rangeFrom(0),
+        rangeTo(UINT64_MAX),
+        keyFilter(NULL),
+        keyColumn(0),
+        nprefix(0),
+        prefix1(0),
+        prefix2(0) {
         }
 
         uint64_t getValue1();
@@ -69,16 +91,66 @@ class TridentScan : public DBLayer::Scan {
 
         bool first(uint64_t, bool, uint64_t, bool, uint64_t, bool);
 
+        void setKeyRange(uint64_t from, uint64_t to) {
+            rangeFrom = from;
+            rangeTo = to;
+        }
+
         ~TridentScan();
 };
 
+//Reads one position of a permutation: the keys if nothing is bound, the
+//second column if the key is bound, or the third if the first two are bound
+class TridentCursor : public DBLayer::Cursor, public ArenaObject {
+    private:
+        const int perm;
+        const unsigned prefixSize;
+        Querier *q;
+        PairItr *itr;
+        uint64_t prefix0, prefix1;
+        uint64_t value;
+
+        bool read();
+
+    public:
+        TridentCursor(const int perm, const unsigned prefixSize, Querier *q) :
+            perm(perm), prefixSize(prefixSize), q(q), itr(NULL), prefix0(0),
+            prefix1(0), value(0) {
+        }
+
+        bool open(const uint64_t *prefix);
+
+        uint64_t getValue() {
+            return value;
+        }
+
+        bool next();
+
+        bool seek(uint64_t target);
+
+        ~TridentCursor();
+};
+
 class TridentLayer : public DBLayer {
     private:
         KB &kb;
         DictMgmt *dict;
-        std::unique_ptr<Querier> q;
+        //The querier is owned by the layer or taken from the pool of the KB
+        std::unique_ptr<Querier> ownQuerier;
+        std::unique_ptr<QuerierPool::Handle> pooledQuerier;
+        Querier *q;
+        //Holds the operators and the scans of the query in execution
+        std::unique_ptr<QueryArena> arena;
         bool bifSampl;
         const int nindices;
+        //Max bytes that ORDER BY keeps in memory before spilling to disk
+        uint64_t sortMemoryBudget;
+        //Max bytes of a hash join table before spilling to disk
+        uint64_t hashMemoryBudget;
+        //Join cyclic patterns with the multiway join
+        bool multiwayJoins;
+        //Number of threads that run a query
+        unsigned parallelism;
 
         //Used to translate IDs back to strings
         std::unique_ptr<char[]> supportBuffer;
@@ -100,7 +172,7 @@ class TridentLayer : public DBLayer {
                 const bool co1,
                 const uint64_t o1) {
             double sample = 0;
-            return query(q.get(), cs1, s1, cp1, p1, co1, o1, -1, sample);
+            return query(q, cs1, s1, cp1, p1, co1, o1, -1, sample);
         }
 
         std::shared_ptr<TupleTable> sampleQuery(const bool cs1,
@@ -165,9 +237,23 @@ class TridentLayer : public DBLayer {
                 const int64_t card2);
 
     public:
-        TridentLayer(KB &kb) : kb(kb), dict(kb.getDictMgmt()), q(kb.query()),
-        bifSampl(true), nindices(kb.getNIndices()), supportBuffer(new
-                char[MAX_TERM_SIZE]) { }
+        TridentLayer(KB &kb) : kb(kb), dict(kb.getDictMgmt()),
+        ownQuerier(kb.query()), q(ownQuerier.get()),
+        arena(new QueryArena()), bifSampl(true), nindices(kb.getNIndices()),
+        sortMemoryBudget(UINT64_C(1024) * 1024 * 1024),
+        hashMemoryBudget(UINT64_C(1024) * 1024 * 1024), multiwayJoins(true),
+        parallelism(1), supportBuffer(new char[MAX_TERM_SIZE]) { }
+
+        //Reads the KB with a querier of its pool, so that several layers
+        //can run queries on the KB at the same time
+        TridentLayer(KB &kb, QuerierPool::Handle handle) : kb(kb),
+        dict(kb.getDictMgmt()),
+        pooledQuerier(new QuerierPool::Handle(std::move(handle))),
+        q(pooledQuerier->get()), arena(new QueryArena()), bifSampl(true),
+        nindices(kb.getNIndices()),
+        sortMemoryBudget(UINT64_C(1024) * 1024 * 1024),
+        hashMemoryBudget(UINT64_C(1024) * 1024 * 1024), multiwayJoins(true),
+        parallelism(1), supportBuffer(new char[MAX_TERM_SIZE]) { }
 
 		DDLEXPORT bool lookup(const std::string& text,
                 ::Type::ID type,
@@ -178,6 +264,57 @@ class TridentLayer : public DBLayer {
             bifSampl = false;
         }
 
+        //Returns NULL if the arena is disabled
+        QueryArena *getArena() {
+            return arena.get();
+        }
+
+        //Allocates every query object on the heap. Used for benchmarking
+        void disableArena() {
+            arena.reset();
+        }
+
+        //0 means that ORDER BY never spills
+        void setSortMemoryBudget(uint64_t bytes) {
+            sortMemoryBudget = bytes;
+        }
+
+        uint64_t getSortMemoryBudget() const {
+            return sortMemoryBudget;
+        }
+
+        //0 means that hash joins never spill
+        void setHashMemoryBudget(uint64_t bytes) {
+            hashMemoryBudget = bytes;
+        }
+
+        uint64_t getHashMemoryBudget() const {
+            return hashMemoryBudget;
+        }
+
+        //Joins cyclic patterns only with binary joins. Used for benchmarking
+        void disableMultiwayJoins() {
+            multiwayJoins = false;
+        }
+
+        bool useMultiwayJoins() const {
+            return multiwayJoins;
+        }
+
+        //Number of threads that run the large scans and joins of a query.
+        //The threads read the KB concurrently, so without MT it is always 1
+        void setParallelism(unsigned nthreads) {
+#ifdef MT
+            parallelism = nthreads > 0 ? nthreads : 1;
+#else
+            parallelism = 1;
+#endif
+        }
+
+        unsigned getParallelism() const {
+            return parallelism;
+        }
+
 		DDLEXPORT bool lookupById(uint64_t id,
                 const char*& start,
                 const char*& stop,
@@ -229,6 +366,8 @@ class TridentLayer : public DBLayer {
 
         DDLEXPORT uint64_t getCardinality();
 
+        DDLEXPORT bool hasUpdates();
+
         uint64_t getNTerms() {
             return kb.getNTerms();
         }
@@ -237,8 +376,20 @@ class TridentLayer : public DBLayer {
                 const DBLayer::Aggr_t,
                 Hint *hint);
 
+        DDLEXPORT bool hasPermutation(const DBLayer::DataOrder order);
+
+        DDLEXPORT std::unique_ptr<DBLayer> createWorker();
+
+        //A layer with the same settings and a querier of the pool of the
+        //KB. Used to run a query while other threads query the KB
+        DDLEXPORT std::unique_ptr<TridentLayer> createSession();
+
+        DDLEXPORT std::unique_ptr<DBLayer::Cursor> getCursor(
+                const DBLayer::DataOrder order,
+                const unsigned prefixSize);
+
         Querier *getQuerier() {
-            return q.get();
+            return q;
         }
 
         KB *getKB() {
@@ -32,12 +32,14 @@
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 
 #include <layers/TridentLayer.hpp>
+#include <trident/sparql/plancache.h>
 
 typedef struct {
     PyObject_HEAD
         KB *kb = NULL;
     Querier *q = NULL;
-    std::unique_ptr<TridentLayer> db;
+    //Created by the first SPARQL query
+    std::unique_ptr<PlanCache> plancache;
     bool rmKbOnDelete = false;
 } trident_Db;
 
@@ -138,6 +138,10 @@ class TableStorage {
 
         int64_t getNTriplesInserted();
 
+        //Used when the files were written before, e.g., by a load that is
+        //resumed
+        void setNTriplesInserted(int64_t n);
+
         short getLastCreatedFile() {
             return lastCreatedFile;
         }
@@ -20,77 +20,82 @@
 **/
 
 
+
 #ifndef _CACHEITR
 #define _CACHEITR
 
-#include <trident/iterators/cacheitr.h>
 #include <trident/iterators/pairitr.h>
 #include <trident/kb/consts.h>
-
 #include <trident/kb/cacheidx.h>
 
-class CacheIdx;
-class Querier;
+#include <memory>
 
+//Reads a table of the reverse permutations cache. It behaves like ArrayItr
 class CacheItr : public PairItr {
 private:
-    Querier *q;
-    uint64_t estimatedSize;
-    CacheIdx *cache;
-
-    std::vector<std::pair<uint64_t, uint64_t>> newPairs;
-    std::vector<CacheBlock> newBlocks;
-
-    std::vector<std::pair<uint64_t, uint64_t>> *p;
-    uint64_t idxEndGroup;
-
-    std::vector<std::pair<uint64_t, uint64_t>> *existingPairs;
-    std::vector<CacheBlock> *existingBlocks;
+    //Position in the compressed table. The row under the cursor is the
+    //next one that is returned
+    struct Cursor {
+        const uint8_t *ptr;
+        uint64_t group; //Groups read so far
+        uint64_t left; //Rows left in the current group
+        uint64_t first, second;
+        bool valid;
+    };
+
+    std::shared_ptr<const CompactPairs> pairs;
+    Cursor cur;
+    //Cursor before the last call to next()
+    Cursor prev;
+    Cursor markCur;
+
+    int64_t v1, v2;
+    bool hasNextChecked, n;
+    bool ignSecondColumn;
+    int64_t countElems;
 
-    uint64_t currentIdx, v1, v2;
-    int64_t lastDeltaValue, startDelta;
-    bool groupSet;
+    void advance(Cursor &c);
 
-    bool hasNextChecked, n;
+    //Moves the cursor on the first row with a first value >= c1
+    void seek(Cursor &c, const uint64_t c1);
 
-    CacheBlock *searchBlock(std::vector<CacheBlock> *blocks,
-                            const uint64_t v);
 public:
     int getTypeItr()  {
         return CACHE_ITR;
     }
 
-    void init(Querier *q, const uint64_t estimatedSize, CacheIdx *cache, int64_t c1,
-              int64_t c2);
+    void init(std::shared_ptr<const CompactPairs> pairs, int64_t c1, int64_t c2);
 
-    int64_t getValue1();
+    int64_t getValue1() {
+        return v1;
+    }
 
-    int64_t getValue2();
+    int64_t getValue2() {
+        return v2;
+    }
 
     bool hasNext();
 
     void next();
 
-    void clear();
-
-    bool gotoFirstTerm(int64_t c1);
+    int64_t getCount();
 
-    void gotoSecondTerm(int64_t c2);
+    void clear();
 
     void mark();
 
-    uint64_t getCardinality();
+    void reset(const char i);
 
-    //uint64_t estimateCardinality();
+    void moveto(const int64_t c1, const int64_t c2);
 
-    void reset(const char i);
+    uint64_t getCardinality();
 
-    bool allowMerge() {
-        return false;
+    uint64_t estCardinality() {
+        return getCardinality();
     }
 
     void ignoreSecondColumn() {
-        throw 10; //not supported
+        ignSecondColumn = true;
     }
 };
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _MEM_ITR_H
+#define _MEM_ITR_H
+
+#include <trident/iterators/pairitr.h>
+#include <trident/kb/consts.h>
+
+#include <vector>
+#include <memory>
+
+//A triple stored in the memtable, already permuted
+struct MemRow {
+    int64_t key;
+    int64_t v1;
+    int64_t v2;
+
+    bool operator <(const MemRow &r) const {
+        return key < r.key || (key == r.key && (v1 < r.v1 ||
+                    (v1 == r.v1 && v2 < r.v2)));
+    }
+};
+
+typedef std::vector<MemRow> MemRows;
+
+//Iterates over a sorted snapshot of the memtable. If the key is not set,
+//then it scans all the rows.
+class MemItr : public PairItr {
+private:
+    std::shared_ptr<const MemRows> rows;
+    size_t start, end;
+    size_t pos, cur;
+    size_t markPos;
+    bool scan;
+    int64_t v1, v2;
+    bool ignseccol;
+    bool hn, hnc;
+    int64_t count;
+
+    bool matches(const MemRow &r) const;
+
+    void skipGroup();
+
+public:
+    int getTypeItr() {
+        return MEM_ITR;
+    }
+
+    int64_t getValue1() {
+        return v1;
+    }
+
+    int64_t getValue2() {
+        return v2;
+    }
+
+    void init(std::shared_ptr<const MemRows> rows, int64_t key,
+            int64_t c1, int64_t c2);
+
+    bool hasNext();
+
+    void next();
+
+    void ignoreSecondColumn();
+
+    int64_t getCount();
+
+    uint64_t getCardinality();
+
+    uint64_t estCardinality();
+
+    void mark();
+
+    void reset(const char i);
+
+    void moveto(const int64_t c1, const int64_t c2);
+
+    void clear() {
+        rows = NULL;
+    }
+};
+
+#endif
@@ -20,60 +20,138 @@
 **/
 
 
+
 #ifndef _CACHEIDX
 #define _CACHEIDX
 
-#include <google/dense_hash_map>
+#include <trident/iterators/arrayitr.h>
+
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
 #include <cstdint>
-#include <climits>
 
-struct CacheBlock {
-    uint64_t startKey;
-    uint64_t endKey;
-    uint64_t startArray;
-    uint64_t endArray;
+//Table of a reversed permutation, sorted on the first column. The rows are
+//stored as groups that share the first value. Every group is encoded as the
+//delta from the previous first value, the number of rows, and the deltas of
+//the second values. All numbers are varints. Every SKIP_GROUPS groups there
+//is an entry in a skip list to jump close to a given first value
+class CompactPairs {
+    public:
+        struct SkipEntry {
+            uint64_t first; //First value of the group
+            uint64_t base; //First value of the previous group
+            uint64_t offset; //Position of the group in the data
+            uint64_t group; //Index of the group
+        };
+
+        static const uint64_t SKIP_GROUPS = 32;
+
+    private:
+        std::vector<uint8_t> data;
+        std::vector<SkipEntry> skips;
+        uint64_t nrows;
+        uint64_t ngroups;
 
-    CacheBlock() {
-        startKey = endKey = startArray = endArray = 0;
-    }
+        void writeVarint(uint64_t v);
 
-    bool operator < (const CacheBlock &b1) const {
-        if (startKey == b1.startKey) {
-            return endKey > b1.endKey;
+    public:
+        //The pairs must be sorted
+        CompactPairs(const Pairs &pairs);
+
+        const uint8_t *getData() const {
+            return data.data();
         }
-        return startKey < b1.startKey;
-    }
-};
 
-struct eqnumbers {
-    bool operator()(const uint64_t v1, const uint64_t v2) const {
-        return v1 == v2;
-    }
-};
+        const std::vector<SkipEntry> &getSkips() const {
+            return skips;
+        }
 
+        uint64_t getNRows() const {
+            return nrows;
+        }
+
+        uint64_t getNGroups() const {
+            return ngroups;
+        }
+
+        size_t getMemoryUsage() const {
+            return sizeof(CompactPairs) + data.capacity() +
+                skips.capacity() * sizeof(SkipEntry);
+        }
+
+        static uint64_t readVarint(const uint8_t *&p) {
+            uint64_t v = *p & 127;
+            int shift = 7;
+            while (*p++ & 128) {
+                v |= (uint64_t)(*p & 127) << shift;
+                shift += 7;
+            }
+            return v;
+        }
 
-typedef google::dense_hash_map<uint64_t,
-        std::pair<std::vector<CacheBlock>*, std::vector<std::pair<uint64_t, uint64_t>>*>,
-        std::hash<uint64_t>, eqnumbers> KeyMap;
+        static void skipVarint(const uint8_t *&p) {
+            while (*p++ & 128);
+        }
+};
 
+//Cache of the tables of the permutations that are not stored on disk and
+//that are rebuilt by reversing another permutation. The tables are
+//indexed by permutation and key. The least recently used tables are
+//evicted when the memory used exceeds the budget
 class CacheIdx {
-private:
-    KeyMap keyMap;
-public:
+    private:
+        struct Entry {
+            uint64_t id;
+            std::shared_ptr<const CompactPairs> pairs;
+            size_t bytes;
+        };
+
+        const size_t maxBytes;
+        size_t bytes;
+        std::list<Entry> lru; //Most recent first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+
+#ifdef MT
+        std::mutex mutex;
+#endif
+
+        static uint64_t getID(const int perm, const uint64_t key) {
+            return (key << 3) | perm;
+        }
 
-    CacheIdx() {
-        keyMap.set_empty_key(UINT64_MAX);
-    }
+    public:
+        CacheIdx(size_t maxBytes);
 
-    std::pair<std::vector<std::pair<uint64_t, uint64_t>>*,
-        std::vector<CacheBlock>*
-        > getIndex(uint64_t key);
+        //Returns NULL if the table is not in the cache
+        std::shared_ptr<const CompactPairs> get(const int perm,
+                const uint64_t key);
 
-    void storeIdx(uint64_t key, std::vector<CacheBlock> *blocks,
-                  std::vector<std::pair<uint64_t, uint64_t>> *pairs);
+        //Tables larger than the budget are not stored
+        void put(const int perm, const uint64_t key,
+                std::shared_ptr<const CompactPairs> pairs);
 
-    ~CacheIdx();
+        size_t getMemoryUsage() const {
+            return bytes;
+        }
+
+        uint64_t getHits() const {
+            return hits;
+        }
+
+        uint64_t getMisses() const {
+            return misses;
+        }
+
+        uint64_t getEvictions() const {
+            return evictions;
+        }
 };
 
 #endif
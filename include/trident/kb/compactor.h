@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _KB_COMPACTOR_H
+#define _KB_COMPACTOR_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+class KB;
+
+//Folds the differential updates of a KB into a new base. All the tables of
+//the current base are rewritten with the updates applied, together with a
+//new tree, in the directory <kb>/_compact/<generation>. The KB can be
+//queried and updated in the meantime: the new base is published with a
+//snapshot, the queriers created before keep reading the old one, and the
+//files of the old base are deleted when its last reader is released
+class KBCompactor {
+    private:
+        KB &kb;
+        const uint64_t maxBytesPerSecond;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> cancelled;
+        bool failed;
+
+        void compact();
+
+    public:
+        //maxBytesPerSecond limits the bytes rewritten per second, so that
+        //the compaction leaves the disk to the queries (0 means no limit)
+        KBCompactor(KB &kb, uint64_t maxBytesPerSecond) : kb(kb),
+        maxBytesPerSecond(maxBytesPerSecond), running(false),
+        cancelled(false), failed(false) {
+        }
+
+        //Compacts the KB in the calling thread. Returns false on failure
+        bool run();
+
+        //Starts the compaction in a background thread. Returns false if a
+        //compaction is already running
+        bool start();
+
+        bool isRunning() const {
+            return running;
+        }
+
+        //Stops the compaction as soon as possible. The KB is not changed
+        void cancel() {
+            cancelled = true;
+        }
+
+        //Waits for the background compaction. Returns false on failure
+        bool wait();
+
+        //The directory of the tree and of the permutations of a base
+        static std::string getBaseDir(std::string path, int64_t generation);
+
+        //Deletes the files of a base that was replaced
+        static void removeBase(std::string path, int64_t generation);
+
+        //Deletes what the compactions left behind: the bases that are not
+        //current and the tables of the diffs that were folded
+        static void recover(std::string path, int64_t generation);
+
+        ~KBCompactor();
+};
+
+#endif
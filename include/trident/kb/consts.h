@@ -69,6 +69,7 @@
 #define DIFF1_ITR 17
 #define RM_ITR 18
 #define RMCOMPOSITETERM_ITR 19
+#define MEM_ITR 20
 
 //Use for dynamic layout
 #define W_DIFFERENCE 0
@@ -80,6 +81,11 @@
 //Size buffer (i.e. number of elements) to sort during the compression
 #define SORTING_BLOCK_SIZE 25000000
 
+//Used to merge the sorted runs during loading
+#define LOADER_DEFAULT_MERGE_FANIN 4
+#define LOADER_MAX_MERGE_FANIN 256
+#define LOADER_MERGE_BYTES_PER_RUN (8 * 1024 * 1024)
+
 #define MAX_N_BLOCKS_IN_CACHE 1000000
 
 //Used in the dictionary lookup thread
@@ -33,6 +33,9 @@
 #include <sparsehash/sparse_hash_map>
 #include <sparsehash/dense_hash_map>
 
+#include <mutex>
+#include <atomic>
+
 class Root;
 class StringBuffer;
 class TreeItr;
@@ -137,6 +140,13 @@ class DictMgmt {
         bool gud_modified;
         uint64_t gud_largestID;
         string gudLocation;
+        //The GUD can grow while the KB is queried
+        std::mutex gudMutex;
+        std::atomic<uint64_t> gudSize;
+        //The string buffers and the trees of the dictionaries are shared by
+        //the threads that query the KB, but they cache their blocks without
+        //locks
+        std::mutex lookupMutex;
 
     public:
 
@@ -147,8 +157,11 @@ class DictMgmt {
 
         void putInUpdateDict(const uint64_t id, const char *term, const size_t len);
 
+        //Write the GUD on disk if it was modified
+        void storeGUD();
+
         uint64_t getGUDSize() {
-            return gud_idtext.size();
+            return gudSize;
         }
 
         uint64_t getNRels() {
@@ -31,6 +31,8 @@
 #include <trident/kb/updatestats.h>
 #include <trident/tree/coordinates.h>
 #include <trident/utils/propertymap.h>
+#include <trident/utils/keyfilter.h>
+#include <trident/kb/diffstats.h>
 #include <trident/kb/kbconfig.h>
 #include <kognac/factory.h>
 
@@ -103,8 +105,10 @@ public:
         return clazz;
     }
 
+    //The iterators are taken from the factories of q, so that the index can
+    //be shared by several queriers
     virtual PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                                 int64_t &nfirstterms) = 0;
+                                 int64_t &nfirstterms, Querier *q) = 0;
 
     virtual int64_t getSize() const = 0;
 
@@ -118,6 +122,16 @@ public:
 
     virtual int64_t getNFirstTables(int idx) = 0;
 
+    //False if the index certainly has no entry with this first term
+    virtual bool mayContain(int idx, int64_t first) const {
+        return true;
+    }
+
+    //NULL if the index was created without statistics
+    virtual const DiffStats *getStats() const {
+        return NULL;
+    }
+
     virtual ~DiffIndex() {}
 
 };
@@ -136,7 +150,6 @@ private:
     std::unique_ptr<ROMappedFile> values;
     std::unique_ptr<ROMappedFile> newpairs1;
     std::unique_ptr<ROMappedFile> newpairs2;
-    Factory<Diff1Itr> *factory;
 
     static int64_t outerJoin(PairItr *itr, std::vector<uint64_t> &values, string filenewkeys);
 
@@ -151,7 +164,7 @@ public:
     DiffIndex1(string dir, DiffIndex::TypeUpdate type);
 
     PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                         int64_t &nfirstterms);
+                         int64_t &nfirstterms, Querier *q);
 
     int64_t getSize() const;
 
@@ -165,8 +178,6 @@ public:
 
     int64_t getNFirstTables(int idx);
 
-    void setFactoryIterators(Factory<Diff1Itr> *f);
-
     static void createDiffIndex(string outputdir,
                                 bool dumpRawFormat,
                                 Querier *q,
@@ -197,15 +208,14 @@ private:
     int64_t nkeys_p;
     std::unique_ptr<Root> o;
     int64_t nkeys_o;
-    std::unique_ptr<ROMappedFile> spo_f;
-    std::unique_ptr<ROMappedFile> sop_f;
-    std::unique_ptr<ROMappedFile> pos_f;
-    std::unique_ptr<ROMappedFile> pso_f;
-    std::unique_ptr<ROMappedFile> ops_f;
-    std::unique_ptr<ROMappedFile> osp_f;
+    //Either the files of the diff or the global ones shared by small diffs
+    std::shared_ptr<ROMappedFile> files[6];
     Root *roots[6];
     const char *buffers[6];
-    StorageStrat *strat;
+    KeyFilter filters[3];
+    const KeyFilter *keyFilters[6];
+    DiffStats stats;
+    bool hasStats;
     int64_t size;
 
     //Data structures to contain the unique keys. At the moment they are not used
@@ -263,6 +273,8 @@ private:
                                         int64_t *counters2,
                                         UpdateStats *stats);
 
+    //If sortFirstColumn is false, idx1 is already sorted by the first
+    //column. The rows of every key are sorted anyway
     static size_t sortIndex(string outputdir,
                             string globaldir,
                             int perm1,
@@ -274,18 +286,19 @@ private:
                             PropertyMap & map,
                             Querier *q,
                             UpdateStats *stats,
-                            const bool sort);
+                            const bool sortFirstColumn);
 
 
 public:
 
-    DiffIndex3(std::string dir, const char **globalbuffers, KBConfig &config,
-               TypeUpdate type);
+    DiffIndex3(std::string dir, std::shared_ptr<ROMappedFile> *globalfiles,
+               KBConfig &config, TypeUpdate type);
 
     PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                         int64_t &nfirstterms);
+                         int64_t &nfirstterms, Querier *q);
 
-    PairItr *getIterator(int idx, int64_t key, TermCoordinates &coord);
+    PairItr *getIterator(int idx, int64_t key, TermCoordinates &coord,
+                         StorageStrat *strat);
 
     PairItr *getScan(int idx, DiffScanItr *itr);
 
@@ -301,8 +314,12 @@ public:
 
     int64_t getNFirstTables(int idx);
 
-    void setStorageStrat(StorageStrat *strat) {
-        this->strat = strat;
+    bool mayContain(int idx, int64_t first) const {
+        return keyFilters[idx]->mayContain(first);
+    }
+
+    const DiffStats *getStats() const {
+        return hasStats ? &stats : NULL;
     }
 
     DDLEXPORT static void createDiffIndex(DiffIndex::TypeUpdate type,
@@ -313,7 +330,8 @@ public:
                                 std::vector<uint64_t> &all_o,
                                 bool dumpRawFormat,
                                 Querier *q,
-                                bool sort);
+                                bool sort,
+                                size_t samplesize = 0);
 
     ~DiffIndex3();
 };
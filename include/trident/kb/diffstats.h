@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _DIFF_STATS_H
+#define _DIFF_STATS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//Statistics of an update, stored in the directory of the diff. The counts
+//refer to the update only: the querier adds or subtracts them depending on
+//the type of the diff
+class DiffStats {
+    public:
+        struct PredicateStats {
+            uint64_t p;
+            uint64_t ntriples;
+            //Subjects and objects of p that are new (addition) or that
+            //disappear (removal)
+            uint64_t nsubjects;
+            uint64_t nobjects;
+        };
+
+    private:
+        //Sorted by p
+        std::vector<PredicateStats> predicates;
+        //Uniform sample of the triples of the update (s, p, o)
+        std::vector<uint64_t> sample;
+
+    public:
+        //Must be called with increasing p
+        void addPredicate(uint64_t p, uint64_t ntriples, uint64_t nsubjects,
+                uint64_t nobjects);
+
+        const PredicateStats *getPredicate(uint64_t p) const;
+
+        const std::vector<PredicateStats> &getPredicates() const {
+            return predicates;
+        }
+
+        //Reservoir sampling of samplesize triples
+        void setSample(const std::vector<uint64_t> &all_s,
+                const std::vector<uint64_t> &all_p,
+                const std::vector<uint64_t> &all_o,
+                size_t samplesize);
+
+        const std::vector<uint64_t> &getSample() const {
+            return sample;
+        }
+
+        void store(std::string file) const;
+
+        //Returns false if the file does not exist
+        bool load(std::string file, bool withSample = true);
+};
+
+#endif
@@ -163,6 +163,8 @@ class Inserter {
 
         void insert(nTerm key, TermCoordinates *value);
 
+        void bulkInsert(std::vector<TermCoordinatesSource*> &sources);
+
         std::string getPathPermutationStorage(const int perm);
 
         void flush(int permutation, TripleWriter *posArray,
@@ -180,6 +182,17 @@ class Inserter {
             return ntables[idx];
         }
 
+        uint64_t getNFirstTablesPerPartition(const int idx) const {
+            return nFirstElsNTables[idx];
+        }
+
+        int64_t getNTriplesInserted(const int permutation);
+
+        //Sets the counters of a permutation whose index was created by a
+        //previous load that is resumed
+        void restoreCounters(const int permutation, const int64_t ntables,
+                const int64_t nFirstTables, const int64_t nTriples);
+
         uint64_t getNSkippedTables(const int idx) const {
             return skippedTables[idx];
         }
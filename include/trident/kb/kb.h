@@ -29,11 +29,18 @@
 #include <trident/kb/kbconfig.h>
 #include <trident/kb/cacheidx.h>
 #include <trident/kb/diffindex.h>
+#include <trident/kb/memtable.h>
+#include <trident/kb/kbsnapshot.h>
+#include <trident/kb/querierpool.h>
 #include <trident/utils/memorymgr.h>
 
 #include <kognac/factory.h>
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
 
 class Leaf;
 class Querier;
@@ -54,7 +61,6 @@ class KB {
 
         const bool readOnly;
 
-        Root *tree;
         Stats stats;
         bool isClosed;
 
@@ -62,14 +68,14 @@ class KB {
         DictMgmt *dictManager;
         int dictPartitions;
         bool dictHash;
-        std::vector<DictMgmt::Dict> dictUpdates;
-
-        int64_t ntables[N_PARTITIONS];
-        int64_t nFirstTables[N_PARTITIONS];
 
         int64_t totalNumberTriples;
-        int64_t totalNumberTerms;
-        int64_t nextID;
+        //Incremented by the single-triple updates while the KB is queried
+        std::atomic<int64_t> totalNumberTerms;
+        std::atomic<int64_t> nextID;
+        //Changes with every update that can change the statistics of the
+        //planner, also those that do not publish a snapshot
+        std::atomic<uint64_t> statsVersion;
         GraphType graphType;
 
         int nindices;
@@ -86,33 +92,63 @@ class KB {
 
         double sampleRate;
 
-        TableStorage *files[N_PARTITIONS];
-        MemoryManager<FileDescriptor> *bytesTracker[N_PARTITIONS];
-
-        CacheIdx *pso;
-        CacheIdx *osp;
-
         KB *sampleKB;
         KBConfig config;
 
-        //The data structures below handle updates
-        std::vector<std::unique_ptr<DiffIndex>> diffIndices;
-        std::unique_ptr<ROMappedFile> spo_f;
-        std::unique_ptr<ROMappedFile> sop_f;
-        std::unique_ptr<ROMappedFile> pos_f;
-        std::unique_ptr<ROMappedFile> pso_f;
-        std::unique_ptr<ROMappedFile> ops_f;
-        std::unique_ptr<ROMappedFile> osp_f;
+        //The data structures below handle updates. The base and the diffs
+        //are in the current snapshot, which is replaced atomically by every
+        //update and compaction
+        std::shared_ptr<const KBSnapshot> snapshot;
+        std::unique_ptr<Querier> updatesQuerier;
+        //Serializes the updates. The readers never take it
+        std::mutex updatesMutex;
+        //Serializes the operations that replace the diffs: compactions and
+        //merges
+        std::mutex compactionMutex;
+
+        //Queriers for the threads that serve queries concurrently
+        std::unique_ptr<QuerierPool> querierPool;
 
         void loadDict(KBConfig *config);
 
-        void createNewDict(std::string dir);
+        //Opens the tree and the permutations of a base
+        std::shared_ptr<KBBase> openBase(int64_t generation);
+
+        void storeStats(const KBBase &base);
+
+        void mapGlobalDiffFiles(std::shared_ptr<ROMappedFile> *globalfiles);
+
+        void publishSnapshot(std::shared_ptr<KBSnapshot> next);
+
+        Querier *getUpdatesQuerier();
+
+        void storeMemTable();
+
+        //Applies the journal of a merge of the diffs, if any
+        void applyMerge(std::string diffDir);
 
         void createSingleUpdate(DiffIndex::TypeUpdate type, PairItr *itr,
                 std::string dir, std::string diffDir, Querier *q);
 
         int cmp(PairItr *itr, uint64_t s, uint64_t p, uint64_t o);
 
+        Root *newTree(string dir, bool readOnly);
+
+        //Querier on the snapshot s that reads the tree passed as argument,
+        //either the one of the base or a copy. If sampleTree is not NULL,
+        //the sampler reads it instead of the tree of the sample KB
+        Querier *query(std::shared_ptr<const KBSnapshot> s, Root *tree,
+                Root *sampleTree);
+
+        //A copy of the tree of a base
+        Root *getRootTree(const KBBase &base);
+
+        //A copy of the tree of the sample KB. NULL if there is no sample
+        Root *getSampleRootTree();
+
+        friend class KBCompactor;
+        friend class QuerierPool;
+
     public:
         DDLEXPORT KB(const char *path, bool readOnly, bool reasoning,
                 bool dictEnabled, KBConfig &config) : KB(path, readOnly, reasoning,
@@ -122,16 +158,44 @@ class KB {
         DDLEXPORT KB(const char *path, bool readOnly, bool reasoning,
                 bool dictEnabled, KBConfig &config, std::vector<string> locationUpdates);
 
+        //The querier reads the snapshot that is current when it is created
         DDLEXPORT Querier *query();
 
+        //Use it instead of query() when several threads query the KB
+        DDLEXPORT QuerierPool &getQuerierPool() {
+            return *querierPool;
+        }
+
+        DDLEXPORT std::shared_ptr<const KBSnapshot> getSnapshot() const {
+            return std::atomic_load(&snapshot);
+        }
+
         DDLEXPORT Inserter *insert();
 
         DictMgmt *getDictMgmt() {
             return dictManager;
         }
 
+        //Replace the diffs with a diff of additions and one of removals.
+        //The queriers created before keep reading the old diffs
         DDLEXPORT void mergeUpdates();
 
+        //Add or remove a single triple. The update is logged and it is
+        //visible right away to the queriers returned by query(). Returns
+        //false if the update did not change the KB
+        DDLEXPORT bool updateTriple(DiffIndex::TypeUpdate type,
+                const std::string &s, const std::string &p,
+                const std::string &o);
+
+        //Store the triples updated in memory as diff indices
+        DDLEXPORT void flushMemTable();
+
+        //Add the triples to the sample of the KB, or remove them from it.
+        //The queriers created from now on estimate with the new sample
+        DDLEXPORT void updateSample(DiffIndex::TypeUpdate type,
+                std::vector<uint64_t> &all_s, std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
         void closeMainDict();
 
         void close();
@@ -175,7 +239,7 @@ class KB {
         }
 
         int getNTablesPerPartition(int idx) {
-            return ntables[idx];
+            return getSnapshot()->base->ntables[idx];
         }
 
         double getSampleRate() {
@@ -190,13 +254,26 @@ class KB {
             return nextID;
         }
 
+        //The plans built with an older version may use stale statistics
+        uint64_t getStatsVersion() const {
+            return statsVersion;
+        }
+
         Root* getRootTree();
 
         TreeItr *getItrTerms();
 
         std::vector<const char*> openAllFiles(int perm);
 
-        void addDiffIndex(string inputdir, const char **globalbuffers, Querier *q);
+        //Store the triples that change the KB as a new diff index and
+        //publish it
+        void storeUpdate(DiffIndex::TypeUpdate type,
+                std::vector<uint64_t> &all_s, std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        void addDiffIndex(string inputdir,
+                std::shared_ptr<ROMappedFile> *globalfiles,
+                KBSnapshot &next);
 
         DDLEXPORT ~KB();
 };
@@ -90,11 +90,15 @@ typedef enum {
     STORAGE_CACHE_SIZE,
     STORAGE_MAX_FILE_SIZE,
     STORAGE_MAX_N_FILES,
+    REVERSE_CACHE_SIZE, //Max bytes of the tables rebuilt from the reverse permutations
 
 //Parameters about the string buffer
     SB_COMPRESSDOMAINS,
     SB_PREALLBUFFERS,
-    SB_CACHESIZE
+    SB_CACHESIZE,
+
+//Max number of triples updated in memory before they are stored in a diff
+    MEMTABLE_MAX_TRIPLES
 
 } KBParam;
 
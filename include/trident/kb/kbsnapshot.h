@@ -0,0 +1,106 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _KB_SNAPSHOT_H
+#define _KB_SNAPSHOT_H
+
+#include <trident/kb/consts.h>
+#include <trident/kb/diffindex.h>
+#include <trident/kb/dictmgmt.h>
+#include <trident/kb/memtable.h>
+#include <trident/utils/memorymgr.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+class Root;
+class TableStorage;
+class FileDescriptor;
+class CacheIdx;
+
+//The base indices of a KB: the tree with the coordinates of the tables and
+//the tables of the permutations. The loader writes the first base in the
+//directory of the KB. A compaction writes a new one in its own directory
+//and publishes it with a snapshot. The base it replaces is deleted, with
+//its files, when the last snapshot that refers to it is released
+struct KBBase {
+    const std::string path;
+    //0 is the base written by the loader
+    const int64_t generation;
+
+    Root *tree;
+    TableStorage *files[N_PARTITIONS];
+    MemoryManager<FileDescriptor> *bytesTracker[N_PARTITIONS];
+    //The tables rebuilt from the reverse permutations
+    CacheIdx *reverseCache;
+
+    int64_t ntables[N_PARTITIONS];
+    int64_t nFirstTables[N_PARTITIONS];
+
+    //Set when a compaction replaces the base
+    std::atomic<bool> obsolete;
+
+    KBBase(std::string path, int64_t generation) : path(path),
+    generation(generation), tree(NULL), files(), bytesTracker(),
+    reverseCache(NULL), ntables(), nFirstTables(), obsolete(false) {
+    }
+
+    //The directory that contains the tree and the permutations
+    std::string getDir() const;
+
+    ~KBBase();
+};
+
+//State of a KB at a given point in time: its base and the updates on top of
+//it. A snapshot is never modified after it is published: an update or a
+//compaction copies the current snapshot, changes the copy and publishes it.
+//Every Querier keeps a reference to the snapshot that was current when it
+//was created, so the diffs and the bases that are replaced are released
+//when their last reader is deleted
+struct KBSnapshot {
+    uint64_t version;
+
+    std::shared_ptr<KBBase> base;
+
+    std::vector<std::shared_ptr<DiffIndex>> diffIndices;
+    //The directories of the diff indices, in the same order
+    std::vector<std::string> diffDirs;
+    std::vector<DictMgmt::Dict> dictUpdates;
+
+    //Single-triple updates. Contrary to the rest of the snapshot, they are
+    //visible as soon as they are applied
+    std::shared_ptr<MemTable> memtable;
+
+    int64_t totalNumberTriples;
+    int64_t totalNumberTerms;
+    int64_t nextID;
+
+    KBSnapshot() : version(0), totalNumberTriples(0), totalNumberTerms(0),
+    nextID(0) {
+    }
+};
+
+#endif
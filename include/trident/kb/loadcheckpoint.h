@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _LOAD_CHECKPOINT_H
+#define _LOAD_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+//Records the phases of the loading that are completed, together with the
+//files they produced, so that an interrupted load can be resumed
+class LoadCheckpoint {
+    private:
+        const std::string dir;
+        const std::string file;
+        const std::string signature;
+
+        std::map<std::string, std::string> params;
+        //Phase -> files (path, size)
+        std::map<std::string, std::vector<std::pair<std::string, int64_t>>> phases;
+
+        static void listFiles(std::string path, std::vector<std::string> &out);
+
+        void read();
+
+        void write();
+
+    public:
+        //The signature identifies the input and the parameters that affect
+        //the output of the phases
+        LoadCheckpoint(std::string dir, std::string signature);
+
+        //Summarizes the names, the sizes and the modification times of the
+        //files in a path, so that a load is not resumed on a changed input
+        static std::string getInputSignature(std::string path);
+
+        //True if the checkpoint file exists and was produced with the same
+        //signature
+        bool isValid() const {
+            return !phases.empty() || !params.empty();
+        }
+
+        //True if the phase is completed and all its files are still there
+        bool isCompleted(std::string phase);
+
+        void markCompleted(std::string phase, std::vector<std::string> outputs);
+
+        //Forgets the other phases and removes their partial outputs. Only
+        //the files in the given paths, i.e., the files and directories that
+        //the loader writes, are removed
+        void restore(std::vector<std::string> phasesToKeep,
+                std::vector<std::string> loaderPaths);
+
+        void setParam(std::string key, std::string value);
+
+        std::string getParam(std::string key);
+
+        void clear();
+};
+
+#endif
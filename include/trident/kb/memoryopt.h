@@ -32,7 +32,9 @@ private:
     static int calculateBytesPerDictPair(int64_t nTerms, int leafSize);
 
 public:
-    static void optimizeForWriting(int64_t inputTriples, KBConfig &config);
+    //If maxMemory > 0, then the caches used during writing are bound by it
+    static void optimizeForWriting(int64_t inputTriples, KBConfig &config,
+                                   int64_t maxMemory = 0);
 
     static void optimizeForReading(int ndicts, KBConfig &config);
 
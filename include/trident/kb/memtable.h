@@ -0,0 +1,110 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _MEMTABLE_H
+#define _MEMTABLE_H
+
+#include <trident/kb/diffindex.h>
+#include <trident/iterators/memitr.h>
+#include <trident/kb/consts.h>
+
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+
+class Querier;
+class DictMgmt;
+
+//Stores in main memory the triples added or removed with single-triple
+//updates. Every change is appended to a write-ahead log and synced to disk
+//before the update returns, so that it can be replayed after a crash. The content is kept sorted for all permutations,
+//and the queriers read it through immutable snapshots (see MemItr). When it
+//becomes too large, the KB flushes it into regular diff indices.
+class MemTable {
+    private:
+        const std::string walFile;
+        //-1 until the first record is written
+        int wal;
+        std::mutex mutex;
+
+        //[0] contains the additions, [1] the removals
+        std::set<MemRow> rows[2][N_PARTITIONS];
+        std::shared_ptr<const MemRows> snapshots[2][N_PARTITIONS];
+        std::atomic<uint64_t> nrows;
+
+        bool apply(DiffIndex::TypeUpdate type, int64_t s, int64_t p, int64_t o,
+                Querier *q);
+
+        void log(const char *record, size_t size, bool sync);
+
+        void closeLog();
+
+    public:
+        MemTable(std::string walFile);
+
+        ~MemTable();
+
+        //Returns true if the update changed the content of the KB. q must
+        //not read the memtable
+        bool update(DiffIndex::TypeUpdate type, int64_t s, int64_t p,
+                int64_t o, Querier *q);
+
+        //Log a term added to the dictionary by an update
+        void logTerm(int64_t id, const char *term, size_t len);
+
+        //Re-apply the content of the log. Terms are added to the GUD
+        void replay(DictMgmt *dict, int64_t &nextID, int64_t &nTerms,
+                Querier *q);
+
+        bool isEmpty() const {
+            return nrows == 0;
+        }
+
+        uint64_t getSize() const {
+            return nrows;
+        }
+
+        uint64_t getSize(DiffIndex::TypeUpdate type);
+
+        std::shared_ptr<const MemRows> getRows(DiffIndex::TypeUpdate type,
+                int perm);
+
+        //Net number of rows added to the table of key
+        int64_t getCard(int perm, int64_t key);
+
+        //Net number of distinct first values added to the table of key
+        int64_t getNDistinct(int perm, int64_t key);
+
+        void getTriples(DiffIndex::TypeUpdate type,
+                std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        //Truncate the log once its content is stored in the diffs. The rows
+        //stay readable by the queriers that still use the table
+        void truncateLog();
+};
+
+#endif
@@ -91,6 +91,20 @@ class PermSorter {
                 int currentPerm,
                 int nextPerm);
 
+        //Returns true if the first column of the two permutations is the
+        //same, i.e., if nextPerm can be obtained by sorting each group of
+        //triples that share the first term
+        static bool sameFirstColumn(int currentPerm, int nextPerm);
+
+        static void sortGroups_seq(char *start, char *end,
+                const size_t sizeTriple,
+                bool includeCount);
+
+        static void sortGroups(char *start, char *end,
+                const size_t sizeTriple,
+                int nthreads,
+                bool includeCount);
+
     public:
         /*static void sortChunks(string inputdir,
                 int maxReadingThreads,
@@ -109,12 +123,16 @@ class PermSorter {
                 bool outputSPO,
                 std::vector<std::pair<string, char>> &additionalPermutations);*/
 
+        //If maxMemory is greater than zero, the in-memory buffer (together
+        //with the space needed to sort it) never exceeds maxMemory bytes.
+        //The input is then split in more (smaller) sorted runs.
         static void sortChunks2(
                 std::vector<std::pair<string, char>> &inputs,
                 int maxReadingThreads,
                 int parallelProcesses,
                 int64_t estimatedSize,
-                bool includeCount);
+                bool includeCount,
+                int64_t maxMemory = 0);
 
         static void sortChunks2(
                 std::string input,
@@ -122,11 +140,12 @@ class PermSorter {
                 int maxReadingThreads,
                 int parallelProcesses,
                 int64_t estimatedSize,
-                bool includeCount) {
+                bool includeCount,
+                int64_t maxMemory = 0) {
             std::vector<std::pair<string, char>> permutations;
             permutations.push_back(std::make_pair(input, permutation));
             sortChunks2(permutations, maxReadingThreads, parallelProcesses,
-                    estimatedSize, includeCount);
+                    estimatedSize, includeCount, maxMemory);
 
         }
 };
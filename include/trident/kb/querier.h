@@ -36,11 +36,14 @@
 #include <trident/iterators/compositescanitr.h>
 #include <trident/iterators/rmitr.h>
 #include <trident/iterators/rmcompositetermitr.h>
+#include <trident/iterators/memitr.h>
 
 #include <trident/tree/coordinates.h>
 #include <trident/binarytables/storagestrat.h>
 #include <trident/binarytables/factorytables.h>
 #include <trident/kb/diffindex.h>
+#include <trident/kb/memtable.h>
+#include <trident/kb/kbsnapshot.h>
 
 #include <kognac/factory.h>
 
@@ -62,7 +65,7 @@ class Querier {
         int64_t lastKeyQueried;
         bool lastKeyFound;
         const int64_t inputSize;
-        const int64_t nTerms;
+        int64_t nTerms;
         const int64_t *nTablesPerPartition;
         const int64_t *nFirstTablesPerPartition;
 
@@ -71,7 +74,12 @@ class Querier {
 
         const int nindices;
 
-        std::vector<std::unique_ptr<DiffIndex>> &diffIndices;
+        //The diffs are read from the snapshot pinned at creation
+        std::shared_ptr<const KBSnapshot> snapshot;
+        const std::vector<std::shared_ptr<DiffIndex>> &diffIndices;
+        MemTable *memtable;
+        //Shared by all the queriers of the KB. Can be NULL
+        CacheIdx *reverseCache;
         std::unique_ptr<Querier> sampler;
 
         TermCoordinates currentValue;
@@ -90,6 +98,7 @@ class Querier {
         Factory<Diff1Itr> factory13;
         Factory<RmItr> factory14;
         Factory<RmCompositeTermItr> factory15;
+        Factory<MemItr> factory16;
 
         Factory<NewColumnTable> ncFactory;
         FactoryNewRowTable nrFactory;
@@ -111,6 +120,25 @@ class Querier {
 
         PairItr *summaryDiff(const int perm, DiffIndex::TypeUpdate tp);
 
+        PairItr *addMemTable(const int idx, const int64_t first,
+                const int64_t second, const int64_t third, PairItr *out);
+
+        //Triples with this first term in the diffs and in the memtable.
+        //The removals are subtracted
+        int64_t getDiffCard(const int perm, const int64_t key);
+
+        //Table of a permutation that is not stored, read from the cache or
+        //rebuilt from the reverse permutation
+        PairItr *getReverseFromCache(const int idx, TermCoordinates &value,
+                const int64_t key, const int64_t v1, const int64_t v2,
+                const bool cons);
+
+        //True if all the diffs have statistics
+        bool hasDiffStats() const;
+
+        //Distinct subjects (PSO) or objects (POS) of the predicate p
+        int64_t getNDistinct(const int perm, const int64_t p);
+
     public:
 
         struct Counters {
@@ -129,9 +157,24 @@ class Querier {
                 const int64_t* nTablesPerPartition,
                 const int64_t* nFirstTablesPerPartition,
                 KB *sampleKB,
-                std::vector<std::unique_ptr<DiffIndex>> &diffIndices);
+                std::shared_ptr<const KBSnapshot> snapshot);
+
+        //A querier on the same KB and snapshot, to be used by another
+        //thread. It has no sampler
+        Querier *copy();
+
+        void setSampler(Querier *sampler) {
+            this->sampler = std::unique_ptr<Querier>(sampler);
+        }
+
+        //The triples in the memtable are merged with the results
+        void setMemTable(MemTable *memtable) {
+            this->memtable = memtable;
+        }
 
-        void initDiffIndex(DiffIndex *diff);
+        void setReverseCache(CacheIdx *cache) {
+            this->reverseCache = cache;
+        }
 
         TermItr *getKBTermList(const int perm, const bool enforcePerm);
 
@@ -154,6 +197,14 @@ class Querier {
             return &strat;
         }
 
+        uint64_t getSnapshotVersion() const {
+            return snapshot->version;
+        }
+
+        Factory<Diff1Itr> *getDiff1Factory() {
+            return &factory13;
+        }
+
         DDLEXPORT PairItr *get(const int idx, const int64_t s, const int64_t p, const int64_t o) {
             return get(idx, s, p, o, true);
         }
@@ -216,6 +267,10 @@ class Querier {
 
         DDLEXPORT int *getInvOrder(int idx);
 
+        bool hasUpdates() const {
+            return !diffIndices.empty() || (memtable && !memtable->isEmpty());
+        }
+
         uint64_t getInputSize() const {
             uint64_t tot = inputSize;
             for (size_t i = 0; i < diffIndices.size(); ++i) {
@@ -226,6 +281,10 @@ class Querier {
                     tot -= sizeUpdate;
                 }
             }
+            if (memtable && !memtable->isEmpty()) {
+                tot += memtable->getSize(DiffIndex::TypeUpdate::ADDITION_df);
+                tot -= memtable->getSize(DiffIndex::TypeUpdate::DELETE_df);
+            }
             return tot;
         }
 
@@ -243,10 +302,28 @@ class Querier {
             return output;
         }
 
+        //Number of distinct first terms of the permutation
+        uint64_t getNKeys(const int idx) const {
+            int64_t output = nTablesPerPartition[idx];
+            for (size_t i = 0; i < diffIndices.size(); ++i) {
+                if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
+                    output += diffIndices[i]->getNUniqueKeys(idx);
+                } else {
+                    output -= diffIndices[i]->getNUniqueKeys(idx);
+                }
+            }
+            return output > 0 ? output : 0;
+        }
+
         uint64_t getNTerms() const {
             return nTerms;
         }
 
+        //The single-triple updates add terms without a new snapshot
+        void setNTerms(int64_t nTerms) {
+            this->nTerms = nTerms;
+        }
+
         LIBEXP void releaseItr(PairItr *itr);
 
         void resetCounters() {
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _QUERIER_POOL_H
+#define _QUERIER_POOL_H
+
+#include <trident/kb/consts.h>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+class KB;
+class Querier;
+class Root;
+struct KBBase;
+
+//Hands out queriers to threads that query the same KB concurrently. A
+//querier is used by one thread at a time and has its own iterator
+//factories and its own copies of the trees of the KB and of its sample. The
+//tables, the diffs and the memtable are shared, so if the library is not
+//compiled with MT only one querier is handed out at a time.
+class QuerierPool {
+    private:
+        struct Entry {
+            //The base of the tree. Declared first, so it is released after
+            //the tree
+            std::shared_ptr<KBBase> base;
+            std::unique_ptr<Root> tree;
+            std::unique_ptr<Root> sampleTree;
+            //Declared after the trees, so it is deleted first
+            std::unique_ptr<Querier> q;
+
+            ~Entry();
+        };
+
+        KB *kb;
+        const size_t maxIdle;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Entry>> idle;
+        //Held by the handles if the library is compiled without MT
+        std::mutex sessionMutex;
+
+        void release(std::unique_ptr<Entry> entry);
+
+    public:
+        //Gives the querier back to the pool when it goes out of scope
+        class Handle {
+            private:
+                QuerierPool *pool;
+                std::unique_ptr<Entry> entry;
+                //Released after the querier is given back
+                std::unique_lock<std::mutex> session;
+
+            public:
+                Handle(QuerierPool *pool, std::unique_ptr<Entry> entry,
+                        std::unique_lock<std::mutex> session) :
+                    pool(pool), entry(std::move(entry)),
+                    session(std::move(session)) {
+                }
+
+                Handle(Handle &&h) : pool(h.pool), entry(std::move(h.entry)),
+                    session(std::move(h.session)) {
+                }
+
+                Handle(const Handle&) = delete;
+
+                Handle &operator=(const Handle&) = delete;
+
+                Querier *get() const {
+                    return entry->q.get();
+                }
+
+                Querier *operator->() const {
+                    return get();
+                }
+
+                ~Handle() {
+                    if (entry) {
+                        pool->release(std::move(entry));
+                    }
+                }
+        };
+
+        //At most maxIdle queriers are kept when they are not in use
+        QuerierPool(KB *kb, size_t maxIdle);
+
+        //The querier reads the snapshot of the KB that is current when the
+        //handle is acquired. The queriers of a base replaced by a
+        //compaction are not reused. Without MT, it waits until the handle
+        //in use is released, so a thread must not acquire two handles
+        DDLEXPORT Handle acquire();
+
+        //Must be called before the KB is closed. No handle can be in use
+        void clear();
+};
+
+#endif
@@ -28,9 +28,13 @@
 
 #include <kognac/stringscol.h>
 #include <kognac/hashmap.h>
+#include <kognac/filereader.h>
+#include <kognac/utils.h>
 
 #include <string>
 #include <cstring>
+#include <vector>
+#include <memory>
 
 class Querier;
 class PairItr;
@@ -63,18 +67,29 @@ class Updater {
 
         };
 
+        //A parsed triple. The terms point to the arena of the chunk and are
+        //prefixed by their length (2 bytes)
         struct TextualTriple {
             const char *s;
-            int lens;
-            uint64_t nums;
             const char *p;
-            uint64_t nump;
-            int lenp;
             const char *o;
-            uint64_t numo;
-            int leno;
         };
 
+        //The part of the update parsed by one thread. Every distinct term is
+        //copied only once in the arena
+        struct Chunk {
+            std::vector<FileInfo> files;
+            std::unique_ptr<StringCollection> arena;
+            ByteArrayToNumberMap terms;
+            std::vector<TextualTriple> triples;
+            std::vector<Triple> encoded;
+            int64_t invalid;
+
+            Chunk();
+        };
+
+        const int nthreads;
+
         void compressUpdate(DiffIndex::TypeUpdate type,
                 string updatedir,
                 std::vector<uint64_t> &all_s,
@@ -86,8 +101,13 @@ class Updater {
                 StringCollection &tmpdictsupport);
 
         void parseUpdate(std::string update,
-                StringCollection &support,
-                std::vector<TextualTriple> &output);
+                std::vector<std::unique_ptr<Chunk>> &chunks);
+
+        static void parseChunk(Chunk *chunk);
+
+        static void encodeChunk(Chunk *chunk,
+                const std::vector<const char*> &terms,
+                const std::vector<int64_t> &ids);
 
         static void match(DiffIndex::TypeUpdate type,
                 std::vector<uint64_t> &outputs,
@@ -96,35 +116,27 @@ class Updater {
                 Querier *q,
                 std::vector<Triple> &input);
 
-        static bool lessThan(const char *s1, int len1, const char *s2, int len2) {
-            int len = len1 < len2 ? len1 : len2;
-            int c = strncmp(s1, s2, len);
+        //Compares two terms prefixed by their length
+        static bool lessThan(const char *t1, const char *t2) {
+            const int len1 = Utils::decode_short(t1);
+            const int len2 = Utils::decode_short(t2);
+            const int c = memcmp(t1 + 2, t2 + 2, len1 < len2 ? len1 : len2);
             if (c != 0) {
                 return c < 0;
             }
             return len1 < len2;
         }
 
-        static bool sortByS(const TextualTriple &t1, const TextualTriple &t2) {
-            // return std::string(t1.s, t1.lens) < std::string(t2.s, t2.lens);
-            return lessThan(t1.s, t1.lens, t2.s, t2.lens);
-        }
-
-        static bool sortByP(const TextualTriple &t1, const TextualTriple &t2) {
-            // return std::string(t1.p, t1.lenp) < std::string(t2.p, t2.lenp);
-            return lessThan(t1.p, t1.lenp, t2.p, t2.lenp);
-        }
-
-        static bool sortByO(const TextualTriple &t1, const TextualTriple &t2) {
-            // return std::string(t1.o, t1.leno) < std::string(t2.o, t2.leno);
-            return lessThan(t1.o, t1.leno, t2.o, t2.leno);
-        }
-
         static int cmp(PairItr *itr, const Triple &t);
 
         static void writeDict(DictMgmt *dictmgmt, string updatedir, ByteArrayToNumberMap &dict);
 
     public:
+        //The parsing, the encoding and the sorting of the update use
+        //nthreads threads. The lookups in the dictionary are sequential
+        Updater(int nthreads = 1) : nthreads(nthreads < 1 ? 1 : nthreads) {
+        }
+
         LIBEXP void creatediffupdate(DiffIndex::TypeUpdate type, std::string kbdir, std::string updatedir);
 
         LIBEXP static std::string getPathForUpdate(std::string kbdir);
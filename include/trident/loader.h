@@ -26,6 +26,8 @@
 #include <trident/kb/kb.h>
 #include <trident/tree/coordinates.h>
 #include <trident/kb/inserter.h>
+#include <trident/kb/loadcheckpoint.h>
+#include <trident/utils/loadprofiler.h>
 
 #include <kognac/filemerger.h>
 #include <kognac/sorter.h>
@@ -40,6 +42,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <limits>
 
 using namespace std;
 
@@ -79,11 +82,18 @@ typedef struct TreeEl {
 
 class TreeWriter: public TreeInserter {
     private:
+        const string path;
         ofstream fos;
         char supportBuffer[23];
     public:
-        TreeWriter(string path) {
-            fos.open(path, ios_base::binary);
+        //If append is set, the entries already in the file are kept
+        TreeWriter(string path, bool append = false) : path(path) {
+            fos.open(path, append ? ios_base::binary | ios_base::app :
+                    ios_base::binary);
+        }
+
+        string getPath() const {
+            return path;
         }
 
         void addEntry(nTerm key, int64_t nElements, short file, int pos,
@@ -96,6 +106,10 @@ class TreeWriter: public TreeInserter {
             fos.write(supportBuffer, 23);
         }
 
+        void flush() {
+            fos.flush();
+        }
+
         void finish() {
             fos.close();
         }
@@ -104,13 +118,14 @@ class TreeWriter: public TreeInserter {
         }
 };
 
-class CoordinatesMerger {
+class CoordinatesMerger : public TermCoordinatesSource {
     private:
         ifstream spo, ops, pos;
         ifstream sop, osp, pso;
         char supportBuffer[23];
 
         const int ncoordinates;
+        const nTerm endKey;
 
         TreeEl elspo, elops, elpos, elsop, elosp, elpso;
         bool spoFinished, opsFinished, posFinished,
@@ -119,28 +134,40 @@ class CoordinatesMerger {
 
         bool getFirst(TreeEl *el, ifstream *buffer);
 
+        void seek(ifstream *buffer, nTerm startKey);
+
     public:
-        CoordinatesMerger(string *coordinates, int ncoordinates) :
-            ncoordinates(ncoordinates) {
+        //Merges the coordinates with keys in the range [startKey, endKey)
+        CoordinatesMerger(string *coordinates, int ncoordinates,
+                nTerm startKey = 0,
+                nTerm endKey = std::numeric_limits<nTerm>::max()) :
+            ncoordinates(ncoordinates), endKey(endKey) {
 
                 //Open the three files
                 spo.open(coordinates[0], ios_base::binary);
+                seek(&spo, startKey);
                 spoFinished = !getFirst(&elspo, &spo);
 
                 if (ncoordinates > 1) {
                     ops.open(coordinates[1], ios_base::binary);
+                    seek(&ops, startKey);
                     opsFinished = !getFirst(&elops, &ops);
                     pos.open(coordinates[2], ios_base::binary);
+                    seek(&pos, startKey);
                     posFinished = !getFirst(&elpos, &pos);
                 }
 
                 if (ncoordinates == 4) {
                     pso.open(coordinates[3], ios_base::binary);
+                    seek(&pso, startKey);
                     getFirst(&elpso, &pso);
                 } else if (ncoordinates == 6 || ncoordinates == 2) {
                     sop.open(coordinates[3], ios_base::binary);
                     osp.open(coordinates[4], ios_base::binary);
                     pso.open(coordinates[5], ios_base::binary);
+                    seek(&sop, startKey);
+                    seek(&osp, startKey);
+                    seek(&pso, startKey);
                     sopFinished = !getFirst(&elsop, &sop);
                     ospFinished = !getFirst(&elosp, &osp);
                     psoFinished = !getFirst(&elpso, &pso);
@@ -167,47 +194,17 @@ class CoordinatesMerger {
         }
 };
 
-class BufferCoordinates {
-    nTerm keys[10000];
-    TermCoordinates values[10000];
-    int size;
-    int pos;
-    public:
-    BufferCoordinates() {
-        size = pos = 0;
-    }
-
-    void add(nTerm key, TermCoordinates *value) {
-        keys[size] = key;
-        values[size++].copyFrom(value);
-    }
-
-    TermCoordinates *getNext(nTerm &key) {
-        key = keys[pos];
-        return values + pos++;
-    }
-
-    bool isFull() {
-        return size == 10000;
-    }
-
-    bool isEmpty() {
-        return pos == size;
-    }
-
-    void clear() {
-        pos = size = 0;
-    }
-};
-
 struct ParamsMergeDiskFragments {
-    ParamsMergeDiskFragments() {}
-    ParamsMergeDiskFragments(string i) : inputDir(i) {}
+    ParamsMergeDiskFragments() : maxMemory(0) {}
+    ParamsMergeDiskFragments(string i, int64_t maxMemory = 0) : inputDir(i),
+    maxMemory(maxMemory) {}
     string inputDir;
+    int64_t maxMemory;
 };
 
 class SimpleTripleWriter;
 struct ParamInsert {
+    ParamInsert() : maxMemory(0), keepSortedRuns(false), profiler(NULL) {}
     int permutation;
     int parallelProcesses;
     string inputDir;
@@ -222,6 +219,11 @@ struct ParamInsert {
     bool printstats;
     bool removeInput;
     bool deletePreviousExt;
+    int64_t maxMemory;
+    //Do not remove the sorted runs while they are merged
+    bool keepSortedRuns;
+    //If set, the insertion is recorded as a phase of the loading
+    LoadProfiler *profiler;
 };
 
 class L_Triple {
@@ -350,29 +352,6 @@ class L_Triple {
     ~L_TripleCount() {}
 };*/
 
-struct ParamsMergeCoordinates {
-    string *coordinates;
-    int ncoordinates;
-    BufferCoordinates *bufferToFill;
-    bool *isFinished;
-    int *buffersReady;
-    BufferCoordinates *buffer1;
-    BufferCoordinates *buffer2;
-    std::condition_variable *cond;
-    std::mutex *mut;
-};
-
-struct SharedStructs {
-    std::mutex mut;
-    int buffersReady;
-    bool isFinished;
-    std::condition_variable cond;
-    BufferCoordinates buffer1;
-    BufferCoordinates buffer2;
-    BufferCoordinates *bufferToFill;
-    BufferCoordinates *bufferToReturn;
-};
-
 struct ParamsLoad {
     string inputformat;
     bool onlyCompress;
@@ -400,11 +379,13 @@ struct ParamsLoad {
     int thresholdSkipTable;
     string remoteLocation;
     int64_t limitSpace;
+    int64_t maxMemory;
     string graphTransformation;
     int timeoutStats;
     bool storeDicts;
     bool relsOwnIDs;
     bool flatTree;
+    bool resume;
 
     ParamsLoad() {
         /**** DEFAULT VALUES ****/
@@ -432,11 +413,13 @@ struct ParamsLoad {
         thresholdSkipTable = 20;
         remoteLocation = "";
         limitSpace = 0;
+        maxMemory = 0;
         graphTransformation = "";
         timeoutStats = -1;
         storeDicts = true;
         relsOwnIDs = false;
         flatTree = false;
+        resume = false;
     }
 
     std::string tostring() {
@@ -465,11 +448,13 @@ struct ParamsLoad {
         output += ";thresholdSkipTable=" + to_string(thresholdSkipTable);
         output += ";remoteLocation=" + remoteLocation;
         output += ";limitSpace=" + to_string(limitSpace);
+        output += ";maxMemory=" + to_string(maxMemory);
         output += ";graphTransformation=" + graphTransformation;
         output += ";timeoutStats=" + to_string(timeoutStats);
         output += ";storeDicts=" + to_string(storeDicts);
         output += ";relsOwnIDs=" + to_string(relsOwnIDs);
         output += ";flatTree=" + to_string(flatTree);
+        output += ";resume=" + to_string(resume);
         return output;
     }
 };
@@ -477,6 +462,11 @@ struct ParamsLoad {
 class Loader {
     private:
         bool printStats;
+        //If set, the outputs of the completed phases are kept until the
+        //load is finished
+        LoadCheckpoint *checkpoint;
+        //Records the resources used by the phases of the current load
+        LoadProfiler *profiler;
 
     public:
         static void generateNewPermutation(string outputdir,
@@ -521,7 +511,9 @@ class Loader {
         static void insertDictionary(const int part, DictMgmt *dict,
                 string dictFileInput,
                 bool insertDictionary, bool insertInverseDictionary,
-                bool sortNumberCoordinates, nTerm *maxValueCounter);
+                bool sortNumberCoordinates, nTerm *maxValueCounter,
+                int64_t maxMemory = 0,
+                bool keepInput = false);
 
         static void parallelmerge(FileMerger<Triple> *merger,
                 int buffersize,
@@ -533,10 +525,6 @@ class Loader {
                 std::mutex *m_exchange,
                 std::condition_variable *cond_exchange);
 
-        static void processTermCoordinates(Inserter *ins,
-                SharedStructs *structs);
-
-        static void mergeTermCoordinates(ParamsMergeCoordinates params);
     private:
         template<class K>
             static void dumpPermutation_seq(K *start, K *end,
@@ -544,10 +532,10 @@ class Loader {
                     int currentPart,
                     char sorter);
 
-        static BufferCoordinates *getBunchTermCoordinates(SharedStructs *structs);
-
-        static void releaseBunchTermCoordinates(BufferCoordinates *cord,
-                SharedStructs *structs);
+        //Sorts the pairs of a file in runs of at most maxElements and
+        //returns the files of the runs
+        static std::vector<string> sortPairsInRuns(string inputFile,
+                int64_t maxElements);
 
         void exportFiles(string tripleDir, string* dictFiles, const
                 int ndicts, string outputFileTriple, string outputFileDict);
@@ -608,12 +596,22 @@ class Loader {
                 string aggr1Dir,
                 string aggr2Dir,
                 TreeWriter **treeWriters,
-                SimpleTripleWriter *sampleWriter,
+                SimpleTripleWriter *&sampleWriter,
+                string sampleDir,
                 double sampleRate,
                 string remoteLocation,
                 int64_t limitSpace,
                 int64_t estimatedSize,
-                int nindices);
+                int nindices,
+                int64_t maxMemory);
+
+        //True if the index of the permutation was created by the load that
+        //is resumed. Its counters are then restored in the inserter
+        bool restoreIndex(int permutation, Inserter *ins);
+
+        //Records the index of the permutation in the checkpoint
+        void checkpointIndex(int permutation, Inserter *ins,
+                TreeWriter *treeWriter, std::vector<string> outputs);
 
         void loadKB_createSamples(string kbDir,
                 string sampleDir,
@@ -629,7 +627,8 @@ class Loader {
         void loadKB_storeDicts(KB &kb,
                 int dictionaries,
                 string dictMethod,
-                string *fileNameDictionaries);
+                string *fileNameDictionaries,
+                int64_t maxMemory);
 
         void loadKB_handleGraphTransformations(KB &kb,
                 string graphTransformation,
@@ -646,7 +645,8 @@ class Loader {
                 bool storeDicts,
                 string graphTransformation,
                 Inserter *ins,
-                int nindices);
+                int nindices,
+                int parallelThreads);
 
         void loadKB(KB &kb,
                 ParamsLoad &p,
@@ -707,6 +707,8 @@ class Loader {
 
         Loader() {
             printStats = true;
+            checkpoint = NULL;
+            profiler = NULL;
         }
 
         LIBEXP void load(ParamsLoad p);
@@ -11,14 +11,21 @@
 #include <cts/infra/QueryGraph.hpp>
 #include <cts/parser/SPARQLParser.hpp>
 #include <rts/runtime/QueryDict.hpp>
+#include <rts/runtime/QueryContext.hpp>
+#include <trident/sparql/plancache.h>
+#include <trident/kb/compactor.h>
 
 #include <map>
+#include <set>
+#include <mutex>
 
 using namespace std;
 
 class TridentServer {
     protected:
-        TridentLayer kb;
+        //Every request reads the snapshot of the KB that is current when it
+        //starts, so no reader keeps an old base alive
+        KB &kb;
 
     private:
         string dirhtmlfiles;
@@ -31,8 +38,27 @@ class TridentServer {
         std::shared_ptr<HttpServer> server;
         int nthreads;
 
+        //Maximum time (ms) and memory (bytes) of a SPARQL query. 0 means
+        //no limit. A request can only ask for lower limits
+        uint64_t queryTimeout;
+        uint64_t queryMemoryLimit;
+        //The queries that are running, cancelled when the server stops
+        std::mutex queriesMutex;
+        std::set<QueryContext*> runningQueries;
+        //The plans of the queries and the prepared queries
+        PlanCache plancache;
+        //Folds the updates in the indices in the background
+        std::unique_ptr<KBCompactor> compactor;
+
         void startThread(int port);
 
+        //A layer on a querier of the pool of the KB
+        std::unique_ptr<TridentLayer> createSession();
+
+        //Executes a query with the limits of the request
+        void runQuery(const string &req, const string &sparqlquery,
+                bool jsonoutput, JSON &pt);
+
         void processRequest(std::string req, std::string &resp);
 
     public:
@@ -48,6 +74,18 @@ class TridentServer {
         //OK
         void stop();
 
+        void setQueryLimits(uint64_t timeout, uint64_t memoryLimit) {
+            queryTimeout = timeout;
+            queryMemoryLimit = memoryLimit;
+        }
+
+        //Maximum bytes per second rewritten by the compactions (0 means no
+        //limit). Must be called before the server is started
+        void setCompactionRate(uint64_t bytesPerSecond) {
+            compactor = std::unique_ptr<KBCompactor>(new KBCompactor(kb,
+                        bytesPerSecond));
+        }
+
         //OK
         string getDefaultPage();
 
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <vector>
 #include <map>
+#include <tuple>
 
 class AggregateHandler {
     public:
@@ -15,6 +16,8 @@ class AggregateHandler {
             double v_dec;
             TYPE type;
             bool requiresNumber;
+            //The number of times the value occurs in the input
+            uint64_t count;
         };
 
     private:
@@ -38,6 +41,8 @@ class AggregateHandler {
 
 
         unsigned varcount;
+        //The input of COUNT(*), which is not bound by the query
+        unsigned starVar;
         std::map<FUNC,std::map<unsigned,unsigned>> assignments;
         uint64_t inputmask;
         std::vector<VarValue> varvalues;
@@ -53,7 +58,8 @@ class AggregateHandler {
         bool execMin(FunctCall &call);
 
     public:
-        AggregateHandler(unsigned varcount) : varcount(varcount) {
+        AggregateHandler(unsigned varcount) : varcount(varcount),
+        starVar(~0u) {
         }
 
         unsigned getNewOrExistingVar(FUNC funID,
@@ -67,6 +73,20 @@ class AggregateHandler {
             return assignments.empty();
         }
 
+        bool onlyCounts() const {
+            return assignments.size() == 1 && assignments.count(COUNT);
+        }
+
+        //COUNT(*) counts the rows. Its input is not in the input variables
+        //and must be updated once per row
+        bool hasStar() const {
+            return starVar != ~0u;
+        }
+
+        unsigned getStarVar() const {
+            return starVar;
+        }
+
         void prepare();
 
         void reset();
@@ -76,6 +96,9 @@ class AggregateHandler {
         std::pair<std::vector<unsigned>,
             std::vector<unsigned>> getInputOutputVars() const;
 
+        //Returns the functions as (function, input var, output var)
+        std::vector<std::tuple<FUNC, unsigned, unsigned>> getFunctions() const;
+
         void updateVarInt(unsigned var, int64_t value, uint64_t count);
 
         void updateVarSymbol(unsigned var, uint64_t value, uint64_t count);
@@ -30,6 +30,9 @@
 #include <trident/iterators/pairitr.h>
 #include <trident/kb/querier.h>
 #include <trident/model/table.h>
+#include <trident/utils/radixjoin.h>
+
+#include <rts/runtime/QueryContext.hpp>
 
 #include <iostream>
 #include <algorithm>
@@ -87,20 +90,26 @@ class NestedMergeJoinItr : public TupleIterator {
         const uint64_t *currentBuffer;
         bool deleteOutputResults;
 
-        //const Timeout * const timeout;
+        //The limits of the query (if any). The join stops when they are
+        //exceeded
+        QueryContext *context;
 
     public:
-        NestedMergeJoinItr(Querier *q, std::shared_ptr<NestedJoinPlan> plan) {
+        NestedMergeJoinItr(Querier *q, std::shared_ptr<NestedJoinPlan> plan,
+                QueryContext *context = NULL) {
             this->q = q;
             this->plan = plan;
+            this->context = context;
             init(getFirstIterator(plan->patterns[0]), NULL, 0);
         }
 
         NestedMergeJoinItr(Querier *q, std::shared_ptr<NestedJoinPlan> plan,
                 PairItr *firstIterator,
-                TupleTable *outputR, int64_t limitOutputTuple) {
+                TupleTable *outputR, int64_t limitOutputTuple,
+                QueryContext *context = NULL) {
             this->q = q;
             this->plan = plan;
+            this->context = context;
             init(firstIterator, outputR, limitOutputTuple);
         }
 
@@ -120,18 +129,6 @@ class NestedMergeJoinItr : public TupleIterator {
 };
 
 class SPARQLOperator;
-typedef google::dense_hash_map<uint64_t, size_t, std::hash<uint64_t>, std::equal_to<uint64_t>> HashJoinMap;
-struct _PairHash {
-    typedef std::pair<uint64_t, uint64_t> argument_type;
-    typedef std::size_t result_type;
-    result_type operator()(argument_type const& s) const noexcept {
-        result_type const h1(std::hash<uint64_t>{}(s.first));
-        result_type const h2(std::hash<uint64_t>{}(s.second));
-        return h1 ^ (h2 << 1);
-    }
-};
-typedef google::dense_hash_map<std::pair<uint64_t, uint64_t>, size_t, _PairHash,
-        std::equal_to<std::pair<uint64_t, uint64_t>>> DoubleHashJoinMap;
 class HashJoinItr : public TupleIterator {
     private:
         std::vector<std::shared_ptr<SPARQLOperator>> children;
@@ -145,8 +142,7 @@ class HashJoinItr : public TupleIterator {
 
         void fillNextMap(const int i, std::vector<uint64_t> &currentMapValues,
                 int &currentMapRowSize,
-                std::unique_ptr<HashJoinMap> &currentMap1,
-                std::unique_ptr<DoubleHashJoinMap> &currentMap2,
+                RadixJoinTable &currentMap,
                 std::vector<uint64_t> &tmpContainer,
                 const int tmpContainerRowSize,
                 std::vector<size_t> &idxRows);
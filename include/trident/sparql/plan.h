@@ -39,6 +39,8 @@ class TridentQueryPlan {
 private:
 
     Querier *q;
+    //Optional. The limits of the query, checked by the joins
+    QueryContext *context;
 
     std::map<string, uint64_t> mapVars1;
     std::map<uint64_t, string> mapVars2;
@@ -55,7 +57,8 @@ private:
 
 public:
 
-    TridentQueryPlan(Querier *q) : q(q) {
+    TridentQueryPlan(Querier *q, QueryContext *context = NULL) : q(q),
+        context(context) {
     }
 
     void create(Query & query, int typePlanning);
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _PLAN_CACHE_H
+#define _PLAN_CACHE_H
+
+#include <cts/infra/QueryGraph.hpp>
+#include <cts/plangen/PlanGen.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//A query prepared once and executed many times with new constants. The
+//parameters are the constants of its triple patterns, in the order of the
+//text. A parameter is a single RDF term in SPARQL syntax, e.g., <iri>,
+//prefix:name, "literal"@lang or 42
+class PreparedQuery {
+    private:
+        //The text around the parameters, one more than the parameters
+        std::vector<std::string> parts;
+
+        static bool isTerm(const std::string &term);
+
+    public:
+        //Throws a SPARQLParser::ParserException if the query is not valid
+        PreparedQuery(const std::string &query);
+
+        size_t getNParameters() const {
+            return parts.size() - 1;
+        }
+
+        //Returns false if the number of parameters is wrong or a parameter
+        //is not a single term
+        bool bind(const std::vector<std::string> &parameters,
+                std::string &query) const;
+};
+
+//The plans of the queries that were executed, keyed on the text of the
+//query where the constants of the triple patterns are replaced by
+//parameters. A query with the same key reuses the plan with its own
+//constants, so that only the code generation runs again. The plans are
+//dropped when the KB publishes a new snapshot, i.e., when its diffs and
+//thus its statistics change.
+class PlanCache {
+    public:
+        //A plan and the query graph it points to
+        struct Entry {
+            std::unique_ptr<QueryGraph> queryGraph;
+            std::unique_ptr<PlanGen> plangen;
+            Plan *plan;
+            //Held while the constants of the query graph are replaced and
+            //the operators are built from the plan
+            std::mutex mutex;
+
+            Entry() : plan(NULL) {}
+        };
+
+    private:
+        const size_t maxEntries;
+        std::mutex mutex;
+        //The version of the statistics of the KB that the plans were built on
+        uint64_t version;
+        //The least recently used key is at the end
+        std::list<std::string> lru;
+        std::unordered_map<std::string, std::pair<std::shared_ptr<Entry>,
+            std::list<std::string>::iterator>> entries;
+        uint64_t hits;
+        uint64_t misses;
+
+        std::map<uint64_t, std::shared_ptr<const PreparedQuery>> prepared;
+        uint64_t nextPreparedId;
+
+        //Drops the plans of the older versions. Returns false if the
+        //version is older than the cached plans
+        bool checkVersion(uint64_t version);
+
+    public:
+        PlanCache(size_t maxEntries = 1024);
+
+        //The key of a query. The constants are the ones recorded by the
+        //parser of the query
+        static std::string getKey(const std::string &query,
+                const std::vector<std::pair<size_t, size_t>> &constants);
+
+        //Copies the constants of the triple patterns of a query graph into
+        //the graph of an entry. Returns false if the two graphs differ in
+        //more than those constants, e.g., because a constant was not found
+        //and a part of the query was dropped
+        static bool copyConstants(const QueryGraph &from, QueryGraph &to);
+
+        //Returns NULL if there is no plan for the key and the version of
+        //the KB
+        std::shared_ptr<Entry> get(const std::string &key, uint64_t version);
+
+        void put(const std::string &key, uint64_t version,
+                std::shared_ptr<Entry> entry);
+
+        void clear();
+
+        size_t size();
+
+        uint64_t getHits();
+
+        uint64_t getMisses();
+
+        //Returns the id of the prepared query. Throws a
+        //SPARQLParser::ParserException if the query is not valid
+        uint64_t prepare(const std::string &query);
+
+        //Returns NULL if the id is unknown
+        std::shared_ptr<const PreparedQuery> getPrepared(uint64_t id);
+
+        void unprepare(uint64_t id);
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include <cts/infra/QueryGraph.hpp>
 #include <cts/parser/SPARQLParser.hpp>
 #include <rts/runtime/QueryDict.hpp>
+#include <rts/runtime/QueryContext.hpp>
+#include <trident/sparql/plancache.h>
 
 class SPARQLUtils {
     public:
@@ -24,7 +26,9 @@ class SPARQLUtils {
                 bool jsonoutput,
                 JSON *jsonvars,
                 JSON *jsonresults,
-                JSON *jsonstats);
+                JSON *jsonstats,
+                QueryContext *context = NULL,
+                PlanCache *cache = NULL);
 };
 
 #endif
@@ -99,6 +99,7 @@ class NestedMergeJoin : public Join {
 private:
     Querier *q;
     std::shared_ptr<NestedJoinPlan> nestedPlan;
+    QueryContext *context;
 
 public:
     NestedMergeJoin(Querier *q,
@@ -115,6 +116,11 @@ public:
         return NESTEDMERGEJOIN;
     }
 
+    //The iterators stop when the limits of the query are exceeded
+    void setQueryContext(QueryContext *context) {
+        this->context = context;
+    }
+
     TupleIterator *getIterator();
 
     void releaseIterator(TupleIterator *itr);
@@ -70,6 +70,9 @@ public:
 
     void registerNode(Node *node);
 
+    //Removes a node from the cache without writing it
+    void unregisterNode(Node *node);
+
     Leaf *newLeaf() {
         return factory->get();
     }
@@ -84,6 +87,17 @@ public:
 
     void flushNode(Node *node, const bool registerNode);
 
+    //Write a node that was already serialized (and compressed if needed)
+    void storeSerializedNode(int64_t id, bool children, char *buffer,
+            int sizeBuffer);
+
+    bool areNodesCompressed() const {
+        return compressedNodes;
+    }
+
+    //Returns the size of the compressed buffer
+    static int compressNode(char *input, int sizeInput, char *output);
+
     void flushAllCache();
 
     ~Cache() {
@@ -47,6 +47,11 @@ public:
 
     IntermediateNode(TreeContext *context, Node *child1, Node *child2);
 
+    //Used by the bulk loader. The children are already stored on disk and
+    //keys[i] separates the child i from the child i + 1
+    void setStoredChildren(const int64_t *idChildren, const int64_t *keys,
+                           const int nChildren);
+
     bool get(nTerm key, int64_t &coordinates);
 
     bool get(tTerm *key, const int sizeKey, nTerm *value);
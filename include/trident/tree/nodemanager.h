@@ -94,6 +94,8 @@ public:
 
     void put(Node *node, char *buffer, int sizeBuffer);
 
+    void put(int64_t id, bool children, char *buffer, int sizeBuffer);
+
     CachedNode *getCachedNode(int64_t id);
 
     static void compressSpace(string path);
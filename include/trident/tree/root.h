@@ -29,6 +29,7 @@
 #include <trident/utils/propertymap.h>
 
 #include <string>
+#include <vector>
 
 class Node;
 class TreeContext;
@@ -55,6 +56,14 @@ typedef enum params {
     NODE_KEYS_PREALL_FACTORY_SIZE
 } TreeParams;
 
+//Sorted stream of (key, coordinates) used to bulk load the tree
+class TermCoordinatesSource {
+    public:
+        virtual TermCoordinates *get(nTerm &key) = 0;
+
+        virtual ~TermCoordinatesSource() {}
+};
+
 class Root {
     private:
         Cache *cache;
@@ -70,6 +79,11 @@ class Root {
 
         void flushChildrenToCache();
 
+        static void bulkLoadLeaves(TermCoordinatesSource *source,
+                std::string file, int maxElementsPerNode, bool compressedNodes,
+                std::vector<int64_t> *smallestKeys,
+                std::vector<int64_t> *largestKeys);
+
     protected:
         Root() : readOnly(true), path("") {
             cache = NULL;
@@ -109,6 +123,11 @@ class Root {
 
         bool get(nTerm key, int64_t &coordinates);
 
+        //Builds a new tree bottom-up. The sources cover disjoint and
+        //increasing key ranges: the leaves of each source are created in
+        //parallel, then the nodes are written sequentially
+        void bulkLoad(std::vector<TermCoordinatesSource*> &sources);
+
 };
 
 #endif /* ROOT_H_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _KEY_FILTER_H
+#define _KEY_FILTER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//Bloom filter on the keys of an index, together with the smallest and
+//the largest key. It can only give false positives. A filter that was not
+//initialized accepts every key
+class KeyFilter {
+    private:
+        std::vector<uint64_t> bits;
+        uint64_t nbits;
+        uint8_t nhashes;
+        int64_t minKey;
+        int64_t maxKey;
+        bool enabled;
+
+        static uint64_t hash(int64_t key, uint64_t seed);
+
+    public:
+        KeyFilter();
+
+        void init(uint64_t nkeys, int bitsPerKey = 10);
+
+        void add(int64_t key);
+
+        bool mayContain(int64_t key) const {
+            if (!enabled) {
+                return true;
+            }
+            if (key < minKey || key > maxKey) {
+                return false;
+            }
+            const uint64_t h1 = hash(key, 0);
+            const uint64_t h2 = hash(key, h1) | 1;
+            for (uint8_t i = 0; i < nhashes; ++i) {
+                const uint64_t bit = (h1 + i * h2) % nbits;
+                if (!(bits[bit >> 6] & ((uint64_t)1 << (bit & 63)))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool isEnabled() const {
+            return enabled;
+        }
+
+        void store(std::string file) const;
+
+        //Returns false (and leaves the filter disabled) if the file does
+        //not exist
+        bool load(std::string file);
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _LOAD_PROFILER_H
+#define _LOAD_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <map>
+
+//Collects resource statistics of the phases of the loading. The CPU time
+//and the I/O counters are process-wide, so the phases should not overlap
+//unless they are nested. A phase is nested in the innermost open phase of
+//its thread or, if there is none, of the thread that created the profiler
+class LoadProfiler {
+    private:
+        struct Phase {
+            std::string name;
+            int level;
+            std::thread::id thread;
+            int threads;
+            bool finished;
+            std::chrono::steady_clock::time_point startWall;
+            double startCPU;
+            int64_t startRead, startWrite;
+            int64_t startPhyRead, startPhyWrite;
+
+            double wallTime;
+            double cpuTime;
+            int64_t bytesRead, bytesWritten;
+            int64_t phyBytesRead, phyBytesWritten;
+            int64_t peakRSS; //KB
+            int64_t maxThreads;
+        };
+
+        std::vector<Phase> phases;
+        int openPhases;
+        //The open phases of every thread, the innermost is the last
+        std::map<std::thread::id, std::vector<size_t>> openPerThread;
+        const std::thread::id owner;
+        std::chrono::steady_clock::time_point start;
+
+        const int samplingMs;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool isFinished;
+        std::thread sampler;
+
+        void sample();
+
+        void updatePeaks(int64_t rss, int64_t threads);
+
+    public:
+        //samplingMs sets how often the RSS and the number of threads are
+        //read while some phase is running
+        LoadProfiler(int samplingMs = 50);
+
+        size_t startPhase(std::string name, int threads);
+
+        void endPhase(size_t id);
+
+        void writeReport(std::string file, std::string params);
+
+        ~LoadProfiler();
+
+        static double getCPUTime();
+};
+
+//Records a phase for the lifetime of the object. It does nothing if the
+//profiler is NULL
+class LoadPhase {
+    private:
+        LoadProfiler *profiler;
+        size_t id;
+        bool ended;
+
+    public:
+        LoadPhase(LoadProfiler *profiler, std::string name, int threads) :
+            profiler(profiler), id(0), ended(false) {
+                if (profiler != NULL) {
+                    id = profiler->startPhase(name, threads);
+                }
+            }
+
+        void end() {
+            if (profiler != NULL && !ended) {
+                profiler->endPhase(id);
+            }
+            ended = true;
+        }
+
+        ~LoadPhase() {
+            end();
+        }
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _LOSER_TREE_H
+#define _LOSER_TREE_H
+
+#include <kognac/lz4io.h>
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+
+/*
+ * Tournament tree used to merge k sorted runs. Every internal node stores the
+ * run that lost the match played at that node, so replacing the head of the
+ * winning run only replays the log2(k) matches on its path to the root.
+ */
+template<typename K>
+class LoserTree {
+    private:
+        bool (*less)(const K&, const K&);
+        size_t k;
+        std::vector<size_t> losers;
+        std::vector<K> heads;
+        std::vector<bool> exhausted;
+        size_t winner;
+        size_t nactive;
+
+        bool beats(const size_t a, const size_t b) const {
+            if (exhausted[a])
+                return false;
+            if (exhausted[b])
+                return true;
+            if (less(heads[a], heads[b]))
+                return true;
+            if (less(heads[b], heads[a]))
+                return false;
+            return a < b; //Keep the merge stable
+        }
+
+        size_t build(const size_t node) {
+            if (node >= k)
+                return node - k;
+            const size_t l = build(2 * node);
+            const size_t r = build(2 * node + 1);
+            if (beats(l, r)) {
+                losers[node] = r;
+                return l;
+            } else {
+                losers[node] = l;
+                return r;
+            }
+        }
+
+        void replay(size_t run) {
+            size_t node = (run + k) / 2;
+            while (node > 0) {
+                if (beats(losers[node], run)) {
+                    std::swap(losers[node], run);
+                }
+                node /= 2;
+            }
+            winner = run;
+        }
+
+    public:
+        LoserTree(bool (*less)(const K&, const K&)) : less(less), k(0),
+        winner(0), nactive(0) {
+        }
+
+        //Each run is identified by its position. Runs without a first element
+        //must be marked as exhausted.
+        void init(std::vector<K> &first, std::vector<bool> &empty) {
+            k = first.size();
+            heads = first;
+            exhausted = empty;
+            nactive = 0;
+            for (auto e : exhausted) {
+                if (!e)
+                    nactive++;
+            }
+            losers.resize(k);
+            winner = k > 0 ? build(1) : 0;
+        }
+
+        bool isEmpty() const {
+            return nactive == 0;
+        }
+
+        size_t getWinnerRun() const {
+            return winner;
+        }
+
+        const K &getWinner() const {
+            return heads[winner];
+        }
+
+        //Replace the head of the winning run with its next element
+        void replaceWinner(const K &next) {
+            heads[winner] = next;
+            replay(winner);
+        }
+
+        //The winning run has no more elements
+        void removeWinner() {
+            exhausted[winner] = true;
+            nactive--;
+            replay(winner);
+        }
+};
+
+/*
+ * Merges a set of sorted LZ4 files with a LoserTree. K must provide
+ * readFrom(LZ4Reader*).
+ */
+template<typename K>
+class LoserTreeFileMerger {
+    private:
+        std::vector<std::string> files;
+        std::vector<std::unique_ptr<LZ4Reader>> readers;
+        LoserTree<K> tree;
+        const bool removeFiles;
+
+    public:
+        LoserTreeFileMerger(std::vector<std::string> files,
+                bool (*less)(const K&, const K&),
+                bool removeFiles) : files(files), tree(less),
+        removeFiles(removeFiles) {
+            std::vector<K> first(files.size());
+            std::vector<bool> empty(files.size());
+            for (size_t i = 0; i < files.size(); ++i) {
+                readers.push_back(std::unique_ptr<LZ4Reader>(
+                            new LZ4Reader(files[i])));
+                if (readers[i]->isEof()) {
+                    empty[i] = true;
+                } else {
+                    first[i].readFrom(readers[i].get());
+                    empty[i] = false;
+                }
+            }
+            tree.init(first, empty);
+        }
+
+        bool isEmpty() const {
+            return tree.isEmpty();
+        }
+
+        K get() {
+            K out = tree.getWinner();
+            LZ4Reader *reader = readers[tree.getWinnerRun()].get();
+            if (reader->isEof()) {
+                tree.removeWinner();
+            } else {
+                K next;
+                next.readFrom(reader);
+                tree.replaceWinner(next);
+            }
+            return out;
+        }
+
+        ~LoserTreeFileMerger() {
+            readers.clear();
+            if (removeFiles) {
+                for (auto &f : files) {
+                    Utils::remove(f);
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _QUERY_ARENA_H
+#define _QUERY_ARENA_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+//Monotonic allocator for the objects that live as long as a query. Memory
+//is handed out from large blocks and is only given back with reset(), which
+//keeps the blocks around for the next query. The arena is not thread-safe:
+//it should be used by one query (and one thread) at the time
+class QueryArena {
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            size_t size;
+        };
+
+        const size_t blockSize;
+        std::vector<Block> blocks;
+        size_t currentBlock;
+        size_t pos;
+
+        uint64_t nallocations;
+        uint64_t nbytes;
+        std::atomic<bool> busy;
+
+        //Arena used by the objects created in the current thread
+        static thread_local QueryArena *current;
+        //Number of ArenaObjects allocated on the heap
+        static std::atomic<uint64_t> heapAllocations;
+
+        friend class ArenaObject;
+
+    public:
+        static const size_t ALIGNMENT = 16;
+        //Blocks kept after a reset
+        static const size_t MAX_RETAINED_BLOCKS = 8;
+
+        QueryArena(size_t blockSize = 64 * 1024);
+
+        void *allocate(size_t size);
+
+        //Releases everything that was allocated since the last reset. All
+        //the objects in the arena must have been destroyed before
+        void reset();
+
+        uint64_t getNAllocations() const {
+            return nallocations;
+        }
+
+        uint64_t getNBytes() const {
+            return nbytes;
+        }
+
+        size_t getCapacity() const;
+
+        //Returns false if another query owns the arena
+        bool acquire() {
+            bool expected = false;
+            return busy.compare_exchange_strong(expected, true);
+        }
+
+        void release() {
+            busy = false;
+        }
+
+        static QueryArena *getCurrent() {
+            return current;
+        }
+
+        static uint64_t getHeapAllocations() {
+            return heapAllocations.load();
+        }
+
+        //Makes an arena the current one of this thread until the scope is
+        //closed. A NULL arena sends the allocations back to the heap
+        class Scope {
+            private:
+                QueryArena *prev;
+            public:
+                Scope(QueryArena *arena) : prev(current) {
+                    current = arena;
+                }
+
+                ~Scope() {
+                    current = prev;
+                }
+        };
+
+        //Acquires an arena for a query and resets and releases it when it
+        //is destroyed, also if the query throws. get() returns NULL if the
+        //arena is NULL or another query owns it
+        class Lease {
+            private:
+                QueryArena *arena;
+
+                Lease(const Lease&) = delete;
+                Lease &operator=(const Lease&) = delete;
+            public:
+                Lease(QueryArena *arena) : arena(arena && arena->acquire() ?
+                        arena : NULL) {
+                }
+
+                QueryArena *get() const {
+                    return arena;
+                }
+
+                ~Lease() {
+                    if (arena) {
+                        arena->reset();
+                        arena->release();
+                    }
+                }
+        };
+};
+
+//Base class of the objects that should be taken from the current arena when
+//they are created with new. delete still runs the destructor, but the memory
+//of the objects in an arena is given back only when the arena is reset
+class ArenaObject {
+    public:
+        static void *operator new(size_t size);
+
+        static void operator delete(void *p);
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#ifndef _RADIX_JOIN_H
+#define _RADIX_JOIN_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Hash table for the build side of a join. The tuples are partitioned on the
+//high bits of the hash of their key so that each partition fits in the
+//cache. Every partition has its own open-addressing table that stores the
+//keys inline, together with the range of the tuples that have that key.
+//The partitions are built in parallel
+class RadixJoinTable {
+    public:
+        //A key of one or two values and the payload of the caller (e.g.,
+        //the position of the row)
+        struct Tuple {
+            uint64_t key1;
+            uint64_t key2;
+            uint64_t payload;
+        };
+
+    private:
+        struct Slot {
+            uint64_t key1;
+            uint64_t key2;
+            //The tuples with this key. An empty slot has count 0
+            uint64_t begin;
+            uint64_t count;
+        };
+
+        struct Partition {
+            uint64_t firstSlot;
+            uint64_t mask;
+        };
+
+        //Grouped by partition and sorted by key within a partition
+        std::vector<Tuple> tuples;
+        std::vector<Slot> slots;
+        std::vector<Partition> partitions;
+        unsigned radixBits;
+        uint64_t nkeys;
+
+        static uint64_t hash(uint64_t key1, uint64_t key2) {
+            uint64_t h = key1 * 0x9E3779B97F4A7C15ull ^ key2;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        uint64_t getPartition(uint64_t h) const {
+            return radixBits ? h >> (64 - radixBits) : 0;
+        }
+
+    public:
+        //Tuples per partition, so that a partition and its table fit in
+        //the L2 cache
+        static const uint64_t PARTITION_SIZE = 8192;
+
+        RadixJoinTable();
+
+        //Takes the content of the input. Uses up to nthreads threads
+        void build(std::vector<Tuple> &input, int nthreads);
+
+        //Returns the tuples with the given key (count is 0 if there are
+        //none)
+        const Tuple *find(uint64_t key1, uint64_t key2, uint64_t &count) const {
+            const uint64_t h = hash(key1, key2);
+            const Partition &p = partitions[getPartition(h)];
+            const Slot *table = slots.data() + p.firstSlot;
+            uint64_t pos = h & p.mask;
+            while (table[pos].count) {
+                if (table[pos].key1 == key1 && table[pos].key2 == key2) {
+                    count = table[pos].count;
+                    return tuples.data() + table[pos].begin;
+                }
+                pos = (pos + 1) & p.mask;
+            }
+            count = 0;
+            return NULL;
+        }
+
+        //All tuples. The ones with the same key are next to each other
+        const std::vector<Tuple> &getTuples() const {
+            return tuples;
+        }
+
+        uint64_t getNKeys() const {
+            return nkeys;
+        }
+
+        //Approximate memory used by a tuple in the table
+        static uint64_t getBytesPerTuple() {
+            return sizeof(Tuple) + 2 * sizeof(Slot);
+        }
+
+        void clear();
+};
+
+#endif
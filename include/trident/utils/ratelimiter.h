@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _RATE_LIMITER_H
+#define _RATE_LIMITER_H
+
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+//Throttles a stream of I/O operations to a maximum number of bytes per
+//second. A limit of 0 disables the throttling
+class RateLimiter {
+    private:
+        const uint64_t bytesPerSecond;
+        uint64_t consumed;
+        uint64_t lastCheck;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        RateLimiter(uint64_t bytesPerSecond) : bytesPerSecond(bytesPerSecond),
+        consumed(0), lastCheck(0) {
+            start = std::chrono::steady_clock::now();
+        }
+
+        void consume(uint64_t bytes) {
+            if (bytesPerSecond == 0) {
+                return;
+            }
+            consumed += bytes;
+            //Do not check the clock for every small operation
+            if (consumed - lastCheck < 64 * 1024) {
+                return;
+            }
+            lastCheck = consumed;
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            const double expected = (double) consumed / bytesPerSecond;
+            if (expected > elapsed.count()) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(
+                            expected - elapsed.count()));
+            }
+        }
+
+        uint64_t getConsumedBytes() const {
+            return consumed;
+        }
+};
+
+#endif
@@ -36,6 +36,12 @@ class TridentUtils {
 
         static int64_t getVmRSS();
 
+        //Peak resident set size (in KB) since the start of the process
+        static int64_t getPeakRSS();
+
+        //Parses sizes like "512M" or "32G" into bytes
+        static int64_t parseMemorySize(std::string size);
+
         static double getCPUUsage();
 
         static int64_t diskread();
@@ -26,6 +26,8 @@ class SPARQLLexer
    std::string input;
    /// The current position
    std::string::const_iterator pos;
+   /// The position before the current token and the whitespace before it
+   std::string::const_iterator lastPos;
    /// The start of the current token
    std::string::const_iterator tokenStart;
    /// The end of the curent token. Only set if delimiters are stripped
@@ -58,6 +60,9 @@ class SPARQLLexer
 
    /// Return the read pointer
    std::string::const_iterator getReader() const { return (putBack!=None)?tokenStart:pos; }
+   /// Return the offset of the read pointer in the input. A token put back
+   /// is read again, so the offset is the end of the token before it
+   size_t getReaderOffset() const { return ((putBack!=None)?lastPos:pos)-input.begin(); }
 };
 //---------------------------------------------------------------------------
 #endif
@@ -186,6 +186,9 @@ class SPARQLParser {
         unsigned offset;
         // Silent output variables
         bool silentOutputVars;
+        /// The positions of the constants of the triple patterns in the
+        /// input (begin and end), in the order of the input
+        std::vector<std::pair<size_t, size_t> > constants;
 
         /// Lookup or create a named variable
         unsigned nameVariable(const std::string& name);
@@ -224,6 +227,8 @@ class SPARQLParser {
         void parseFilter(PatternGroup& group, std::map<std::string, unsigned>& localVars);
         /// Parse an entry in a pattern
         Element parsePatternElement(PatternGroup& group, std::map<std::string, unsigned>& localVars);
+        /// Parse an entry of a triple pattern, remember where its constant is
+        Element parseTripleElement(PatternGroup& group, std::map<std::string, unsigned>& localVars);
         /// Parse blank node patterns
         Element parseBlankNode(PatternGroup& group, std::map<std::string, unsigned>& localVars);
         // Parse a graph pattern
@@ -325,6 +330,11 @@ class SPARQLParser {
         }
 
         SLIBEXP unsigned getVarCount() const;
+
+        /// The positions of the constants of the triple patterns in the input
+        const std::vector<std::pair<size_t, size_t> > &getConstants() const {
+            return constants;
+        }
 };
 //---------------------------------------------------------------------------
 #endif
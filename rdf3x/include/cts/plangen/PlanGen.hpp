@@ -37,6 +37,8 @@ class PlanGen {
         DBLayer* db;
         /// The current query
         const QueryGraph* fullQuery;
+        /// Use the multiway join for cyclic patterns?
+        bool multiwayJoins;
 
         SLIBEXP PlanGen(const PlanGen&);
         void operator=(const PlanGen&);
@@ -70,6 +72,9 @@ class PlanGen {
         Problem* buildTableFunction(const QueryGraph::TableFunction& function,
                 uint64_t id);
 
+        /// Can the patterns be joined with a single multiway join?
+        bool isCyclicPattern(const QueryGraph::SubQuery& query);
+
         //Add a filter
         Plan* buildFilters(const QueryGraph::SubQuery& query, Plan* plan, uint64_t value1, uint64_t value2, uint64_t value3);
         Plan *attachFiltersToPlan(QueryGraph::Filter *filter, Plan *plan);
@@ -82,6 +87,10 @@ class PlanGen {
         /// Destructor
         SLIBEXP ~PlanGen();
 
+        /// Join the cyclic patterns with a multiway join (default) or only
+        /// with binary joins
+        void setMultiwayJoins(bool enabled) { multiwayJoins = enabled; }
+
         void init(DBLayer* db, const QueryGraph& query);
         /// Translate a query into an operator tree
         SLIBEXP Plan* translate(DBLayer& db, const QueryGraph& query, bool completeEstimate = true);
@@ -26,6 +26,8 @@
 #define DDLEXPORT
 #endif
 
+class SemiJoinFilter;
+
 class DBLayer {
     public:
 
@@ -51,23 +53,47 @@ class DBLayer {
 
                 virtual bool first(uint64_t, bool, uint64_t, bool, uint64_t, bool) = 0;
 
+                //Restricts first() and next() to the triples whose first
+                //value is in [from, to). Used to split a scan in morsels
+                virtual void setKeyRange(uint64_t from, uint64_t to) = 0;
+
                 virtual ~Scan() {}
         };
 
+        //Iterates over the sorted distinct values that follow a prefix of
+        //bound values in a permutation. Used by the multiway joins
+        class Cursor {
+            public:
+                //Moves to the first value after the prefix. Returns false
+                //if there is none
+                virtual bool open(const uint64_t *prefix) = 0;
+
+                virtual uint64_t getValue() = 0;
+
+                virtual bool next() = 0;
+
+                //Moves to the first value >= target
+                virtual bool seek(uint64_t target) = 0;
+
+                virtual ~Cursor() {}
+        };
+
         class Hint {
             private:
-                std::vector<uint64_t> *hashKeys = NULL; // Keys of a hashjoin. Significant for the right iterator.
+                const SemiJoinFilter *hashKeys = NULL; // Keys of a hashjoin. Significant for the right iterator.
                 int varbitset = 0;
 
             public:
-                std::vector<uint64_t> *getKeys(int *bitset) {
+                //The bitset tells the positions of the keys in the
+                //triples: 1 - subject, 2 - predicate, 4 - object
+                const SemiJoinFilter *getKeys(int *bitset) {
                     if (bitset != NULL) {
                         *bitset = varbitset;
                     }
                     return hashKeys;
                 }
 
-                void setKeys(std::vector<uint64_t> *keys, int bitset) {
+                void setKeys(const SemiJoinFilter *keys, int bitset) {
                     hashKeys = keys;
                     varbitset = bitset;
                 }
@@ -161,10 +187,24 @@ class DBLayer {
 
         virtual uint64_t getCardinality() = 0;
 
+        //True if some triples are stored outside the indices (e.g., in
+        //the updates). If so, the counts in the indices are not exact
+        virtual bool hasUpdates() = 0;
+
         virtual std::unique_ptr<DBLayer::Scan> getScan(const DataOrder order,
                 const Aggr_t aggr,
                 Hint *hint) = 0;
 
+        virtual bool hasPermutation(const DataOrder order) = 0;
+
+        //A layer with its own querier, for the threads that run parts of a
+        //query in parallel
+        virtual std::unique_ptr<DBLayer> createWorker() = 0;
+
+        //The cursor reads the values in position prefixSize of the order
+        virtual std::unique_ptr<DBLayer::Cursor> getCursor(const DataOrder order,
+                const unsigned prefixSize) = 0;
+
         virtual ~DBLayer() {
         }
 };
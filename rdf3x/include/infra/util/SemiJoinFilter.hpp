@@ -0,0 +1,57 @@
+#ifndef H_infra_util_SemiJoinFilter
+#define H_infra_util_SemiJoinFilter
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <trident/utils/keyfilter.h>
+
+#include <algorithm>
+#include <vector>
+#include <inttypes.h>
+//---------------------------------------------------------------------------
+/// The join keys of a hash join build side, used by the scans of the probe
+/// side to skip keys that cannot join. Small key sets are kept exactly as a
+/// sorted array, larger ones in a Bloom filter
+class SemiJoinFilter
+{
+   public:
+   /// The largest key set that is kept as a sorted array
+   static const unsigned maxSortedKeys = 4096;
+
+   private:
+   /// The keys, if exact
+   std::vector<uint64_t> keys;
+   /// The Bloom filter otherwise
+   KeyFilter bloom;
+   /// Exact set?
+   bool exact;
+
+   public:
+   /// Constructor
+   SemiJoinFilter();
+
+   /// Build the filter over a set of distinct keys
+   void build(const std::vector<uint64_t>& keys);
+   /// Is the set exact (i.e., a sorted array)?
+   bool isExact() const { return exact; }
+   /// Is the key possibly in the set?
+   bool contains(uint64_t key) const {
+      if (exact)
+         return std::binary_search(keys.begin(),keys.end(),key);
+      return bloom.mayContain(static_cast<int64_t>(key));
+   }
+   /// The smallest key >= the given one, ~0 if none. Exact sets only
+   uint64_t seek(uint64_t key) const {
+      std::vector<uint64_t>::const_iterator pos=std::lower_bound(keys.begin(),keys.end(),key);
+      return (pos==keys.end())?~static_cast<uint64_t>(0):(*pos);
+   }
+};
+//---------------------------------------------------------------------------
+#endif
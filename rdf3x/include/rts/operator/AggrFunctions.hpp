@@ -49,6 +49,13 @@ class AggrFunctions : public Operator {
         void addMergeHint(Register* reg1,Register* reg2);
         /// Register parts of the tree that can be executed asynchronous
         void getAsyncInputCandidates(Scheduler& scheduler);
+
+        /// Read the number stored in a value. Returns SYMBOL if the value
+        /// is not a number
+        static AggregateHandler::VarValue readNumber(DBLayer& dict,
+                uint64_t value);
+        /// Encode the result of an aggregate in a value
+        static uint64_t encodeNumber(const AggregateHandler::VarValue& value);
 };
 //---------------------------------------------------------------------------
 #endif
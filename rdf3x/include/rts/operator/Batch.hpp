@@ -0,0 +1,90 @@
+#ifndef H_rts_operator_Batch
+#define H_rts_operator_Batch
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <rts/runtime/Runtime.hpp>
+
+#include <inttypes.h>
+#include <vector>
+//---------------------------------------------------------------------------
+/// A batch of tuples exchanged between operators, stored in columns. The
+/// consumer chooses the registers that are stored; an operator that reads
+/// more registers adds them before the batch is filled. Only the rows in the
+/// selection vector are valid
+class Batch
+{
+   public:
+   /// The maximum number of rows
+   static const unsigned capacity = 1024;
+
+   /// The registers of the columns
+   std::vector<Register*> registers;
+   /// The values, capacity entries per column
+   std::vector<uint64_t> values;
+   /// The multiplicities of the rows
+   std::vector<uint64_t> counts;
+   /// The valid rows
+   std::vector<unsigned> selection;
+   /// The number of rows
+   unsigned rows;
+   /// The number of valid rows
+   unsigned size;
+   /// Is the input exhausted?
+   bool done;
+
+   /// Constructor
+   explicit Batch(const std::vector<Register*>& registers);
+
+   /// Get the column of a register, add it if needed
+   unsigned addRegister(Register* reg);
+   /// Get a column
+   uint64_t* getColumn(unsigned column) { return &values[column*capacity]; }
+
+   /// Remove all rows
+   void clear() { rows=0; size=0; }
+   /// Is the batch full?
+   bool full() const { return rows==capacity; }
+   /// Append the current values of the registers
+   void append(uint64_t count) {
+      for (unsigned index=0,limit=registers.size();index<limit;index++)
+         values[index*capacity+rows]=registers[index]->value;
+      counts[rows]=count;
+      selection[size++]=rows++;
+   }
+   /// Copy a valid row back into the registers
+   uint64_t load(unsigned index) {
+      unsigned row=selection[index];
+      for (unsigned index2=0,limit=registers.size();index2<limit;index2++)
+         registers[index2]->value=values[index2*capacity+row];
+      return counts[row];
+   }
+
+   /// Fill the batch with the tuples of an operator. The tuple interface of T is called without virtual dispatch
+   template <class T> unsigned fill(T& op,bool restart) {
+      clear();
+      if (restart) {
+         done=false;
+         uint64_t count=op.T::first();
+         if (!count) { done=true; return 0; }
+         append(count);
+      } else if (done) {
+         return 0;
+      }
+      while (!full()) {
+         uint64_t count=op.T::next();
+         if (!count) { done=true; break; }
+         append(count);
+      }
+      return size;
+   }
+};
+//---------------------------------------------------------------------------
+#endif
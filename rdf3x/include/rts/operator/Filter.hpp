@@ -30,6 +30,11 @@ class Filter : public Operator
    /// Negative filter
    bool exclude;
 
+   /// Restrict the domain of the filter register
+   void restrictDomain();
+   /// Remove the rows of a batch that do not qualify
+   unsigned filterBatch(Batch& batch,unsigned column);
+
    public:
    /// Constructor
    Filter(Operator* input,Register* filter,const std::vector<uint64_t>& values,bool exclude,double expectedOutputCardinality);
@@ -40,6 +45,10 @@ class Filter : public Operator
    uint64_t first();
    /// Produce the next tuple
    uint64_t next();
+   /// Produce the first batch of tuples
+   unsigned firstBatch(Batch& batch);
+   /// Produce the next batch of tuples
+   unsigned nextBatch(Batch& batch);
 
    /// Print the operator tree. Debugging only.
    void print(PlanPrinter& out);
@@ -47,6 +56,8 @@ class Filter : public Operator
    void addMergeHint(Register* reg1,Register* reg2);
    /// Register parts of the tree that can be executed asynchronous
    void getAsyncInputCandidates(Scheduler& scheduler);
+   /// Pass the keys of a hash join build side to the scans of the input
+   void setHashKeys(const SemiJoinFilter* keys,int bitset) { input->setHashKeys(keys,bitset); }
 };
 //---------------------------------------------------------------------------
 #endif
@@ -75,9 +75,15 @@ class FullyAggregatedIndexScan : public Operator
    /// Add a merge join hint
    void addMergeHint(Register* reg1,Register* reg2);
 
-   void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
+   void setHashKeys(const SemiJoinFilter *keys, int bitset) {
        hint.setKeys(keys, bitset);
    }
+   /// Restrict the scan to the first values in [from,to)
+   bool setKeyRange(uint64_t from,uint64_t to) {
+      if (bound1) return false;
+      scan->setKeyRange(from,to);
+      return true;
+   }
 
    /// Register parts of the tree that can be executed asynchronous
    void getAsyncInputCandidates(Scheduler& scheduler);
@@ -0,0 +1,66 @@
+#ifndef H_rts_operator_GroupCountScan
+#define H_rts_operator_GroupCountScan
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <rts/operator/Operator.hpp>
+#include <dblayer.hpp>
+
+#include <memory>
+#include <vector>
+//---------------------------------------------------------------------------
+class Register;
+//---------------------------------------------------------------------------
+/// Computes COUNT aggregates over a single triple pattern with the counts
+/// stored in the indices, without enumerating the triples. The pattern can
+/// have at most two positions that are either constant or grouped.
+class GroupCountScan : public Operator
+{
+   private:
+   /// The database
+   DBLayer& db;
+   /// The data order. The constants come first, then the grouped positions
+   DBLayer::DataOrder order;
+   /// The constants of the pattern (~0 if the position is a variable)
+   uint64_t subject,predicate,object;
+   /// The number of constants
+   unsigned nconsts;
+   /// The registers of the grouped positions, in the data order (may be 0)
+   Register* group1,*group2;
+   /// The registers that receive the counts
+   std::vector<Register*> counts;
+   /// The scan over the aggregated index
+   std::unique_ptr<DBLayer::Scan> scan;
+   /// The constant that prefixes the scan (if any)
+   uint64_t prefix;
+
+   /// Copy the current group and its count in the registers
+   uint64_t produce();
+
+   public:
+   /// Constructor
+   GroupCountScan(DBLayer& db,DBLayer::DataOrder order,uint64_t subject,uint64_t predicate,uint64_t object,Register* group1,Register* group2,const std::vector<Register*>& counts,double expectedOutputCardinality);
+   /// Destructor
+   ~GroupCountScan();
+
+   /// Produce the first tuple
+   uint64_t first();
+   /// Produce the next tuple
+   uint64_t next();
+
+   /// Print the operator tree. Debugging only.
+   void print(PlanPrinter& out);
+   /// Add a merge join hint
+   void addMergeHint(Register* reg1,Register* reg2);
+   /// Register parts of the tree that can be executed asynchronous
+   void getAsyncInputCandidates(Scheduler& scheduler);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -11,41 +11,118 @@
 // San Francisco, California, 94105, USA.
 //---------------------------------------------------------------------------
 #include "rts/operator/Operator.hpp"
-#include "infra/util/VarPool.hpp"
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <vector>
 //---------------------------------------------------------------------------
-/// A hash based aggregation
+class Batch;
+class DBLayer;
+class QueryContext;
+//---------------------------------------------------------------------------
+/// A hash based aggregation. The groups are spread over partitions by their
+/// hash. Every thread of a parallel input aggregates in its own tables, the
+/// partitions of the threads are merged at the end. When the groups exceed
+/// the memory budget, the partitions are written to disk and merged later
 class HashGroupify : public Operator
 {
+   public:
+   /// An aggregate computed for every group
+   struct Aggregate {
+      /// The functions
+      enum Function { Count, Sum };
+      /// The function
+      Function function;
+      /// The input register, NULL for COUNT(*)
+      Register* input;
+      /// The output register
+      Register* output;
+   };
+
    private:
-   /// A group
-   struct Group {
-      /// The next group
-      Group* next;
-      /// The hash value
-      uint64_t hash;
-      /// The count
+   /// The groups of a partition, with a hash table over them. A group
+   /// stores its hash, the values, the count and the state of the aggregates
+   struct Partition {
+      /// The groups, one after the other
+      std::vector<uint64_t> groups;
+      /// The hash table, the index of a group plus one (0 if empty)
+      std::vector<uint32_t> slots;
+      /// The number of groups
       uint64_t count;
-      /// The values
-      uint64_t values[];
+
+      /// Constructor
+      Partition() : count(0) {}
+
+      /// Find a group, create it if needed
+      uint64_t* lookup(uint64_t hash,const uint64_t* values,unsigned width,unsigned groupSize);
+      /// The size in bytes
+      uint64_t getSize() const { return groups.capacity()*sizeof(uint64_t)+slots.capacity()*sizeof(uint32_t); }
+      /// Release the groups
+      void clear();
    };
-   /// Helper
-   class Rehasher;
-   /// Helper
-   class Chainer;
+   /// The partitions of a thread
+   struct Table;
+   /// Aggregates the batches of the threads of a parallel input
+   class Collector;
+
+   /// The number of partitions
+   static const unsigned partitions = 64;
 
    /// The input registers
    std::vector<Register*> values;
+   /// The aggregates
+   std::vector<Aggregate> aggregates;
    /// The input
    Operator* input;
-   /// The groups
-   Group* groups,*groupsIter;
-   /// The groups pool
-   VarPool<Group> groupsPool;
+   /// The database, to read the numbers that are not inlined
+   DBLayer& db;
+   /// The number of threads that merge the partitions
+   unsigned threads;
+   /// The maximum size of the groups in memory (0 = unlimited)
+   uint64_t memoryBudget;
+   /// The number of words of a group
+   unsigned groupSize;
+   /// The tables of the threads
+   std::vector<std::unique_ptr<Table> > tables;
+   /// The spilled groups of every partition (0 if none)
+   std::vector<FILE*> spilled;
+   /// Protects the spilled partitions
+   std::mutex spillMutex;
+   /// The number of spilled bytes
+   uint64_t bytesSpilled;
+   /// The merged partitions
+   std::vector<Partition> merged;
+   /// The next partition to merge
+   unsigned nextPartition;
+   /// The current merged partition
+   unsigned mergedIter;
+   /// The current group
+   uint64_t groupsIter;
+   /// The limits of the query (if any)
+   QueryContext* context;
+   /// The memory of the merged partitions accounted in the context
+   uint64_t mergedBytes;
+
+   /// Aggregate a batch
+   void aggregate(Table& table,DBLayer& db,Batch& batch,unsigned size,const std::vector<unsigned>& columns);
+   /// Write the groups of a table to disk
+   void spill(Table& table);
+   /// Add the count and the aggregates of a group to another one
+   void combine(uint64_t* group,const uint64_t* other) const;
+   /// Merge the groups of a partition
+   void merge(unsigned partition,Partition& result);
+   /// Close the spilled partitions
+   void closeSpilled();
+   /// Account memory in the context, the previous amount is given
+   void accountMemory(uint64_t& accounted,uint64_t bytes);
+   /// Release the memory accounted in the context
+   void releaseMemory();
 
    public:
    /// Constructor
-   HashGroupify(Operator* input,const std::vector<Register*>& values,double expectedOutputCardinality);
+   HashGroupify(Operator* input,const std::vector<Register*>& values,DBLayer& db,double expectedOutputCardinality,unsigned threads=1,uint64_t memoryBudget=0,QueryContext* context=0);
+   /// Constructor. Computes the aggregates for every group of values
+   HashGroupify(Operator* input,const std::vector<Register*>& values,const std::vector<Aggregate>& aggregates,DBLayer& db,double expectedOutputCardinality,unsigned threads=1,uint64_t memoryBudget=0,QueryContext* context=0);
    /// Destructor
    ~HashGroupify();
 
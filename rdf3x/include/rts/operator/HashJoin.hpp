@@ -12,26 +12,40 @@
 //---------------------------------------------------------------------------
 #include <rts/operator/Operator.hpp>
 #include <rts/operator/Scheduler.hpp>
-#include <infra/util/VarPool.hpp>
+#include <infra/util/SemiJoinFilter.hpp>
+#include <trident/utils/radixjoin.h>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <set>
 //---------------------------------------------------------------------------
+class Batch;
 class Register;
+class QueryContext;
+class HashJoin;
 //---------------------------------------------------------------------------
-/// A memory based hash join
+/// The hash table of a join in a parallel pipeline. The copies of the join
+/// in the threads share it: the first one builds the table, the others wait
+/// and probe it. A table that was spilled to disk is not shared
+class SharedHashBuild {
+    public:
+    /// Held while the table is built
+    std::mutex mutex;
+    /// Was the table built?
+    bool built;
+    /// The join that holds the table (0 if not built or spilled)
+    HashJoin* builder;
+
+    /// Constructor
+    SharedHashBuild() : built(false), builder(0) {}
+};
+//---------------------------------------------------------------------------
+/// A hash join. The left side is kept in a radix partitioned hash table.
+/// If it exceeds the memory budget, both sides are partitioned to disk and
+/// joined one partition at a time
 class HashJoin : public Operator {
 private:
-    /// A hash table entry
-    struct Entry {
-        /// The next entry
-        Entry* next;
-        /// The key
-        uint64_t key;
-        /// The count
-        uint64_t count;
-        /// Further values
-        uint64_t values[];
-    };
     /// Hash table task
     class BuildHashTable : public Scheduler::AsyncPoint {
     private:
@@ -45,6 +59,8 @@ private:
         BuildHashTable(HashJoin& join) : join(join), done(false) {}
         /// Perform the task
         void run();
+        /// Build the hash table from the left side
+        void build();
     };
     friend class BuildHashTable;
     /// Probe peek task
@@ -66,6 +82,15 @@ private:
         void run();
     };
     friend class ProbePeek;
+    /// A partition spilled to disk. A tuple is its key, its count and its tail
+    struct SpilledPartition {
+        /// The tuples of the left and of the right side
+        FILE* left, *right;
+        /// The number of times the tuples were partitioned
+        unsigned level;
+    };
+    /// The state of the join
+    enum State { Probe, Unmatched, Done };
 
     /// The input
     Operator* left, *right;
@@ -73,12 +98,17 @@ private:
     Register* leftValue, *rightValue;
     /// The non-join attributes
     std::vector<Register*> leftTail, rightTail;
-    /// The pool of hash entry
-    VarPool<Entry> entryPool;
-    /// The hash table
-    std::vector<Entry*> hashTable;
-    /// The current iter
-    Entry* hashTableIter;
+    /// The left tuples in memory: the count, then the tail
+    std::vector<uint64_t> leftRows;
+    /// The hash table over the left tuples
+    RadixJoinTable hashTable;
+    /// The hash table shared with the other threads (if any)
+    std::shared_ptr<SharedHashBuild> sharedBuild;
+    /// The join whose left tuples and hash table are probed, this one or
+    /// the one that built the shared table
+    const HashJoin* source;
+    /// The matches of the current right tuple
+    const RadixJoinTable::Tuple* matchIter, *matchLimit;
     /// The tuple count from the right side
     uint64_t rightCount;
     // If the right is a scan, bitset indicates the position(s) of the joins.
@@ -90,22 +120,68 @@ private:
     ProbePeek probePeekTask;
     /// Task priorities
     double hashPriority, probePriority;
+    /// The threads that build the hash table
+    unsigned threads;
+    /// The memory budget of the hash table, in bytes (0 if unlimited)
+    uint64_t memoryBudget;
+    /// The spilled partitions (none if the left side fits in memory)
+    std::vector<SpilledPartition> spilled;
+    /// The current partition
+    unsigned currentPartition;
+    /// The bytes written to disk
+    uint64_t bytesSpilled;
+    /// The limits of the query (if any)
+    QueryContext* context;
+    /// The memory of the left side accounted in the context
+    uint64_t accountedBytes;
+    /// The state
+    State state;
 
-    /// Insert into the hash table
-    void insert(Entry* e);
-    /// Lookup an entry
-    inline Entry* lookup(uint64_t key);
+    /// Add a tuple of the left side
+    void addLeft(std::vector<RadixJoinTable::Tuple>& tuples, uint64_t key, uint64_t count, const uint64_t* tail);
+    /// Move the left tuples to disk
+    void spillLeft(std::vector<RadixJoinTable::Tuple>& tuples);
+    /// Write a tuple to a spilled partition
+    void writeTuple(FILE* file, uint64_t key, uint64_t count, const uint64_t* values, uint64_t nvalues);
+    /// Write the right side to the spilled partitions
+    void spillRight();
+    /// Split a spilled partition whose left side does not fit in memory
+    bool splitPartition(unsigned partition);
+    /// Move the tuples of a spilled file to the new partitions
+    void splitFile(FILE* file, unsigned first, unsigned level, uint64_t nvalues, bool leftSide, std::vector<uint64_t>& counts);
+    /// Load the left side of a spilled partition
+    void loadPartition(unsigned partition);
+    /// Read the next tuple from the right side
+    uint64_t readRight();
+    /// Find the matches of the current right tuple
+    void probe();
+    /// Start to join a partition
+    void startPartition(unsigned partition);
+    /// The right side of the current partition is done
+    void finishRight();
+    /// Account the memory of the left side in the context
+    void accountMemory(uint64_t bytes);
 
     //Optional?
     bool leftOptional, rightOptional, joinSuccedeed;
     std::set<uint64_t> collectedRightValues;
     size_t currentIdx;
     std::vector<uint64_t> keys;
+    /// The keys of the hash table, for the scans of the right side
+    SemiJoinFilter keyFilter;
+    /// The current batch of the right side, when the join produces batches
+    std::unique_ptr<Batch> probeBatch;
+    /// The position in the batch of the right side and its size
+    unsigned probePos, probeSize;
+
+    /// Can the join produce batches? The spilled and the optional joins are
+    /// produced one tuple at the time
+    bool canBatch() const { return spilled.empty() && !leftOptional && !rightOptional; }
 
 public:
     /// Constructor
     HashJoin(Operator* left, Register* leftValue, const std::vector<Register*>& leftTail, Operator* right, Register* rightValue, const std::vector<Register*>& rightTail,
-             double hashPriority, double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset);
+             double hashPriority, double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset, unsigned threads = 1, uint64_t memoryBudget = 0, QueryContext* context = 0);
     /// Destructor
     ~HashJoin();
 
@@ -113,6 +189,10 @@ public:
     uint64_t first();
     /// Produce the next tuple
     uint64_t next();
+    /// Produce the first batch of tuples. The right side is read in batches
+    unsigned firstBatch(Batch& batch);
+    /// Produce the next batch of tuples
+    unsigned nextBatch(Batch& batch);
 
     /// Print the operator tree. Debugging only.
     void print(PlanPrinter& out);
@@ -121,8 +201,15 @@ public:
     /// Register parts of the tree that can be executed asynchronous
     void getAsyncInputCandidates(Scheduler& scheduler);
 
-    void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
-        left->setHashKeys(keys, bitset);
+    /// Share the hash table with the copies of the join in the other threads
+    void shareBuild(const std::shared_ptr<SharedHashBuild>& build) {
+        sharedBuild = build;
+    }
+
+    void setHashKeys(const SemiJoinFilter *keys, int bitset) {
+        // An optional side would lose its matches
+        if (!leftOptional)
+            left->setHashKeys(keys, bitset);
    }
 
 };
@@ -19,6 +19,7 @@
 #include <vector>
 //---------------------------------------------------------------------------
 class Register;
+class QueryContext;
 //---------------------------------------------------------------------------
 /// An index scan over the facts table
 class IndexScan : public Operator {
@@ -53,6 +54,8 @@ private:
     std::vector<Register*> merge1, merge2, merge3;
     /// The scan
     std::unique_ptr<DBLayer::Scan> scan;
+    /// The limits of the query (if any)
+    QueryContext* context;
 
     /// Constructor
     IndexScan(DBLayer& db, DBLayer::DataOrder order, Register* value1,
@@ -83,15 +86,21 @@ public:
     /// Add a merge join hint
     void addMergeHint(Register* reg1, Register* reg2);
 
-   void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
+   void setHashKeys(const SemiJoinFilter *keys, int bitset) {
        hint.setKeys(keys, bitset);
    }
+   /// Restrict the scan to the first values in [from,to)
+   bool setKeyRange(uint64_t from,uint64_t to) {
+      if (bound1) return false;
+      scan->setKeyRange(from,to);
+      return true;
+   }
 
     /// Register parts of the tree that can be executed asynchronous
     void getAsyncInputCandidates(Scheduler& scheduler);
 
     /// Create a suitable operator
-    static IndexScan* create(DBLayer& db, DBLayer::DataOrder order, Register* subjectRegister, bool subjectBound, Register* predicateRegister, bool predicateBound, Register* objectRegister, bool objectBound, double expectedOutputCardinality);
+    static IndexScan* create(DBLayer& db, DBLayer::DataOrder order, Register* subjectRegister, bool subjectBound, Register* predicateRegister, bool predicateBound, Register* objectRegister, bool objectBound, double expectedOutputCardinality, QueryContext* context = 0);
 };
 //---------------------------------------------------------------------------
 #endif
@@ -0,0 +1,91 @@
+#ifndef H_rts_operator_LeapfrogJoin
+#define H_rts_operator_LeapfrogJoin
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <rts/operator/Operator.hpp>
+#include <dblayer.hpp>
+
+#include <memory>
+#include <vector>
+//---------------------------------------------------------------------------
+class Register;
+//---------------------------------------------------------------------------
+/// A worst-case optimal multiway join (Leapfrog Triejoin) of triple patterns.
+/// The variables are bound one at a time in a global order. For each of them,
+/// the cursors of the patterns that contain it are intersected by seeking
+/// every cursor to the largest current value.
+class LeapfrogJoin : public Operator
+{
+   public:
+   /// A triple pattern
+   struct Pattern {
+      /// The data order. The bound positions come first, then the variables in the global order
+      DBLayer::DataOrder order;
+      /// The registers of the bound positions (constants or outer bindings)
+      std::vector<Register*> bound;
+      /// The global positions of the variables, in the data order
+      std::vector<unsigned> variables;
+   };
+
+   private:
+   /// A cursor over one position of a pattern
+   struct Participant {
+      /// The pattern
+      unsigned pattern;
+      /// The number of values that are bound before the position
+      unsigned prefixSize;
+      /// The cursor
+      std::unique_ptr<DBLayer::Cursor> cursor;
+   };
+   /// The participants of every variable
+   std::vector<std::vector<Participant> > levels;
+   /// The patterns
+   std::vector<Pattern> patterns;
+   /// The registers of the variables, in the global order
+   std::vector<Register*> variables;
+   /// The values bound in every pattern (three per pattern)
+   std::vector<uint64_t> prefixes;
+   /// The current variable
+   unsigned depth;
+   /// The number of seeks. Debugging only.
+   uint64_t seeks;
+
+   /// Position the cursors of a variable and intersect them
+   bool open(unsigned level);
+   /// Intersect the cursors of a variable
+   bool search(unsigned level);
+   /// Move to the next common value of a variable
+   bool advance(unsigned level);
+   /// Bind the current value of a variable
+   void bind(unsigned level);
+   /// Bind the variables after the current one
+   uint64_t descend();
+
+   public:
+   /// Constructor
+   LeapfrogJoin(DBLayer& db,const std::vector<Pattern>& patterns,const std::vector<Register*>& variables,double expectedOutputCardinality);
+   /// Destructor
+   ~LeapfrogJoin();
+
+   /// Produce the first tuple
+   uint64_t first();
+   /// Produce the next tuple
+   uint64_t next();
+
+   /// Print the operator tree. Debugging only.
+   void print(PlanPrinter& out);
+   /// Add a merge join hint
+   void addMergeHint(Register* reg1,Register* reg2);
+   /// Register parts of the tree that can be executed asynchronous
+   void getAsyncInputCandidates(Scheduler& scheduler);
+};
+//---------------------------------------------------------------------------
+#endif
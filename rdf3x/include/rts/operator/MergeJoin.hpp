@@ -14,8 +14,11 @@
 #include <vector>
 //---------------------------------------------------------------------------
 class Register;
+class QueryContext;
 //---------------------------------------------------------------------------
 /// A merge join. The input has to be sorted by the join attributes.
+/// It produces one tuple at the time, also for the batches: the merge advances
+/// the inputs per tuple and the merge hints skip ahead inside the scans.
 class MergeJoin : public Operator
 {
    private:
@@ -52,6 +55,10 @@ class MergeJoin : public Operator
    bool leftInCopy;
 
    bool leftOptional, rightOptional;
+   /// The limits of the query (if any)
+   QueryContext* context;
+   /// The size of the buffer accounted in the context
+   uint64_t bufferBytes;
 
    /// Copy the left tuple into its shadow
    void copyLeft();
@@ -64,6 +71,8 @@ class MergeJoin : public Operator
 
    /// Handle the n:m case
    void handleNM();
+   /// Account the growth of the buffer in the context
+   void accountBuffer();
 
    public:
    /// Constructor
@@ -74,7 +83,8 @@ class MergeJoin : public Operator
            const std::vector<Register*>& rightTail,
             bool leftOptional,
             bool rightOptional,
-           double expectedOutputCardinality);
+           double expectedOutputCardinality,
+           QueryContext* context=0);
    /// Destructor
    ~MergeJoin();
 
@@ -89,8 +99,10 @@ class MergeJoin : public Operator
    void addMergeHint(Register* reg1,Register* reg2);
    /// Register parts of the tree that can be executed asynchronous
    void getAsyncInputCandidates(Scheduler& scheduler);
-   void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
-       left->setHashKeys(keys, bitset);
+   void setHashKeys(const SemiJoinFilter *keys, int bitset) {
+       // An optional side would lose its matches
+       if (!leftOptional)
+           left->setHashKeys(keys, bitset);
    }
 
 };
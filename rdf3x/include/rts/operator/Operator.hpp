@@ -13,13 +13,18 @@
 #include <inttypes.h>
 #include <vector>
 
+#include <trident/utils/queryarena.h>
+
+class Batch;
+class SemiJoinFilter;
 class Register;
 class DictionarySegment;
 class Scheduler;
 class PlanPrinter;
 //---------------------------------------------------------------------------
-/// Base class for all operators of the runtime system
-class Operator
+/// Base class for all operators of the runtime system. Operators are taken
+/// from the arena of the query, if there is one
+class Operator : public ArenaObject
 {
    protected:
    /// Tuple counter
@@ -27,6 +32,9 @@ class Operator
    /// Tuple counter
    uint64_t observedOutputCardinality;
 
+   /// Fill the rest of a batch one tuple at the time
+   unsigned nextBatchRows(Batch& batch);
+
    public:
    /// Constructor
    explicit Operator(double expectedOutputCardinality);
@@ -37,6 +45,10 @@ class Operator
    virtual uint64_t first() = 0;
    /// Produce the next tuple
    virtual uint64_t next() = 0;
+   /// Produce the first batch of tuples. Returns the number of valid rows, 0 at the end
+   virtual unsigned firstBatch(Batch& batch);
+   /// Produce the next batch of tuples
+   virtual unsigned nextBatch(Batch& batch);
 
    /// Tuple counter
    double getExpectedOutputCardinality() const { return expectedOutputCardinality; }
@@ -50,9 +62,12 @@ class Operator
    /// Register parts of the tree that can be executed asynchronous
    virtual void getAsyncInputCandidates(Scheduler& scheduler) = 0;
 
-   virtual void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
+   /// Pass the keys of a hash join build side to the scans of the probe side
+   virtual void setHashKeys(const SemiJoinFilter *keys, int bitset) {
        // Default version is empty.
    }
+   /// Restrict a scan to the tuples whose first value is in [from,to). Returns false if the operator cannot be split
+   virtual bool setKeyRange(uint64_t /*from*/,uint64_t /*to*/) { return false; }
 
    /// Disable scan skipping. Debugging only, this is a global property!
    static bool disableSkipping;
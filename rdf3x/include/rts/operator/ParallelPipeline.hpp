@@ -0,0 +1,136 @@
+#ifndef H_rts_operator_ParallelPipeline
+#define H_rts_operator_ParallelPipeline
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <rts/operator/Operator.hpp>
+#include <rts/runtime/Runtime.hpp>
+#include <dblayer.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+//---------------------------------------------------------------------------
+class Batch;
+//---------------------------------------------------------------------------
+/// Executes a pipeline of scans and joins with several threads. Every thread
+/// runs its own copy of the pipeline, with its own registers and database
+/// layer. The driving scan of the pipeline is split in morsels (ranges of its
+/// first value) that the threads take one at the time, so that every result
+/// tuple is produced by exactly one thread. The scans that are merge joined
+/// with it are restricted to the same range. The results are handed to the
+/// consumer in chunks
+class ParallelPipeline : public Operator
+{
+   public:
+   /// A copy of the pipeline
+   struct Worker {
+      /// The database layer of the thread
+      std::unique_ptr<DBLayer> db;
+      /// The registers of the thread
+      std::unique_ptr<Runtime> runtime;
+      /// The operator tree
+      Operator* tree;
+      /// The scan that is split in morsels
+      Operator* driver;
+      /// The scans that are restricted to the same morsels
+      std::vector<Operator*> partners;
+      /// The output registers, in the order of the output of the operator
+      std::vector<Register*> output;
+   };
+   /// Receives the batches of the threads, see consume()
+   class Consumer {
+      public:
+      /// Destructor
+      virtual ~Consumer();
+      /// Process a batch of a thread. The first columns are the output registers of the worker
+      virtual void consume(unsigned thread,DBLayer& db,Batch& batch,unsigned size)=0;
+   };
+
+   private:
+   /// A chunk of results
+   struct Chunk {
+      /// The values, one tuple after the other
+      std::vector<uint64_t> values;
+      /// The multiplicities of the tuples
+      std::vector<uint64_t> counts;
+   };
+   /// The number of tuples in a chunk
+   static const unsigned chunkSize = 1024;
+
+   /// The copies of the pipeline
+   std::vector<Worker> workers;
+   /// The output registers
+   std::vector<Register*> output;
+   /// The boundaries of the morsels
+   std::vector<uint64_t> bounds;
+   /// The next morsel to process
+   std::atomic<unsigned> nextMorsel;
+   /// The threads
+   std::vector<std::thread> threads;
+   /// Protects the queue
+   std::mutex mutex;
+   /// Signaled when a chunk is added or a thread has finished
+   std::condition_variable produced;
+   /// Signaled when a chunk is removed
+   std::condition_variable consumed;
+   /// The chunks that are ready
+   std::deque<Chunk> queue;
+   /// The number of threads that are still running
+   unsigned running;
+   /// Stop the threads?
+   std::atomic<bool> stop;
+   /// The first error raised by a thread
+   std::exception_ptr error;
+   /// The chunk that is returned
+   Chunk current;
+   /// The position in the current chunk
+   uint64_t pos;
+
+   /// Run one copy of the pipeline
+   void run(unsigned thread,Consumer* consumer);
+   /// Start the threads
+   void start(Consumer* consumer);
+   /// Stop all threads
+   void shutdown();
+   /// Return the next tuple of the current chunk
+   uint64_t produce();
+
+   public:
+   /// Constructor. The morsels split the first values in [0,maxKey)
+   ParallelPipeline(std::vector<Worker>& workers,const std::vector<Register*>& output,uint64_t maxKey,unsigned morsels,double expectedOutputCardinality);
+   /// Destructor
+   ~ParallelPipeline();
+
+   /// Produce the first tuple
+   uint64_t first();
+   /// Produce the next tuple
+   uint64_t next();
+   /// Run the pipeline and hand the batches to a consumer, inside the thread that produced them
+   void consume(Consumer& consumer);
+   /// The number of threads
+   unsigned getThreads() const { return workers.size(); }
+   /// The output registers
+   const std::vector<Register*>& getOutput() const { return output; }
+
+   /// Print the operator tree. Debugging only.
+   void print(PlanPrinter& out);
+   /// Add a merge join hint
+   void addMergeHint(Register* reg1,Register* reg2);
+   /// Register parts of the tree that can be executed asynchronous
+   void getAsyncInputCandidates(Scheduler& scheduler);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -114,6 +114,15 @@ class Selection : public Operator {
                 /// Destructor
                 ~BinaryPredicate();
 
+                /// The left input
+                Predicate* getLeft() const {
+                    return left;
+                }
+                /// The right input
+                Predicate* getRight() const {
+                    return right;
+                }
+
                 /// Register the selection
                 void setSelection(Selection* selection);
         };
@@ -290,6 +299,11 @@ class Selection : public Operator {
                 /// Constructor
                 Variable(Register* reg) : reg(reg) {}
 
+                /// The register
+                Register* getRegister() const {
+                    return reg;
+                }
+
                 /// Evaluate the predicate
                 void eval(Result& result);
                 /// Print the predicate (debugging only)
@@ -320,6 +334,11 @@ class Selection : public Operator {
                 /// Constructor
                 ConstantLiteral(uint64_t id) : id(id) {}
 
+                /// The id
+                uint64_t getId() const {
+                    return id;
+                }
+
                 /// Evaluate the predicate
                 void eval(Result& result);
                 /// Print the predicate (debugging only)
@@ -352,6 +371,11 @@ class Selection : public Operator {
                 /// Constructor
                 ConstantIRI(uint64_t id) : id(id) {}
 
+                /// The id
+                uint64_t getId() const {
+                    return id;
+                }
+
                 /// Evaluate the predicate
                 void eval(Result& result);
                 /// Print the predicate (debugging only)
@@ -616,6 +640,33 @@ class Selection : public Operator {
         /// The predicate
         Predicate* predicate;
 
+        /// A comparison of a register with a constant that is evaluated on whole batches
+        struct VectorCondition {
+            /// The kinds of comparison
+            enum Kind { IdEqual, IdNotEqual, NumLess, NumLessOrEqual };
+            /// The kind
+            Kind kind;
+            /// The comparison, evaluated for the values that are not inline numbers
+            Predicate* predicate;
+            /// The register
+            Register* reg;
+            /// Is the constant the left side of the comparison?
+            bool constantFirst;
+            /// The constant. For NumLess and NumLessOrEqual, encoded like the inline numbers
+            uint64_t type, value;
+            /// The column of the register in the batch
+            unsigned column;
+        };
+        /// The conjunction of comparisons that forms the predicate
+        std::vector<VectorCondition> conditions;
+        /// Can the predicate be evaluated on whole batches?
+        enum { VectorUnknown, VectorYes, VectorNo } vectorMode;
+
+        /// Collect the comparisons of a conjunction that can be evaluated on whole batches
+        bool prepareVector(Predicate* predicate);
+        /// Remove the rows of a batch that do not qualify
+        unsigned filterBatch(Batch& batch);
+
         bool numeric(Result &v);
         bool numLess(const Result &l, const Result &r);
         bool isNumericComparison(Result &l, Result &r);
@@ -630,6 +681,10 @@ class Selection : public Operator {
         uint64_t first();
         /// Produce the next tuple
         uint64_t next();
+        /// Produce the first batch of tuples
+        unsigned firstBatch(Batch& batch);
+        /// Produce the next batch of tuples
+        unsigned nextBatch(Batch& batch);
 
         /// Print the operator tree. Debugging only.
         void print(PlanPrinter& out);
@@ -638,7 +693,7 @@ class Selection : public Operator {
         /// Register parts of the tree that can be executed asynchronous
         void getAsyncInputCandidates(Scheduler& scheduler);
 
-        void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
+        void setHashKeys(const SemiJoinFilter *keys, int bitset) {
             input->setHashKeys(keys, bitset);
         }
 };
@@ -13,8 +13,11 @@
 #include <rts/operator/Operator.hpp>
 #include <infra/util/VarPool.hpp>
 #include <dblayer.hpp>
+#include <memory>
 #include <vector>
 //---------------------------------------------------------------------------
+class QueryContext;
+//---------------------------------------------------------------------------
 /// A sort operator
 class Sort : public Operator
 {
@@ -23,7 +26,7 @@ class Sort : public Operator
    struct Tuple {
       /// The count
       uint64_t count;
-      /// The values
+      /// The values, followed by one sort key per order entry
       uint64_t values[];
    };
    /// Order specification
@@ -34,6 +37,14 @@ class Sort : public Operator
       bool descending;
    };
    class Sorter;
+   class Decoder;
+   class Run;
+   class RunOrder;
+
+   /// Inputs smaller than this are sorted by a single thread
+   static const uint64_t parallelSortThreshold = 100000;
+   /// Minimum number of tuples collected before the top-k are selected
+   static const uint64_t minTopKBuffer = 16384;
 
    /// The input registers
    std::vector<Register*> values;
@@ -49,10 +60,45 @@ class Sort : public Operator
    DBLayer& dict;
    /// Tuples iterator
    std::vector<Tuple*>::const_iterator tuplesIter;
+   /// Only the first topK tuples are needed (~0 if all)
+   uint64_t topK;
+   /// The memory budget in bytes (0 if unlimited)
+   uint64_t memoryBudget;
+   /// The sorted runs spilled to disk
+   std::vector<Run*> runs;
+   /// The runs that still have tuples, as a heap
+   std::vector<Run*> mergeHeap;
+   /// The buffer to decode the values of the runs
+   std::unique_ptr<char[]> lookupBuffer;
+   /// Statistics
+   uint64_t rowsProcessed,bytesSpilled,nRuns;
+   /// The limits of the query (if any)
+   QueryContext* context;
+   /// The memory of the tuples accounted in the context
+   uint64_t accountedBytes;
+
+   /// Replace the values of an order entry with their rank in the sort order
+   void computeKeys(uint64_t entry);
+   /// Sort the tuples in memory
+   void sortTuples();
+   /// Keep only the first topK tuples
+   void pruneTuples();
+   /// Write the tuples in memory to a sorted run
+   void spillTuples();
+   /// Read the next tuple of a run
+   bool loadRun(Run& run);
+   /// Decode the value of an order entry in the current tuple of a run
+   void decodeRun(Run& run,uint64_t entry);
+   /// Compare the current tuples of two runs
+   bool lessRun(Run& a,Run& b);
+   /// Delete the runs
+   void closeRuns();
+   /// Account the memory of the tuples in the context
+   void accountMemory(uint64_t bytes);
 
    public:
    /// Constructor
-   Sort(DBLayer& db,Operator* input,const std::vector<Register*>& values,const std::vector<std::pair<Register*,bool> >& order,double expectedOutputCardinality);
+   Sort(DBLayer& db,Operator* input,const std::vector<Register*>& values,const std::vector<std::pair<Register*,bool> >& order,double expectedOutputCardinality,uint64_t topK=UINT64_MAX,uint64_t memoryBudget=0,QueryContext* context=0);
    /// Destructor
    ~Sort();
 
@@ -0,0 +1,120 @@
+#ifndef H_rts_runtime_QueryContext
+#define H_rts_runtime_QueryContext
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+//---------------------------------------------------------------------------
+/// The limits of a running query: a deadline, a cancellation flag and the
+/// memory used by its operators. The operators check it in their loops, the
+/// check throws a QueryContext::Exception once the query has to stop
+class QueryContext {
+public:
+    /// Why the query was stopped
+    enum Reason { None, Timeout, Cancelled, MemoryLimit };
+    /// Thrown when the query has to stop
+    struct Exception {
+        /// The reason
+        Reason reason;
+        /// The message
+        std::string message;
+
+        /// Constructor
+        Exception(Reason reason, const std::string& message) : reason(reason), message(message) {}
+    };
+
+private:
+    /// The clock
+    typedef std::chrono::steady_clock Clock;
+    /// The number of checks between two reads of the clock
+    static const unsigned clockInterval = 64;
+
+    /// Has a deadline?
+    bool hasDeadline;
+    /// The deadline
+    Clock::time_point deadline;
+    /// The reason the query was stopped
+    std::atomic<int> reason;
+    /// The maximum memory of the operators, in bytes (0 if unlimited)
+    uint64_t memoryLimit;
+    /// The memory used by the operators
+    std::atomic<uint64_t> memoryUsed;
+    /// The maximum memory used so far
+    std::atomic<uint64_t> memoryPeak;
+
+    /// Stop the query, the first reason is kept
+    void stop(Reason why);
+    /// Read the clock
+    bool checkDeadline();
+
+public:
+    /// Constructor
+    QueryContext();
+    /// Destructor
+    ~QueryContext();
+
+    /// Stop the query after the given number of milliseconds (0 = never)
+    void setTimeout(uint64_t milliseconds);
+    /// Set the maximum memory of the operators (0 = unlimited)
+    void setMemoryLimit(uint64_t bytes) {
+        memoryLimit = bytes;
+    }
+    /// Get the maximum memory of the operators
+    uint64_t getMemoryLimit() const {
+        return memoryLimit;
+    }
+    /// Cancel the query. Can be called from any thread
+    void cancel() {
+        stop(Cancelled);
+    }
+    /// Get the reason the query was stopped
+    Reason getReason() const {
+        return static_cast<Reason>(reason.load(std::memory_order_relaxed));
+    }
+
+    /// Must the query stop? Cheap, the clock is only read every few calls
+    bool shouldStop() {
+        static thread_local unsigned ticks = 0;
+        if (reason.load(std::memory_order_relaxed) != None)
+            return true;
+        if (hasDeadline && !(++ticks % clockInterval))
+            return checkDeadline();
+        return false;
+    }
+    /// Throw an exception if the query must stop
+    void check() {
+        if (shouldStop())
+            raise();
+    }
+    /// Throw the exception of the reason the query was stopped
+    void raise() const;
+    /// Describe the reason the query was stopped
+    std::string getMessage() const;
+
+    /// Account memory used by an operator. Throws if the limit is exceeded
+    void allocate(uint64_t bytes);
+    /// Give back memory accounted with allocate
+    void release(uint64_t bytes) {
+        memoryUsed.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    /// Get the memory accounted so far
+    uint64_t getMemoryUsed() const {
+        return memoryUsed.load(std::memory_order_relaxed);
+    }
+    /// Get the maximum memory accounted at the same time
+    uint64_t getMemoryPeak() const {
+        return memoryPeak.load(std::memory_order_relaxed);
+    }
+};
+//---------------------------------------------------------------------------
+#endif
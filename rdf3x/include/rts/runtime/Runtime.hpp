@@ -13,6 +13,8 @@
 #include <dblayer.hpp>
 #include <rts/runtime/DomainDescription.hpp>
 #include <rts/operator/Selection.hpp>
+#include <map>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 //---------------------------------------------------------------------------
@@ -20,6 +22,10 @@
 //class DifferentialIndex;
 class TemporaryDictionary;
 class QueryDict;
+class QueryContext;
+class Operator;
+class SharedHashBuild;
+struct Plan;
 //---------------------------------------------------------------------------
 /// A runtime register storing a single value
 class Register {
@@ -57,6 +63,24 @@ private:
     std::vector<Register> registers;
     /// The domain descriptions
     std::vector<PotentialDomainDescription> domainDescriptions;
+    /// The memory budget of a sort, in bytes (0 if unlimited)
+    uint64_t sortMemoryBudget;
+    /// The memory budget of a hash table, in bytes (0 if unlimited)
+    uint64_t hashMemoryBudget;
+    /// The number of threads that execute the query
+    unsigned parallelism;
+    /// The plan of the scan that is split in morsels (if any)
+    const Plan* morselPlan;
+    /// The operator translated from morselPlan
+    Operator* morselScan;
+    /// The plans of the scans that are restricted to the same morsels
+    std::vector<const Plan*> morselPartnerPlans;
+    /// The operators translated from morselPartnerPlans
+    std::vector<Operator*> morselPartners;
+    /// The hash tables shared with the other threads of a parallel pipeline (if any)
+    std::map<const Plan*, std::shared_ptr<SharedHashBuild> >* sharedBuilds;
+    /// The limits of the query (if any)
+    QueryContext* queryContext;
 public:
 
     std::unordered_map<uint64_t, IdValue> valueMap;
@@ -92,6 +116,81 @@ public:
         return queryDict;
     }
 
+    /// Set the memory budget of a sort. Larger inputs are spilled to disk
+    void setSortMemoryBudget(uint64_t bytes) {
+        sortMemoryBudget = bytes;
+    }
+    /// Get the memory budget of a sort
+    uint64_t getSortMemoryBudget() const {
+        return sortMemoryBudget;
+    }
+    /// Set the memory budget of a hash table. Larger inputs are spilled to disk
+    void setHashMemoryBudget(uint64_t bytes) {
+        hashMemoryBudget = bytes;
+    }
+    /// Get the memory budget of a hash table
+    uint64_t getHashMemoryBudget() const {
+        return hashMemoryBudget;
+    }
+
+    /// Set the number of threads that execute the query
+    void setParallelism(unsigned threads) {
+        parallelism = threads ? threads : 1;
+    }
+    /// Get the number of threads that execute the query
+    unsigned getParallelism() const {
+        return parallelism;
+    }
+    /// Set the plan of the scan that is split in morsels, and of the scans
+    /// that are restricted to the same morsels
+    void setMorselPlan(const Plan* plan, const std::vector<const Plan*>& partners) {
+        morselPlan = plan;
+        morselScan = 0;
+        morselPartnerPlans = partners;
+        morselPartners.clear();
+    }
+    /// Get the plan of the scan that is split in morsels
+    const Plan* getMorselPlan() const {
+        return morselPlan;
+    }
+    /// Set the operator of the scan that is split in morsels
+    void setMorselScan(Operator* scan) {
+        morselScan = scan;
+    }
+    /// Get the operator of the scan that is split in morsels
+    Operator* getMorselScan() const {
+        return morselScan;
+    }
+    /// Get the plans of the scans that are restricted to the same morsels
+    const std::vector<const Plan*>& getMorselPartnerPlans() const {
+        return morselPartnerPlans;
+    }
+    /// Add the operator of a scan that is restricted to the same morsels
+    void addMorselPartner(Operator* scan) {
+        morselPartners.push_back(scan);
+    }
+    /// Get the operators of the scans that are restricted to the same morsels
+    const std::vector<Operator*>& getMorselPartners() const {
+        return morselPartners;
+    }
+    /// Set the hash tables shared by the threads of a parallel pipeline
+    void setSharedBuilds(std::map<const Plan*, std::shared_ptr<SharedHashBuild> >* builds) {
+        sharedBuilds = builds;
+    }
+    /// Get the hash tables shared by the threads of a parallel pipeline (0 if none)
+    std::map<const Plan*, std::shared_ptr<SharedHashBuild> >* getSharedBuilds() const {
+        return sharedBuilds;
+    }
+
+    /// Set the limits of the query, checked by the operators
+    void setQueryContext(QueryContext* context) {
+        queryContext = context;
+    }
+    /// Get the limits of the query (0 if none)
+    QueryContext* getQueryContext() const {
+        return queryContext;
+    }
+
     /// Set the number of registers
     void allocateRegisters(unsigned count);
     /// Get the number of registers
@@ -13,10 +13,12 @@
 #include <rts/operator/HashJoin.hpp>
 #include <rts/operator/CartProd.hpp>
 #include <rts/operator/IndexScan.hpp>
+#include <rts/operator/LeapfrogJoin.hpp>
 #include <rts/operator/MergeJoin.hpp>
 #include <rts/operator/MergeUnion.hpp>
 #include <rts/operator/NestedLoopFilter.hpp>
 #include <rts/operator/NestedLoopJoin.hpp>
+#include <rts/operator/ParallelPipeline.hpp>
 #include <rts/operator/ResultsPrinter.hpp>
 #include <rts/operator/Selection.hpp>
 #include <rts/operator/SingletonScan.hpp>
@@ -28,10 +30,12 @@
 #include <rts/operator/Union.hpp>
 #include <rts/operator/DuplLimit.hpp>
 #include <rts/operator/GroupBy.hpp>
+#include <rts/operator/GroupCountScan.hpp>
 #include <rts/operator/AggrFunctions.hpp>
 
 #include <trident/sparql/aggrhandler.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <map>
 #include <set>
@@ -49,6 +53,7 @@
 using namespace std;
 //---------------------------------------------------------------------------
 static Operator* translatePlan(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan);
+static Operator* translateParallel(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan);
 //---------------------------------------------------------------------------
 static void resolveScanVariable(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, unsigned slot, const QueryGraph::Node& node, Register*& reg, bool& bound, bool unused = false)
     // Resolve a variable used in a scan
@@ -107,7 +112,7 @@ static Operator* translateIndexScan(Runtime& runtime, const map<unsigned, Regist
             subject, constSubject,
             predicate, constPredicate,
             object, constObject,
-            plan->cardinality);
+            plan->cardinality, runtime.getQueryContext());
 }
 //---------------------------------------------------------------------------
 static Operator* translateAggregatedIndexScan(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan)
@@ -209,6 +214,7 @@ static void collectVariables(const map<unsigned, Register*>& context, set<unsign
         case Plan::GroupBy:
         case Plan::Aggregates:
         case Plan::Having:
+        case Plan::LeapfrogJoin:
                                   collectVariables(context, variables, plan->left);
                                   break;
         case Plan::Subselect:
@@ -242,6 +248,7 @@ static void findScan(Plan *plan, set<unsigned>& variables, int *bitset) {
                                              break;
         case Plan::HashJoin:
         case Plan::MergeJoin:
+        case Plan::Filter:
                                              findScan(plan->left, variables, bitset);
                                              break;
         default:
@@ -363,7 +370,7 @@ static Operator* translateMergeJoin(Runtime& runtime, const map<unsigned, Regist
             rightTail.push_back((*iter).second);
 
     // Build the operator
-    Operator* result = new MergeJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, plan->left->optional, plan->right->optional, plan->cardinality);
+    Operator* result = new MergeJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, plan->left->optional, plan->right->optional, plan->cardinality, runtime.getQueryContext());
 
     // And apply additional selections if necessary
     result = addAdditionalSelections(runtime, result, joinVariables, leftBindings, rightBindings, joinOn);
@@ -376,12 +383,17 @@ static Operator* translateHashJoin(Runtime& runtime, const map<unsigned, Registe
 {
     // Get the join variables (if any)
     set<unsigned> joinVariables, newProjection = projection;
-    int bitset;
-    getJoinVariables(context, joinVariables, plan->left, plan->right, &bitset);
+    getJoinVariables(context, joinVariables, plan->left, plan->right, NULL);
     newProjection.insert(joinVariables.begin(), joinVariables.end());
     assert(!joinVariables.empty());
     unsigned joinOn = *(joinVariables.begin());
 
+    // Where the hash keys are in the scan of the right side (if any)
+    set<unsigned> keyVariables;
+    keyVariables.insert(joinOn);
+    int bitset;
+    findScan(plan->right, keyVariables, &bitset);
+
     // Build the input trees
     map<unsigned, Register*> leftBindings, rightBindings;
     Operator* leftTree = translatePlan(runtime, context, newProjection, leftBindings, registers, plan->left);
@@ -398,7 +410,15 @@ static Operator* translateHashJoin(Runtime& runtime, const map<unsigned, Registe
             rightTail.push_back((*iter).second);
 
     // Build the operator
-    Operator* result = new HashJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, -plan->left->costs, plan->right->costs, plan->cardinality, plan->left->optional, plan->right->optional, bitset);
+    HashJoin* join = new HashJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, -plan->left->costs, plan->right->costs, plan->cardinality, plan->left->optional, plan->right->optional, bitset, runtime.getParallelism(), runtime.getHashMemoryBudget(), runtime.getQueryContext());
+    // The copies of the join in the threads of a parallel pipeline build one hash table
+    if (runtime.getSharedBuilds()) {
+        std::shared_ptr<SharedHashBuild>& build = (*runtime.getSharedBuilds())[plan];
+        if (!build)
+            build.reset(new SharedHashBuild());
+        join->shareBuild(build);
+    }
+    Operator* result = join;
 
     // And apply additional selections if necessary
     result = addAdditionalSelections(runtime, result, joinVariables, leftBindings, rightBindings, joinOn);
@@ -439,7 +459,7 @@ static Operator* translateHashGroupify(Runtime& runtime, const map<unsigned, Reg
     // Translate a hash groupify into an operator tree
 {
     // Build the input trees
-    Operator* tree = translatePlan(runtime, context, projection, bindings, registers, plan->left);
+    Operator* tree = translateParallel(runtime, context, projection, bindings, registers, plan->left);
 
     // Collect output registers
     vector<Register*> output;
@@ -447,7 +467,7 @@ static Operator* translateHashGroupify(Runtime& runtime, const map<unsigned, Reg
         output.push_back((*iter).second);
 
     // Build the operator
-    return new HashGroupify(tree, output, plan->cardinality);
+    return new HashGroupify(tree, output, runtime.getDatabase(), plan->cardinality, runtime.getParallelism(), runtime.getHashMemoryBudget(), runtime.getQueryContext());
 }
 //---------------------------------------------------------------------------
 static void collectVariables(set<unsigned>& filterVariables, const QueryGraph::Filter& filter)
@@ -624,7 +644,7 @@ static Selection::Predicate* buildSelection(Runtime &runtime, const map<unsigned
 }
 //---------------------------------------------------------------------------
 static Operator* translateGroupBy(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan) {
-    Operator* tree = translatePlan(runtime, context, projection, bindings,
+    Operator* tree = translateParallel(runtime, context, projection, bindings,
             registers, plan->left);
 
     vector<unsigned> regs;
@@ -648,6 +668,267 @@ static Operator* translateGroupBy(Runtime& runtime, const map<unsigned, Register
     return result;
 }
 //---------------------------------------------------------------------------
+static DBLayer::DataOrder orderOf(unsigned first, unsigned second)
+    // The data order that starts with the two given positions
+{
+    switch (first) {
+        case 0: return (second == 2) ? DBLayer::Order_Subject_Object_Predicate : DBLayer::Order_Subject_Predicate_Object;
+        case 1: return (second == 0) ? DBLayer::Order_Predicate_Subject_Object : DBLayer::Order_Predicate_Object_Subject;
+        default: return (second == 0) ? DBLayer::Order_Object_Subject_Predicate : DBLayer::Order_Object_Predicate_Subject;
+    }
+}
+//---------------------------------------------------------------------------
+static Operator* translateLeapfrogJoin(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan)
+    // Translate a multiway join into an operator tree
+{
+    const QueryGraph::SubQuery& query = *reinterpret_cast<QueryGraph::SubQuery*>(plan->right);
+
+    // Collect the occurrences of the variables
+    map<unsigned, vector<unsigned> > occurrences;
+    for (unsigned index = 0; index < query.nodes.size(); index++) {
+        const QueryGraph::Node& node = query.nodes[index];
+        if (!node.constSubject) occurrences[node.subject].push_back(index);
+        if (!node.constPredicate) occurrences[node.predicate].push_back(index);
+        if (!node.constObject) occurrences[node.object].push_back(index);
+    }
+
+    // Variables bound by an outer operator can leave patterns without
+    // variables. Use the binary joins
+    for (map<unsigned, vector<unsigned> >::const_iterator iter = occurrences.begin(), limit = occurrences.end(); iter != limit; ++iter)
+        if (context.count((*iter).first))
+            return translatePlan(runtime, context, projection, bindings, registers, plan->left);
+
+    // Order the variables. Start from the most frequent one, then prefer the
+    // variables that share most patterns with the ones already chosen
+    vector<unsigned> order;
+    map<unsigned, unsigned> ranks;
+    vector<bool> touched(query.nodes.size());
+    while (order.size() < occurrences.size()) {
+        unsigned best = 0, bestShared = 0, bestCount = 0;
+        bool found = false;
+        for (map<unsigned, vector<unsigned> >::const_iterator iter = occurrences.begin(), limit = occurrences.end(); iter != limit; ++iter) {
+            if (ranks.count((*iter).first))
+                continue;
+            unsigned shared = 0;
+            for (vector<unsigned>::const_iterator iter2 = (*iter).second.begin(), limit2 = (*iter).second.end(); iter2 != limit2; ++iter2)
+                if (touched[*iter2])
+                    shared++;
+            if ((!found) || (shared > bestShared) || ((shared == bestShared) && ((*iter).second.size() > bestCount))) {
+                best = (*iter).first;
+                bestShared = shared;
+                bestCount = (*iter).second.size();
+                found = true;
+            }
+        }
+        ranks[best] = order.size();
+        order.push_back(best);
+        for (vector<unsigned>::const_iterator iter = occurrences[best].begin(), limit = occurrences[best].end(); iter != limit; ++iter)
+            touched[*iter] = true;
+    }
+
+    // Build the patterns. The registers of the first occurrence receive the
+    // values of the variables
+    vector<Register*> variables(order.size());
+    vector<LeapfrogJoin::Pattern> patterns;
+    for (unsigned index = 0; index < query.nodes.size(); index++) {
+        const QueryGraph::Node& node = query.nodes[index];
+        unsigned base = (*registers.find(&node)).second;
+        bool constant[3] = { node.constSubject, node.constPredicate, node.constObject };
+        uint64_t values[3] = { node.subject, node.predicate, node.object };
+
+        LeapfrogJoin::Pattern pattern;
+        vector<unsigned> positions, vars;
+        for (unsigned slot = 0; slot < 3; slot++) {
+            if (!constant[slot])
+                continue;
+            Register* reg = runtime.getRegister(base + slot);
+            reg->value = values[slot];
+            pattern.bound.push_back(reg);
+            positions.push_back(slot);
+        }
+        for (unsigned rank = 0; rank < order.size(); rank++) {
+            for (unsigned slot = 0; slot < 3; slot++) {
+                if (constant[slot] || (values[slot] != order[rank]))
+                    continue;
+                if (!variables[rank]) {
+                    variables[rank] = runtime.getRegister(base + slot);
+                    if (projection.count(order[rank]))
+                        bindings[order[rank]] = variables[rank];
+                }
+                pattern.variables.push_back(rank);
+                positions.push_back(slot);
+            }
+        }
+        pattern.order = orderOf(positions[0], positions[1]);
+        patterns.push_back(pattern);
+    }
+
+    return new LeapfrogJoin(runtime.getDatabase(), patterns, variables, plan->cardinality);
+}
+//---------------------------------------------------------------------------
+static Operator* translateGroupCount(Runtime& runtime,
+        const map<unsigned, Register*>& context,
+        const set<unsigned>& projection,
+        map<unsigned, Register*>& bindings,
+        const map<const QueryGraph::Node*, unsigned>& registers,
+        const AggregateHandler &hdl,
+        const std::vector<Register*> &counts,
+        Plan* plan)
+    // Answer COUNTs over a single pattern with the counts stored in the
+    // indices. COUNT(*) counts the triples of the pattern. Returns 0 if the
+    // query does not have this shape. The counts are not merged with the
+    // diffs and the memtable, so the operators are built as usual when the
+    // KB has updates
+{
+    Plan* groupBy = plan->left;
+    if (!groupBy || groupBy->op != Plan::GroupBy || !groupBy->left)
+        return 0;
+    Plan* scan = groupBy->left;
+    if (scan->op != Plan::IndexScan && scan->op != Plan::AggregatedIndexScan
+            && scan->op != Plan::FullyAggregatedIndexScan)
+        return 0;
+    // The counts in the indices do not include the updates
+    if (!hdl.onlyCounts() || runtime.getDatabase().hasUpdates())
+        return 0;
+
+    const QueryGraph::Node& node = *reinterpret_cast<QueryGraph::Node*>(scan->right);
+    bool constant[3] = {node.constSubject, node.constPredicate, node.constObject};
+    uint64_t values[3] = {node.subject, node.predicate, node.object};
+    unsigned nconsts = 0;
+    for (unsigned i = 0; i < 3; ++i) {
+        if (constant[i]) {
+            nconsts++;
+            continue;
+        }
+        if (context.count(values[i]))
+            return 0;
+        // Repeated variables need a filter on the triples
+        for (unsigned j = 0; j < i; ++j)
+            if (!constant[j] && values[j] == values[i])
+                return 0;
+    }
+
+    // Every group key must be a position of the pattern
+    std::vector<unsigned> groupSlots;
+    if (groupBy->right) {
+        const std::vector<unsigned>& groupByVars =
+            *reinterpret_cast<const std::vector<unsigned>*>(groupBy->right);
+        for (auto v : groupByVars) {
+            unsigned slot = 0;
+            while (slot < 3 && (constant[slot] || values[slot] != v))
+                slot++;
+            if (slot == 3)
+                return 0;
+            for (auto s : groupSlots)
+                if (s == slot)
+                    return 0;
+            groupSlots.push_back(slot);
+        }
+    }
+    if (!groupSlots.empty() && nconsts + groupSlots.size() > 2)
+        return 0;
+
+    // The counted variables must be bound by the pattern, and the pattern
+    // cannot return any other variable
+    std::set<unsigned> counted;
+    for (auto v : hdl.getInputOutputVars().first)
+        counted.insert(v);
+    for (unsigned i = 0; i < 3; ++i) {
+        if (constant[i])
+            continue;
+        bool grouped = false;
+        for (auto s : groupSlots)
+            if (s == i)
+                grouped = true;
+        if (!grouped && projection.count(values[i]) && !counted.count(values[i]))
+            return 0;
+        counted.erase(values[i]);
+    }
+    if (!counted.empty())
+        return 0;
+
+    // Constants first, then the grouped positions
+    std::vector<unsigned> slots;
+    for (unsigned i = 0; i < 3; ++i)
+        if (constant[i])
+            slots.push_back(i);
+    for (auto s : groupSlots)
+        slots.push_back(s);
+    for (unsigned i = 0; slots.size() < 2; ++i) {
+        bool used = false;
+        for (auto s : slots)
+            if (s == i)
+                used = true;
+        if (!used)
+            slots.push_back(i);
+    }
+    DBLayer::DataOrder order = orderOf(slots[0], slots[1]);
+
+    Register* groups[2] = {0, 0};
+    for (unsigned i = 0; i < groupSlots.size(); ++i) {
+        unsigned slot = groupSlots[i];
+        groups[i] = runtime.getRegister(registers.find(&node)->second + slot);
+        bindings[values[slot]] = groups[i];
+    }
+    return new GroupCountScan(runtime.getDatabase(), order,
+            constant[0] ? values[0] : UINT64_MAX,
+            constant[1] ? values[1] : UINT64_MAX,
+            constant[2] ? values[2] : UINT64_MAX,
+            groups[0], groups[1], counts, plan->cardinality);
+}
+//---------------------------------------------------------------------------
+static Operator* translateHashAggregates(Runtime& runtime,
+        const map<unsigned, Register*>& context,
+        const set<unsigned>& projection,
+        map<unsigned, Register*>& bindings,
+        const map<const QueryGraph::Node*, unsigned>& registers,
+        const AggregateHandler &hdl,
+        const std::vector<unsigned> &groupkeys,
+        Plan* plan)
+    // Compute COUNTs and SUMs with a hash table instead of sorting the
+    // input on the group keys. Returns 0 if other functions are used
+{
+    Plan* groupBy = plan->left;
+    if (!groupBy || groupBy->op != Plan::GroupBy || !groupBy->left)
+        return 0;
+    auto functions = hdl.getFunctions();
+    auto inputs = hdl.getInputOutputVars().first;
+    for (auto &f : functions) {
+        if (std::get<0>(f) != AggregateHandler::COUNT &&
+                std::get<0>(f) != AggregateHandler::SUM)
+            return 0;
+        // The result of a function cannot be the input of another one
+        if (std::find(inputs.begin(), inputs.end(), std::get<1>(f)) == inputs.end()
+                && std::get<1>(f) != hdl.getStarVar())
+            return 0;
+    }
+
+    Operator* tree = translateParallel(runtime, context, projection, bindings,
+            registers, groupBy->left);
+
+    std::vector<Register*> keys;
+    for (unsigned v : groupkeys)
+        if (bindings.count(v))
+            keys.push_back(bindings[v]);
+    std::vector<HashGroupify::Aggregate> aggregates;
+    for (auto &f : functions) {
+        bool star = std::get<1>(f) == hdl.getStarVar();
+        if ((!star && !bindings.count(std::get<1>(f))) || !bindings.count(std::get<2>(f))) {
+            LOG(ERRORL) << "Register not found";
+            throw 10;
+        }
+        HashGroupify::Aggregate aggregate;
+        aggregate.function = (std::get<0>(f) == AggregateHandler::COUNT) ?
+            HashGroupify::Aggregate::Count : HashGroupify::Aggregate::Sum;
+        aggregate.input = star ? 0 : bindings[std::get<1>(f)];
+        aggregate.output = bindings[std::get<2>(f)];
+        aggregates.push_back(aggregate);
+    }
+    return new HashGroupify(tree, keys, aggregates, runtime.getDatabase(),
+            plan->cardinality, runtime.getParallelism(),
+            runtime.getHashMemoryBudget(), runtime.getQueryContext());
+}
+//---------------------------------------------------------------------------
 static Operator* translateAggregates(Runtime& runtime,
         const map<unsigned, Register*>& context,
         const set<unsigned>& projection,
@@ -671,13 +952,28 @@ static Operator* translateAggregates(Runtime& runtime,
 	LOG(ERRORL) << "Register not found";
 	throw 10;
     }
+    std::vector<Register*> outputs;
     for(auto v : vars.second) {
         Register* reg = runtime.getRegister(it->second + slot);
         bindings[v] = reg;
+        outputs.push_back(reg);
         slot++;
     }
 
-    Operator* tree = translatePlan(runtime, context, newprojection, bindings,
+    //COUNTs over a single pattern can be read from the indices
+    Operator* count = translateGroupCount(runtime, context, projection,
+            bindings, registers, hdl, outputs, plan);
+    if (count)
+        return count;
+
+    //COUNTs and SUMs are computed with a hash table, the input does not
+    //need to be sorted on the group keys
+    Operator* hash = translateHashAggregates(runtime, context, newprojection,
+            bindings, registers, hdl, groupkeys, plan);
+    if (hash)
+        return hash;
+
+    Operator* tree = translateParallel(runtime, context, newprojection, bindings,
             registers, plan->left);
     Operator *result = new AggrFunctions(runtime.getDatabase(),
             tree, bindings, hdl,
@@ -1070,10 +1366,166 @@ static Operator* translatePlan(Runtime& runtime, const map<unsigned, Register*>&
         case Plan::Aggregates:
             result = translateAggregates(runtime, context, projection, bindings, registers, plan);
             break;
+        case Plan::LeapfrogJoin:
+            result = translateLeapfrogJoin(runtime, context, projection, bindings, registers, plan);
+            break;
     }
+    // Remember the scan that the threads split in morsels, and the scans
+    // restricted to the same morsels
+    if (plan == runtime.getMorselPlan())
+        runtime.setMorselScan(result);
+    else if (std::find(runtime.getMorselPartnerPlans().begin(), runtime.getMorselPartnerPlans().end(), plan) != runtime.getMorselPartnerPlans().end())
+        runtime.addMorselPartner(result);
     return result;
 }
 //---------------------------------------------------------------------------
+static bool isPipeline(Plan* plan)
+    // Can the plan be executed by several threads at the same time?
+{
+    if (plan->optional)
+        return false;
+    switch (plan->op) {
+        case Plan::IndexScan:
+        case Plan::AggregatedIndexScan:
+        case Plan::FullyAggregatedIndexScan:
+        case Plan::ValuesScan:
+            return true;
+        case Plan::HashJoin:
+        case Plan::MergeJoin:
+            return isPipeline(plan->left) && isPipeline(plan->right);
+        case Plan::Filter:
+            return isPipeline(plan->left);
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+static bool isRangeScan(Plan* plan)
+    // Can the scan be restricted to a range of its first value?
+{
+    switch (plan->op) {
+        case Plan::IndexScan:
+        case Plan::AggregatedIndexScan:
+        case Plan::FullyAggregatedIndexScan: {
+            // The ranges are on the first value, it cannot be a constant
+            const QueryGraph::Node& node = *reinterpret_cast<QueryGraph::Node*>(plan->right);
+            bool constFirst;
+            switch (static_cast<DBLayer::DataOrder>(plan->opArg)) {
+                case DBLayer::Order_Subject_Predicate_Object: case DBLayer::Order_Subject_Object_Predicate: constFirst = node.constSubject; break;
+                case DBLayer::Order_Predicate_Subject_Object: case DBLayer::Order_Predicate_Object_Subject: constFirst = node.constPredicate; break;
+                default: constFirst = node.constObject; break;
+            }
+            return !constFirst;
+        }
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+static bool collectMergeScans(Plan* plan, vector<Plan*>& scans)
+    // Collect the scans of a tree of merge joins. Fails if an input is not a range scan
+{
+    if (plan->op == Plan::MergeJoin)
+        return collectMergeScans(plan->left, scans) && collectMergeScans(plan->right, scans);
+    if (!isRangeScan(plan))
+        return false;
+    scans.push_back(plan);
+    return true;
+}
+//---------------------------------------------------------------------------
+static Plan* findMorselScan(Plan* plan, vector<const Plan*>& partners)
+    // Find the largest scan that can be split in morsels. Every result of the plan contains exactly one of its tuples
+{
+    switch (plan->op) {
+        case Plan::IndexScan:
+        case Plan::AggregatedIndexScan:
+        case Plan::FullyAggregatedIndexScan:
+            return isRangeScan(plan) ? plan : 0;
+        case Plan::HashJoin:
+            // The build side is read only once
+            return findMorselScan(plan->right, partners);
+        case Plan::MergeJoin: {
+            // The inputs are sorted on the join value. If they are all scans,
+            // the join value is their first value and the other scans are
+            // restricted to the same morsels. Otherwise they would be read
+            // again for every morsel, so the join is not split
+            vector<Plan*> scans;
+            if (!collectMergeScans(plan, scans))
+                return 0;
+            Plan* largest = scans.front();
+            for (vector<Plan*>::const_iterator iter = scans.begin(), limit = scans.end(); iter != limit; ++iter)
+                if ((*iter)->cardinality > largest->cardinality)
+                    largest = *iter;
+            for (vector<Plan*>::const_iterator iter = scans.begin(), limit = scans.end(); iter != limit; ++iter)
+                if ((*iter) != largest)
+                    partners.push_back(*iter);
+            return largest;
+        }
+        case Plan::Filter:
+            return findMorselScan(plan->left, partners);
+        default:
+            return 0;
+    }
+}
+//---------------------------------------------------------------------------
+static Operator* translateParallel(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan)
+    // Translate a plan into an operator tree that is executed by several threads, if it is worth it
+{
+    // Smaller scans are not split
+    static const double minMorselScan = 100000;
+
+    Plan* morselPlan = 0;
+    vector<const Plan*> partners;
+    if ((runtime.getParallelism() > 1) && context.empty() && isPipeline(plan))
+        morselPlan = findMorselScan(plan, partners);
+    if ((!morselPlan) || (morselPlan->cardinality < minMorselScan))
+        return translatePlan(runtime, context, projection, bindings, registers, plan);
+
+    // Every thread gets its own copy of the tree, with its own registers
+    DBLayer& db = runtime.getDatabase();
+    unsigned threads = runtime.getParallelism();
+    vector<ParallelPipeline::Worker> workers(threads);
+    map<unsigned, Register*> workerBindings;
+    // The threads share the hash tables of the joins
+    map<const Plan*, std::shared_ptr<SharedHashBuild> > sharedBuilds;
+    for (unsigned index = 0; index < threads; index++) {
+        ParallelPipeline::Worker& worker = workers[index];
+        worker.db = db.createWorker();
+        worker.runtime.reset(new Runtime(*worker.db, runtime.hasTemporaryDictionary() ? &runtime.getTemporaryDictionary() : 0, runtime.getQueryDict()));
+        worker.runtime->allocateRegisters(runtime.getRegisterCount());
+        worker.runtime->setSortMemoryBudget(runtime.getSortMemoryBudget());
+        worker.runtime->setHashMemoryBudget(runtime.getHashMemoryBudget() / threads);
+        worker.runtime->setQueryContext(runtime.getQueryContext());
+        worker.runtime->setMorselPlan(morselPlan, partners);
+        worker.runtime->setSharedBuilds(&sharedBuilds);
+        workerBindings.clear();
+        worker.tree = translatePlan(*worker.runtime, context, projection, workerBindings, registers, plan);
+        worker.runtime->setSharedBuilds(0);
+        worker.driver = worker.runtime->getMorselScan();
+        worker.partners = worker.runtime->getMorselPartners();
+        bool split = worker.driver && worker.driver->setKeyRange(0, UINT64_MAX) && (worker.partners.size() == partners.size());
+        for (vector<Operator*>::const_iterator iter = worker.partners.begin(), limit = worker.partners.end(); split && (iter != limit); ++iter)
+            split = (*iter)->setKeyRange(0, UINT64_MAX);
+        if (!split) {
+            for (unsigned index2 = 0; index2 <= index; index2++)
+                delete workers[index2].tree;
+            return translatePlan(runtime, context, projection, bindings, registers, plan);
+        }
+        for (map<unsigned, Register*>::const_iterator iter = workerBindings.begin(), limit = workerBindings.end(); iter != limit; ++iter)
+            worker.output.push_back((*iter).second);
+    }
+
+    // The results are copied in the registers with the same slots
+    vector<Register*> output;
+    Register* base = workers.back().runtime->getRegister(0);
+    for (map<unsigned, Register*>::const_iterator iter = workerBindings.begin(), limit = workerBindings.end(); iter != limit; ++iter) {
+        Register* reg = runtime.getRegister((*iter).second - base);
+        bindings[(*iter).first] = reg;
+        output.push_back(reg);
+    }
+    return new ParallelPipeline(workers, output, db.getNextId(), 8 * threads, plan->cardinality);
+}
+//---------------------------------------------------------------------------
 static unsigned allocateRegisters(map<const QueryGraph::Node*, unsigned>& registers, map<unsigned, set<unsigned> >& registerClasses, const QueryGraph& query, unsigned id);
 static unsigned allocateRegisters(map<const QueryGraph::Node*, unsigned>& registers, map<unsigned, set<unsigned> >& registerClasses, const QueryGraph::SubQuery& query, unsigned id)
     // Allocate registers
@@ -1180,7 +1632,7 @@ Operator* CodeGen::translateIntern(Runtime& runtime, const QueryGraph& query, Pl
 
         // And build the tree
         map<unsigned, Register*> context, bindings;
-        tree = translatePlan(runtime, context, projection, bindings, registers, plan);
+        tree = translateParallel(runtime, context, projection, bindings, registers, plan);
 
         // Sort if necessary
         if (query.orderBegin() != query.orderEnd()) {
@@ -1193,7 +1645,13 @@ Operator* CodeGen::translateIntern(Runtime& runtime, const QueryGraph& query, Pl
                     order.push_back(pair<Register*, bool>(bindings[(*iter).id], (*iter).descending));
                 else
                     order.push_back(pair<Register*, bool>(0, (*iter).descending));
-            tree = new Sort(runtime.getDatabase(), tree, regs, order, tree->getExpectedOutputCardinality());
+            // With a limit, only the first limit+offset tuples are needed. This
+            // does not hold if the duplicates are removed after the sort
+            uint64_t topK = UINT64_MAX;
+            if (query.getLimit() != ~0u && query.getDuplicateHandling() == QueryGraph::AllDuplicates)
+                topK = static_cast<uint64_t>(query.getLimit()) + query.getOffset();
+            tree = new Sort(runtime.getDatabase(), tree, regs, order, tree->getExpectedOutputCardinality(),
+                    topK, runtime.getSortMemoryBudget(), runtime.getQueryContext());
         }
 
         // Remember the output registers
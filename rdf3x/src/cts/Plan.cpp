@@ -100,6 +100,9 @@ void Plan::print(unsigned indent) const
 	case Aggregates:
             cout << "Aggregates";
 	    break;
+        case LeapfrogJoin:
+            cout << "LeapfrogJoin";
+            break;
     }
     cout << " cardinality=" << cardinality << " costs=" << costs << endl;
     switch (op) {
@@ -142,6 +145,8 @@ void Plan::print(unsigned indent) const
             break;
         case ValuesScan:
             break;
+        case LeapfrogJoin:
+            break;
     }
 }
 //---------------------------------------------------------------------------
@@ -37,12 +37,12 @@ struct PlanGen::JoinDescription {
     const QueryGraph::TableFunction* tableFunction;
 };
 //---------------------------------------------------------------------------
-PlanGen::PlanGen() : plans(new PlanContainer())
+PlanGen::PlanGen() : plans(new PlanContainer()), multiwayJoins(true)
                      // Constructor
 {
 }
 //---------------------------------------------------------------------------
-PlanGen::PlanGen(std::shared_ptr<PlanContainer> plans) : plans(plans)
+PlanGen::PlanGen(std::shared_ptr<PlanContainer> plans) : plans(plans), multiwayJoins(true)
                                                          // Constructor
 {
 }
@@ -881,6 +881,9 @@ static void findFilters(Plan* plan, set<const QueryGraph::Filter*>& filters)
             break;
         case Plan::ValuesScan:
             break;
+        case Plan::LeapfrogJoin:
+            // The filters are applied on top
+            break;
         case Plan::Minus:
             findFilters(plan->left, filters);
             break;
@@ -892,6 +895,57 @@ static void findFilters(Plan* plan, set<const QueryGraph::Filter*>& filters)
     }
 }
 //---------------------------------------------------------------------------
+static uint64_t findRoot(map<uint64_t, uint64_t>& parents, uint64_t var)
+    // Find the representative of a set of variables
+{
+    while (parents[var] != var)
+        var = parents[var] = parents[parents[var]];
+    return var;
+}
+//---------------------------------------------------------------------------
+bool PlanGen::isCyclicPattern(const QueryGraph::SubQuery& query)
+    // Can the patterns be joined with a single multiway join?
+{
+    // Only plain conjunctive patterns
+    if ((query.nodes.size() < 3) || (!query.optional.empty()) || (!query.unions.empty()) ||
+            (!query.subqueries.empty()) || (!query.tableFunctions.empty()) || (!query.valueNodes.empty()))
+        return false;
+
+    // The multiway join needs every permutation
+    for (unsigned order = DBLayer::Order_Subject_Predicate_Object; order <= DBLayer::Order_Predicate_Object_Subject; order++)
+        if (!db->hasPermutation(static_cast<DBLayer::DataOrder>(order)))
+            return false;
+
+    // Look for a cycle in the graph that connects the variables that occur in
+    // the same pattern. The variables of a pattern are connected by a path
+    // only, so that a single pattern never closes a cycle
+    map<uint64_t, uint64_t> parents;
+    bool cyclic = false;
+    for (vector<QueryGraph::Node>::const_iterator iter = query.nodes.begin(), limit = query.nodes.end(); iter != limit; ++iter) {
+        vector<uint64_t> vars;
+        if (!(*iter).constSubject) vars.push_back((*iter).subject);
+        if (!(*iter).constPredicate) vars.push_back((*iter).predicate);
+        if (!(*iter).constObject) vars.push_back((*iter).object);
+        if (vars.empty())
+            return false;
+        for (unsigned index = 0; index < vars.size(); index++) {
+            for (unsigned index2 = 0; index2 < index; index2++)
+                if (vars[index] == vars[index2])
+                    return false;
+            if (!parents.count(vars[index]))
+                parents[vars[index]] = vars[index];
+        }
+        for (unsigned index = 1; index < vars.size(); index++) {
+            uint64_t root1 = findRoot(parents, vars[index - 1]), root2 = findRoot(parents, vars[index]);
+            if (root1 == root2)
+                cyclic = true;
+            else
+                parents[root1] = root2;
+        }
+    }
+    return cyclic;
+}
+//---------------------------------------------------------------------------
 Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
         const QueryGraph &entirePlan,
         bool completeEstimate)
@@ -912,6 +966,7 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
     std::vector<Plan*> subqueryPlans;
     for (std::vector<std::shared_ptr<QueryGraph>>::const_iterator itr = query.subqueries.begin(); itr != query.subqueries.end(); ++itr) {
         PlanGen p(plans);
+        p.setMultiwayJoins(multiwayJoins);
         p.init(db, *itr->get());
         Plan* childPlan = p.translate_int((*itr)->getQuery(), *itr->get(), completeEstimate);
         Plan* plan = plans->alloc();
@@ -1236,6 +1291,21 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
     }
     Plan* plan =  dpTable.back()->plans;
 
+    // Cyclic patterns are joined at once. The binary plan gives the estimates
+    // and is used if some variables are bound by an outer operator
+    if (multiwayJoins && isCyclicPattern(query)) {
+        Plan* p = plans->alloc();
+        p->op = Plan::LeapfrogJoin;
+        p->opArg = 0;
+        p->left = plan;
+        p->right = reinterpret_cast<Plan*>(const_cast<QueryGraph::SubQuery*>(&query));
+        p->next = 0;
+        p->cardinality = plan->cardinality;
+        p->costs = plan->costs;
+        p->ordering = ~0u;
+        plan = p;
+    }
+
     // Add all remaining filters
     set<const QueryGraph::Filter*> appliedFilters;
     findFilters(plan, appliedFilters);
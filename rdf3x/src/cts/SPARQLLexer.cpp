@@ -10,7 +10,7 @@
 // San Francisco, California, 94105, USA.
 //---------------------------------------------------------------------------
 SPARQLLexer::SPARQLLexer(const std::string& input)
-    : input(input), pos(this->input.begin()), tokenStart(pos), tokenEnd(pos),
+    : input(input), pos(this->input.begin()), lastPos(pos), tokenStart(pos), tokenEnd(pos),
       putBack(None), hasTokenEnd(false)
       // Constructor
 {
@@ -33,6 +33,7 @@ SPARQLLexer::Token SPARQLLexer::getNext()
 
     // Reset the token end
     hasTokenEnd = false;
+    lastPos = pos;
 
     //For decimal numbers
     bool isInt = true;
@@ -197,7 +197,7 @@ string _filter2string(SPARQLParser::Filter *filter) {
     switch (filter->type) {
         case SPARQLParser::Filter::Aggregate_count:
             out += "COUNT(";
-            out += _filter2string(filter->arg1);
+            out += filter->arg1 ? _filter2string(filter->arg1) : "*";
             out += ")";
             break;
         case SPARQLParser::Filter::Aggregate_min:
@@ -249,8 +249,11 @@ void SPARQLParser::parseProjection(PatternGroup& group)
                 throw ParserException("'{' expected");
         }
 
+        //The constants of the template are not part of the query graph
+        size_t nconstants = constants.size();
         constructPatterns = PatternGroup();
         parseGroupGraphPattern(constructPatterns);
+        constants.resize(nconstants);
 
         //Now I get all variables in my pattern.
         //These are the projection variables I need
@@ -743,6 +746,8 @@ SPARQLParser::Filter* SPARQLParser::parseBuiltInCall(std::map<std::string, unsig
                 newSubquery->parse(true);
                 variableCount = newSubquery->variableCount;
                 namedVariables = newSubquery->namedVariables;
+                constants.insert(constants.end(), newSubquery->constants.begin(),
+                        newSubquery->constants.end());
                 result->pointerToSubquery = std::shared_ptr<SPARQLParser>(newSubquery);
 
                 if (lexer.hasNext(SPARQLLexer::RCurly)) {
@@ -1234,20 +1239,20 @@ SPARQLParser::Element SPARQLParser::parseBlankNode(PatternGroup & group, map<str
     subject.id = variableCount++;
 
     // Parse the the remaining part of the pattern
-    SPARQLParser::Element predicate = parsePatternElement(group, localVars);
-    SPARQLParser::Element object = parsePatternElement(group, localVars);
+    SPARQLParser::Element predicate = parseTripleElement(group, localVars);
+    SPARQLParser::Element object = parseTripleElement(group, localVars);
     group.patterns.push_back(Pattern(subject, predicate, object));
 
     // Check for the tail
     while (true) {
         SPARQLLexer::Token token = lexer.getNext();
         if (token == SPARQLLexer::Semicolon) {
-            predicate = parsePatternElement(group, localVars);
-            object = parsePatternElement(group, localVars);
+            predicate = parseTripleElement(group, localVars);
+            object = parseTripleElement(group, localVars);
             group.patterns.push_back(Pattern(subject, predicate, object));
             continue;
         } else if (token == SPARQLLexer::Comma) {
-            object = parsePatternElement(group, localVars);
+            object = parseTripleElement(group, localVars);
             group.patterns.push_back(Pattern(subject, predicate, object));
             continue;
         } else if (token == SPARQLLexer::Dot) {
@@ -1340,27 +1345,37 @@ SPARQLParser::Element SPARQLParser::parsePatternElement(PatternGroup & group, ma
     return result;
 }
 //---------------------------------------------------------------------------
+SPARQLParser::Element SPARQLParser::parseTripleElement(PatternGroup & group, map<string, unsigned>& localVars)
+    // Parse an entry of a triple pattern, remember where its constant is
+{
+    size_t begin = lexer.getReaderOffset();
+    Element result = parsePatternElement(group, localVars);
+    if (result.type != Element::Variable)
+        constants.push_back(make_pair(begin, lexer.getReaderOffset()));
+    return result;
+}
+//---------------------------------------------------------------------------
 void SPARQLParser::parseGraphPattern(PatternGroup & group)
     // Parse a graph pattern
 {
     map<string, unsigned> localVars;
 
     // Parse the first pattern
-    Element subject = parsePatternElement(group, localVars);
-    Element predicate = parsePatternElement(group, localVars);
-    Element object = parsePatternElement(group, localVars);
+    Element subject = parseTripleElement(group, localVars);
+    Element predicate = parseTripleElement(group, localVars);
+    Element object = parseTripleElement(group, localVars);
     group.patterns.push_back(Pattern(subject, predicate, object));
 
     // Check for the tail
     while (true) {
         SPARQLLexer::Token token = lexer.getNext();
         if (token == SPARQLLexer::Semicolon) {
-            predicate = parsePatternElement(group, localVars);
-            object = parsePatternElement(group, localVars);
+            predicate = parseTripleElement(group, localVars);
+            object = parseTripleElement(group, localVars);
             group.patterns.push_back(Pattern(subject, predicate, object));
             continue;
         } else if (token == SPARQLLexer::Comma) {
-            object = parsePatternElement(group, localVars);
+            object = parseTripleElement(group, localVars);
             group.patterns.push_back(Pattern(subject, predicate, object));
             continue;
         } else if (token == SPARQLLexer::Dot) {
@@ -1414,6 +1429,8 @@ void SPARQLParser::parseGroupGraphPattern(PatternGroup & group)
             group.subqueries.push_back(std::shared_ptr<SPARQLParser>(newSubquery));
             variableCount = newSubquery->variableCount;
             namedVariables = newSubquery->namedVariables;
+            constants.insert(constants.end(), newSubquery->constants.begin(),
+                    newSubquery->constants.end());
 
             //The last token should be the RCurly
             if (lexer.getNext() != SPARQLLexer::RCurly) {
@@ -0,0 +1,36 @@
+#include "infra/util/SemiJoinFilter.hpp"
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+SemiJoinFilter::SemiJoinFilter()
+   : exact(true)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+void SemiJoinFilter::build(const std::vector<uint64_t>& keys)
+   // Build the filter over a set of distinct keys
+{
+   this->keys.clear();
+
+   // Small sets are kept exactly
+   exact=keys.size()<=maxSortedKeys;
+   if (exact) {
+      this->keys=keys;
+      std::sort(this->keys.begin(),this->keys.end());
+      return;
+   }
+
+   // Otherwise in a Bloom filter
+   bloom.init(keys.size());
+   for (std::vector<uint64_t>::const_iterator iter=keys.begin(),limit=keys.end();iter!=limit;++iter)
+      bloom.add(static_cast<int64_t>(*iter));
+}
+//---------------------------------------------------------------------------
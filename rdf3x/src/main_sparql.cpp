@@ -13,6 +13,7 @@
 #include <cts/codegen/CodeGen.hpp>
 #include <rts/runtime/Runtime.hpp>
 #include <rts/runtime/QueryDict.hpp>
+#include <rts/runtime/QueryContext.hpp>
 #include <rts/operator/Operator.hpp>
 #include <rts/operator/PlanPrinter.hpp>
 #include <rts/operator/ResultsPrinter.hpp>
@@ -24,7 +25,8 @@ using namespace std;
 
 DDLEXPORT void execNativeQuery(ProgramArgs &vm, Querier *q, KB &kb, bool silent);
 DDLEXPORT void callRDF3X(TridentLayer &db, const string &queryFileName, bool explain,
-        bool disableBifocalSampling, bool resultslookup);
+        bool disableBifocalSampling, bool resultslookup, uint64_t timeout,
+        uint64_t memoryLimit);
 
 std::unique_ptr<Query> createQueryFromRF3XQueryGraph(SPARQLParser &parser,
         QueryGraph &graph) {
@@ -102,7 +104,8 @@ void parseQuery(bool &success,
 }
 
 void callRDF3X(TridentLayer &db, const string &queryFileName, bool explain,
-        bool disableBifocalSampling, bool resultslookup) {
+        bool disableBifocalSampling, bool resultslookup, uint64_t timeout,
+        uint64_t memoryLimit) {
     QueryDict queryDict(db.getNextId());
     bool parsingOk;
 
@@ -153,8 +156,12 @@ void callRDF3X(TridentLayer &db, const string &queryFileName, bool explain,
     }
     std::chrono::duration<double> durationO = std::chrono::system_clock::now() - start;
 
-    // Build a physical plan
+    // Build a physical plan. The query stops if it exceeds the limits
+    QueryContext context;
+    context.setTimeout(timeout);
+    context.setMemoryLimit(memoryLimit);
     Runtime runtime(db, NULL, &queryDict);
+    runtime.setQueryContext(&context);
     Operator* operatorTree = CodeGen().translate(runtime, *queryGraph.get(), plan, !resultslookup);
 
     // Execute it
@@ -164,8 +171,12 @@ void callRDF3X(TridentLayer &db, const string &queryFileName, bool explain,
         delete operatorTree;
     } else {
         std::chrono::system_clock::time_point startQ = std::chrono::system_clock::now();
-        if (operatorTree->first()) {
-            while (operatorTree->next());
+        try {
+            if (operatorTree->first()) {
+                while (operatorTree->next());
+            }
+        } catch (const QueryContext::Exception &e) {
+            LOG(WARNL) << "The query was stopped: " << e.message;
         }
         std::chrono::duration<double> durationQ = std::chrono::system_clock::now() - startQ;
         std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
@@ -211,7 +222,11 @@ void execNativeQuery(ProgramArgs &vm, Querier *q, KB &kb, bool silent) {
 
     std::unique_ptr<Query> query  = createQueryFromRF3XQueryGraph(parser,
             *queryGraph.get());
-    TridentQueryPlan plan(q);
+    //The query stops if it exceeds the timeout. The memory of the native
+    //operators is not accounted
+    QueryContext context;
+    context.setTimeout(vm["timeout"].as<int64_t>());
+    TridentQueryPlan plan(q, &context);
     plan.create(*query.get(), SIMPLE);
     std::chrono::duration<double> durationO = std::chrono::system_clock::now() - start;
 
@@ -227,16 +242,20 @@ void execNativeQuery(ProgramArgs &vm, Querier *q, KB &kb, bool silent) {
         TupleIterator *root = plan.getIterator();
         //Execute the query
         const uint8_t nvars = (uint8_t) root->getTupleSize();
-        while (root->hasNext()) {
-            root->next();
-            if (! silent) {
-                for (uint8_t i = 0; i < nvars; ++i) {
-                    dict->getText(root->getElementAt(i), bufferTerm);
-                    std::cout << bufferTerm << ' ';
+        try {
+            while (root->hasNext()) {
+                root->next();
+                if (! silent) {
+                    for (uint8_t i = 0; i < nvars; ++i) {
+                        dict->getText(root->getElementAt(i), bufferTerm);
+                        std::cout << bufferTerm << ' ';
+                    }
+                    std::cout << '\n';
                 }
-                std::cout << '\n';
+                nElements++;
             }
-            nElements++;
+        } catch (const QueryContext::Exception &e) {
+            LOG(WARNL) << "The query was stopped: " << e.message;
         }
         std::chrono::duration<double> sec = std::chrono::system_clock::now()
             - startQ;
@@ -6,6 +6,7 @@
 #include <kognac/logs.h>
 
 #include <assert.h>
+#include <cstring>
 
 AggrFunctions::AggrFunctions(DBLayer& db, Operator* child,
         std::map<unsigned, Register *> &bindings,
@@ -26,6 +27,11 @@ AggrFunctions::AggrFunctions(DBLayer& db, Operator* child,
             Register *reg = bindings.find(v)->second;
             varsToUpdate.push_back(std::make_pair(v, reg));
         }
+        //The input of COUNT(*) has no register
+        if (this->hdl.hasStar()) {
+            varsToUpdate.push_back(std::make_pair(this->hdl.getStarVar(),
+                        (Register*) NULL));
+        }
         for(auto v : iovars.second) {
             Register *reg = bindings.find(v)->second;
             varsToReturn.push_back(std::make_pair(v, reg));
@@ -44,20 +50,28 @@ void AggrFunctions::readKeys() {
 
 void AggrFunctions::copyVars() {
     for(uint8_t i = 0; i < varsToReturn.size(); ++i) {
-        if (hdl.getValueType(varsToReturn[i].first)
-                == AggregateHandler::VarValue::TYPE::INT) {
-            uint64_t val = hdl.getValueInt(varsToReturn[i].first);
-            val = val | DICTMGMT_INTEGER;
-            varsToReturn[i].second->value = val;
+        AggregateHandler::VarValue value;
+        value.type = hdl.getValueType(varsToReturn[i].first);
+        if (value.type == AggregateHandler::VarValue::TYPE::INT) {
+            value.v_int = hdl.getValueInt(varsToReturn[i].first);
         } else {
-            assert(hdl.getValueType(varsToReturn[i].first)
-                    == AggregateHandler::VarValue::TYPE::DEC);
-            double val = hdl.getValueDec(varsToReturn[i].first);
-            uint64_t uint_val = 0;
-            uint_val = uint_val | DICTMGMT_FLOAT;
-            *(float*)((char*)(&uint_val) + 4) = val;
-            varsToReturn[i].second->value = val;
+            assert(value.type == AggregateHandler::VarValue::TYPE::DEC);
+            value.v_dec = hdl.getValueDec(varsToReturn[i].first);
         }
+        varsToReturn[i].second->value = encodeNumber(value);
+    }
+}
+
+uint64_t AggrFunctions::encodeNumber(const AggregateHandler::VarValue &value) {
+    if (value.type == AggregateHandler::VarValue::TYPE::INT) {
+        uint64_t val = value.v_int;
+        return val | DICTMGMT_INTEGER;
+    } else {
+        uint64_t uint_val = 0;
+        uint_val = uint_val | DICTMGMT_FLOAT;
+        float val = value.v_dec;
+        memcpy((char*)(&uint_val) + 4, &val, sizeof(float));
+        return uint_val;
     }
 }
 
@@ -93,47 +107,60 @@ double __getDouble(const std::string &s) {
     return std::stod(number);
 }
 
+AggregateHandler::VarValue AggrFunctions::readNumber(DBLayer &dict,
+        uint64_t value) {
+    AggregateHandler::VarValue number;
+    number.type = AggregateHandler::VarValue::TYPE::SYMBOL;
+    number.v_int = value;
+    if (DictMgmt::isnumeric(value)) {
+        if (DictMgmt::getType(value) == DICTMGMT_INTEGER) {
+            number.type = AggregateHandler::VarValue::TYPE::INT;
+            number.v_int = DictMgmt::getIntValue(value);
+        } else { //Dec
+            number.type = AggregateHandler::VarValue::TYPE::DEC;
+            number.v_dec = DictMgmt::getFloatValue(value);
+        }
+    } else {
+        //The input is a symbol. Must do a dictionary lookup to check whether
+        //I can retrieve the type and value
+        const char *start;
+        const char *end;
+        ::Type::ID type;
+        unsigned subType;
+        bool lkp = dict.lookupById(value, start, end, type, subType);
+        if (lkp) {
+            std::string d = "^^<http://www.w3.org/2001/XMLSchema#double>";
+            std::string f = "^^<http://www.w3.org/2001/XMLSchema#float>";
+            std::string i = "^^<http://www.w3.org/2001/XMLSchema#integer>";
+            string s = string(start, end);
+            if (__endsWith(s,d) || __endsWith(s,f)) {
+                //Decimal number
+                number.type = AggregateHandler::VarValue::TYPE::DEC;
+                number.v_dec = __getDouble(s);
+            } else if (__endsWith(s,i)) {
+                //Integer number
+                number.type = AggregateHandler::VarValue::TYPE::INT;
+                number.v_int = __getLong(s);
+            }
+        }
+    }
+    return number;
+}
+
 void AggrFunctions::updateVar(std::pair<unsigned,Register*> &var,
         uint64_t currentCount) {
-    uint64_t value = var.second->value;
+    uint64_t value = var.second ? var.second->value : 0;
     if (!hdl.requiresNumber(var.first)) {
         hdl.updateVarSymbol(var.first, value, currentCount);
     } else {
-        if (DictMgmt::isnumeric(value)) {
-            if (DictMgmt::getType(value) == DICTMGMT_INTEGER) {
-                hdl.updateVarInt(var.first, DictMgmt::getIntValue(value), currentCount);
-            } else { //Dec
-                hdl.updateVarDec(var.first, DictMgmt::getFloatValue(value), currentCount);
-            }
+        AggregateHandler::VarValue number = readNumber(dict, value);
+        if (number.type == AggregateHandler::VarValue::TYPE::INT) {
+            hdl.updateVarInt(var.first, number.v_int, currentCount);
+        } else if (number.type == AggregateHandler::VarValue::TYPE::DEC) {
+            hdl.updateVarDec(var.first, number.v_dec, currentCount);
         } else {
-            //The input is a symbol. Must do a dictionary lookup to check whether
-            //I can retrieve the type and value
-            const char *start;
-            const char *end;
-            ::Type::ID type;
-            unsigned subType;
-            bool lkp = dict.lookupById(value, start, end, type, subType);
-            if (lkp) {
-                std::string d = "^^<http://www.w3.org/2001/XMLSchema#double>";
-                std::string f = "^^<http://www.w3.org/2001/XMLSchema#float>";
-                std::string i = "^^<http://www.w3.org/2001/XMLSchema#integer>";
-                string s = string(start, end);
-                if (__endsWith(s,d) || __endsWith(s,f)) {
-                    //Decimal number
-                    double v1 = __getDouble(s);
-                    hdl.updateVarDec(var.first, v1, currentCount);
-                } else if (__endsWith(s,i)) {
-                    //Integer number
-                    int64_t v1 = __getLong(s);
-                    hdl.updateVarInt(var.first, v1, currentCount);
-                } else {
-                    //Treat the symbol as integer
-                    hdl.updateVarSymbol(var.first, value, currentCount);
-                }
-            } else {
-                //Treat the symbol as integer
-                hdl.updateVarSymbol(var.first, value, currentCount);
-            }
+            //Treat the symbol as integer
+            hdl.updateVarSymbol(var.first, value, currentCount);
         }
     }
 }
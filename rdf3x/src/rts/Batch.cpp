@@ -0,0 +1,28 @@
+#include "rts/operator/Batch.hpp"
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+Batch::Batch(const std::vector<Register*>& registers)
+   : registers(registers),values(registers.size()*capacity),counts(capacity),selection(capacity),rows(0),size(0),done(false)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+unsigned Batch::addRegister(Register* reg)
+   // Get the column of a register, add it if needed
+{
+   for (unsigned index=0,limit=registers.size();index<limit;index++)
+      if (registers[index]==reg)
+         return index;
+   registers.push_back(reg);
+   values.resize(registers.size()*capacity);
+   return registers.size()-1;
+}
+//---------------------------------------------------------------------------
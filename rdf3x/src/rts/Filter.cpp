@@ -1,4 +1,5 @@
 #include "rts/operator/Filter.hpp"
+#include "rts/operator/Batch.hpp"
 #include "rts/operator/PlanPrinter.hpp"
 #include "rts/runtime/Runtime.hpp"
 //---------------------------------------------------------------------------
@@ -38,11 +39,9 @@ Filter::~Filter()
    delete input;
 }
 //---------------------------------------------------------------------------
-uint64_t Filter::first()
-   // Produce the first tuple
+void Filter::restrictDomain()
+   // Restrict the domain of the filter register
 {
-   observedOutputCardinality=0;
-
    // Do we know the domain?
    if ((!exclude)&&(filter->domain)) {
       ObservedDomainDescription domain;
@@ -51,6 +50,13 @@ uint64_t Filter::first()
             domain.add(index);
       filter->domain->restrictTo(domain);
    }
+}
+//---------------------------------------------------------------------------
+uint64_t Filter::first()
+   // Produce the first tuple
+{
+   observedOutputCardinality=0;
+   restrictDomain();
 
    // Empty input?
    uint64_t count;
@@ -107,6 +113,58 @@ uint64_t Filter::next()
    }
 }
 //---------------------------------------------------------------------------
+unsigned Filter::filterBatch(Batch& batch,unsigned column)
+   // Remove the rows of a batch that do not qualify
+{
+   const uint64_t* values=batch.getColumn(column);
+   const uint64_t* counts=batch.counts.data();
+   unsigned* selection=batch.selection.data();
+   unsigned size=0;
+   if (valid.empty()) {
+      // Nothing is in the set
+      if (exclude) size=batch.size;
+   } else {
+      // Values below min wrap around and fail the range check
+      const unsigned char* set=valid.data();
+      uint64_t range=max-min;
+      for (unsigned index=0;index<batch.size;index++) {
+         unsigned row=selection[index];
+         uint64_t value=values[row]-min;
+         bool found=(value<=range)&&set[value];
+         selection[size]=row;
+         size+=(found!=exclude);
+      }
+   }
+   batch.size=size;
+   for (unsigned index=0;index<size;index++)
+      observedOutputCardinality+=counts[selection[index]];
+   return size;
+}
+//---------------------------------------------------------------------------
+unsigned Filter::firstBatch(Batch& batch)
+   // Produce the first batch of tuples
+{
+   observedOutputCardinality=0;
+   restrictDomain();
+
+   unsigned column=batch.addRegister(filter);
+   if (!input->firstBatch(batch))
+      return 0;
+   if (filterBatch(batch,column))
+      return batch.size;
+   return nextBatch(batch);
+}
+//---------------------------------------------------------------------------
+unsigned Filter::nextBatch(Batch& batch)
+   // Produce the next batch of tuples
+{
+   unsigned column=batch.addRegister(filter);
+   while (input->nextBatch(batch))
+      if (filterBatch(batch,column))
+         return batch.size;
+   return 0;
+}
+//---------------------------------------------------------------------------
 void Filter::print(PlanPrinter& out)
    // Print the operator tree. Debugging only.
 {
@@ -0,0 +1,119 @@
+#include "rts/operator/GroupCountScan.hpp"
+#include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/Runtime.hpp"
+
+#include <trident/kb/dictmgmt.h>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+GroupCountScan::GroupCountScan(DBLayer& db,DBLayer::DataOrder order,uint64_t subject,uint64_t predicate,uint64_t object,Register* group1,Register* group2,const std::vector<Register*>& counts,double expectedOutputCardinality)
+   : Operator(expectedOutputCardinality),db(db),order(order),subject(subject),predicate(predicate),object(object),nconsts(0),group1(group1),group2(group2),counts(counts),prefix(UINT64_MAX)
+   // Constructor
+{
+   if (~subject) nconsts++;
+   if (~predicate) nconsts++;
+   if (~object) nconsts++;
+
+   // The constant that comes first in the data order
+   switch (order) {
+      case DBLayer::Order_Subject_Predicate_Object: case DBLayer::Order_Subject_Object_Predicate: prefix=subject; break;
+      case DBLayer::Order_Predicate_Subject_Object: case DBLayer::Order_Predicate_Object_Subject: prefix=predicate; break;
+      case DBLayer::Order_Object_Subject_Predicate: case DBLayer::Order_Object_Predicate_Subject: prefix=object; break;
+      default: break;
+   }
+}
+//---------------------------------------------------------------------------
+GroupCountScan::~GroupCountScan()
+   // Destructor
+{
+}
+//---------------------------------------------------------------------------
+uint64_t GroupCountScan::produce()
+   // Copy the current group and its count in the registers
+{
+   if (nconsts) {
+      if (scan->getValue1()!=prefix)
+         return false;
+      group1->value=scan->getValue2();
+   } else {
+      group1->value=scan->getValue1();
+      if (group2)
+         group2->value=scan->getValue2();
+   }
+   uint64_t count=scan->getCount();
+   for (std::vector<Register*>::const_iterator iter=counts.begin(),limit=counts.end();iter!=limit;++iter)
+      (*iter)->value=count|DICTMGMT_INTEGER;
+   observedOutputCardinality++;
+   return 1;
+}
+//---------------------------------------------------------------------------
+uint64_t GroupCountScan::first()
+   // Produce the first tuple
+{
+   observedOutputCardinality=0;
+   scan.reset();
+
+   // No groups, a single lookup is enough
+   if (!group1) {
+      uint64_t count=nconsts?db.getCardinality(subject,predicate,object):db.getCardinality();
+      if (!count)
+         return false;
+      for (std::vector<Register*>::const_iterator iter=counts.begin(),limit=counts.end();iter!=limit;++iter)
+         (*iter)->value=count|DICTMGMT_INTEGER;
+      observedOutputCardinality++;
+      return 1;
+   }
+
+   // One group: the counts are stored next to the keys of the term list.
+   // Otherwise, they are stored next to the pairs of the aggregated index
+   if ((!group2)&&(!nconsts)) {
+      scan=db.getScan(order,DBLayer::AGGR_SKIP_2LAST,0);
+      if (!scan->first())
+         return false;
+   } else {
+      scan=db.getScan(order,DBLayer::AGGR_SKIP_LAST,0);
+      bool found=nconsts?scan->first(prefix,true,0,false):scan->first();
+      if (!found)
+         return false;
+   }
+   return produce();
+}
+//---------------------------------------------------------------------------
+uint64_t GroupCountScan::next()
+   // Produce the next tuple
+{
+   if ((!scan)||(!scan->next()))
+      return false;
+   return produce();
+}
+//---------------------------------------------------------------------------
+void GroupCountScan::print(PlanPrinter& out)
+   // Print the operator tree. Debugging only.
+{
+   out.beginOperator("GroupCountScan",expectedOutputCardinality,observedOutputCardinality);
+   if (~subject) out.addGenericAnnotation("subject="+out.formatValue(subject));
+   if (~predicate) out.addGenericAnnotation("predicate="+out.formatValue(predicate));
+   if (~object) out.addGenericAnnotation("object="+out.formatValue(object));
+   if (group1) out.addScanAnnotation(group1,false);
+   if (group2) out.addScanAnnotation(group2,false);
+   out.addMaterializationAnnotation(counts);
+   out.endOperator();
+}
+//---------------------------------------------------------------------------
+void GroupCountScan::addMergeHint(Register* /*reg1*/,Register* /*reg2*/)
+   // Add a merge join hint
+{
+}
+//---------------------------------------------------------------------------
+void GroupCountScan::getAsyncInputCandidates(Scheduler& /*scheduler*/)
+   // Register parts of the tree that can be executed asynchronous
+{
+}
+//---------------------------------------------------------------------------
@@ -1,6 +1,18 @@
 #include "rts/operator/HashGroupify.hpp"
+#include "rts/operator/AggrFunctions.hpp"
+#include "rts/operator/Batch.hpp"
+#include "rts/operator/ParallelPipeline.hpp"
 #include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/QueryContext.hpp"
 #include "rts/runtime/Runtime.hpp"
+
+#include <trident/kb/dictmgmt.h>
+#include <trident/utils/parallel.h>
+#include <kognac/logs.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
 //---------------------------------------------------------------------------
 // RDF-3X
 // (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
@@ -11,117 +23,353 @@
 // or send a letter to Creative Commons, 171 Second Street, Suite 300,
 // San Francisco, California, 94105, USA.
 //---------------------------------------------------------------------------
-/// Helper
-class HashGroupify::Rehasher {
-   private:
-   /// The hash table
-   std::vector<Group*>& hashTable;
+/// The number of words of the state of a sum: the integer part, the decimal part and whether there was a decimal
+static const unsigned sumSize=3;
+//---------------------------------------------------------------------------
+static inline uint64_t hashValues(const uint64_t* values,unsigned width)
+   // Hash the values of a group. The partition is taken from the top bits
+{
+   uint64_t hash=0;
+   for (unsigned index=0;index<width;index++)
+      hash=((hash<<15)|(hash>>(8*sizeof(uint64_t)-15)))^values[index];
+   hash*=0x9E3779B97F4A7C15ull;
+   return hash^(hash>>32);
+}
+//---------------------------------------------------------------------------
+static inline void addDecimal(uint64_t* state,double value)
+   // Add a decimal to the state of a sum
+{
+   double sum;
+   memcpy(&sum,state+1,sizeof(double));
+   sum+=value;
+   memcpy(state+1,&sum,sizeof(double));
+   state[2]=1;
+}
+//---------------------------------------------------------------------------
+/// The partitions of a thread
+struct HashGroupify::Table {
+   /// The partitions
+   std::vector<Partition> partitions;
+   /// The memory accounted in the context
+   uint64_t accountedBytes;
 
-   public:
    /// Constructor
-   Rehasher(std::vector<Group*>& hashTable) : hashTable(hashTable) {}
+   Table() : partitions(HashGroupify::partitions),accountedBytes(0) {}
 
-   /// Rehash
-   void operator()(Group* g) {
-      Group*& slot=hashTable[g->hash&(hashTable.size()-1)];
-      g->next=slot;
-      slot=g;
+   /// The size in bytes
+   uint64_t getSize() const {
+      uint64_t size=0;
+      for (std::vector<Partition>::const_iterator iter=partitions.begin(),limit=partitions.end();iter!=limit;++iter)
+         size+=(*iter).getSize();
+      return size;
    }
 };
 //---------------------------------------------------------------------------
-/// Helper
-class HashGroupify::Chainer {
+/// Aggregates the batches of the threads of a parallel input
+class HashGroupify::Collector : public ParallelPipeline::Consumer {
    private:
-   /// The chain
-   Group* head,*tail;
+   /// The operator
+   HashGroupify& groupify;
+   /// The columns of the values and of the aggregates
+   const std::vector<unsigned>& columns;
 
    public:
    /// Constructor
-   Chainer() : head(0),tail(0) {}
-
-   /// Get the head
-   Group* getHead() const { return head; }
-
-   /// Rehash
-   void operator()(Group* g) {
-      if (tail)
-         tail->next=g; else
-         head=g;
-      g->next=0;
-      tail=g;
+   Collector(HashGroupify& groupify,const std::vector<unsigned>& columns) : groupify(groupify),columns(columns) {}
+
+   /// Aggregate a batch in the table of the thread
+   void consume(unsigned thread,DBLayer& db,Batch& batch,unsigned size) {
+      groupify.aggregate(*groupify.tables[thread],db,batch,size,columns);
    }
 };
 //---------------------------------------------------------------------------
-HashGroupify::HashGroupify(Operator* input,const std::vector<Register*>& values,double expectedOutputCardinality)
-   : Operator(expectedOutputCardinality),values(values),input(input),groups(0),groupsPool(values.size()*sizeof(uint64_t))
+uint64_t* HashGroupify::Partition::lookup(uint64_t hash,const uint64_t* values,unsigned width,unsigned groupSize)
+   // Find a group, create it if needed
+{
+   // The hash table is at most half full
+   if (2*(count+1)>slots.size()) {
+      uint64_t size=slots.empty()?64:2*slots.size();
+      slots.assign(size,0);
+      for (uint64_t index=0;index<count;index++) {
+         uint64_t slot=groups[index*groupSize]&(size-1);
+         while (slots[slot])
+            slot=(slot+1)&(size-1);
+         slots[slot]=index+1;
+      }
+   }
+
+   // Linear probing
+   const uint64_t mask=slots.size()-1;
+   for (uint64_t slot=hash&mask;;slot=(slot+1)&mask) {
+      if (!slots[slot]) {
+         slots[slot]=++count;
+         groups.resize(count*groupSize);
+         uint64_t* group=&groups[(count-1)*groupSize];
+         group[0]=hash;
+         for (unsigned index=0;index<width;index++)
+            group[index+1]=values[index];
+         return group;
+      }
+      uint64_t* group=&groups[(slots[slot]-1)*groupSize];
+      if (group[0]!=hash)
+         continue;
+      bool match=true;
+      for (unsigned index=0;index<width;index++)
+         if (group[index+1]!=values[index])
+            { match=false; break; }
+      if (match)
+         return group;
+   }
+}
+//---------------------------------------------------------------------------
+void HashGroupify::Partition::clear()
+   // Release the groups
+{
+   std::vector<uint64_t>().swap(groups);
+   std::vector<uint32_t>().swap(slots);
+   count=0;
+}
+//---------------------------------------------------------------------------
+HashGroupify::HashGroupify(Operator* input,const std::vector<Register*>& values,DBLayer& db,double expectedOutputCardinality,unsigned threads,uint64_t memoryBudget,QueryContext* context)
+   : Operator(expectedOutputCardinality),values(values),input(input),db(db),threads(threads?threads:1),memoryBudget(memoryBudget),groupSize(values.size()+2),bytesSpilled(0),nextPartition(partitions),mergedIter(0),groupsIter(0),context(context),mergedBytes(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+HashGroupify::HashGroupify(Operator* input,const std::vector<Register*>& values,const std::vector<Aggregate>& aggregates,DBLayer& db,double expectedOutputCardinality,unsigned threads,uint64_t memoryBudget,QueryContext* context)
+   : Operator(expectedOutputCardinality),values(values),aggregates(aggregates),input(input),db(db),threads(threads?threads:1),memoryBudget(memoryBudget),groupSize(values.size()+2),bytesSpilled(0),nextPartition(partitions),mergedIter(0),groupsIter(0),context(context),mergedBytes(0)
    // Constructor
 {
+   for (std::vector<Aggregate>::const_iterator iter=aggregates.begin(),limit=aggregates.end();iter!=limit;++iter)
+      if ((*iter).function==Aggregate::Sum)
+         groupSize+=sumSize;
 }
 //---------------------------------------------------------------------------
 HashGroupify::~HashGroupify()
    // Destructor
 {
+   releaseMemory();
+   closeSpilled();
    delete input;
 }
 //---------------------------------------------------------------------------
-uint64_t HashGroupify::first()
-   // Produce the first tuple
+void HashGroupify::closeSpilled()
+   // Close the spilled partitions
 {
-   observedOutputCardinality=0;
+   for (std::vector<FILE*>::const_iterator iter=spilled.begin(),limit=spilled.end();iter!=limit;++iter)
+      if (*iter)
+         fclose(*iter);
+   spilled.clear();
+}
+//---------------------------------------------------------------------------
+void HashGroupify::accountMemory(uint64_t& accounted,uint64_t bytes)
+   // Account memory in the context, the previous amount is given
+{
+   if (!context)
+      return;
+   if (bytes>accounted) {
+      uint64_t delta=bytes-accounted;
+      accounted=bytes;
+      context->allocate(delta);
+   } else {
+      context->release(accounted-bytes);
+      accounted=bytes;
+   }
+}
+//---------------------------------------------------------------------------
+void HashGroupify::releaseMemory()
+   // Release the memory accounted in the context
+{
+   for (std::vector<std::unique_ptr<Table> >::iterator iter=tables.begin(),limit=tables.end();iter!=limit;++iter)
+      accountMemory((*iter)->accountedBytes,0);
+   accountMemory(mergedBytes,0);
+}
+//---------------------------------------------------------------------------
+void HashGroupify::aggregate(Table& table,DBLayer& db,Batch& batch,unsigned size,const std::vector<unsigned>& columns)
+   // Aggregate a batch
+{
+   const unsigned width=values.size();
+   std::vector<uint64_t> row(width);
+   for (unsigned index=0;index<size;index++) {
+      unsigned pos=batch.selection[index];
+      uint64_t count=batch.counts[pos];
+      for (unsigned index2=0;index2<width;index2++)
+         row[index2]=batch.getColumn(columns[index2])[pos];
+
+      // Find the group
+      uint64_t hash=hashValues(row.data(),width);
+      uint64_t* group=table.partitions[hash>>58].lookup(hash,row.data(),width,groupSize);
+      group[width+1]+=count;
 
-   // Aggregate the input
-   std::vector<Group*> hashTable;
-   uint64_t hashTableSize=64,load=0,maxLoad=static_cast<uint64_t>(0.8*hashTableSize);
-   hashTable.resize(hashTableSize);
-   groupsPool.freeAll();
-
-   for (uint64_t count=input->first();count;count=input->next()) {
-      // Hash the aggregation values
-      uint64_t hash=0;
-      for (std::vector<Register*>::const_iterator iter=values.begin(),limit=values.end();iter!=limit;++iter)
-         hash=((hash<<15)|(hash>>(8*sizeof(uint64_t)-15)))^((*iter)->value);
-
-      // Scan the hash table for existing values
-      Group*& slot=hashTable[hash&(hashTableSize-1)];
-      bool match=false;
-      for (Group* iter=slot;iter;iter=iter->next) {
-         match=true;
-         for (uint64_t index=0,limit=values.size();index<limit;index++)
-            if (iter->values[index]!=values[index]->value)
-               { match=false; break; }
-         if (match) {
-            iter->count+=count;
-            break;
+      // The counts are the counts of the groups, only the sums have a state
+      uint64_t* state=group+width+2;
+      for (unsigned index2=0,limit=aggregates.size();index2<limit;index2++) {
+         if (aggregates[index2].function!=Aggregate::Sum)
+            continue;
+         uint64_t value=batch.getColumn(columns[width+index2])[pos];
+         if (DictMgmt::getType(value)==DICTMGMT_INTEGER) {
+            // Inlined integers are added without a lookup
+            state[0]+=DictMgmt::getIntValue(value)*count;
+         } else if (~value) {
+            AggregateHandler::VarValue number=AggrFunctions::readNumber(db,value);
+            if (number.type==AggregateHandler::VarValue::TYPE::INT)
+               state[0]+=number.v_int*count;
+            else if (number.type==AggregateHandler::VarValue::TYPE::DEC)
+               addDecimal(state,number.v_dec*count);
          }
+         state+=sumSize;
       }
-      if (match) continue;
-
-      // Create a new group
-      Group* g=groupsPool.alloc();
-      g->next=slot;
-      g->hash=hash;
-      g->count=count;
-      for (uint64_t index=0,limit=values.size();index<limit;index++)
-         g->values[index]=values[index]->value;
-      slot=g;
-
-      // Rehash if necessary
-      if ((++load)>=maxLoad) {
-         hashTable.clear();
-         hashTableSize*=2;
-         maxLoad=static_cast<uint64_t>(0.8*hashTableSize);
-         hashTable.resize(hashTableSize);
-         Rehasher rehasher(hashTable);
-         groupsPool.enumAll(rehasher);
+   }
+
+   // Write the groups to disk if the table is too large
+   if (memoryBudget&&(table.getSize()>memoryBudget/tables.size()))
+      spill(table);
+   if (context) {
+      context->check();
+      accountMemory(table.accountedBytes,table.getSize());
+   }
+}
+//---------------------------------------------------------------------------
+void HashGroupify::spill(Table& table)
+   // Write the groups of a table to disk
+{
+   std::lock_guard<std::mutex> lock(spillMutex);
+   for (unsigned index=0;index<partitions;index++) {
+      Partition& partition=table.partitions[index];
+      if (!partition.count)
+         continue;
+      if ((!spilled[index])&&(!(spilled[index]=tmpfile()))) {
+         LOG(ERRORL) << "HashGroupify: cannot create a temporary file for the spilled groups";
+         throw 10;
+      }
+      uint64_t words=partition.count*groupSize;
+      if (fwrite(partition.groups.data(),sizeof(uint64_t),words,spilled[index])!=words) {
+         LOG(ERRORL) << "HashGroupify: cannot write the spilled groups";
+         throw 10;
+      }
+      bytesSpilled+=words*sizeof(uint64_t);
+      partition.clear();
+   }
+}
+//---------------------------------------------------------------------------
+void HashGroupify::combine(uint64_t* group,const uint64_t* other) const
+   // Add the count and the aggregates of a group to another one
+{
+   const unsigned width=values.size();
+   group[width+1]+=other[width+1];
+   uint64_t* state=group+width+2;
+   const uint64_t* otherState=other+width+2;
+   for (std::vector<Aggregate>::const_iterator iter=aggregates.begin(),limit=aggregates.end();iter!=limit;++iter) {
+      if ((*iter).function!=Aggregate::Sum)
+         continue;
+      state[0]+=otherState[0];
+      if (otherState[2]) {
+         double value;
+         memcpy(&value,otherState+1,sizeof(double));
+         addDecimal(state,value);
+      }
+      state+=sumSize;
+      otherState+=sumSize;
+   }
+}
+//---------------------------------------------------------------------------
+void HashGroupify::merge(unsigned partition,Partition& result)
+   // Merge the groups of a partition
+{
+   result.clear();
+
+   // A partition that only one thread has seen is taken over as it is
+   Partition* single=0;
+   unsigned sources=0;
+   for (std::vector<std::unique_ptr<Table> >::iterator iter=tables.begin(),limit=tables.end();iter!=limit;++iter)
+      if ((*iter)->partitions[partition].count) {
+         single=&((*iter)->partitions[partition]);
+         sources++;
+      }
+   if ((sources==1)&&(!spilled[partition])) {
+      std::swap(result,*single);
+      return;
+   }
+
+   // Merge the groups of the threads
+   const unsigned width=values.size();
+   for (std::vector<std::unique_ptr<Table> >::iterator iter=tables.begin(),limit=tables.end();iter!=limit;++iter) {
+      Partition& part=(*iter)->partitions[partition];
+      for (uint64_t index=0;index<part.count;index++) {
+         const uint64_t* group=&part.groups[index*groupSize];
+         combine(result.lookup(group[0],group+1,width,groupSize),group);
+      }
+      part.clear();
+   }
+
+   // And the groups on disk
+   if (FILE* file=spilled[partition]) {
+      rewind(file);
+      std::vector<uint64_t> buffer(1024*groupSize);
+      size_t read;
+      while ((read=fread(buffer.data(),groupSize*sizeof(uint64_t),1024,file))>0) {
+         // Runs in a task that cannot throw, the caller checks the context
+         if (context&&context->shouldStop())
+            return;
+         for (size_t index=0;index<read;index++) {
+            const uint64_t* group=&buffer[index*groupSize];
+            combine(result.lookup(group[0],group+1,width,groupSize),group);
+         }
       }
+      fclose(file);
+      spilled[partition]=0;
    }
+}
+//---------------------------------------------------------------------------
+uint64_t HashGroupify::first()
+   // Produce the first tuple
+{
+   observedOutputCardinality=0;
+   releaseMemory();
+   closeSpilled();
+   spilled.resize(partitions);
+   bytesSpilled=0;
+   merged.clear();
+   nextPartition=0;
+   mergedIter=0;
+   groupsIter=0;
 
-   // Form a chain out of the groups
-   Chainer chainer;
-   groupsPool.enumAll(chainer);
+   // Every thread of a parallel input aggregates in its own table
+   ParallelPipeline* pipeline=dynamic_cast<ParallelPipeline*>(input);
+   tables.clear();
+   for (unsigned index=0,limit=pipeline?pipeline->getThreads():1;index<limit;index++)
+      tables.push_back(std::unique_ptr<Table>(new Table()));
 
-   groups=chainer.getHead();
-   groupsIter=groups;
+   // The columns of the values, then the columns of the inputs of the aggregates
+   const unsigned width=values.size();
+   std::vector<unsigned> columns;
+   if (pipeline) {
+      const std::vector<Register*>& output=pipeline->getOutput();
+      for (unsigned index=0;index<width+aggregates.size();index++) {
+         Register* reg=(index<width)?values[index]:aggregates[index-width].input;
+         // The counts do not read their input, COUNT(*) has none
+         if (!reg) {
+            columns.push_back(0);
+            continue;
+         }
+         std::vector<Register*>::const_iterator pos=std::find(output.begin(),output.end(),reg);
+         if (pos==output.end()) {
+            LOG(ERRORL) << "HashGroupify: the register is not produced by the input";
+            throw 10;
+         }
+         columns.push_back(pos-output.begin());
+      }
+      Collector collector(*this,columns);
+      pipeline->consume(collector);
+   } else {
+      Batch batch(values);
+      for (unsigned index=0;index<width;index++)
+         columns.push_back(index);
+      for (std::vector<Aggregate>::const_iterator iter=aggregates.begin(),limit=aggregates.end();iter!=limit;++iter)
+         columns.push_back((*iter).input?batch.addRegister((*iter).input):0);
+      for (unsigned size=input->firstBatch(batch);size;size=input->nextBatch(batch))
+         aggregate(*tables.front(),db,batch,size,columns);
+   }
 
    return next();
 }
@@ -129,18 +377,77 @@ uint64_t HashGroupify::first()
 uint64_t HashGroupify::next()
    // Produce the next tuple
 {
-   // End of input?
-   if (!groupsIter)
-      return 0;
+   const unsigned width=values.size();
+   while (true) {
+      // Produce the groups of the merged partitions
+      if (mergedIter<merged.size()) {
+         Partition& partition=merged[mergedIter];
+         if (groupsIter==partition.count) {
+            partition.clear();
+            mergedIter++;
+            groupsIter=0;
+            continue;
+         }
+         const uint64_t* group=&partition.groups[(groupsIter++)*groupSize];
+         for (unsigned index=0;index<width;index++)
+            values[index]->value=group[index+1];
+         uint64_t count=group[width+1];
+         if (aggregates.empty()) {
+            observedOutputCardinality+=count;
+            return count;
+         }
+
+         // One tuple per group with the aggregates
+         const uint64_t* state=group+width+2;
+         for (std::vector<Aggregate>::const_iterator iter=aggregates.begin(),limit=aggregates.end();iter!=limit;++iter) {
+            AggregateHandler::VarValue result;
+            result.type=AggregateHandler::VarValue::TYPE::INT;
+            if ((*iter).function==Aggregate::Count) {
+               result.v_int=count;
+            } else {
+               result.v_int=state[0];
+               if (state[2]) {
+                  memcpy(&result.v_dec,state+1,sizeof(double));
+                  result.v_dec+=result.v_int;
+                  result.type=AggregateHandler::VarValue::TYPE::DEC;
+               }
+               state+=sumSize;
+            }
+            (*iter).output->value=AggrFunctions::encodeNumber(result);
+         }
+         observedOutputCardinality++;
+         return 1;
+      }
 
-   // Produce the next group
-   for (uint64_t index=0,limit=values.size();index<limit;index++)
-      values[index]->value=groupsIter->values[index];
-   uint64_t count=groupsIter->count;
-   groupsIter=groupsIter->next;
+      // Merge the next partitions, one per thread
+      if (nextPartition>=partitions)
+         return 0;
+      unsigned count=std::min(threads,partitions-nextPartition),base=nextPartition;
+      merged.clear();
+      merged.resize(count);
+      if (count==1) {
+         merge(base,merged[0]);
+      } else {
+         ParallelTasks::parallel_for(0,count,1,[&](const ParallelRange& r) {
+            for (size_t index=r.begin();index<r.end();index++)
+               merge(base+index,merged[index]);
+         },count);
+      }
+      nextPartition+=count;
 
-   observedOutputCardinality+=count;
-   return count;
+      // The groups moved from the tables of the threads to the merged partitions
+      if (context) {
+         context->check();
+         for (std::vector<std::unique_ptr<Table> >::iterator iter=tables.begin(),limit=tables.end();iter!=limit;++iter)
+            accountMemory((*iter)->accountedBytes,(*iter)->getSize());
+         uint64_t bytes=0;
+         for (std::vector<Partition>::const_iterator iter=merged.begin(),limit=merged.end();iter!=limit;++iter)
+            bytes+=(*iter).getSize();
+         accountMemory(mergedBytes,bytes);
+      }
+      mergedIter=0;
+      groupsIter=0;
+   }
 }
 //---------------------------------------------------------------------------
 void HashGroupify::print(PlanPrinter& out)
@@ -148,6 +455,14 @@ void HashGroupify::print(PlanPrinter& out)
 {
    out.beginOperator("HashGroupify",expectedOutputCardinality,observedOutputCardinality);
    out.addMaterializationAnnotation(values);
+   if (!aggregates.empty()) {
+      std::vector<Register*> outputs;
+      for (std::vector<Aggregate>::const_iterator iter=aggregates.begin(),limit=aggregates.end();iter!=limit;++iter)
+         outputs.push_back((*iter).output);
+      out.addMaterializationAnnotation(outputs);
+   }
+   if (bytesSpilled)
+      out.addGenericAnnotation("spilled "+std::to_string(bytesSpilled)+" bytes");
    input->print(out);
    out.endOperator();
 }
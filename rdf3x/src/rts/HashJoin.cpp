@@ -1,5 +1,7 @@
 #include "rts/operator/HashJoin.hpp"
+#include "rts/operator/Batch.hpp"
 #include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/QueryContext.hpp"
 #include "rts/runtime/Runtime.hpp"
 
 #include <kognac/logs.h>
@@ -17,108 +19,128 @@
 //---------------------------------------------------------------------------
 using namespace std;
 //---------------------------------------------------------------------------
-static inline uint64_t hash1(uint64_t key, uint64_t hashTableSize) {
-    return key & (hashTableSize - 1);
-}
-static inline uint64_t hash2(uint64_t key, uint64_t hashTableSize) {
-    return hashTableSize + ((key ^ (key >> 3)) & (hashTableSize - 1));
+/// The number of partitions of a spilled join, and of a split partition
+static const unsigned spillPartitions = 64;
+/// The bits of the hash that select a partition
+static const unsigned spillBits = 6;
+/// The number of times a partition that is too large can be split. A key
+/// with more tuples than the memory budget is loaded anyway
+static const unsigned maxSpillLevel = 3;
+//---------------------------------------------------------------------------
+static inline unsigned spillPartition(uint64_t key, unsigned level)
+    // The spilled partition of a key. Every split uses the next bits of the hash
+{
+    return ((key * 0x9E3779B97F4A7C15ull) >> (64 - spillBits * (level + 1))) & (spillPartitions - 1);
 }
 //---------------------------------------------------------------------------
-//
 void HashJoin::BuildHashTable::run()
     // Build the hash table
 {
     if (done) return; // XXX support repeated executions under nested loop joins etc!
     // To restart, we only need to restart the "right" iterator. --Ceriel
 
+    if (join.sharedBuild) {
+        // The first thread builds the table, the others probe it
+        std::lock_guard<std::mutex> lock(join.sharedBuild->mutex);
+        if (join.sharedBuild->builder) {
+            const HashJoin& builder = *join.sharedBuild->builder;
+            join.source = &builder;
+            if (join.bitset != 0 && !join.leftOptional)
+                join.right->setHashKeys(&builder.keyFilter, join.bitset);
+            done = true;
+            return;
+        }
+        if (!join.sharedBuild->built) {
+            build();
+            join.sharedBuild->built = true;
+            if (join.spilled.empty())
+                join.sharedBuild->builder = &join;
+            return;
+        }
+    }
+    // The shared table was spilled, every thread partitions its own
+    build();
+}
+//---------------------------------------------------------------------------
+void HashJoin::BuildHashTable::build()
+    // Build the hash table from the left side
+{
+    // The left side is read in batches, the key is in the first column
+    vector<Register*> leftRegs;
+    leftRegs.push_back(join.leftValue);
+    leftRegs.insert(leftRegs.end(), join.leftTail.begin(), join.leftTail.end());
+    Batch batch(leftRegs);
+
     // Prepare relevant domain informations
-    Register* leftValue = join.leftValue;
     vector<Register*> domainRegs;
-    if (leftValue->domain)
-        domainRegs.push_back(leftValue);
-    for (vector<Register*>::const_iterator iter = join.leftTail.begin(), limit = join.leftTail.end(); iter != limit; ++iter)
-        if ((*iter)->domain)
-            domainRegs.push_back(*iter);
+    vector<unsigned> domainColumns;
+    for (unsigned index = 0; index < leftRegs.size(); index++)
+        if (leftRegs[index]->domain) {
+            domainRegs.push_back(leftRegs[index]);
+            domainColumns.push_back(index);
+        }
     vector<ObservedDomainDescription> observedDomains;
     observedDomains.resize(domainRegs.size());
 
-    // Build the hash table from the left side
-    uint64_t hashTableSize = 1024;
+    // Collect the left side
     uint64_t tailLength = join.leftTail.size();
-    join.hashTable.clear();
-    join.hashTable.resize(2 * hashTableSize);
-    for (uint64_t leftCount = join.left->first(); leftCount; leftCount = join.left->next()) {
-        // Check the domain first
-        bool joinCandidate = true;
-        for (uint64_t index = 0, limit = domainRegs.size(); index < limit; ++index) {
-            if (!domainRegs[index]->domain->couldQualify(domainRegs[index]->value)) {
-                joinCandidate = false;
-                break;
-            }
-            observedDomains[index].add(domainRegs[index]->value);
-        }
-        if (!joinCandidate)
-            continue;
-        // Compute the slots
-        uint64_t leftKey = leftValue->value;
-        uint64_t slot1 = hash1(leftKey, hashTableSize), slot2 = hash2(leftKey, hashTableSize);
-        // LOG(DEBUGL) << "leftKey = " << leftKey;
+    vector<uint64_t> tail(tailLength);
+    vector<RadixJoinTable::Tuple> tuples;
+    join.leftRows.clear();
+    for (unsigned size = join.left->firstBatch(batch); size; size = join.left->nextBatch(batch)) {
+        for (unsigned index = 0; index < size; index++) {
+            unsigned row = batch.selection[index];
 
-        // Scan if the entry already exists
-        Entry* e = join.hashTable[slot1];
-        if ((!e) || (e->key != leftKey))
-            e = join.hashTable[slot2];
-        if (e && (e->key == leftKey)) {
-            uint64_t ofs = (e == join.hashTable[slot1]) ? slot1 : slot2;
-            bool match = false;
-            for (Entry* iter = e; iter; iter = iter->next)
-                if (leftKey == iter->key) {
-                    // Tuple already in the table?
-                    match = true;
-                    for (uint64_t index2 = 0; index2 < tailLength; index2++)
-                        if (join.leftTail[index2]->value != iter->values[index2]) {
-                            match = false;
-                            break;
-                        }
-                    // Then aggregate
-                    if (match) {
-                        iter->count += leftCount;
-                        break;
-                    }
+            // Check the domain first
+            bool joinCandidate = true;
+            for (uint64_t index2 = 0, limit = domainRegs.size(); index2 < limit; ++index2) {
+                uint64_t value = batch.getColumn(domainColumns[index2])[row];
+                if (!domainRegs[index2]->domain->couldQualify(value)) {
+                    joinCandidate = false;
+                    break;
                 }
-            if (match)
+                observedDomains[index2].add(value);
+            }
+            if (!joinCandidate)
                 continue;
 
-            // Append to the current bucket
-            e = join.entryPool.alloc();
-            e->next = join.hashTable[ofs];
-            join.hashTable[ofs] = e;
-            e->key = leftKey;
-            e->count = leftCount;
             for (uint64_t index2 = 0; index2 < tailLength; index2++)
-                e->values[index2] = join.leftTail[index2]->value;
-            continue;
+                tail[index2] = batch.getColumn(index2 + 1)[row];
+            join.addLeft(tuples, batch.getColumn(0)[row], batch.counts[row], tail.data());
         }
 
-        // Create a new tuple
-        join.keys.push_back(leftKey);
-        e = join.entryPool.alloc();
-        e->next = 0;
-        e->key = leftKey;
-        e->count = leftCount;
-        for (uint64_t index2 = 0; index2 < tailLength; index2++)
-            e->values[index2] = join.leftTail[index2]->value;
-
-        // And insert it
-        join.insert(e);
-        hashTableSize = join.hashTable.size() / 2;
+        // Too large for memory?
+        if (join.memoryBudget && join.spilled.empty() &&
+                join.leftRows.size() * sizeof(uint64_t) + tuples.size() * RadixJoinTable::getBytesPerTuple() > join.memoryBudget)
+            join.spillLeft(tuples);
+        if (join.context) {
+            join.context->check();
+            join.accountMemory(join.leftRows.capacity() * sizeof(uint64_t) + tuples.capacity() * RadixJoinTable::getBytesPerTuple());
+        }
     }
 
     // Update the domains
     for (uint64_t index = 0, limit = domainRegs.size(); index < limit; ++index)
         domainRegs[index]->domain->restrictTo(observedDomains[index]);
-    if (join.bitset != 0) {
-        join.right->setHashKeys(&join.keys, join.bitset);
+
+    if (!join.spilled.empty()) {
+        LOG(DEBUGL) << "HashJoin: spilled " << join.bytesSpilled << " bytes of the left side";
+        done = true;
+        return;
+    }
+    join.hashTable.build(tuples, join.threads);
+    join.accountMemory(join.leftRows.capacity() * sizeof(uint64_t) + join.hashTable.getTuples().size() * RadixJoinTable::getBytesPerTuple());
+
+    // Let the right side skip the keys that cannot join. Not if the right
+    // tuples are kept without a join partner
+    if (join.bitset != 0 && !join.leftOptional) {
+        join.keys.clear();
+        const vector<RadixJoinTable::Tuple>& entries = join.hashTable.getTuples();
+        for (uint64_t index = 0, limit = entries.size(); index < limit; ++index)
+            if ((!index) || (entries[index].key1 != entries[index - 1].key1))
+                join.keys.push_back(entries[index].key1);
+        join.keyFilter.build(join.keys);
+        join.right->setHashKeys(&join.keyFilter, join.bitset);
     }
 
     done = true;
@@ -135,11 +157,12 @@ void HashJoin::ProbePeek::run()
 }
 //---------------------------------------------------------------------------
 HashJoin::HashJoin(Operator* left, Register* leftValue, const vector<Register*>& leftTail, Operator* right, Register* rightValue, const vector<Register*>& rightTail, double hashPriority,
-        double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset)
+        double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset, unsigned threads, uint64_t memoryBudget, QueryContext* context)
     : Operator(expectedOutputCardinality), left(left), right(right), leftValue(leftValue), rightValue(rightValue),
-    leftTail(leftTail), rightTail(rightTail), entryPool(leftTail.size() * sizeof(uint64_t)),
+    leftTail(leftTail), rightTail(rightTail), source(this), matchIter(0), matchLimit(0), rightCount(0),
     bitset(bitset), buildHashTableTask(*this), probePeekTask(*this), hashPriority(hashPriority), probePriority(probePriority),
-    leftOptional(leftOptional), rightOptional(rightOptional)
+    threads(threads), memoryBudget(memoryBudget), currentPartition(0), bytesSpilled(0), context(context), accountedBytes(0), state(Done),
+    leftOptional(leftOptional), rightOptional(rightOptional), probePos(0), probeSize(0)
       // Constructor
 {
 }
@@ -147,45 +170,256 @@ HashJoin::HashJoin(Operator* left, Register* leftValue, const vector<Register*>&
 HashJoin::~HashJoin()
     // Destructor
 {
+    accountMemory(0);
+    for (vector<SpilledPartition>::const_iterator iter = spilled.begin(), limit = spilled.end(); iter != limit; ++iter) {
+        if ((*iter).left)
+            fclose((*iter).left);
+        if ((*iter).right)
+            fclose((*iter).right);
+    }
     delete left;
     delete right;
 }
 //---------------------------------------------------------------------------
-void HashJoin::insert(Entry* e)
-    // Insert into the hash table
+void HashJoin::addLeft(vector<RadixJoinTable::Tuple>& tuples, uint64_t key, uint64_t count, const uint64_t* tail)
+    // Add a tuple of the left side
 {
-    uint64_t hashTableSize = hashTable.size() / 2;
-    // Try to insert
-    bool firstTable = true;
-    for (uint64_t index = 0; index < hashTableSize; index++) {
-        uint64_t slot = firstTable ? hash1(e->key, hashTableSize) : hash2(e->key, hashTableSize);
-        swap(e, hashTable[slot]);
-        if (!e)
-            return;
-        firstTable = !firstTable;
+    if (!spilled.empty()) {
+        writeTuple(spilled[spillPartition(key, 0)].left, key, count, tail, leftTail.size());
+        return;
+    }
+    RadixJoinTable::Tuple t;
+    t.key1 = key;
+    t.key2 = 0;
+    t.payload = leftRows.size();
+    tuples.push_back(t);
+    leftRows.push_back(count);
+    leftRows.insert(leftRows.end(), tail, tail + leftTail.size());
+}
+//---------------------------------------------------------------------------
+void HashJoin::writeTuple(FILE* file, uint64_t key, uint64_t count, const uint64_t* values, uint64_t nvalues)
+    // Write a tuple to a spilled partition
+{
+    if (fwrite(&key, sizeof(uint64_t), 1, file) != 1 ||
+            fwrite(&count, sizeof(uint64_t), 1, file) != 1 ||
+            fwrite(values, sizeof(uint64_t), nvalues, file) != nvalues) {
+        LOG(ERRORL) << "HashJoin: cannot write the spilled tuples";
+        throw 10;
+    }
+    bytesSpilled += (nvalues + 2) * sizeof(uint64_t);
+}
+//---------------------------------------------------------------------------
+void HashJoin::spillLeft(vector<RadixJoinTable::Tuple>& tuples)
+    // Move the left tuples to disk
+{
+    spilled.resize(spillPartitions);
+    for (unsigned index = 0; index < spillPartitions; index++) {
+        spilled[index].right = 0;
+        spilled[index].level = 0;
+        if (!(spilled[index].left = tmpfile())) {
+            spilled.resize(index);
+            LOG(ERRORL) << "HashJoin: cannot create a temporary file for the spilled tuples";
+            throw 10;
+        }
+    }
+    for (vector<RadixJoinTable::Tuple>::const_iterator iter = tuples.begin(), limit = tuples.end(); iter != limit; ++iter) {
+        const uint64_t* row = leftRows.data() + (*iter).payload;
+        writeTuple(spilled[spillPartition((*iter).key1, 0)].left, (*iter).key1, row[0], row + 1, leftTail.size());
+    }
+    vector<RadixJoinTable::Tuple>().swap(tuples);
+    vector<uint64_t>().swap(leftRows);
+    accountMemory(0);
+}
+//---------------------------------------------------------------------------
+void HashJoin::spillRight()
+    // Write the right side to the spilled partitions
+{
+    // The partitions that were split are split again with the new right side
+    for (unsigned index = spillPartitions; index < spilled.size(); index++) {
+        if (spilled[index].left)
+            fclose(spilled[index].left);
+        if (spilled[index].right)
+            fclose(spilled[index].right);
+    }
+    spilled.resize(spillPartitions);
+    for (vector<SpilledPartition>::iterator iter = spilled.begin(), limit = spilled.end(); iter != limit; ++iter) {
+        if ((*iter).right)
+            fclose((*iter).right);
+        if (!((*iter).right = tmpfile())) {
+            LOG(ERRORL) << "HashJoin: cannot create a temporary file for the spilled tuples";
+            throw 10;
+        }
+    }
+    vector<uint64_t> values(rightTail.size());
+    for (uint64_t count = right->first(); count; count = right->next()) {
+        if (context)
+            context->check();
+        for (uint64_t index = 0, limit = rightTail.size(); index < limit; ++index)
+            values[index] = rightTail[index]->value;
+        writeTuple(spilled[spillPartition(rightValue->value, 0)].right, rightValue->value, count, values.data(), values.size());
+    }
+    for (vector<SpilledPartition>::const_iterator iter = spilled.begin(), limit = spilled.end(); iter != limit; ++iter)
+        rewind((*iter).right);
+}
+//---------------------------------------------------------------------------
+bool HashJoin::splitPartition(unsigned partition)
+    // Split a spilled partition whose left side does not fit in memory
+{
+    if ((!memoryBudget) || (spilled[partition].level >= maxSpillLevel))
+        return false;
+    FILE* file = spilled[partition].left;
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    uint64_t rows = ftell(file) / ((leftTail.size() + 2) * sizeof(uint64_t));
+    if (rows * ((leftTail.size() + 1) * sizeof(uint64_t) + RadixJoinTable::getBytesPerTuple()) <= memoryBudget)
+        return false;
+
+    // The new partitions are joined after the others, their files are
+    // created when a tuple is written. The files of the split partition are
+    // kept for the next executions
+    unsigned first = spilled.size(), level = spilled[partition].level + 1;
+    spilled.resize(first + spillPartitions);
+    for (unsigned index = first; index < spilled.size(); index++) {
+        spilled[index].left = spilled[index].right = 0;
+        spilled[index].level = level;
+    }
+    vector<uint64_t> counts(spillPartitions);
+    splitFile(spilled[partition].left, first, level, leftTail.size(), true, counts);
+    splitFile(spilled[partition].right, first, level, rightTail.size(), false, counts);
+
+    // The tuples of a single key stay together, do not split them again
+    for (unsigned index = 0; index < spillPartitions; index++)
+        if (counts[index] == rows)
+            spilled[first + index].level = maxSpillLevel;
+    LOG(DEBUGL) << "HashJoin: split a spilled partition of " << rows << " tuples";
+    return true;
+}
+//---------------------------------------------------------------------------
+void HashJoin::splitFile(FILE* file, unsigned first, unsigned level, uint64_t nvalues, bool leftSide, vector<uint64_t>& counts)
+    // Move the tuples of a spilled file to the new partitions
+{
+    if (!file)
+        return;
+    rewind(file);
+    vector<uint64_t> row(nvalues + 2);
+    while (fread(row.data(), sizeof(uint64_t), row.size(), file) == row.size()) {
+        unsigned partition = spillPartition(row[0], level);
+        FILE*& target = leftSide ? spilled[first + partition].left : spilled[first + partition].right;
+        if ((!target) && (!(target = tmpfile()))) {
+            LOG(ERRORL) << "HashJoin: cannot create a temporary file for the spilled tuples";
+            throw 10;
+        }
+        writeTuple(target, row[0], row[1], row.data() + 2, nvalues);
+        if (leftSide)
+            counts[partition]++;
+    }
+    for (unsigned index = first; index < spilled.size(); index++)
+        if (FILE* target = leftSide ? spilled[index].left : spilled[index].right)
+            rewind(target);
+}
+//---------------------------------------------------------------------------
+void HashJoin::loadPartition(unsigned partition)
+    // Load the left side of a spilled partition
+{
+    currentPartition = partition;
+    FILE* file = spilled[partition].left;
+    leftRows.clear();
+    vector<RadixJoinTable::Tuple> tuples;
+    vector<uint64_t> row(leftTail.size() + 2);
+    if (file)
+        rewind(file);
+    while (file && fread(row.data(), sizeof(uint64_t), row.size(), file) == row.size()) {
+        RadixJoinTable::Tuple t;
+        t.key1 = row[0];
+        t.key2 = 0;
+        t.payload = leftRows.size();
+        tuples.push_back(t);
+        leftRows.insert(leftRows.end(), row.begin() + 1, row.end());
     }
+    hashTable.build(tuples, threads);
+    accountMemory(leftRows.capacity() * sizeof(uint64_t) + hashTable.getTuples().size() * RadixJoinTable::getBytesPerTuple());
+}
+//---------------------------------------------------------------------------
+uint64_t HashJoin::readRight()
+    // Read the next tuple from the right side
+{
+    if (spilled.empty())
+        return right->next();
 
-    // No place found, rehash
-    vector<Entry*> oldTable;
-    oldTable.resize(4 * hashTableSize);
-    swap(hashTable, oldTable);
-    for (vector<Entry*>::const_iterator iter = oldTable.begin(), limit = oldTable.end(); iter != limit; ++iter)
-        if (*iter)
-            insert(*iter);
-    insert(e);
+    uint64_t header[2];
+    FILE* file = spilled[currentPartition].right;
+    if ((!file) || fread(header, sizeof(uint64_t), 2, file) != 2)
+        return 0;
+    rightValue->value = header[0];
+    for (uint64_t index = 0, limit = rightTail.size(); index < limit; ++index)
+        if (fread(&(rightTail[index]->value), sizeof(uint64_t), 1, file) != 1)
+            return 0;
+    return header[1];
 }
 //---------------------------------------------------------------------------
-HashJoin::Entry* HashJoin::lookup(uint64_t key)
-    // Search an entry in the hash table
+void HashJoin::probe()
+    // Find the matches of the current right tuple
 {
-    uint64_t hashTableSize = hashTable.size() / 2;
-    Entry* e = hashTable[hash1(key, hashTableSize)];
-    if (e && (e->key == key))
-        return e;
-    e = hashTable[hash2(key, hashTableSize)];
-    if (e && (e->key == key))
-        return e;
-    return 0;
+    uint64_t count;
+    matchIter = source->hashTable.find(rightValue->value, 0, count);
+    matchLimit = matchIter + count;
+    joinSuccedeed = count != 0;
+    if (rightOptional && joinSuccedeed) {
+        collectedRightValues.insert(rightValue->value);
+    }
+}
+//---------------------------------------------------------------------------
+void HashJoin::startPartition(unsigned partition)
+    // Start to join a partition
+{
+    for (; partition < spilled.size(); partition++) {
+        if (context)
+            context->check();
+        if (splitPartition(partition))
+            continue;
+        loadPartition(partition);
+        if ((rightCount = readRight()) != 0) {
+            probe();
+            state = Probe;
+            return;
+        }
+        if (rightOptional) {
+            finishRight();
+            return;
+        }
+    }
+    state = Done;
+}
+//---------------------------------------------------------------------------
+void HashJoin::finishRight()
+    // The right side of the current partition is done
+{
+    matchIter = matchLimit = 0;
+    if (rightOptional) {
+        // Return the left tuples without a join partner
+        for (uint64_t index = 0, limit = rightTail.size(); index < limit; ++index)
+            rightTail[index]->value = ~0u;
+        currentIdx = 0;
+        state = Unmatched;
+    } else {
+        startPartition(currentPartition + 1);
+    }
+}
+//---------------------------------------------------------------------------
+void HashJoin::accountMemory(uint64_t bytes)
+    // Account the memory of the left side in the context
+{
+    if (!context)
+        return;
+    if (bytes > accountedBytes) {
+        uint64_t delta = bytes - accountedBytes;
+        accountedBytes = bytes;
+        context->allocate(delta);
+    } else {
+        context->release(accountedBytes - bytes);
+        accountedBytes = bytes;
+    }
 }
 //---------------------------------------------------------------------------
 uint64_t HashJoin::first()
@@ -193,6 +427,7 @@ uint64_t HashJoin::first()
 {
     currentIdx = (size_t) -1;
     observedOutputCardinality = 0;
+    collectedRightValues.clear();
     // Build the hash table if not already done
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     buildHashTableTask.run();
@@ -200,17 +435,21 @@ uint64_t HashJoin::first()
         - start;
     LOG(INFOL) << "Runtime building hashtable = " << sec.count() * 1000 << " milliseconds";
 
-    // Read the first tuple from the right side
-    probePeekTask.run();
-    if (((rightCount = probePeekTask.count) == 0) && !leftOptional) {
-        return false;
+    if (!spilled.empty()) {
+        // Partition the right side as well, then join the partitions
+        spillRight();
+        startPartition(0);
+        return next();
     }
 
-    // Setup the lookup
-    hashTableIter = lookup(rightValue->value);
-    joinSuccedeed = hashTableIter != NULL;
-    if (rightOptional && joinSuccedeed) {
-        collectedRightValues.insert(rightValue->value);
+    // Read the first tuple from the right side
+    currentPartition = 0;
+    probePeekTask.run();
+    if ((rightCount = probePeekTask.count) != 0) {
+        probe();
+        state = Probe;
+    } else {
+        finishRight();
     }
 
     return next();
@@ -219,71 +458,133 @@ uint64_t HashJoin::first()
 uint64_t HashJoin::next()
     // Produce the next tuple
 {
-    if (currentIdx != (size_t) -1) {
-        Entry *e;
-        while (currentIdx < hashTable.size()) {
-            if ((e = hashTable[currentIdx++])
-                    && !collectedRightValues.count(e->key)) {
-                for (uint64_t index = 0, limit = leftTail.size();
-                        index < limit; ++index)
-                    leftTail[index]->value = e->values[index];
-                return e->count;
+    // Repeat until a match is found
+    while (true) {
+        if (context)
+            context->check();
+        switch (state) {
+            case Probe:
+                // Still scanning the matches?
+                if (matchIter != matchLimit) {
+                    const uint64_t* row = source->leftRows.data() + matchIter->payload;
+                    leftValue->value = matchIter->key1;
+                    for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
+                        leftTail[index]->value = row[index + 1];
+                    ++matchIter;
+
+                    uint64_t count = row[0] * rightCount;
+                    observedOutputCardinality += count;
+                    return count;
+                }
+
+                // Return the right tuple without a join partner?
+                if (!joinSuccedeed && leftOptional) {
+                    joinSuccedeed = true;
+                    //Set the hash values to NULL
+                    for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
+                        leftTail[index]->value = ~0u;
+                    return rightCount;
+                }
+
+                // Read the next tuple from the right
+                if ((rightCount = readRight()) != 0)
+                    probe();
+                else
+                    finishRight();
+                break;
+            case Unmatched: {
+                // Scan the left tuples, return a NULL for each one not joined
+                const vector<RadixJoinTable::Tuple>& tuples = source->hashTable.getTuples();
+                while (currentIdx < tuples.size()) {
+                    const RadixJoinTable::Tuple& t = tuples[currentIdx++];
+                    if (!collectedRightValues.count(t.key1)) {
+                        const uint64_t* row = source->leftRows.data() + t.payload;
+                        leftValue->value = t.key1;
+                        for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
+                            leftTail[index]->value = row[index + 1];
+                        return row[0];
+                    }
+                }
+                currentIdx = (size_t) -1;
+                startPartition(currentPartition + 1);
+                break;
             }
+            case Done:
+                return false;
         }
-        return false;
     }
+}
+//---------------------------------------------------------------------------
+unsigned HashJoin::firstBatch(Batch& batch)
+    // Produce the first batch of tuples
+{
+    if (leftOptional || rightOptional)
+        return Operator::firstBatch(batch);
 
-    // Repeat until a match is found
-    while (true) {
-        // Still scanning the hash table?
-        bool elementToProcess = false;
-        for (; hashTableIter; hashTableIter = hashTableIter->next) {
-            elementToProcess = true;
-            uint64_t leftCount = hashTableIter->count;
-            leftValue->value = hashTableIter->key;
-            for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
-                leftTail[index]->value = hashTableIter->values[index];
-            hashTableIter = hashTableIter->next;
+    observedOutputCardinality = 0;
+    buildHashTableTask.run();
+    batch.clear();
+    batch.done = false;
+    if (!spilled.empty()) {
+        // Partition the right side as well, then join the partitions
+        spillRight();
+        startPartition(0);
+        return nextBatch(batch);
+    }
 
-            uint64_t count = leftCount * rightCount;
-            observedOutputCardinality += count;
-            return count;
-        }
+    // The registers of the right side are loaded from its batches
+    if (!probeBatch) {
+        vector<Register*> rightRegs;
+        rightRegs.push_back(rightValue);
+        rightRegs.insert(rightRegs.end(), rightTail.begin(), rightTail.end());
+        probeBatch.reset(new Batch(rightRegs));
+    }
+    matchIter = matchLimit = 0;
+    probePos = 0;
+    probeSize = right->firstBatch(*probeBatch);
+    state = Probe;
+    return nextBatch(batch);
+}
+//---------------------------------------------------------------------------
+unsigned HashJoin::nextBatch(Batch& batch)
+    // Produce the next batch of tuples
+{
+    if (!canBatch())
+        return Operator::nextBatch(batch);
 
-        //First we finish all joins
-        if (!elementToProcess && !joinSuccedeed && leftOptional) {
-            joinSuccedeed = true;
-            //Set the hash values to NULL
+    batch.clear();
+    if (batch.done)
+        return 0;
+    while (!batch.full()) {
+        // Still scanning the matches?
+        if (matchIter != matchLimit) {
+            const uint64_t* row = source->leftRows.data() + matchIter->payload;
+            leftValue->value = matchIter->key1;
             for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
-                leftTail[index]->value = ~0u;
-            return rightCount;
-        }
+                leftTail[index]->value = row[index + 1];
+            ++matchIter;
 
-        // Read the next tuple from the right
-	// But only if rightCount != 0
-	if (rightCount == 0) {
-	    return false;
-	}
-	rightCount = right->next();
-        if (rightCount == 0) {
-            if (!rightOptional) {
-                return false;
-            } else {
-                //Scan the all left table. return a NULL for each entry not joined
-                currentIdx = 0;
-                for (uint64_t index = 0, limit = rightTail.size();
-                        index < limit; ++index)
-                    rightTail[index]->value = ~0u;
-                return next();
-            }
+            uint64_t count = row[0] * rightCount;
+            observedOutputCardinality += count;
+            batch.append(count);
+            continue;
         }
 
-        hashTableIter = lookup(rightValue->value);
-        joinSuccedeed = hashTableIter != NULL;
-        if (rightOptional && joinSuccedeed) {
-            collectedRightValues.insert(rightValue->value);
+        // Probe the next tuple of the right side
+        if (probePos == probeSize) {
+            if (context)
+                context->check();
+            probePos = 0;
+            if (!(probeSize = right->nextBatch(*probeBatch))) {
+                state = Done;
+                batch.done = true;
+                break;
+            }
         }
+        rightCount = probeBatch->load(probePos++);
+        probe();
     }
+    return batch.size;
 }
 //---------------------------------------------------------------------------
 void HashJoin::print(PlanPrinter& out)
@@ -296,6 +597,8 @@ void HashJoin::print(PlanPrinter& out)
     out.addEqualPredicateAnnotation(leftValue, rightValue);
     out.addMaterializationAnnotation(leftTail);
     out.addMaterializationAnnotation(rightTail);
+    if (!spilled.empty())
+        out.addGenericAnnotation("spilled " + to_string(bytesSpilled) + " bytes in " + to_string(spilled.size()) + " partitions");
     left->print(out);
     right->print(out);
     out.endOperator();
@@ -1,5 +1,7 @@
 #include "rts/operator/IndexScan.hpp"
+#include "rts/operator/Batch.hpp"
 #include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/QueryContext.hpp"
 #include "rts/runtime/Runtime.hpp"
 //---------------------------------------------------------------------------
 // RDF-3X
@@ -21,6 +23,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -37,6 +43,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -53,6 +63,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -69,6 +83,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -85,6 +103,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -103,6 +125,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -119,6 +145,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 /// Implementation
@@ -135,6 +165,10 @@ public:
     uint64_t first();
     /// Next tuple
     uint64_t next();
+    /// First batch
+    unsigned firstBatch(Batch& batch) { return batch.fill(*this, true); }
+    /// Next batch
+    unsigned nextBatch(Batch& batch) { return batch.fill(*this, false); }
 };
 //---------------------------------------------------------------------------
 IndexScan::IndexScanHint::IndexScanHint(IndexScan& scan)
@@ -223,7 +257,7 @@ void IndexScan::IndexScanHint::next(uint64_t& value1, uint64_t& value2, uint64_t
 //---------------------------------------------------------------------------
 IndexScan::IndexScan(DBLayer& db, DBLayer::DataOrder order, Register* value1, bool bound1, Register* value2, bool bound2, Register* value3, bool bound3, double expectedOutputCardinality)
     : Operator(expectedOutputCardinality), value1(value1), value2(value2), value3(value3), bound1(bound1), bound2(bound2), bound3(bound3)/*,facts(db.getFacts(order))*/, order(order),
-      hint(*this), scan(db.getScan(order, DBLayer::AGGR_NO, &hint))
+      hint(*this), scan(db.getScan(order, DBLayer::AGGR_NO, &hint)), context(0)
       //,scan(disableSkipping?0:&hint),hint(*this)
       // Constructor
 {
@@ -312,7 +346,7 @@ void IndexScan::getAsyncInputCandidates(Scheduler& /*scheduler*/)
 {
 }
 //---------------------------------------------------------------------------
-IndexScan* IndexScan::create(DBLayer& db, DBLayer::DataOrder order, Register* subject, bool subjectBound, Register* predicate, bool predicateBound, Register* object, bool objectBound, double expectedOutputCardinality)
+IndexScan* IndexScan::create(DBLayer& db, DBLayer::DataOrder order, Register* subject, bool subjectBound, Register* predicate, bool predicateBound, Register* object, bool objectBound, double expectedOutputCardinality, QueryContext* context)
 // Constructor
 {
     // Setup the slot bindings
@@ -401,6 +435,7 @@ IndexScan* IndexScan::create(DBLayer& db, DBLayer::DataOrder order, Register* su
                 result = new ScanPrefix123(db, order, value1, bound1, value2, bound2, value3, bound3, expectedOutputCardinality);
         }
     }
+    result->context = context;
     return result;
 }
 //---------------------------------------------------------------------------
@@ -420,6 +455,8 @@ uint64_t IndexScan::Scan::first()
 uint64_t IndexScan::Scan::next()
 // Produce the next tuple
 {
+    if (context)
+        context->check();
     if (!scan->next())
         return false;
     value1->value = scan->getValue1();
@@ -448,6 +485,8 @@ uint64_t IndexScan::ScanFilter2::next()
 // Produce the next tuple
 {
     while (true) {
+        if (context)
+            context->check();
         if (!scan->next())
             return false;
         if (scan->getValue2() != filter2)
@@ -478,6 +517,8 @@ uint64_t IndexScan::ScanFilter3::next()
 // Produce the next tuple
 {
     while (true) {
+        if (context)
+            context->check();
         if (!scan->next())
             return false;
         if (scan->getValue3() != filter3)
@@ -508,6 +549,8 @@ uint64_t IndexScan::ScanFilter23::next()
 // Produce the next tuple
 {
     while (true) {
+        if (context)
+            context->check();
         if (!scan->next())
             return false;
         if ((scan->getValue2() != filter2) || (scan->getValue3() != filter3))
@@ -536,6 +579,8 @@ uint64_t IndexScan::ScanPrefix1::first()
 uint64_t IndexScan::ScanPrefix1::next()
 // Produce the next tuple
 {
+    if (context)
+        context->check();
     if (!scan->next())
         return false;
     if (scan->getValue1() > stop1)
@@ -567,6 +612,8 @@ uint64_t IndexScan::ScanPrefix1Filter3::next()
 // Produce the next tuple
 {
     while (true) {
+        if (context)
+            context->check();
         if (!scan->next())
             return false;
         if (scan->getValue1() > stop1)
@@ -597,6 +644,8 @@ uint64_t IndexScan::ScanPrefix12::first()
 uint64_t IndexScan::ScanPrefix12::next()
 // Produce the next tuple
 {
+    if (context)
+        context->check();
     if (!scan->next())
         return false;
     if ((scan->getValue1() > stop1) || ((scan->getValue1() == stop1) && (scan->getValue2() > stop2)))
@@ -625,6 +674,8 @@ uint64_t IndexScan::ScanPrefix123::first()
 uint64_t IndexScan::ScanPrefix123::next()
 // Produce the next tuple
 {
+    if (context)
+        context->check();
     if (!scan->next())
         return false;
     if ((scan->getValue1() > stop1) || ((scan->getValue1() == stop1) &&
@@ -0,0 +1,176 @@
+#include "rts/operator/LeapfrogJoin.hpp"
+#include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/Runtime.hpp"
+
+#include <sstream>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+LeapfrogJoin::LeapfrogJoin(DBLayer& db,const std::vector<Pattern>& patterns,const std::vector<Register*>& variables,double expectedOutputCardinality)
+   : Operator(expectedOutputCardinality),levels(variables.size()),patterns(patterns),variables(variables),prefixes(3*patterns.size()),depth(0),seeks(0)
+   // Constructor
+{
+   // One cursor for every variable of every pattern
+   for (unsigned index=0;index<patterns.size();index++) {
+      const Pattern& pattern=patterns[index];
+      for (unsigned index2=0;index2<pattern.variables.size();index2++) {
+         Participant participant;
+         participant.pattern=index;
+         participant.prefixSize=pattern.bound.size()+index2;
+         participant.cursor=db.getCursor(pattern.order,participant.prefixSize);
+         levels[pattern.variables[index2]].push_back(std::move(participant));
+      }
+   }
+}
+//---------------------------------------------------------------------------
+LeapfrogJoin::~LeapfrogJoin()
+   // Destructor
+{
+}
+//---------------------------------------------------------------------------
+bool LeapfrogJoin::search(unsigned level)
+   // Intersect the cursors of a variable
+{
+   std::vector<Participant>& participants=levels[level];
+   uint64_t target=0;
+   for (std::vector<Participant>::iterator iter=participants.begin(),limit=participants.end();iter!=limit;++iter)
+      if ((*iter).cursor->getValue()>target)
+         target=(*iter).cursor->getValue();
+
+   // Seek every cursor to the largest value until they agree
+   while (true) {
+      bool aligned=true;
+      for (std::vector<Participant>::iterator iter=participants.begin(),limit=participants.end();iter!=limit;++iter) {
+         DBLayer::Cursor& cursor=*(*iter).cursor;
+         if (cursor.getValue()<target) {
+            seeks++;
+            if (!cursor.seek(target))
+               return false;
+            if (cursor.getValue()>target) {
+               target=cursor.getValue();
+               aligned=false;
+            }
+         }
+      }
+      if (aligned)
+         return true;
+   }
+}
+//---------------------------------------------------------------------------
+bool LeapfrogJoin::open(unsigned level)
+   // Position the cursors of a variable and intersect them
+{
+   std::vector<Participant>& participants=levels[level];
+   for (std::vector<Participant>::iterator iter=participants.begin(),limit=participants.end();iter!=limit;++iter)
+      if (!(*iter).cursor->open(&prefixes[3*(*iter).pattern]))
+         return false;
+   return search(level);
+}
+//---------------------------------------------------------------------------
+bool LeapfrogJoin::advance(unsigned level)
+   // Move to the next common value of a variable
+{
+   if (!levels[level].front().cursor->next())
+      return false;
+   return search(level);
+}
+//---------------------------------------------------------------------------
+void LeapfrogJoin::bind(unsigned level)
+   // Bind the current value of a variable
+{
+   std::vector<Participant>& participants=levels[level];
+   uint64_t value=participants.front().cursor->getValue();
+   variables[level]->value=value;
+   for (std::vector<Participant>::iterator iter=participants.begin(),limit=participants.end();iter!=limit;++iter)
+      prefixes[3*(*iter).pattern+(*iter).prefixSize]=value;
+}
+//---------------------------------------------------------------------------
+uint64_t LeapfrogJoin::descend()
+   // Bind the variables after the current one
+{
+   while (true) {
+      bind(depth);
+      if (depth+1==levels.size()) {
+         observedOutputCardinality++;
+         return 1;
+      }
+      if (open(depth+1)) {
+         depth++;
+         continue;
+      }
+      // Backtrack
+      while (!advance(depth)) {
+         if (!depth)
+            return false;
+         depth--;
+      }
+   }
+}
+//---------------------------------------------------------------------------
+uint64_t LeapfrogJoin::first()
+   // Produce the first tuple
+{
+   observedOutputCardinality=0;
+   seeks=0;
+
+   // Copy the bound values, they may come from an outer operator
+   for (unsigned index=0;index<patterns.size();index++) {
+      const Pattern& pattern=patterns[index];
+      for (unsigned index2=0;index2<pattern.bound.size();index2++)
+         prefixes[3*index+index2]=pattern.bound[index2]->value;
+   }
+
+   depth=0;
+   if (levels.empty()||(!open(0)))
+      return false;
+   return descend();
+}
+//---------------------------------------------------------------------------
+uint64_t LeapfrogJoin::next()
+   // Produce the next tuple
+{
+   while (!advance(depth)) {
+      if (!depth)
+         return false;
+      depth--;
+   }
+   return descend();
+}
+//---------------------------------------------------------------------------
+void LeapfrogJoin::print(PlanPrinter& out)
+   // Print the operator tree. Debugging only.
+{
+   out.beginOperator("LeapfrogJoin",expectedOutputCardinality,observedOutputCardinality);
+   out.addMaterializationAnnotation(variables);
+   for (std::vector<Pattern>::const_iterator iter=patterns.begin(),limit=patterns.end();iter!=limit;++iter) {
+      std::stringstream pattern;
+      pattern << "pattern order=" << (*iter).order;
+      for (std::vector<Register*>::const_iterator iter2=(*iter).bound.begin(),limit2=(*iter).bound.end();iter2!=limit2;++iter2)
+         pattern << " " << out.formatRegister(*iter2);
+      for (std::vector<unsigned>::const_iterator iter2=(*iter).variables.begin(),limit2=(*iter).variables.end();iter2!=limit2;++iter2)
+         pattern << " " << out.formatRegister(variables[*iter2]);
+      out.addGenericAnnotation(pattern.str());
+   }
+   std::stringstream stats;
+   stats << "seeks " << seeks;
+   out.addGenericAnnotation(stats.str());
+   out.endOperator();
+}
+//---------------------------------------------------------------------------
+void LeapfrogJoin::addMergeHint(Register* /*reg1*/,Register* /*reg2*/)
+   // Add a merge join hint
+{
+}
+//---------------------------------------------------------------------------
+void LeapfrogJoin::getAsyncInputCandidates(Scheduler& /*scheduler*/)
+   // Register parts of the tree that can be executed asynchronous
+{
+}
+//---------------------------------------------------------------------------
@@ -1,5 +1,6 @@
 #include "rts/operator/MergeJoin.hpp"
 #include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/QueryContext.hpp"
 #include "rts/runtime/Runtime.hpp"
 //---------------------------------------------------------------------------
 // RDF-3X
@@ -14,10 +15,11 @@
 MergeJoin::MergeJoin(Operator* left,Register* leftValue,const std::vector<Register*>& leftTail,Operator* right,Register* rightValue,const std::vector<Register*>& rightTail,
         bool leftOptional,
         bool rightOptional,
-        double expectedOutputCardinality)
+        double expectedOutputCardinality,
+        QueryContext* context)
     : Operator(expectedOutputCardinality),left(left),right(right),leftValue(leftValue),rightValue(rightValue),
     leftTail(leftTail),rightTail(rightTail),scanState(empty), leftOptional(leftOptional),
-    rightOptional(rightOptional)
+    rightOptional(rightOptional),context(context),bufferBytes(0)
       // Constructor
 {
     leftShadow.resize(leftTail.size()+2);
@@ -30,6 +32,8 @@ MergeJoin::MergeJoin(Operator* left,Register* leftValue,const std::vector<Regist
 MergeJoin::~MergeJoin()
     // Destructor
 {
+    if (context)
+        context->release(bufferBytes);
     delete left;
     delete right;
 }
@@ -124,6 +128,8 @@ void MergeJoin::handleNM()
 
     // Spool the right hande side into the buffer
     while (true) {
+        if (context)
+            context->check();
         // Materialize
         if (hasCurrent) {
             for (std::vector<uint64_t>::const_iterator iter=rightShadow.begin(),limit=rightShadow.end();iter!=limit;++iter)
@@ -140,6 +146,7 @@ void MergeJoin::handleNM()
             hasCurrent=false;
         } else {
             if ((rightCount=right->next())==0) {
+                accountBuffer();
                 bufferIter=buffer.begin();
                 scanState=loopSpooledRightEmpty;
                 return;
@@ -148,6 +155,7 @@ void MergeJoin::handleNM()
 
         // End of the block?
         if (rightValue->value!=rightShadow[1]) {
+            accountBuffer();
             swapRight();
             bufferIter=buffer.begin();
             scanState=loopSpooledRightHasData;
@@ -156,11 +164,24 @@ void MergeJoin::handleNM()
     }
 }
 //---------------------------------------------------------------------------
+void MergeJoin::accountBuffer()
+    // Account the growth of the buffer in the context
+{
+    uint64_t bytes=buffer.capacity()*sizeof(uint64_t);
+    if (context&&(bytes>bufferBytes)) {
+        uint64_t delta=bytes-bufferBytes;
+        bufferBytes=bytes;
+        context->allocate(delta);
+    }
+}
+//---------------------------------------------------------------------------
 uint64_t MergeJoin::next()
     // Produce the next tuple
 {
     // Repeat until a match is found
     while (true) {
+        if (context)
+            context->check();
         switch (scanState) {
             case empty: return false;
             case scanStepLeftCopyRight:
@@ -1,4 +1,5 @@
 #include "rts/operator/Operator.hpp"
+#include "rts/operator/Batch.hpp"
 //---------------------------------------------------------------------------
 // RDF-3X
 // (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
@@ -22,3 +23,40 @@ Operator::~Operator()
 {
 }
 //---------------------------------------------------------------------------
+unsigned Operator::firstBatch(Batch& batch)
+   // Produce the first batch of tuples
+{
+   batch.clear();
+   batch.done=false;
+   uint64_t count=first();
+   if (!count) {
+      batch.done=true;
+      return 0;
+   }
+   batch.append(count);
+   return nextBatchRows(batch);
+}
+//---------------------------------------------------------------------------
+unsigned Operator::nextBatch(Batch& batch)
+   // Produce the next batch of tuples
+{
+   batch.clear();
+   if (batch.done)
+      return 0;
+   return nextBatchRows(batch);
+}
+//---------------------------------------------------------------------------
+unsigned Operator::nextBatchRows(Batch& batch)
+   // Fill the rest of a batch one tuple at the time
+{
+   while (!batch.full()) {
+      uint64_t count=next();
+      if (!count) {
+         batch.done=true;
+         break;
+      }
+      batch.append(count);
+   }
+   return batch.size;
+}
+//---------------------------------------------------------------------------
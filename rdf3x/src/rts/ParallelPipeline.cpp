@@ -0,0 +1,225 @@
+#include "rts/operator/ParallelPipeline.hpp"
+#include "rts/operator/Batch.hpp"
+#include "rts/operator/PlanPrinter.hpp"
+
+#include <sstream>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+ParallelPipeline::ParallelPipeline(std::vector<Worker>& workers,const std::vector<Register*>& output,uint64_t maxKey,unsigned morsels,double expectedOutputCardinality)
+   : Operator(expectedOutputCardinality),workers(std::move(workers)),output(output),nextMorsel(0),running(0),stop(false),pos(0)
+   // Constructor
+{
+   // Uniform ranges of the first value. The last one also covers the values
+   // that are not in the dictionary (e.g., inlined numbers)
+   if (!morsels) morsels=1;
+   uint64_t step=maxKey/morsels;
+   for (unsigned index=0;index<morsels;index++)
+      bounds.push_back(step*index);
+   bounds.push_back(UINT64_MAX);
+}
+//---------------------------------------------------------------------------
+ParallelPipeline::Consumer::~Consumer()
+   // Destructor
+{
+}
+//---------------------------------------------------------------------------
+ParallelPipeline::~ParallelPipeline()
+   // Destructor
+{
+   shutdown();
+   for (std::vector<Worker>::iterator iter=workers.begin(),limit=workers.end();iter!=limit;++iter)
+      delete (*iter).tree;
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::run(unsigned thread,Consumer* consumer)
+   // Run one copy of the pipeline
+{
+   Worker& worker=workers[thread];
+   uint64_t rows=0;
+   try {
+      Chunk chunk;
+      Batch input(worker.output);
+      const unsigned width=worker.output.size();
+      while (!stop) {
+         unsigned morsel=nextMorsel++;
+         if (morsel+1>=bounds.size())
+            break;
+         worker.driver->setKeyRange(bounds[morsel],bounds[morsel+1]);
+         for (std::vector<Operator*>::const_iterator iter=worker.partners.begin(),limit=worker.partners.end();iter!=limit;++iter)
+            (*iter)->setKeyRange(bounds[morsel],bounds[morsel+1]);
+         for (unsigned size=worker.tree->firstBatch(input);size&&(!stop);size=worker.tree->nextBatch(input)) {
+            // The consumer processes the batch in this thread
+            if (consumer) {
+               for (unsigned index=0;index<size;index++)
+                  rows+=input.counts[input.selection[index]];
+               consumer->consume(thread,*worker.db,input,size);
+               continue;
+            }
+            for (unsigned index=0;index<size;index++) {
+               unsigned row=input.selection[index];
+               for (unsigned column=0;column<width;column++)
+                  chunk.values.push_back(input.getColumn(column)[row]);
+               chunk.counts.push_back(input.counts[row]);
+            }
+            if (chunk.counts.size()<chunkSize)
+               continue;
+
+            // Hand the chunk over, wait if the consumer is too slow
+            std::unique_lock<std::mutex> lock(mutex);
+            while ((!stop)&&(queue.size()>=4*workers.size()))
+               consumed.wait(lock);
+            if (stop)
+               break;
+            queue.push_back(std::move(chunk));
+            chunk=Chunk();
+            produced.notify_one();
+         }
+      }
+      if ((!stop)&&(!chunk.counts.empty())) {
+         std::lock_guard<std::mutex> lock(mutex);
+         queue.push_back(std::move(chunk));
+      }
+   } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+         error=std::current_exception();
+      stop=true;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
+   if (consumer)
+      observedOutputCardinality+=rows;
+   running--;
+   produced.notify_all();
+   consumed.notify_all();
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::shutdown()
+   // Stop all threads
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop=true;
+   }
+   consumed.notify_all();
+   for (std::vector<std::thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      (*iter).join();
+   threads.clear();
+}
+//---------------------------------------------------------------------------
+uint64_t ParallelPipeline::produce()
+   // Return the next tuple of the current chunk
+{
+   const uint64_t* values=current.values.data()+pos*output.size();
+   for (std::vector<Register*>::const_iterator iter=output.begin(),limit=output.end();iter!=limit;++iter,++values)
+      (*iter)->value=*values;
+   uint64_t count=current.counts[pos++];
+   observedOutputCardinality+=count;
+   return count;
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::start(Consumer* consumer)
+   // Start the threads
+{
+   running=workers.size();
+   for (unsigned index=0;index<workers.size();index++)
+      threads.push_back(std::thread(&ParallelPipeline::run,this,index,consumer));
+}
+//---------------------------------------------------------------------------
+uint64_t ParallelPipeline::first()
+   // Produce the first tuple
+{
+   shutdown();
+   queue.clear();
+   current=Chunk();
+   pos=0;
+   nextMorsel=0;
+   stop=false;
+   error=std::exception_ptr();
+   observedOutputCardinality=0;
+
+   start(0);
+   return next();
+}
+//---------------------------------------------------------------------------
+uint64_t ParallelPipeline::next()
+   // Produce the next tuple
+{
+   if (pos<current.counts.size())
+      return produce();
+
+   // Wait for the next chunk
+   std::exception_ptr failure;
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (queue.empty()&&running&&(!error))
+         produced.wait(lock);
+      failure=error;
+      if (!failure) {
+         if (queue.empty())
+            return false;
+         current=std::move(queue.front());
+         queue.pop_front();
+         pos=0;
+         consumed.notify_one();
+      }
+   }
+   if (failure) {
+      shutdown();
+      std::rethrow_exception(failure);
+   }
+   return produce();
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::consume(Consumer& consumer)
+   // Run the pipeline and hand the batches to a consumer, inside the thread that produced them
+{
+   shutdown();
+   queue.clear();
+   current=Chunk();
+   pos=0;
+   nextMorsel=0;
+   stop=false;
+   error=std::exception_ptr();
+   observedOutputCardinality=0;
+
+   // Wait for all threads, the first error is passed on
+   start(&consumer);
+   for (std::vector<std::thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      (*iter).join();
+   threads.clear();
+   if (error)
+      std::rethrow_exception(error);
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::print(PlanPrinter& out)
+   // Print the operator tree. Debugging only.
+{
+   out.beginOperator("ParallelPipeline",expectedOutputCardinality,observedOutputCardinality);
+   std::stringstream stats;
+   stats << "workers " << workers.size() << " morsels " << (bounds.size()-1);
+   out.addGenericAnnotation(stats.str());
+   out.addMaterializationAnnotation(output);
+   if (!workers.empty())
+      workers.front().tree->print(out);
+   out.endOperator();
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::addMergeHint(Register* /*reg1*/,Register* /*reg2*/)
+   // Add a merge join hint
+{
+}
+//---------------------------------------------------------------------------
+void ParallelPipeline::getAsyncInputCandidates(Scheduler& /*scheduler*/)
+   // Register parts of the tree that can be executed asynchronous
+{
+}
+//---------------------------------------------------------------------------
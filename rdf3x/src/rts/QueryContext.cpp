@@ -0,0 +1,78 @@
+#include "rts/runtime/QueryContext.hpp"
+#include <string>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+QueryContext::QueryContext()
+   : hasDeadline(false),reason(None),memoryLimit(0),memoryUsed(0),memoryPeak(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+QueryContext::~QueryContext()
+   // Destructor
+{
+}
+//---------------------------------------------------------------------------
+void QueryContext::setTimeout(uint64_t milliseconds)
+   // Stop the query after the given number of milliseconds
+{
+   hasDeadline=milliseconds;
+   if (hasDeadline)
+      deadline=Clock::now()+std::chrono::milliseconds(milliseconds);
+}
+//---------------------------------------------------------------------------
+void QueryContext::stop(Reason why)
+   // Stop the query, the first reason is kept
+{
+   int expected=None;
+   reason.compare_exchange_strong(expected,why);
+}
+//---------------------------------------------------------------------------
+bool QueryContext::checkDeadline()
+   // Read the clock
+{
+   if (Clock::now()<deadline)
+      return false;
+   stop(Timeout);
+   return true;
+}
+//---------------------------------------------------------------------------
+void QueryContext::raise() const
+   // Throw the exception of the reason the query was stopped
+{
+   Reason why=getReason();
+   if (why!=None)
+      throw Exception(why,getMessage());
+}
+//---------------------------------------------------------------------------
+std::string QueryContext::getMessage() const
+   // Describe the reason the query was stopped
+{
+   switch (getReason()) {
+      case Timeout: return "the query exceeded its time limit";
+      case Cancelled: return "the query was cancelled";
+      case MemoryLimit: return "the query exceeded its memory limit of "+std::to_string(memoryLimit)+" bytes";
+      default: return "";
+   }
+}
+//---------------------------------------------------------------------------
+void QueryContext::allocate(uint64_t bytes)
+   // Account memory used by an operator. Throws if the limit is exceeded
+{
+   uint64_t used=memoryUsed.fetch_add(bytes,std::memory_order_relaxed)+bytes;
+   uint64_t peak=memoryPeak.load(std::memory_order_relaxed);
+   while ((used>peak)&&(!memoryPeak.compare_exchange_weak(peak,used,std::memory_order_relaxed))) ;
+   if (memoryLimit&&(used>memoryLimit)) {
+      stop(MemoryLimit);
+      raise();
+   }
+}
+//---------------------------------------------------------------------------
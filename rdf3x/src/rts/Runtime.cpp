@@ -17,7 +17,7 @@ void Register::reset()
 }
 //---------------------------------------------------------------------------
 Runtime::Runtime(DBLayer& db,/*DifferentialIndex* diff,*/TemporaryDictionary* temporaryDictionary, QueryDict *queryDict)
-   : db(db),/*diff(diff),*/temporaryDictionary(temporaryDictionary), queryDict(queryDict)
+   : db(db),/*diff(diff),*/temporaryDictionary(temporaryDictionary), queryDict(queryDict), sortMemoryBudget(0), hashMemoryBudget(0), parallelism(1), morselPlan(0), morselScan(0), sharedBuilds(0), queryContext(0)
    // Constructor
 {
 }
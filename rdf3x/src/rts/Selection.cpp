@@ -1,4 +1,5 @@
 #include "rts/operator/Selection.hpp"
+#include "rts/operator/Batch.hpp"
 #include "rts/operator/PlanPrinter.hpp"
 #include "rts/operator/ResultsPrinter.hpp"
 #include "rts/runtime/Runtime.hpp"
@@ -1209,7 +1210,7 @@ string Selection::AggrFunction::print(PlanPrinter& out)
 }
 //---------------------------------------------------------------------------
 Selection::Selection(Operator* input, Runtime& runtime, Predicate* predicate, double expectedOutputCardinality)
-    : Operator(expectedOutputCardinality), input(input), runtime(runtime), predicate(predicate)
+    : Operator(expectedOutputCardinality), input(input), runtime(runtime), predicate(predicate), vectorMode(VectorUnknown)
       // Constructor
 {
 }
@@ -1257,6 +1258,169 @@ uint64_t Selection::next()
     }
 }
 //---------------------------------------------------------------------------
+bool Selection::prepareVector(Predicate* predicate)
+    // Collect the comparisons of a conjunction that can be evaluated on whole batches
+{
+    if (And* conjunction = dynamic_cast<And*>(predicate))
+        return prepareVector(conjunction->getLeft()) && prepareVector(conjunction->getRight());
+
+    // A comparison between a variable and a constant
+    VectorCondition condition;
+    if (dynamic_cast<Equal*>(predicate))
+        condition.kind = VectorCondition::IdEqual;
+    else if (dynamic_cast<NotEqual*>(predicate))
+        condition.kind = VectorCondition::IdNotEqual;
+    else if (dynamic_cast<Less*>(predicate))
+        condition.kind = VectorCondition::NumLess;
+    else if (dynamic_cast<LessOrEqual*>(predicate))
+        condition.kind = VectorCondition::NumLessOrEqual;
+    else
+        return false;
+    BinaryPredicate* comparison = static_cast<BinaryPredicate*>(predicate);
+    Variable* variable = dynamic_cast<Variable*>(comparison->getLeft());
+    Predicate* constant = comparison->getRight();
+    condition.constantFirst = false;
+    if (!variable) {
+        variable = dynamic_cast<Variable*>(comparison->getRight());
+        constant = comparison->getLeft();
+        condition.constantFirst = true;
+    }
+    if (!variable)
+        return false;
+    uint64_t id;
+    if (ConstantLiteral* literal = dynamic_cast<ConstantLiteral*>(constant))
+        id = literal->getId();
+    else if (ConstantIRI* iri = dynamic_cast<ConstantIRI*>(constant))
+        id = iri->getId();
+    else
+        return false;
+    condition.predicate = predicate;
+    condition.reg = variable->getRegister();
+    condition.type = 0;
+    condition.value = id;
+    condition.column = 0;
+
+    // Equalities compare the ids. The other comparisons are numeric for the
+    // inline numbers, so the constant is converted like in Less::eval
+    if ((condition.kind == VectorCondition::NumLess) || (condition.kind == VectorCondition::NumLessOrEqual)) {
+        if (dynamic_cast<ConstantIRI*>(constant))
+            return false;
+        if (DictMgmt::isnumeric(id)) {
+            condition.type = DictMgmt::getType(id);
+        } else {
+            Result r;
+            r.setId(id);
+            r.ensureString(this);
+            NumType tp = getNumType(r.value);
+            try {
+                if (tp == NumType::INT) {
+                    condition.type = DICTMGMT_INTEGER;
+                    condition.value = _getLong(r.value);
+                } else if (tp == NumType::DECIMAL) {
+                    condition.type = DICTMGMT_FLOAT;
+                    float v_tmp1 = _getDouble(r.value);
+                    uint32_t v_tmp;
+                    memcpy(&v_tmp, &v_tmp1, sizeof(float));
+                    condition.value = v_tmp;
+                } else {
+                    return false;
+                }
+            } catch (...) {
+                // Leave the errors to the evaluation of the single rows
+                return false;
+            }
+        }
+    }
+    conditions.push_back(condition);
+    return true;
+}
+//---------------------------------------------------------------------------
+unsigned Selection::filterBatch(Batch& batch)
+    // Remove the rows of a batch that do not qualify
+{
+    unsigned* selection = batch.selection.data();
+    for (vector<VectorCondition>::const_iterator iter = conditions.begin(), limit = conditions.end(); iter != limit; ++iter) {
+        const VectorCondition& condition = *iter;
+        const uint64_t* values = batch.getColumn(condition.column);
+        unsigned size = 0;
+        switch (condition.kind) {
+            case VectorCondition::IdEqual:
+                for (unsigned index = 0; index < batch.size; index++) {
+                    unsigned row = selection[index];
+                    selection[size] = row;
+                    size += (values[row] == condition.value);
+                }
+                break;
+            case VectorCondition::IdNotEqual:
+                for (unsigned index = 0; index < batch.size; index++) {
+                    unsigned row = selection[index];
+                    selection[size] = row;
+                    size += (values[row] != condition.value);
+                }
+                break;
+            case VectorCondition::NumLess:
+            case VectorCondition::NumLessOrEqual: {
+                bool orEqual = (condition.kind == VectorCondition::NumLessOrEqual);
+                for (unsigned index = 0; index < batch.size; index++) {
+                    unsigned row = selection[index];
+                    uint64_t value = values[row];
+                    bool match;
+                    if (DictMgmt::isnumeric(value)) {
+                        int res = condition.constantFirst ?
+                            DictMgmt::compare(condition.type, condition.value, DictMgmt::getType(value), value) :
+                            DictMgmt::compare(DictMgmt::getType(value), value, condition.type, condition.value);
+                        match = orEqual ? (res <= 0) : (res < 0);
+                    } else {
+                        // Strings and numbers in the dictionary
+                        condition.reg->value = value;
+                        match = condition.predicate->check();
+                    }
+                    selection[size] = row;
+                    size += match;
+                }
+                break;
+            }
+        }
+        batch.size = size;
+    }
+    for (unsigned index = 0; index < batch.size; index++)
+        observedOutputCardinality += batch.counts[selection[index]];
+    return batch.size;
+}
+//---------------------------------------------------------------------------
+unsigned Selection::firstBatch(Batch& batch)
+    // Produce the first batch of tuples
+{
+    predicate->setSelection(this);
+    if (vectorMode == VectorUnknown) {
+        vectorMode = prepareVector(predicate) ? VectorYes : VectorNo;
+        if (vectorMode == VectorNo)
+            conditions.clear();
+    }
+    if (vectorMode == VectorNo)
+        return Operator::firstBatch(batch);
+
+    observedOutputCardinality = 0;
+    for (vector<VectorCondition>::iterator iter = conditions.begin(), limit = conditions.end(); iter != limit; ++iter)
+        (*iter).column = batch.addRegister((*iter).reg);
+    if (!input->firstBatch(batch))
+        return 0;
+    if (filterBatch(batch))
+        return batch.size;
+    return nextBatch(batch);
+}
+//---------------------------------------------------------------------------
+unsigned Selection::nextBatch(Batch& batch)
+    // Produce the next batch of tuples
+{
+    if (vectorMode != VectorYes)
+        return Operator::nextBatch(batch);
+    while (input->nextBatch(batch))
+        if (filterBatch(batch))
+            return batch.size;
+    return 0;
+}
+//---------------------------------------------------------------------------
 void Selection::print(PlanPrinter& out)
     // Print the operator tree. Debugging only.
 {
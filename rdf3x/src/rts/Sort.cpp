@@ -1,11 +1,17 @@
 #include "rts/operator/Sort.hpp"
 #include "infra/util/Type.hpp"
 #include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/QueryContext.hpp"
 #include "rts/runtime/Runtime.hpp"
 #include "trident/kb/dictmgmt.h"
+#include "trident/utils/parallel.h"
 
 #include <kognac/consts.h>
+#include <kognac/logs.h>
 #include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
 //---------------------------------------------------------------------------
 // RDF-3X
 // (c) 2009 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
@@ -18,87 +24,41 @@
 //---------------------------------------------------------------------------
 using namespace std;
 //---------------------------------------------------------------------------
-/// Comparator
+/// Comparator on the sort keys
 class Sort::Sorter {
     private:
-        /// The dictionary
-        DBLayer& dict;
         /// The sort order
         const vector<Order>& order;
-        std::shared_ptr<char> buffer1;
-        std::shared_ptr<char> buffer2;
+        /// The position of the first sort key in a tuple
+        uint64_t keys;
 
     public:
         /// Constructor
-        Sorter(DBLayer& dict, const vector<Order>& order) : dict(dict), order(order),
-        buffer1(new char[MAX_TERM_SIZE]), buffer2(new char[MAX_TERM_SIZE]) {}
+        Sorter(const vector<Order>& order, uint64_t keys) : order(order), keys(keys) {}
 
         /// Compare
-        bool operator()(const Tuple* a, const Tuple* b);
+        bool operator()(const Tuple* a, const Tuple* b) const;
 };
 //---------------------------------------------------------------------------
-bool Sort::Sorter::operator()(const Tuple* a, const Tuple* b)
+bool Sort::Sorter::operator()(const Tuple* a, const Tuple* b) const
     // Compare
 {
-    for (vector<Order>::const_iterator iter = order.begin(), limit = order.end(); iter != limit; ++iter) {
-        uint64_t slot = (*iter).slot;
-        if (~slot) {
-            // Access values
+    for (uint64_t index = 0, limit = order.size(); index < limit; index++) {
+        if (~order[index].slot) {
+            // The keys are ranks, null values come first
             uint64_t v1, v2;
-            if ((*iter).descending) {
-                v1 = b->values[slot];
-                v2 = a->values[slot];
+            if (order[index].descending) {
+                v1 = b->values[keys + index];
+                v2 = a->values[keys + index];
             } else {
-                v1 = a->values[slot];
-                v2 = b->values[slot];
-            }
-
-            // Equal?
-            if (v1 == v2) continue;
-
-            // Null values
-            if (!~v1) return true;
-            if (!~v2) return false;
-
-            if (DictMgmt::isnumeric(v1) && DictMgmt::isnumeric(v2)) {
-                int cmp = DictMgmt::compare(DictMgmt::getType(v1), v1, DictMgmt::getType(v2), v2);
-                if (cmp == 0) {
-                    continue;
-                }
-                return cmp < 0;
-            }
-
-            // Load the strings
-            const char* start1, *stop1, *start2, *stop2;
-            size_t len1, len2;
-            Type::ID type1, type2;
-            unsigned subType1, subType2;
-            if (!dict.lookupById(v1, buffer1.get(), len1, type1, subType1)) continue;
-            if (!dict.lookupById(v2, buffer2.get(), len2, type2, subType2)) continue;
-            start1 = buffer1.get();
-            start2 = buffer2.get();
-            stop1 = start1 + len1;
-            stop2 = start2 + len2;
-
-            // Compare
-            if (type1 < type2) return true;
-            if (type1 > type2) return false;
-            if (Type::hasSubType(type1)) {
-                if (subType1 < subType2) return true;
-                if (subType1 > subType2) return false;
+                v1 = a->values[keys + index];
+                v2 = b->values[keys + index];
             }
-            int c = memcmp(start1, start2, min(stop1 - start1, stop2 - start2));
-            if (c < 0) return true;
-            if (c > 0) return false;
-            if ((stop1 - start1) < (stop2 - start2)) return true;
-            if ((stop1 - start1) > (stop2 - start2)) return false;
-
-            // Tie breaker. Should not be necessary...
             if (v1 < v2) return true;
             if (v1 > v2) return false;
         } else {
             // Sort by count
-            if ((*iter).descending) {
+            if (order[index].descending) {
                 if (a->count > b->count) return true;
                 if (a->count < b->count) return false;
             } else {
@@ -110,8 +70,135 @@ bool Sort::Sorter::operator()(const Tuple* a, const Tuple* b)
     return false;
 }
 //---------------------------------------------------------------------------
-Sort::Sort(DBLayer& db, Operator* input, const vector<Register*>& values, const vector<pair<Register*, bool> >& registerOrder, double expectedOutputCardinality)
-    : Operator(expectedOutputCardinality), values(values), input(input), tuplesPool(values.size() * sizeof(uint64_t)), dict(db)
+/// Decodes every distinct value once and compares the decoded strings
+class Sort::Decoder {
+    public:
+        /// A decoded value
+        struct Entry {
+            /// The id
+            uint64_t id;
+            /// The position in the list of distinct values
+            uint64_t index;
+            /// The string in the arena
+            uint64_t offset, len;
+            /// The type
+            Type::ID type;
+            /// The sub-type
+            unsigned subType;
+            /// Was the lookup successful?
+            bool found;
+        };
+
+    private:
+        /// The dictionary
+        DBLayer& dict;
+        /// The strings
+        vector<char> arena;
+        /// The lookup buffer
+        std::unique_ptr<char[]> buffer;
+
+    public:
+        /// Constructor
+        Decoder(DBLayer& dict) : dict(dict), buffer(new char[MAX_TERM_SIZE]) {}
+
+        /// Decode a value
+        Entry decode(uint64_t id, uint64_t index, bool lookup);
+        /// Compare two distinct values
+        bool operator()(const Entry& a, const Entry& b) const {
+            return less(a, arena.data() + a.offset, b, arena.data() + b.offset);
+        }
+        /// Compare two distinct values, given their strings
+        static bool less(const Entry& a, const char* s1, const Entry& b, const char* s2);
+};
+//---------------------------------------------------------------------------
+Sort::Decoder::Entry Sort::Decoder::decode(uint64_t id, uint64_t index, bool lookup)
+    // Decode a value
+{
+    Entry e;
+    e.id = id;
+    e.index = index;
+    e.offset = arena.size();
+    e.len = 0;
+    e.type = Type::ID(0);
+    e.subType = 0;
+    e.found = false;
+    if (lookup) {
+        size_t len;
+        if (dict.lookupById(id, buffer.get(), len, e.type, e.subType)) {
+            arena.insert(arena.end(), buffer.get(), buffer.get() + len);
+            e.len = len;
+            e.found = true;
+        }
+    }
+    return e;
+}
+//---------------------------------------------------------------------------
+bool Sort::Decoder::less(const Entry& a, const char* s1, const Entry& b, const char* s2)
+    // Compare two distinct values, given their strings
+{
+    uint64_t v1 = a.id, v2 = b.id;
+    if (DictMgmt::isnumeric(v1) && DictMgmt::isnumeric(v2)) {
+        return DictMgmt::compare(DictMgmt::getType(v1), v1, DictMgmt::getType(v2), v2) < 0;
+    }
+
+    // Values that are not in the dictionary go last
+    if (a.found != b.found) return a.found;
+    if (!a.found) return v1 < v2;
+
+    // Compare
+    if (a.type < b.type) return true;
+    if (a.type > b.type) return false;
+    if (Type::hasSubType(a.type)) {
+        if (a.subType < b.subType) return true;
+        if (a.subType > b.subType) return false;
+    }
+    int c = memcmp(s1, s2, min(a.len, b.len));
+    if (c < 0) return true;
+    if (c > 0) return false;
+    if (a.len < b.len) return true;
+    if (a.len > b.len) return false;
+
+    // Tie breaker. Should not be necessary...
+    return v1 < v2;
+}
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+/// A sorted run spilled to disk
+class Sort::Run {
+    public:
+        /// The file
+        FILE* file;
+        /// The current tuple: count and values
+        vector<uint64_t> tuple;
+        /// The decoded values of the order entries in the current tuple
+        vector<Decoder::Entry> entries;
+        /// The strings of the decoded values
+        vector<string> strings;
+        /// Which order entries are decoded?
+        vector<bool> decoded;
+
+        /// Constructor
+        Run(FILE* file, uint64_t nvalues, uint64_t norder) : file(file), tuple(nvalues + 1), entries(norder), strings(norder), decoded(norder) {}
+        /// Destructor
+        ~Run() { fclose(file); }
+};
+//---------------------------------------------------------------------------
+/// Order of the runs in the merge heap
+class Sort::RunOrder {
+    private:
+        /// The operator
+        Sort& sort;
+
+    public:
+        /// Constructor
+        RunOrder(Sort& sort) : sort(sort) {}
+
+        /// The heap keeps the smallest tuple on top
+        bool operator()(Run* a, Run* b) const { return sort.lessRun(*b, *a); }
+};
+//---------------------------------------------------------------------------
+Sort::Sort(DBLayer& db, Operator* input, const vector<Register*>& values, const vector<pair<Register*, bool> >& registerOrder, double expectedOutputCardinality, uint64_t topK, uint64_t memoryBudget, QueryContext* context)
+    : Operator(expectedOutputCardinality), values(values), input(input), tuplesPool((values.size() + registerOrder.size()) * sizeof(uint64_t)), dict(db), topK(topK), memoryBudget(memoryBudget), rowsProcessed(0), bytesSpilled(0), nRuns(0), context(context), accountedBytes(0)
       // Constructor
 {
     for (vector<pair<Register*, bool> >::const_iterator iter = registerOrder.begin(), limit = registerOrder.end(); iter != limit; ++iter) {
@@ -140,15 +227,222 @@ Sort::Sort(DBLayer& db, Operator* input, const vector<Register*>& values, const
 Sort::~Sort()
     // Destructor
 {
+    accountMemory(0);
+    closeRuns();
     delete input;
 }
 //---------------------------------------------------------------------------
+void Sort::computeKeys(uint64_t entry)
+    // Replace the values of an order entry with their rank in the sort order
+{
+    const uint64_t slot = order[entry].slot;
+    const uint64_t key = values.size() + entry;
+
+    // Collect the distinct values
+    vector<uint64_t> ids;
+    ids.reserve(tuples.size());
+    for (vector<Tuple*>::const_iterator iter = tuples.begin(), limit = tuples.end(); iter != limit; ++iter) {
+        uint64_t v = (*iter)->values[slot];
+        if (~v)
+            ids.push_back(v);
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    // Numbers are compared without the dictionary, unless they must be
+    // compared with strings
+    bool allNumeric = true;
+    for (vector<uint64_t>::const_iterator iter = ids.begin(), limit = ids.end(); iter != limit; ++iter)
+        if (!DictMgmt::isnumeric(*iter)) {
+            allNumeric = false;
+            break;
+        }
+
+    // Decode each value once and sort them
+    Decoder decoder(dict);
+    vector<Decoder::Entry> entries;
+    entries.reserve(ids.size());
+    for (uint64_t index = 0, limit = ids.size(); index < limit; index++)
+        entries.push_back(decoder.decode(ids[index], index, !allNumeric));
+    sort(entries.begin(), entries.end(), std::ref(decoder));
+
+    // Equal values get the same rank. 0 is left for null
+    vector<uint64_t> ranks(ids.size());
+    uint64_t rank = 1;
+    for (uint64_t index = 0, limit = entries.size(); index < limit; index++) {
+        if (index && decoder(entries[index - 1], entries[index]))
+            rank++;
+        ranks[entries[index].index] = rank;
+    }
+
+    for (vector<Tuple*>::const_iterator iter = tuples.begin(), limit = tuples.end(); iter != limit; ++iter) {
+        uint64_t v = (*iter)->values[slot];
+        if (~v)
+            (*iter)->values[key] = ranks[lower_bound(ids.begin(), ids.end(), v) - ids.begin()];
+        else
+            (*iter)->values[key] = 0;
+    }
+}
+//---------------------------------------------------------------------------
+void Sort::sortTuples()
+    // Sort the tuples in memory
+{
+    // Sort on fixed-width keys, so that the comparisons do not need the dictionary
+    for (uint64_t entry = 0, limit = order.size(); entry < limit; entry++)
+        if (~order[entry].slot)
+            computeKeys(entry);
+    int32_t nthreads = (tuples.size() < parallelSortThreshold) ? 1 : ParallelTasks::getNThreads();
+    ParallelTasks::sort_int(tuples.begin(), tuples.end(), Sorter(order, values.size()), nthreads);
+}
+//---------------------------------------------------------------------------
+void Sort::pruneTuples()
+    // Keep only the first topK tuples
+{
+    for (uint64_t entry = 0, limit = order.size(); entry < limit; entry++)
+        if (~order[entry].slot)
+            computeKeys(entry);
+    Sorter sorter(order, values.size());
+    if (tuples.size() > topK) {
+        nth_element(tuples.begin(), tuples.begin() + topK, tuples.end(), sorter);
+        for (vector<Tuple*>::const_iterator iter = tuples.begin() + topK, limit = tuples.end(); iter != limit; ++iter)
+            tuplesPool.free(*iter);
+        tuples.resize(topK);
+    }
+    sort(tuples.begin(), tuples.end(), sorter);
+}
+//---------------------------------------------------------------------------
+void Sort::spillTuples()
+    // Write the tuples in memory to a sorted run
+{
+    sortTuples();
+    FILE* file = tmpfile();
+    if (!file) {
+        LOG(ERRORL) << "Sort: cannot create a temporary file for the spilled tuples";
+        throw 10;
+    }
+    for (vector<Tuple*>::const_iterator iter = tuples.begin(), limit = tuples.end(); iter != limit; ++iter) {
+        if (fwrite(&(*iter)->count, sizeof(uint64_t), 1, file) != 1 ||
+                fwrite((*iter)->values, sizeof(uint64_t), values.size(), file) != values.size()) {
+            fclose(file);
+            LOG(ERRORL) << "Sort: cannot write the spilled tuples";
+            throw 10;
+        }
+    }
+    bytesSpilled += tuples.size() * (values.size() + 1) * sizeof(uint64_t);
+    rewind(file);
+    runs.push_back(new Run(file, values.size(), order.size()));
+    nRuns++;
+
+    // Reuse the memory for the next run
+    for (vector<Tuple*>::const_iterator iter = tuples.begin(), limit = tuples.end(); iter != limit; ++iter)
+        tuplesPool.free(*iter);
+    tuples.clear();
+}
+//---------------------------------------------------------------------------
+bool Sort::loadRun(Run& run)
+    // Read the next tuple of a run
+{
+    if (fread(run.tuple.data(), sizeof(uint64_t), run.tuple.size(), run.file) != run.tuple.size())
+        return false;
+    fill(run.decoded.begin(), run.decoded.end(), false);
+    return true;
+}
+//---------------------------------------------------------------------------
+void Sort::decodeRun(Run& run, uint64_t entry)
+    // Decode the value of an order entry in the current tuple of a run
+{
+    if (run.decoded[entry])
+        return;
+    Decoder::Entry& e = run.entries[entry];
+    e.id = run.tuple[1 + order[entry].slot];
+    e.offset = 0;
+    e.len = 0;
+    e.type = Type::ID(0);
+    e.subType = 0;
+    size_t len;
+    if (!lookupBuffer)
+        lookupBuffer.reset(new char[MAX_TERM_SIZE]);
+    e.found = dict.lookupById(e.id, lookupBuffer.get(), len, e.type, e.subType);
+    if (e.found) {
+        run.strings[entry].assign(lookupBuffer.get(), len);
+        e.len = len;
+    }
+    run.decoded[entry] = true;
+}
+//---------------------------------------------------------------------------
+bool Sort::lessRun(Run& a, Run& b)
+    // Compare the current tuples of two runs
+{
+    for (uint64_t index = 0, limit = order.size(); index < limit; index++) {
+        uint64_t slot = order[index].slot;
+        Run& r1 = order[index].descending ? b : a;
+        Run& r2 = order[index].descending ? a : b;
+        if (~slot) {
+            uint64_t v1 = r1.tuple[1 + slot], v2 = r2.tuple[1 + slot];
+            if (v1 == v2) continue;
+
+            // Null values
+            if (!~v1) return true;
+            if (!~v2) return false;
+
+            // Numbers are compared without the dictionary
+            if (!DictMgmt::isnumeric(v1) || !DictMgmt::isnumeric(v2)) {
+                decodeRun(r1, index);
+                decodeRun(r2, index);
+            } else {
+                r1.entries[index].id = v1;
+                r2.entries[index].id = v2;
+            }
+            if (Decoder::less(r1.entries[index], r1.strings[index].data(), r2.entries[index], r2.strings[index].data())) return true;
+            if (Decoder::less(r2.entries[index], r2.strings[index].data(), r1.entries[index], r1.strings[index].data())) return false;
+        } else {
+            // Sort by count
+            if (r1.tuple[0] < r2.tuple[0]) return true;
+            if (r1.tuple[0] > r2.tuple[0]) return false;
+        }
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
+void Sort::closeRuns()
+    // Delete the runs
+{
+    for (vector<Run*>::const_iterator iter = runs.begin(), limit = runs.end(); iter != limit; ++iter)
+        delete *iter;
+    runs.clear();
+    mergeHeap.clear();
+}
+//---------------------------------------------------------------------------
+void Sort::accountMemory(uint64_t bytes)
+    // Account the memory of the tuples in the context
+{
+    if (!context)
+        return;
+    if (bytes > accountedBytes) {
+        uint64_t delta = bytes - accountedBytes;
+        accountedBytes = bytes;
+        context->allocate(delta);
+    } else {
+        context->release(accountedBytes - bytes);
+        accountedBytes = bytes;
+    }
+}
+//---------------------------------------------------------------------------
 uint64_t Sort::first()
     // Produce the first tuple
 {
     observedOutputCardinality = 0;
+    rowsProcessed = bytesSpilled = nRuns = 0;
+    closeRuns();
 
-    // Collect the input
+    // Collect the input. With a limit, only the first topK tuples are kept,
+    // unless they do not fit in the budget. Otherwise, the tuples that
+    // exceed the memory budget are spilled
+    uint64_t topKBuffer = 2 * topK;
+    if (topKBuffer < minTopKBuffer)
+        topKBuffer = minTopKBuffer;
+    const uint64_t tupleSize = VarPool<Tuple>::basicSize + (values.size() + order.size()) * sizeof(uint64_t) + sizeof(Tuple*);
+    const bool useTopK = (~topK) && ((!memoryBudget) || (topKBuffer < memoryBudget / tupleSize));
     tuples.clear();
     tuplesPool.freeAll();
     for (uint64_t count = input->first(); count; count = input->next()) {
@@ -158,10 +452,38 @@ uint64_t Sort::first()
             t->values[index] = values[index]->value;
         }
         tuples.push_back(t);
+        rowsProcessed++;
+
+        if (useTopK) {
+            if (tuples.size() >= topKBuffer)
+                pruneTuples();
+        } else if (memoryBudget && tuples.size() * tupleSize >= memoryBudget) {
+            spillTuples();
+        }
+
+        // The memory is accounted once every few thousand tuples
+        if (context) {
+            context->check();
+            if (!(rowsProcessed % 4096))
+                accountMemory(tuples.size() * tupleSize);
+        }
     }
+    accountMemory(tuples.size() * tupleSize);
 
-    // Sort it
-    sort(tuples.begin(), tuples.end(), Sorter(dict, order));
+    if (useTopK) {
+        pruneTuples();
+    } else if (runs.empty()) {
+        sortTuples();
+    } else {
+        // Merge the runs
+        if (!tuples.empty())
+            spillTuples();
+        LOG(DEBUGL) << "Sort: spilled " << bytesSpilled << " bytes in " << nRuns << " runs";
+        for (vector<Run*>::const_iterator iter = runs.begin(), limit = runs.end(); iter != limit; ++iter)
+            if (loadRun(**iter))
+                mergeHeap.push_back(*iter);
+        make_heap(mergeHeap.begin(), mergeHeap.end(), RunOrder(*this));
+    }
 
     // Return the first one
     tuplesIter = tuples.begin();
@@ -171,6 +493,25 @@ uint64_t Sort::first()
 uint64_t Sort::next()
     // Produce the next tuple
 {
+    // Merge the spilled runs
+    if (!runs.empty()) {
+        if (mergeHeap.empty())
+            return 0;
+        RunOrder runOrder(*this);
+        pop_heap(mergeHeap.begin(), mergeHeap.end(), runOrder);
+        Run& run = *mergeHeap.back();
+        for (uint64_t index = 0, limit = values.size(); index < limit; index++)
+            values[index]->value = run.tuple[1 + index];
+        uint64_t count = run.tuple[0];
+        if (loadRun(run))
+            push_heap(mergeHeap.begin(), mergeHeap.end(), runOrder);
+        else
+            mergeHeap.pop_back();
+
+        observedOutputCardinality += count;
+        return count;
+    }
+
     // End of input
     if (tuplesIter == tuples.end())
         return 0;
@@ -202,6 +543,11 @@ void Sort::print(PlanPrinter& out)
     }
     o += "]";
     out.addGenericAnnotation(o);
+    if (~topK)
+        out.addGenericAnnotation("top " + to_string(topK));
+    out.addGenericAnnotation("rows " + to_string(rowsProcessed));
+    if (nRuns)
+        out.addGenericAnnotation("spilled " + to_string(bytesSpilled) + " bytes in " + to_string(nRuns) + " runs");
     out.addMaterializationAnnotation(values);
     input->print(out);
     out.endOperator();
@@ -5,8 +5,9 @@ ValuesScan::ValuesScan(std::vector<Register*> regs,
         const std::vector<uint64_t> &values,
         double expectedOutputCardinality) : Operator(expectedOutputCardinality),
     regs(regs), values(values) {
+        // The values of the rows one after the other
         if (regs.size() > 0)
-            toBeProcessed = values.size() / regs.size();
+            toBeProcessed = values.size() - values.size() % regs.size();
         else
             toBeProcessed = 0;
         processed = 0;
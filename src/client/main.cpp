@@ -25,10 +25,12 @@
 #include <trident/kb/statistics.h>
 #include <trident/kb/inserter.h>
 #include <trident/kb/updater.h>
+#include <trident/kb/compactor.h>
 #include <trident/kb/kbconfig.h>
 #include <trident/kb/querier.h>
 #include <trident/mining/miner.h>
 #include <trident/tests/common.h>
+#include <trident/utils/tridentutils.h>
 
 #ifdef SERVER
 #include <trident/server/server.h>
@@ -60,7 +62,8 @@ extern bool checkMachineConstraints();
 //Implemented in main_sparql.cpp
 extern void execNativeQuery(ProgramArgs &vm, Querier *q, KB &kb, bool silent);
 extern void callRDF3X(TridentLayer &db, const string &queryFileName, bool explain,
-        bool disableBifocalSampling, bool resultslookup);
+        bool disableBifocalSampling, bool resultslookup, uint64_t timeout,
+        uint64_t memoryLimit);
 
 //Implemented in main_ml.cpp
 extern void launchML(KB &kb, string op, string algo, string paramsLearn,
@@ -183,6 +186,7 @@ void testkb(string kbDir, ProgramArgs &vm) {
         p.graphTransformation = vm["gf"].as<string>();
         p.storeDicts = vm["storedicts"].as<bool>();
         p.flatTree = vm["flatTree"].as<bool>();
+        p.resume = vm["resume"].as<bool>();
 
         loader.load(p);
     }
@@ -243,10 +247,13 @@ void printInfo(KB &kb) {
 }
 
 #ifdef SERVER
-void startServer(KB &kb, int port, int nthreads) {
+void startServer(KB &kb, int port, int nthreads, uint64_t queryTimeout,
+        uint64_t queryMemoryLimit, uint64_t compactionRate) {
     std::unique_ptr<TridentServer> webint;
     webint = std::unique_ptr<TridentServer>(
             new TridentServer(kb, "./../webinterface", nthreads));
+    webint->setQueryLimits(queryTimeout, queryMemoryLimit);
+    webint->setCompactionRate(compactionRate);
     webint->start(port);
     LOG(INFOL) << "Server is launched at 0.0.0.0:" << to_string(port);
     webint->join();
@@ -338,8 +345,14 @@ int main(int argc, const char** argv) {
         std::vector<string> locUpdates;
         KB kb(kbDir.c_str(), true, false, true, config, locUpdates);
         TridentLayer layer(kb);
+        layer.setSortMemoryBudget(vm["sortmem"].as<int64_t>() * 1024 * 1024);
+        layer.setHashMemoryBudget(vm["hashmem"].as<int64_t>() * 1024 * 1024);
+        layer.setParallelism(std::max(vm["parallelism"].as<int>(), 1));
+        const uint64_t timeout = vm["timeout"].as<int64_t>();
+        const uint64_t memoryLimit = vm["memlimit"].as<int64_t>() * 1024 * 1024;
         callRDF3X(layer, vm["query"].as<string>(), vm["explain"].as<bool>(),
-                vm["disbifsampl"].as<bool>(), vm["decodeoutput"].as<bool>());
+                vm["disbifsampl"].as<bool>(), vm["decodeoutput"].as<bool>(),
+                timeout, memoryLimit);
 
         int repeatQuery = vm["repeatQuery"].as<int>();
         ofstream file("/dev/null");
@@ -347,7 +360,8 @@ int main(int argc, const char** argv) {
         cout.rdbuf(file.rdbuf());
         while (repeatQuery > 0 && !vm["explain"].as<bool>()) {
             callRDF3X(layer, vm["query"].as<string>(), false,
-                    vm["disbifsampl"].as<bool>(), vm["decodeoutput"].as<bool>());
+                    vm["disbifsampl"].as<bool>(), vm["decodeoutput"].as<bool>(),
+                    timeout, memoryLimit);
             repeatQuery--;
         }
         cout.rdbuf(strm_buffer);
@@ -446,10 +460,14 @@ int main(int argc, const char** argv) {
         p.timeoutStats = vm["timeoutStats"].as<int>();
         p.remoteLocation = vm["remoteLoc"].as<string>();
         p.limitSpace = vm["limitSpace"].as<int64_t>();
+        if (!vm["maxmem"].empty()) {
+            p.maxMemory = TridentUtils::parseMemorySize(vm["maxmem"].as<string>());
+        }
         p.graphTransformation = vm["gf"].as<string>();
         p.storeDicts = vm["storedicts"].as<bool>();
         p.relsOwnIDs = vm["relsOwnIDs"].as<bool>();
         p.flatTree = vm["flatTree"].as<bool>();
+        p.resume = vm["resume"].as<bool>();
 
         loader.load(p);
 
@@ -459,16 +477,24 @@ int main(int argc, const char** argv) {
         printInfo(kb);
     } else if (cmd == "add") {
         string updatedir = vm["update"].as<string>();
-        Updater up;
+        Updater up(vm["updateThreads"].as<int>());
         up.creatediffupdate(DiffIndex::TypeUpdate::ADDITION_df, kbDir, updatedir);
     } else if (cmd == "rm") {
         string updatedir = vm["update"].as<string>();
-        Updater up;
+        Updater up(vm["updateThreads"].as<int>());
         up.creatediffupdate(DiffIndex::TypeUpdate::DELETE_df, kbDir, updatedir);
     } else if (cmd == "merge") {
         KBConfig config;
         KB kb(kbDir.c_str(), true, false, true, config);
         kb.mergeUpdates();
+    } else if (cmd == "compact") {
+        KBConfig config;
+        KB kb(kbDir.c_str(), true, false, true, config);
+        KBCompactor compactor(kb,
+                TridentUtils::parseMemorySize(vm["iorate"].as<string>()));
+        if (!compactor.run()) {
+            return EXIT_FAILURE;
+        }
     } else if (cmd == "analytics") {
 #ifdef ANALYTICS
         KBConfig config;
@@ -497,7 +523,10 @@ int main(int argc, const char** argv) {
 #ifdef SERVER
         KBConfig config;
         KB kb(kbDir.c_str(), true, false, true, config);
-        startServer(kb, vm["port"].as<int>(), vm["webthreads"].as<int>());
+        startServer(kb, vm["port"].as<int>(), vm["webthreads"].as<int>(),
+                vm["querytimeout"].as<int64_t>(),
+                vm["querymem"].as<int64_t>() * 1024 * 1024,
+                TridentUtils::parseMemorySize(vm["compactrate"].as<string>()));
 #else
         LOG(ERRORL) << "Trident was not compiled with the webserver. Add -DSERVER=1 to cmake";
         return EXIT_FAILURE;
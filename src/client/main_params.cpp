@@ -1,6 +1,7 @@
 #include <trident/kb/kbconfig.h>
 #include <trident/loader.h>
 #include <trident/binarytables/storagestrat.h>
+#include <trident/utils/tridentutils.h>
 
 #include <kognac/progargs.h>
 
@@ -35,6 +36,7 @@ void printHelp(const char *programName, string section,
         cout << "load\t\t\t load the KB." << endl;
         cout << "add\t\t\t add triples to an existing KB." << endl;
         cout << "rm\t\t\t rm triples to an existing KB." << endl;
+        cout << "compact\t\t\t fold the updates into the indices." << endl;
         cout << "lookup\t\t\t lookup for values in the dictionary." << endl;
         cout << "info\t\t\t print some information about the KB." << endl;
         cout << "dump\t\t\t dump the graph on files." << endl;
@@ -82,6 +84,7 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
             && cmd != "add"
             && cmd != "rm"
             && cmd != "merge"
+            && cmd != "compact"
 #ifdef ANALYTICS
             && cmd != "analytics"
 #endif
@@ -196,6 +199,17 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
                         "The number of dictionary partitions must be at least 1");
                 return false;
             }
+            if (!vm["maxmem"].empty()) {
+                try {
+                    if (TridentUtils::parseMemorySize(vm["maxmem"].as<string>()) < 0) {
+                        printErrorMsg("The parameter 'maxmem' cannot be negative");
+                        return false;
+                    }
+                } catch (int e) {
+                    printErrorMsg("The parameter 'maxmem' should be a number followed by an optional unit (K, M, G, T)");
+                    return false;
+                }
+            }
             if (!vm["gf"].empty()) {
                 string v = vm["gf"].as<string>();
                 if (v != "" && v != "unlabeled" && v != "undirected") {
@@ -217,6 +231,31 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
                 printErrorMsg(msgerror.c_str());
                 return false;
             }
+            if (vm["updateThreads"].as<int>() < 1) {
+                printErrorMsg(
+                        "The number of threads to use must be at least 1");
+                return false;
+            }
+        } else if (cmd == "compact") {
+            try {
+                if (TridentUtils::parseMemorySize(vm["iorate"].as<string>()) < 0) {
+                    printErrorMsg("The parameter 'iorate' cannot be negative");
+                    return false;
+                }
+            } catch (int e) {
+                printErrorMsg("The parameter 'iorate' should be a number followed by an optional unit (K, M, G, T)");
+                return false;
+            }
+        } else if (cmd == "server") {
+            try {
+                if (TridentUtils::parseMemorySize(vm["compactrate"].as<string>()) < 0) {
+                    printErrorMsg("The parameter 'compactrate' cannot be negative");
+                    return false;
+                }
+            } catch (int e) {
+                printErrorMsg("The parameter 'compactrate' should be a number followed by an optional unit (K, M, G, T)");
+                return false;
+            }
         } else if (cmd == "analytics") {
             if (!vm.count("op")) {
                 printErrorMsg(
@@ -267,6 +306,16 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Retrieve the original values of the results of query. Default is true", false);
     query_options.add<bool>("", "disbifsampl", false,
             "Disable bifocal sampling (accurate but expensive). Default is false", false);
+    query_options.add<int64_t>("", "sortmem", 1024,
+            "Max MB of memory used by ORDER BY before it spills to disk. 0 means no limit. Default is 1024", false);
+    query_options.add<int64_t>("", "hashmem", 1024,
+            "Max MB of memory used by the table of a hash join before it spills to disk. 0 means no limit. Default is 1024", false);
+    query_options.add<int>("", "parallelism", 1,
+            "Number of threads that execute the large scans and joins of a query. Requires MT. Default is 1", false);
+    query_options.add<int64_t>("", "timeout", 0,
+            "Max milliseconds of the execution of a query, also for <query_native>. 0 means no limit. Default is 0", false);
+    query_options.add<int64_t>("", "memlimit", 0,
+            "Max MB of memory used by the operators of a query. 0 means no limit. Default is 0", false);
 
     /***** LOAD *****/
     ParamsLoad p;
@@ -314,9 +363,11 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Default value is 128.", false);
     load_options.add<string>("","remoteLoc", p.remoteLocation, "", false);
     load_options.add<int64_t>("","limitSpace", p.limitSpace, "", false);
+    load_options.add<string>("","maxmem", "", "Hard limit on the memory used while sorting and inserting the data (e.g., '512M' or '32G'). If the data does not fit, the loader spills smaller sorted runs on disk. Default is no limit", false);
     load_options.add<string>("","gf", p.graphTransformation, "Possible graph transformations. 'unlabeled' removes the edge labels (but keeps it directed), 'undirected' makes the graph undirected and without edge labels", false);
     load_options.add<bool>("","relsOwnIDs", p.relsOwnIDs, "Should I give independent IDs to the terms that appear as predicates? (Useful for ML learning models). Default is DISABLED", false);
     load_options.add<bool>("","flatTree", p.flatTree, "Create a flat representation of the nodes' tree. This parameter is forced to tree if the graph is unlabeled. Default is DISABLED", false);
+    load_options.add<bool>("","resume", p.resume, "Record the completed phases in the temporary directory and, if a previous load with the same input was interrupted, skip the phases that are already completed. Requires a temporary directory different from the output directory. Default is DISABLED", false);
 
     /***** LOOKUP *****/
     ProgramArgs::GroupArgs& lookup_options = *vm.newGroup("Options for <lookup>");
@@ -332,11 +383,19 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     /***** UPDATES *****/
     ProgramArgs::GroupArgs& update_options = *vm.newGroup("Options for <add> or <rm>");
     update_options.add<string>("", "update", "", "Path to the file/dir that contains the triples to update", false);
+    update_options.add<int>("", "updateThreads", nHardwareThreads, "Sets the number of threads used to parse, encode and sort the update. Default is the number of hardware threads", false);
+
+    /***** COMPACTION *****/
+    ProgramArgs::GroupArgs& compact_options = *vm.newGroup("Options for <compact>");
+    compact_options.add<string>("", "iorate", "0", "Maximum number of bytes per second rewritten by the compaction (e.g., '50M'). Default is no limit", false);
 
     /***** SERVER *****/
     ProgramArgs::GroupArgs& server_options = *vm.newGroup("Options for <server>");
     server_options.add<int>("", "port", 8080, "Port to listen to", false);
     server_options.add<int>("", "webthreads", 1, "N. of threads for the webserver", false);
+    server_options.add<int64_t>("", "querytimeout", 0, "Max milliseconds of a SPARQL query. A request can ask for less with the parameter 'timeout'. 0 means no limit. Default is 0", false);
+    server_options.add<int64_t>("", "querymem", 0, "Max MB of memory used by the operators of a SPARQL query. A request can ask for less with the parameter 'memory'. 0 means no limit. Default is 0", false);
+    server_options.add<string>("", "compactrate", "0", "Maximum number of bytes per second rewritten by the compactions started with the request /compact (e.g., '50M'). Default is no limit", false);
 
     /***** LEARN/PREDICT *****/
 #ifdef ML
@@ -411,6 +470,7 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     sections.insert(make_pair("test",&test_options));
     sections.insert(make_pair("add",&update_options));
     sections.insert(make_pair("rm",&update_options));
+    sections.insert(make_pair("compact",&compact_options));
 #ifdef ANALYTICS
     sections.insert(make_pair("analytics",&ana_options));
 #endif
@@ -27,6 +27,7 @@
 #include <trident/model/table.h>
 #include <layers/TridentLayer.hpp>
 #include <infra/util/Type.hpp>
+#include <infra/util/SemiJoinFilter.hpp>
 #include <string>
 #include <map>
 #include <cmath>
@@ -313,10 +314,38 @@ double TridentLayer::getScanCost(DBLayer::DataOrder order,
         return std::numeric_limits<double>::max();
     }
 
-    if (value1C == UINT64_MAX)
-        return kb.getNTerms();
-    else
+    if (value1C == UINT64_MAX) {
+        //Scan all the distinct first terms of the order
+        int idx;
+        switch (order) {
+            case DBLayer::DataOrder::Order_No_Order_SPO:
+            case DBLayer::DataOrder::Order_Subject_Predicate_Object:
+                idx = IDX_SPO;
+                break;
+            case DBLayer::DataOrder::Order_No_Order_SOP:
+            case DBLayer::DataOrder::Order_Subject_Object_Predicate:
+                idx = IDX_SOP;
+                break;
+            case DBLayer::DataOrder::Order_No_Order_PSO:
+            case DBLayer::DataOrder::Order_Predicate_Subject_Object:
+                idx = IDX_PSO;
+                break;
+            case DBLayer::DataOrder::Order_No_Order_POS:
+            case DBLayer::DataOrder::Order_Predicate_Object_Subject:
+                idx = IDX_POS;
+                break;
+            case DBLayer::DataOrder::Order_No_Order_OSP:
+            case DBLayer::DataOrder::Order_Object_Subject_Predicate:
+                idx = IDX_OSP;
+                break;
+            default:
+                idx = IDX_OPS;
+                break;
+        }
+        return q->getNKeys(idx);
+    } else {
         return 1; //It's the cost of a lookup on the tree
+    }
 }
 
 bool same(TupleTable *t, const size_t idx, const uint8_t *j, const uint8_t sj) {
@@ -730,46 +759,95 @@ uint64_t TridentLayer::getCardinality(uint64_t c1,
 }
 
 uint64_t TridentLayer::getCardinality() {
-    return kb.getSize();
+    //Includes the updates
+    return q->getInputSize();
 }
 
-std::unique_ptr<DBLayer::Scan> TridentLayer::getScan(
-        const DBLayer::DataOrder order,
-        const DBLayer::Aggr_t a,
-        Hint * hint) {
+bool TridentLayer::hasUpdates() {
+    return q->hasUpdates();
+}
 
-    //Must convert the DataOrder in a IDX_flag
+//Converts a DataOrder in a IDX_flag
+static int getPermutation(const DBLayer::DataOrder order) {
     int perm = 0;
     switch (order) {
-        case Order_No_Order_SOP:
-        case Order_Subject_Object_Predicate:
+        case DBLayer::Order_No_Order_SOP:
+        case DBLayer::Order_Subject_Object_Predicate:
             perm = IDX_SOP;
             break;
-        case Order_No_Order_SPO:
-        case Order_Subject_Predicate_Object:
+        case DBLayer::Order_No_Order_SPO:
+        case DBLayer::Order_Subject_Predicate_Object:
             perm = IDX_SPO;
             break;
-        case Order_No_Order_POS:
-        case Order_Predicate_Object_Subject:
+        case DBLayer::Order_No_Order_POS:
+        case DBLayer::Order_Predicate_Object_Subject:
             perm = IDX_POS;
             break;
-        case Order_No_Order_PSO:
-        case Order_Predicate_Subject_Object:
+        case DBLayer::Order_No_Order_PSO:
+        case DBLayer::Order_Predicate_Subject_Object:
             perm = IDX_PSO;
             break;
-        case Order_No_Order_OPS:
-        case Order_Object_Predicate_Subject:
+        case DBLayer::Order_No_Order_OPS:
+        case DBLayer::Order_Object_Predicate_Subject:
             perm = IDX_OPS;
             break;
-        case Order_No_Order_OSP:
-        case Order_Object_Subject_Predicate:
+        case DBLayer::Order_No_Order_OSP:
+        case DBLayer::Order_Object_Subject_Predicate:
             perm = IDX_OSP;
             break;
     }
-    std::unique_ptr<DBLayer::Scan> s(new TridentScan(perm, a, q.get(), hint));
+    return perm;
+}
+
+std::unique_ptr<DBLayer::Scan> TridentLayer::getScan(
+        const DBLayer::DataOrder order,
+        const DBLayer::Aggr_t a,
+        Hint * hint) {
+    std::unique_ptr<DBLayer::Scan> s(new TridentScan(getPermutation(order), a,
+                q, hint));
     return s;
 }
 
+bool TridentLayer::hasPermutation(const DBLayer::DataOrder order) {
+    //With three indices, only SPO, POS and OPS are stored
+    const int perm = getPermutation(order);
+    return nindices != 3 || perm == IDX_SPO || perm == IDX_POS ||
+        perm == IDX_OPS;
+}
+
+std::unique_ptr<DBLayer> TridentLayer::createWorker() {
+    std::unique_ptr<TridentLayer> worker = createSession();
+    //The operators of the workers are built in the arena of this layer
+    worker->disableArena();
+    return std::unique_ptr<DBLayer>(worker.release());
+}
+
+std::unique_ptr<TridentLayer> TridentLayer::createSession() {
+    std::unique_ptr<TridentLayer> session(new TridentLayer(kb,
+                kb.getQuerierPool().acquire()));
+    session->bifSampl = bifSampl;
+    session->sortMemoryBudget = sortMemoryBudget;
+    session->hashMemoryBudget = hashMemoryBudget;
+    session->multiwayJoins = multiwayJoins;
+    session->parallelism = parallelism;
+    if (!arena) {
+        session->disableArena();
+    }
+    return session;
+}
+
+std::unique_ptr<DBLayer::Cursor> TridentLayer::getCursor(
+        const DBLayer::DataOrder order,
+        const unsigned prefixSize) {
+    if (prefixSize > 2) {
+        LOG(ERRORL) << "Cursors can have at most two bound values";
+        throw 10;
+    }
+    std::unique_ptr<DBLayer::Cursor> c(new TridentCursor(
+                getPermutation(order), prefixSize, q));
+    return c;
+}
+
 std::shared_ptr<TupleTable> TridentLayer::query(Querier * querier,
         const bool cs1,
         const uint64_t s1,
@@ -1016,7 +1094,9 @@ bool TridentScan::next() {
     if (itr->hasNext()) {
         itr->next();
         //cerr <<  "Type=" << itr->getTypeItr() << " " << itr->getKey() << " " << itr->getValue1() << endl;
-        return true;
+        if (rangeTo != UINT64_MAX && !checkRange())
+            return false;
+        return keyFilter == NULL || skipKeys();
     } else {
         q->releaseItr(itr);
         itr = NULL;
@@ -1024,22 +1104,132 @@ bool TridentScan::next() {
     }
 }
 
+bool TridentScan::checkRange() {
+    if (itr->getKey() < rangeFrom) {
+        itr->gotoKey(rangeFrom);
+        if (!itr->hasNext()) {
+            q->releaseItr(itr);
+            itr = NULL;
+            return false;
+        }
+        itr->next();
+    }
+    if (itr->getKey() >= rangeTo) {
+        q->releaseItr(itr);
+        itr = NULL;
+        return false;
+    }
+    return true;
+}
+
+void TridentScan::prepareKeys(unsigned nprefix, uint64_t prefix1,
+        uint64_t prefix2) {
+    //The positions (1 - subject, 2 - predicate, 4 - object) of the columns
+    //of each permutation
+    static const int positions[6][3] = {
+        {1, 2, 4}, //IDX_SPO
+        {4, 2, 1}, //IDX_OPS
+        {2, 4, 1}, //IDX_POS
+        {1, 4, 2}, //IDX_SOP
+        {4, 1, 2}, //IDX_OSP
+        {2, 1, 4}, //IDX_PSO
+    };
+    this->nprefix = nprefix;
+    this->prefix1 = prefix1;
+    this->prefix2 = prefix2;
+
+    //The hash join publishes its keys only after the scan is created
+    keyFilter = NULL;
+    int bitset = 0;
+    const SemiJoinFilter *keys = hint ? hint->getKeys(&bitset) : NULL;
+    if (keys == NULL || bitset == 0)
+        return;
+    const unsigned ncolumns = a == DBLayer::AGGR_NO ? 3 :
+        (a == DBLayer::AGGR_SKIP_LAST ? 2 : 1);
+    for (unsigned i = nprefix; i < ncolumns; ++i) {
+        if (positions[perm][i] & bitset) {
+            keyFilter = keys;
+            keyColumn = i + 1;
+            return;
+        }
+    }
+}
+
+bool TridentScan::skipKeys() {
+    //Skip the rows whose key cannot join
+    while (true) {
+        //Past the bound prefix, the caller stops the scan
+        if (nprefix > 0 && itr->getKey() != prefix1)
+            return true;
+        if (nprefix > 1 && itr->getValue1() != prefix2)
+            return true;
+        const uint64_t key = keyColumn == 1 ? itr->getKey() :
+            (keyColumn == 2 ? itr->getValue1() : itr->getValue2());
+        if (keyFilter->contains(key))
+            return true;
+
+        //If the keys are the first column, jump to the next key that can
+        //join (the term list has a single row per key anyway)
+        if (keyColumn == 1 && (keyFilter->isExact() ||
+                    a != DBLayer::AGGR_SKIP_2LAST)) {
+            const uint64_t target = keyFilter->isExact() ?
+                keyFilter->seek(key) : key + 1;
+            if (target == UINT64_MAX || target >= rangeTo) {
+                q->releaseItr(itr);
+                itr = NULL;
+                return false;
+            }
+            itr->gotoKey(target);
+        } else if (keyColumn == 2 && (keyFilter->isExact() ||
+                    a == DBLayer::AGGR_NO)) {
+            //If the keys are the second column, jump inside the rows of the
+            //current first value, or to the next first value if no key is left
+            const uint64_t target = keyFilter->isExact() ?
+                keyFilter->seek(key) : key + 1;
+            if (target != UINT64_MAX) {
+                itr->moveto(target, 0);
+            } else if (nprefix == 0 && itr->getKey() + 1 < rangeTo) {
+                itr->gotoKey(itr->getKey() + 1);
+            } else {
+                q->releaseItr(itr);
+                itr = NULL;
+                return false;
+            }
+        }
+        if (!itr->hasNext()) {
+            q->releaseItr(itr);
+            itr = NULL;
+            return false;
+        }
+        itr->next();
+        if (rangeTo != UINT64_MAX && !checkRange())
+            return false;
+    }
+}
+
 bool TridentScan::first() {
+    //The scan is restarted for every morsel
+    if (itr != NULL) {
+        q->releaseItr(itr);
+        itr = NULL;
+    }
+    prepareKeys(0, 0, 0);
     if (a == DBLayer::AGGR_SKIP_2LAST) {
         itr = q->getTermList(perm);
-        bool resp = itr->hasNext();
-        if (resp)
-            itr->next();
-        return resp;
     } else {
         itr = q->getPermuted(perm, -1, -1, -1, false);
         if (a == DBLayer::AGGR_SKIP_LAST)
             itr->ignoreSecondColumn();
-        bool resp = itr->hasNext();
-        if (resp)
-            itr->next();
-        return resp;
     }
+    if (!itr->hasNext()) {
+        q->releaseItr(itr);
+        itr = NULL;
+        return false;
+    }
+    itr->next();
+    if ((rangeFrom > 0 || rangeTo != UINT64_MAX) && !checkRange())
+        return false;
+    return keyFilter == NULL || skipKeys();
 }
 
 bool TridentScan::first(uint64_t el, bool constrained) {
@@ -1050,10 +1240,11 @@ bool TridentScan::first(uint64_t el, bool constrained) {
         itr = q->getPermuted(perm, el, -1, -1, false);
     else
         itr = q->getPermuted(perm, -1, -1, -1, false);
+    prepareKeys(constrained ? 1 : 0, el, 0);
 
     if (itr->hasNext()) {
         itr->next();
-        return true;
+        return keyFilter == NULL || skipKeys();
     } else {
         q->releaseItr(itr);
         itr = NULL;
@@ -1074,13 +1265,14 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2, bool cons
     } else {
         itr = q->getPermuted(perm, -1, -1, -1, false);
     }
+    prepareKeys(constrained1 ? (constrained2 ? 2 : 1) : 0, el1, el2);
 
     if (a == DBLayer::Aggr_t::AGGR_SKIP_LAST) {
         itr->ignoreSecondColumn();
     }
     if (itr->hasNext()) {
         itr->next();
-        return true;
+        return keyFilter == NULL || skipKeys();
     } else {
         q->releaseItr(itr);
         itr = NULL;
@@ -1107,10 +1299,13 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2,
     } else {
         itr = q->getPermuted(perm, -1, -1, -1, false);
     }
+    prepareKeys(constrained1 ? (constrained2 ? (constrained3 ? 3 : 2) : 1) : 0,
+            el1, el2);
 
     bool resp = itr->hasNext();
     if (resp) {
         itr->next();
+        resp = keyFilter == NULL || skipKeys();
     } else {
         q->releaseItr(itr);
         itr = NULL;
@@ -1124,3 +1319,90 @@ TridentScan::~TridentScan() {
         itr = NULL;
     }
 }
+
+//-----------------------------------------------------------------------------
+
+bool TridentCursor::read() {
+    if (itr->hasNext()) {
+        itr->next();
+        //The iterators are not always restricted to the prefix
+        switch (prefixSize) {
+            case 0:
+                value = itr->getKey();
+                return true;
+            case 1:
+                if (itr->getKey() == prefix0) {
+                    value = itr->getValue1();
+                    return true;
+                }
+                break;
+            default:
+                if (itr->getKey() == prefix0 && itr->getValue1() == prefix1) {
+                    value = itr->getValue2();
+                    return true;
+                }
+                break;
+        }
+    }
+    q->releaseItr(itr);
+    itr = NULL;
+    return false;
+}
+
+bool TridentCursor::open(const uint64_t *prefix) {
+    if (itr != NULL) {
+        q->releaseItr(itr);
+        itr = NULL;
+    }
+    switch (prefixSize) {
+        case 0:
+            itr = q->getPermuted(perm, -1, -1, -1, false);
+            break;
+        case 1:
+            prefix0 = prefix[0];
+            itr = q->getPermuted(perm, prefix0, -1, -1, false);
+            itr->ignoreSecondColumn();
+            break;
+        default:
+            prefix0 = prefix[0];
+            prefix1 = prefix[1];
+            itr = q->getPermuted(perm, prefix0, prefix1, -1, false);
+            break;
+    }
+    return read();
+}
+
+bool TridentCursor::next() {
+    if (itr == NULL)
+        return false;
+    //The scan over the keys returns all the triples of a key
+    if (prefixSize == 0)
+        return seek(value + 1);
+    return read();
+}
+
+bool TridentCursor::seek(uint64_t target) {
+    if (itr == NULL)
+        return false;
+    if (target <= value)
+        return true;
+    switch (prefixSize) {
+        case 0:
+            itr->gotoKey(target);
+            break;
+        case 1:
+            itr->moveto(target, 0);
+            break;
+        default:
+            itr->moveto(prefix1, target);
+            break;
+    }
+    return read();
+}
+
+TridentCursor::~TridentCursor() {
+    if (itr != NULL) {
+        q->releaseItr(itr);
+        itr = NULL;
+    }
+}
@@ -65,7 +65,6 @@ static int db_init(trident_Db *self, PyObject *args, PyObject *kwds) {
         std::vector<string> locUpdates;
         self->kb = new KB(path, true, false, true, config, locUpdates);
         self->q = self->kb->query();
-        self->db = std::unique_ptr<TridentLayer>(new TridentLayer(*(self->kb)));
     }
     return 0;
 }
@@ -855,25 +854,33 @@ static PyObject * db_join_e2e(PyObject *self, PyObject *args) {
     return obj;
 }
 
-static PyObject * db_sparql(PyObject *self, PyObject *args) {
-    const char *query = NULL;
-    if (!PyArg_ParseTuple(args, "s", &query))
-        return NULL;
+static PlanCache *getPlanCache(trident_Db *self) {
+    if (!self->plancache)
+        self->plancache = std::unique_ptr<PlanCache>(new PlanCache());
+    return self->plancache.get();
+}
 
-    KB *kb = ((trident_Db*)self)->kb;
+//Executes a query and returns the results in JSON
+static PyObject *runSPARQLQuery(trident_Db *self, const std::string &query) {
+    KB *kb = self->kb;
+    //Every query reads the KB with its own querier, taken from the pool.
+    //Without MT, the pool hands out one querier at a time
+    TridentLayer db(*kb, kb->getQuerierPool().acquire());
     JSON vars;
     JSON bindings;
     JSON stats;
     SPARQLUtils::execSPARQLQuery(
-            std::string(query),
+            query,
             false,
             kb->getNTerms(),
-            *((trident_Db*)self)->db.get(),
+            db,
             false,
             true,
             &vars,
             &bindings,
-            &stats);
+            &stats,
+            NULL,
+            getPlanCache(self));
     JSON head;
     head.add_child("vars", vars);
     JSON pt;
@@ -889,7 +896,76 @@ static PyObject * db_sparql(PyObject *self, PyObject *args) {
     return PyUnicode_FromStringAndSize(out.c_str(), out.size());
 }
 
+static PyObject * db_sparql(PyObject *self, PyObject *args) {
+    const char *query = NULL;
+    if (!PyArg_ParseTuple(args, "s", &query))
+        return NULL;
+    return runSPARQLQuery((trident_Db*)self, std::string(query));
+}
+
+static PyObject * db_prepare(PyObject *self, PyObject *args) {
+    const char *query = NULL;
+    if (!PyArg_ParseTuple(args, "s", &query))
+        return NULL;
+    try {
+        uint64_t id = getPlanCache((trident_Db*)self)->prepare(
+                std::string(query));
+        return PyLong_FromUnsignedLongLong(id);
+    } catch (const SPARQLParser::ParserException &e) {
+        std::string err = "parse error: " + e.message;
+        PyErr_SetString(PyExc_BaseException, err.c_str());
+        return NULL;
+    }
+}
+
+static PyObject * db_execute(PyObject *self, PyObject *args) {
+    unsigned long long id;
+    PyObject *params = NULL;
+    if (!PyArg_ParseTuple(args, "KO", &id, &params))
+        return NULL;
+    std::shared_ptr<const PreparedQuery> prepared =
+        getPlanCache((trident_Db*)self)->getPrepared(id);
+    if (!prepared) {
+        PyErr_SetString(PyExc_BaseException, "Unknown prepared query");
+        return NULL;
+    }
+    if (!PySequence_Check(params)) {
+        PyErr_SetString(PyExc_BaseException,
+                "The parameters must be a list of terms");
+        return NULL;
+    }
+    std::vector<std::string> values;
+    for (Py_ssize_t i = 0; i < PySequence_Size(params); ++i) {
+        PyObject *item = PySequence_GetItem(params, i);
+        const char *value = item ? PyUnicode_AsUTF8(item) : NULL;
+        if (value)
+            values.push_back(std::string(value));
+        Py_XDECREF(item);
+        if (!value)
+            return NULL;
+    }
+    std::string query;
+    if (!prepared->bind(values, query)) {
+        std::string err = "The query has " + std::to_string(
+                prepared->getNParameters()) +
+            " parameters and each must be a single term";
+        PyErr_SetString(PyExc_BaseException, err.c_str());
+        return NULL;
+    }
+    return runSPARQLQuery((trident_Db*)self, query);
+}
+
+static PyObject * db_unprepare(PyObject *self, PyObject *args) {
+    unsigned long long id;
+    if (!PyArg_ParseTuple(args, "K", &id))
+        return NULL;
+    getPlanCache((trident_Db*)self)->unprepare(id);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static void db_dealloc(trident_Db* self) {
+    self->plancache.reset();
     if (self->q)
         delete self->q;
     if (self->kb) {
@@ -904,6 +980,9 @@ static void db_dealloc(trident_Db* self) {
 
 static PyMethodDef Db_methods[] = {
     {"sparql", db_sparql, METH_VARARGS, "Execute SPARQL query." },
+    {"prepare", db_prepare, METH_VARARGS, "Prepare a SPARQL query. The constants of its triple patterns become parameters. Returns the id of the query." },
+    {"execute", db_execute, METH_VARARGS, "Execute a prepared query with a list of new constants (e.g., <iri> or \"literal\"), one for each parameter." },
+    {"unprepare", db_unprepare, METH_VARARGS, "Forget a prepared query." },
     {"s", db_alls, METH_VARARGS, "Get all subjects given the p and o. Returns a Python list." },
     {"s_itr", db_alls_fast, METH_VARARGS, "Get all subjects given the p and o. Returns an itr." },
     {"s_aggr_fromo", db_alls_aggr, METH_VARARGS, "Get all subjects given o" },
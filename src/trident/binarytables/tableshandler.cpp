@@ -207,6 +207,10 @@ int64_t TableStorage::getNTriplesInserted() {
     return nTriplesInserted;
 }
 
+void TableStorage::setNTriplesInserted(int64_t n) {
+    nTriplesInserted = n;
+}
+
 void TableStorage::stopAppend() {
     insertHandler->stopTableAppend();
     lastCreatedFile = insertHandler->getCurrentFile();
@@ -21,227 +21,180 @@
 
 
 #include <trident/iterators/cacheitr.h>
-#include <trident/kb/querier.h>
-#include <trident/kb/cacheidx.h>
-
-void CacheItr::init(Querier *q, const uint64_t estimatedSize, CacheIdx *cache,
-                    int64_t c1, int64_t c2) {
-    this->cache = cache;
-    this->estimatedSize = estimatedSize;
-    this->q = q;
-    constraint1 = c1;
-    constraint2 = c2;
-
-    v1 = 0;
-    v2 = 0;
-
-    idxEndGroup = 0;
-    currentIdx = 0;
-    groupSet = false;
-    newPairs.clear();
-    p = NULL;
-
-    newBlocks.clear();
-    startDelta = 0;
-    lastDeltaValue = -2;
-
-    //Initially the iterator is set to return some triples since there must
-    //be some. The first time that the iterator is moved to a location then
-    //the flags will be set accordingly.
-    hasNextChecked = true;
-    n = true;
-
-    //Get existing pairs from cache
-    std::pair<std::vector<std::pair<uint64_t, uint64_t>>*, std::vector<CacheBlock>*> pair =
-                cache->getIndex(getKey());
-    existingPairs = pair.first;
-    existingBlocks = pair.second;
-}
 
-int64_t CacheItr::getValue1() {
-    return v1;
-}
-
-int64_t CacheItr::getValue2() {
-    return v2;
-}
+#include <algorithm>
 
-bool CacheItr::hasNext() {
-    if (!hasNextChecked) {
-        n = true;
-        if (groupSet) {
-            if (currentIdx >= idxEndGroup || p->at(currentIdx).first != v1) {
-                n = false;
-            } else if (constraint2 != -1 && p->at(currentIdx).second != constraint2) {
-                n = false;
-            }
-        } else {
-            n = false;
+void CacheItr::advance(Cursor &c) {
+    if (c.left == 0) {
+        if (c.group == pairs->getNGroups()) {
+            c.valid = false;
+            return;
         }
-        hasNextChecked = true;
+        c.first += CompactPairs::readVarint(c.ptr);
+        c.left = CompactPairs::readVarint(c.ptr);
+        c.second = 0;
+        c.group++;
     }
-    assert(groupSet || !n);
-    return n;
-}
-
-void CacheItr::next() {
-    assert(groupSet);
-    v2 = p->at(currentIdx).second;
-    currentIdx++;
-    hasNextChecked = false;
+    c.second += CompactPairs::readVarint(c.ptr);
+    c.left--;
+    c.valid = true;
 }
 
-void CacheItr::clear() {
-    LOG(DEBUGL) << "Collected " << newPairs.size() << " pairs and " << newBlocks.size() << " blocks. All pairs are " << estimatedSize;
-
-    if (newPairs.size() > 0) {
-        if (startDelta != newPairs.size()) {
-            CacheBlock b;
-            b.startKey = newPairs[startDelta].first;
-            b.endKey = newPairs[newPairs.size() - 1].first;
-            b.startArray = startDelta;
-            b.endArray = newPairs.size();
-            newBlocks.push_back(b);
+void CacheItr::seek(Cursor &c, const uint64_t c1) {
+    if (!c.valid || c.first >= c1) {
+        return;
+    }
+    //Can the skip list bring us closer?
+    const std::vector<CompactPairs::SkipEntry> &skips = pairs->getSkips();
+    auto itr = std::upper_bound(skips.begin(), skips.end(), c1,
+            [](const uint64_t v, const CompactPairs::SkipEntry &e) {
+            return v < e.first;
+            });
+    if (itr != skips.begin() && (itr - 1)->group >= c.group) {
+        itr--;
+        c.ptr = pairs->getData() + itr->offset;
+        c.first = itr->base;
+        c.group = itr->group;
+    } else {
+        //Skip the rest of the current group
+        for (uint64_t i = 0; i < c.left; ++i) {
+            CompactPairs::skipVarint(c.ptr);
         }
-
-        std::sort(newBlocks.begin(), newBlocks.end());
-        //Remove the duplicates
-        uint64_t lastKey = 0;
-        uint64_t lastEndKey = 0;
-        bool first = true;
-        std::vector<CacheBlock> *cacheBlock = new std::vector<CacheBlock>();
-        for (std::vector<CacheBlock>::iterator itr = newBlocks.begin();
-                itr != newBlocks.end(); ++itr) {
-            if (first) {
-                cacheBlock->push_back(*itr);
-                first = false;
-                lastKey = itr->startKey;
-                lastEndKey = itr->endKey;
-            } else if (itr->startKey != lastKey) {
-                if (itr->startKey <= lastEndKey) {
-                    if (itr->endKey <= lastEndKey) {
-                        //Continue
-                        continue;
-                    } else {
-                        //Change the key, and move forward
-                        itr->startArray += lastEndKey - itr->startKey + 1;
-                        itr->startKey = lastEndKey + 1;
-                    }
-                }
-                cacheBlock->push_back(*itr);
-                lastKey = itr->startKey;
-                lastEndKey = itr->endKey;
-            }
+    }
+    c.left = 0;
+
+    //Skip whole groups until the right one
+    while (c.group < pairs->getNGroups()) {
+        const uint64_t first = c.first + CompactPairs::readVarint(c.ptr);
+        const uint64_t count = CompactPairs::readVarint(c.ptr);
+        c.first = first;
+        c.group++;
+        if (first >= c1) {
+            c.left = count;
+            c.second = 0;
+            advance(c);
+            return;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            CompactPairs::skipVarint(c.ptr);
         }
-
-        std::vector<std::pair<uint64_t, uint64_t>> *cachePairs =
-                new std::vector<std::pair<uint64_t, uint64_t>>();
-        newPairs.swap(*cachePairs);
-        cache->storeIdx(getKey(), cacheBlock, cachePairs);
-        newPairs.clear();
-        newBlocks.clear();
     }
+    c.valid = false;
 }
 
-CacheBlock *CacheItr::searchBlock(std::vector<CacheBlock> *blocks,
-                                  const uint64_t v) {
-    if (blocks == NULL)
-        return NULL;
-
-    CacheBlock b;
-    b.startKey = v;
-    std::vector<CacheBlock>::iterator itr = std::lower_bound(blocks->begin(),
-                                            blocks->end(), b);
-    if (itr != blocks->begin() || v == itr->startKey) {
-        if (v != itr->startKey)
-            itr--;
-        if (v <= itr->endKey) {
-            return &(*itr);
+void CacheItr::init(std::shared_ptr<const CompactPairs> pairs, int64_t c1,
+        int64_t c2) {
+    this->pairs = pairs;
+    constraint1 = c1;
+    constraint2 = c2;
+    countElems = 0;
+    ignSecondColumn = false;
+    v1 = v2 = -1;
+
+    cur.ptr = pairs->getData();
+    cur.group = cur.left = 0;
+    cur.first = cur.second = 0;
+    advance(cur);
+
+    if (c1 != -1) {
+        seek(cur, c1);
+        if (cur.valid && cur.first == (uint64_t) c1) {
+            if (c2 != -1) {
+                while (cur.valid && cur.first == (uint64_t) c1 &&
+                        cur.second < (uint64_t) c2) {
+                    advance(cur);
+                }
+                n = cur.valid && cur.first == (uint64_t) c1 &&
+                    cur.second == (uint64_t) c2;
+            } else {
+                n = true;
+            }
         } else {
-            return NULL;
+            n = false;
         }
     } else {
-        return NULL;
+        n = cur.valid;
     }
+    hasNextChecked = true;
+    prev = markCur = cur;
 }
 
-bool CacheItr::gotoFirstTerm(int64_t c1) {
-    //does c1 exist in the existing blocks? For now, assume it does not
-    CacheBlock *block = searchBlock(existingBlocks, c1);
-    if (block != NULL) {
-        p = existingPairs;
-        currentIdx = block->startArray + c1 - block->startKey;
-        idxEndGroup = block->endArray;
-        assert(currentIdx < idxEndGroup);
-        while (currentIdx < idxEndGroup && p->at(currentIdx).first < c1) {
-            ++currentIdx;
-        }
-        v1 = c1;
-        v2 = p->at(currentIdx).second;
-        hasNextChecked = true;
-        n = p->at(currentIdx).first == c1;
-        groupSet = true;
-        return v1 == c1;
-    }
-
-    if (c1 != lastDeltaValue + 1 && newPairs.size() != startDelta) {
-        //Start a new delta...
-        CacheBlock b;
-        b.startKey = newPairs[startDelta].first;
-        b.endKey = newPairs[newPairs.size() - 1].first;
-        b.startArray = startDelta;
-        b.endArray = newPairs.size();
-        newBlocks.push_back(b);
-        startDelta = newPairs.size();
+bool CacheItr::hasNext() {
+    if (hasNextChecked) {
+        return n;
     }
-
-    currentIdx = newPairs.size();
-    PairItr *subitr = q->get(IDX_SPO, c1, getKey(), -1);
-    while (subitr->hasNext()) {
-        subitr->next();
-        newPairs.push_back(std::make_pair(c1, subitr->getValue2()));
+    if (ignSecondColumn && v1 != -1) {
+        //Move to the next first term
+        while (cur.valid && cur.first == (uint64_t) v1) {
+            advance(cur);
+        }
     }
-    q->releaseItr(subitr);
-
-    if (newPairs.size() != currentIdx) {
-        p = &newPairs;
-        lastDeltaValue = c1;
-        v1 = c1;
-        v2 = newPairs.at(currentIdx).second;
-        n = true;
-        groupSet = true;
-        idxEndGroup = newPairs.size();
+    if (constraint1 == -1) {
+        n = cur.valid;
     } else {
-        n = false;
-        groupSet = false;
+        n = cur.valid && cur.first == (uint64_t) constraint1 &&
+            (constraint2 == -1 || cur.second == (uint64_t) constraint2);
     }
     hasNextChecked = true;
-    return v1 == c1;
+    return n;
 }
 
-void CacheItr::gotoSecondTerm(int64_t c2) {
-    while (currentIdx < idxEndGroup && v1 == p->at(currentIdx).first &&
-            p->at(currentIdx).second < c2) {
-        currentIdx++;
+void CacheItr::next() {
+    prev = cur;
+    v1 = (int64_t) cur.first;
+    v2 = (int64_t) cur.second;
+    advance(cur);
+    hasNextChecked = false;
+    countElems = 0;
+}
+
+int64_t CacheItr::getCount() {
+    if (!ignSecondColumn) {
+        throw 10;
     }
-    if (currentIdx < idxEndGroup && v1 == p->at(currentIdx).first &&
-            p->at(currentIdx).second == c2)
-        n = true;
-    else
-        n = false;
-    hasNextChecked = true;
+    if (countElems == 0) {
+        countElems = 1;
+        while (cur.valid && cur.first == (uint64_t) v1) {
+            advance(cur);
+            countElems++;
+        }
+    }
+    return countElems;
+}
+
+void CacheItr::clear() {
+    pairs = NULL;
 }
 
 void CacheItr::mark() {
+    markCur = cur;
 }
 
 void CacheItr::reset(const char i) {
+    cur = markCur;
+    hasNextChecked = false;
 }
 
-uint64_t CacheItr::getCardinality() {
-    throw 10;
+void CacheItr::moveto(const int64_t c1, const int64_t c2) {
+    if (v1 >= c1 && (ignSecondColumn || v1 > c1 || v2 >= c2)) {
+        //Position is backwards. Return the current row again
+        cur = prev;
+        hasNextChecked = true;
+        n = true;
+        return;
+    }
+    seek(cur, c1);
+    while (cur.valid && cur.first == (uint64_t) c1 &&
+            cur.second < (uint64_t) c2) {
+        advance(cur);
+    }
+    hasNextChecked = false;
 }
 
-/*uint64_t CacheItr::estimateCardinality() {
-    return estimatedSize;
-}*/
+uint64_t CacheItr::getCardinality() {
+    if (ignSecondColumn) {
+        return pairs->getNGroups();
+    } else {
+        return pairs->getNRows();
+    }
+}
@@ -37,7 +37,8 @@ bool DiffScanItr::hasNext() {
         if (root->hasNext()) {
             TermCoordinates values;
             currentkey = root->next(&values);
-            currentItr = ((DiffIndex3*)diff)->getIterator(perm, currentkey, values);
+            currentItr = ((DiffIndex3*)diff)->getIterator(perm, currentkey, values,
+                    q->getStorageStrat());
             if (!currentItr->hasNext()) {
                 LOG(ERRORL) << "This should not happen";
             }
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#include <trident/iterators/memitr.h>
+
+#include <algorithm>
+#include <limits>
+
+void MemItr::init(std::shared_ptr<const MemRows> rows, int64_t key,
+        int64_t c1, int64_t c2) {
+    this->rows = rows;
+    constraint1 = c1;
+    constraint2 = c2;
+    scan = key < 0;
+    setKey(key);
+    v1 = v2 = -1;
+    ignseccol = false;
+    hnc = false;
+    count = 1;
+    if (scan) {
+        start = 0;
+        end = rows->size();
+    } else {
+        auto b = std::lower_bound(rows->begin(), rows->end(), key,
+                [](const MemRow &r, const int64_t k) { return r.key < k; });
+        auto e = std::upper_bound(b, rows->end(), key,
+                [](const int64_t k, const MemRow &r) { return k < r.key; });
+        if (c1 >= 0) {
+            MemRow first;
+            first.key = key;
+            first.v1 = c1;
+            first.v2 = c2 >= 0 ? c2 : std::numeric_limits<int64_t>::min();
+            b = std::lower_bound(b, e, first);
+        }
+        start = b - rows->begin();
+        end = e - rows->begin();
+    }
+    pos = cur = markPos = start;
+}
+
+bool MemItr::matches(const MemRow &r) const {
+    return (constraint1 == NO_CONSTRAINT || r.v1 == constraint1) &&
+        (constraint2 == NO_CONSTRAINT || r.v2 == constraint2);
+}
+
+void MemItr::skipGroup() {
+    const int64_t k = (*rows)[cur].key;
+    while (pos < end && (*rows)[pos].key == k && (*rows)[pos].v1 == v1) {
+        pos++;
+    }
+    count = pos - cur;
+}
+
+bool MemItr::hasNext() {
+    if (!hnc) {
+        hn = pos < end && matches((*rows)[pos]);
+        hnc = true;
+    }
+    return hn;
+}
+
+void MemItr::next() {
+    cur = pos;
+    const MemRow &r = (*rows)[pos++];
+    if (scan) {
+        setKey(r.key);
+    }
+    v1 = r.v1;
+    v2 = r.v2;
+    if (ignseccol) {
+        skipGroup();
+    }
+    hnc = false;
+}
+
+void MemItr::ignoreSecondColumn() {
+    ignseccol = true;
+    if (v1 != -1) {
+        skipGroup();
+    }
+    hnc = false;
+}
+
+int64_t MemItr::getCount() {
+    return count;
+}
+
+uint64_t MemItr::getCardinality() {
+    uint64_t card = 0;
+    for (size_t i = start; i < end; ++i) {
+        const MemRow &r = (*rows)[i];
+        if (!matches(r)) {
+            continue;
+        }
+        if (ignseccol && card > 0 && r.key == (*rows)[i - 1].key &&
+                r.v1 == (*rows)[i - 1].v1) {
+            continue;
+        }
+        card++;
+    }
+    return card;
+}
+
+uint64_t MemItr::estCardinality() {
+    return end - start;
+}
+
+void MemItr::mark() {
+    markPos = pos;
+}
+
+void MemItr::reset(const char i) {
+    pos = markPos;
+    hnc = false;
+}
+
+void MemItr::moveto(const int64_t c1, const int64_t c2) {
+    if (v1 != -1 && v1 >= c1 && (ignseccol || v1 > c1 || v2 >= c2)) {
+        //The current row already satisfies the condition
+        pos = cur;
+    } else {
+        MemRow target;
+        target.key = getKey();
+        target.v1 = c1;
+        target.v2 = ignseccol ? std::numeric_limits<int64_t>::min() : c2;
+        pos = std::lower_bound(rows->begin() + pos, rows->begin() + end,
+                target) - rows->begin();
+    }
+    hnc = false;
+}
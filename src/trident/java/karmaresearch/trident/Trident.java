@@ -14,6 +14,7 @@ public class Trident
 {
     public long myTrident;
     public long myTridentLayer;
+    public long myPlanCache;
 
     static {
         loadLibrary("kognac-core");
@@ -26,6 +27,7 @@ public class Trident
     public Trident() {
         myTrident = 0;
         myTridentLayer = 0;
+        myPlanCache = 0;
     }
 
     private static void loadLibrary(String s) {
@@ -116,5 +118,15 @@ public class Trident
 
     public native String sparql(String query);
 
+    //The constants of the triple patterns of the query become parameters.
+    //Returns the id of the prepared query
+    public native long prepare(String query);
+
+    //Executes a prepared query with one RDF term for each parameter, e.g.,
+    //"<iri>". Returns the results like sparql
+    public native String execute(long id, String[] params);
+
+    public native void unprepare(long id);
+
     public native void unload();
 }
@@ -7,6 +7,7 @@
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 #include <trident/sparql/sparql.h>
+#include <trident/sparql/plancache.h>
 #include <kognac/logs.h>
 
 jlong getId(std::string nameField, JNIEnv *env, jobject &jobj) {
@@ -23,6 +24,49 @@ void setId(std::string nameField, JNIEnv *env, jobject &jobj, jlong id) {
 
 long nterms;
 
+//Executes a query and returns the results in JSON
+static jstring runSPARQLQuery(JNIEnv *jenv, jobject &jobj,
+        const std::string &query) {
+    TridentLayer *db = (TridentLayer*)getId("myTridentLayer", jenv, jobj);
+    PlanCache *cache = (PlanCache*)getId("myPlanCache", jenv, jobj);
+
+    //Execute the sparql query
+    JSON pt;
+    JSON vars;
+    JSON bindings;
+
+    JSON stats;
+    SPARQLUtils::execSPARQLQuery(query,
+            false,
+            nterms,
+            *db,
+            false,
+            true,
+            &vars,
+            &bindings,
+            &stats,
+            NULL,
+            cache);
+    JSON head;
+    head.add_child("vars", vars);
+    pt.add_child("head", head);
+    JSON results;
+    results.add_child("bindings", bindings);
+    pt.add_child("results", results);
+    pt.add_child("stats", stats);
+
+    std::ostringstream buf;
+    JSON::write(buf, pt);
+    auto page = buf.str();
+    //Return the results
+    return jenv->NewStringUTF(page.c_str());
+}
+
+static void throwException(JNIEnv *jenv, const std::string &message) {
+    jclass cls = jenv->FindClass("java/lang/IllegalArgumentException");
+    jenv->ThrowNew(cls, message.c_str());
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,6 +83,7 @@ extern "C" {
 
             setId("myTrident", env, obj, (jlong)kb);
             setId("myTridentLayer", env, obj, (jlong)tlayer);
+            setId("myPlanCache", env, obj, (jlong)new PlanCache());
 
             std::cout << "Trident database is loaded." << std::endl;
 
@@ -47,44 +92,69 @@ extern "C" {
 
     JNIEXPORT jstring JNICALL Java_karmaresearch_trident_Trident_sparql
         (JNIEnv *jenv, jobject jobj, jstring jquery) {
-            auto id = getId("myTridentLayer", jenv, jobj);
-            TridentLayer *db = (TridentLayer*)id;
-
-            //Execute the sparql query
-            JSON pt;
-            JSON vars;
-            JSON bindings;
+            const char *query = jenv->GetStringUTFChars(jquery, 0);
+            std::string q(query);
+            jenv->ReleaseStringUTFChars(jquery, query);
+            return runSPARQLQuery(jenv, jobj, q);
+        }
 
-            JSON stats;
+    JNIEXPORT jlong JNICALL Java_karmaresearch_trident_Trident_prepare
+        (JNIEnv *jenv, jobject jobj, jstring jquery) {
+            PlanCache *cache = (PlanCache*)getId("myPlanCache", jenv, jobj);
             const char *query = jenv->GetStringUTFChars(jquery, 0);
-            SPARQLUtils::execSPARQLQuery(query,
-                    false,
-                    nterms,
-                    *db,
-                    false,
-                    true,
-                    &vars,
-                    &bindings,
-                    &stats);
+            std::string q(query);
             jenv->ReleaseStringUTFChars(jquery, query);
-            JSON head;
-            head.add_child("vars", vars);
-            pt.add_child("head", head);
-            JSON results;
-            results.add_child("bindings", bindings);
-            pt.add_child("results", results);
-            pt.add_child("stats", stats);
-
-            std::ostringstream buf;
-            JSON::write(buf, pt);
-            auto page = buf.str();
-            //Return the results
-            auto out = jenv->NewStringUTF(page.c_str());
-            return out;
+            try {
+                return (jlong)cache->prepare(q);
+            } catch (const SPARQLParser::ParserException &e) {
+                throwException(jenv, "parse error: " + e.message);
+                return -1;
+            }
+        }
+
+    JNIEXPORT jstring JNICALL Java_karmaresearch_trident_Trident_execute
+        (JNIEnv *jenv, jobject jobj, jlong id, jobjectArray jparams) {
+            PlanCache *cache = (PlanCache*)getId("myPlanCache", jenv, jobj);
+            std::shared_ptr<const PreparedQuery> prepared =
+                cache->getPrepared(id);
+            if (!prepared) {
+                throwException(jenv, "Unknown prepared query");
+                return NULL;
+            }
+            std::vector<std::string> params;
+            jsize nparams = jparams ? jenv->GetArrayLength(jparams) : 0;
+            for (jsize i = 0; i < nparams; ++i) {
+                jstring jparam = (jstring)jenv->GetObjectArrayElement(jparams, i);
+                if (jparam == NULL) {
+                    throwException(jenv, "The parameter " + std::to_string(i) +
+                            " is null");
+                    return NULL;
+                }
+                const char *param = jenv->GetStringUTFChars(jparam, 0);
+                params.push_back(std::string(param));
+                jenv->ReleaseStringUTFChars(jparam, param);
+                jenv->DeleteLocalRef(jparam);
+            }
+            std::string query;
+            if (!prepared->bind(params, query)) {
+                throwException(jenv, "The query has " + std::to_string(
+                            prepared->getNParameters()) +
+                        " parameters and each must be a single term");
+                return NULL;
+            }
+            return runSPARQLQuery(jenv, jobj, query);
+        }
+
+    JNIEXPORT void JNICALL Java_karmaresearch_trident_Trident_unprepare
+        (JNIEnv *jenv, jobject jobj, jlong id) {
+            PlanCache *cache = (PlanCache*)getId("myPlanCache", jenv, jobj);
+            cache->unprepare(id);
         }
 
     JNIEXPORT void JNICALL Java_karmaresearch_trident_Trident_unload
         (JNIEnv *env, jobject obj) {
+            PlanCache *cache = (PlanCache*)getId("myPlanCache", env, obj);
+            delete cache;
             auto idl = getId("myTridentLayer", env, obj);
             TridentLayer *address1 = (TridentLayer*)idl;
             delete address1;
@@ -23,6 +23,30 @@ JNIEXPORT void JNICALL Java_karmaresearch_trident_Trident_load
 JNIEXPORT jstring JNICALL Java_karmaresearch_trident_Trident_sparql
   (JNIEnv *, jobject, jstring);
 
+/*
+ * Class:     karmaresearch_trident_Trident
+ * Method:    prepare
+ * Signature: (Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_karmaresearch_trident_Trident_prepare
+  (JNIEnv *, jobject, jstring);
+
+/*
+ * Class:     karmaresearch_trident_Trident
+ * Method:    execute
+ * Signature: (J[Ljava/lang/String;)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_karmaresearch_trident_Trident_execute
+  (JNIEnv *, jobject, jlong, jobjectArray);
+
+/*
+ * Class:     karmaresearch_trident_Trident
+ * Method:    unprepare
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_karmaresearch_trident_Trident_unprepare
+  (JNIEnv *, jobject, jlong);
+
 /*
  * Class:     karmaresearch_trident_Trident
  * Method:    unload
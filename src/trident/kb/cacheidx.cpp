@@ -22,72 +22,99 @@
 
 #include <trident/kb/cacheidx.h>
 
-#include <string>
+#include <kognac/logs.h>
 
-std::pair<std::vector<std::pair<uint64_t, uint64_t>>*,
-std::vector<CacheBlock>*> CacheIdx::getIndex(uint64_t key) {
-    KeyMap::iterator itr = keyMap.find(key);
-    if (itr != keyMap.end()) {
-        return std::make_pair(itr->second.second, itr->second.first);
-    } else {
-        return std::make_pair((std::vector<std::pair<uint64_t, uint64_t>>*)NULL,
-                              (std::vector<CacheBlock>*)NULL);
+CompactPairs::CompactPairs(const Pairs &pairs) : nrows(pairs.size()),
+    ngroups(0) {
+    data.reserve(pairs.size() * 2);
+    uint64_t prevFirst = 0;
+    size_t i = 0;
+    while (i < pairs.size()) {
+        const uint64_t first = pairs[i].first;
+        size_t j = i + 1;
+        while (j < pairs.size() && pairs[j].first == first) {
+            j++;
+        }
+        if (ngroups % SKIP_GROUPS == 0) {
+            SkipEntry e;
+            e.first = first;
+            e.base = prevFirst;
+            e.offset = data.size();
+            e.group = ngroups;
+            skips.push_back(e);
+        }
+        writeVarint(first - prevFirst);
+        writeVarint(j - i);
+        //The second values start from 0 in every group
+        uint64_t prevSecond = 0;
+        for (size_t k = i; k < j; ++k) {
+            writeVarint(pairs[k].second - prevSecond);
+            prevSecond = pairs[k].second;
+        }
+        prevFirst = first;
+        ngroups++;
+        i = j;
     }
+    data.shrink_to_fit();
+    skips.shrink_to_fit();
 }
 
-void CacheIdx::storeIdx(uint64_t key, std::vector<CacheBlock> *blocks,
-                        std::vector<std::pair<uint64_t, uint64_t>> *pairs) {
-    KeyMap::iterator itr = keyMap.find(key);
-    if (itr != keyMap.end()) {
-        //A merge is needed
-
-#ifdef DEBUG
-        for (std::vector<CacheBlock>::iterator itrNewBlocks = blocks->begin();
-                itrNewBlocks != blocks->end(); ++itrNewBlocks) {
-            for (std::vector<CacheBlock>::iterator itrBlocks = itr->second.first->begin();
-                    itrBlocks != itr->second.first->end(); ++itrBlocks) {
-                if (itrNewBlocks->startKey >= itrBlocks->startKey &&
-                        itrNewBlocks->startKey < itrBlocks->endKey) {
-                    assert(false);
-                }
-                if (itrNewBlocks->endKey > itrBlocks->startKey &&
-                        itrNewBlocks->endKey <= itrBlocks->endKey) {
-                    assert(false);
-                }
-                if (itrNewBlocks->startKey >= itrBlocks->startKey &&
-                        itrNewBlocks->endKey <= itrBlocks->endKey) {
-                    assert(false);
-                }
-            }
-        }
-#endif
-        //All blocks should not be in ranges that are already existing. I just add them
-        for (std::vector<CacheBlock>::iterator itrNewBlocks = blocks->begin();
-                itrNewBlocks != blocks->end(); ++itrNewBlocks) {
-            //Add all the pairs that are pointed by the block
-            size_t newStart = itr->second.second->size();
-            for (uint64_t i = itrNewBlocks->startArray; i < itrNewBlocks->endArray; ++i) {
-                itr->second.second->push_back(pairs->at(i));
-            }
-            itrNewBlocks->startArray = newStart;
-            itrNewBlocks->endArray = itr->second.second->size();
-            itr->second.first->push_back(*itrNewBlocks);
-        }
+void CompactPairs::writeVarint(uint64_t v) {
+    while (v >= 128) {
+        data.push_back((uint8_t)(v | 128));
+        v >>= 7;
+    }
+    data.push_back((uint8_t) v);
+}
 
-        //Re-Sort all the blocks
-        std::sort(itr->second.first->begin(), itr->second.first->end());
+CacheIdx::CacheIdx(size_t maxBytes) : maxBytes(maxBytes), bytes(0), hits(0),
+    misses(0), evictions(0) {
+}
 
-        //Delete the input variables. No longer need them
-        delete blocks;
-        delete pairs;
-    } else {
-        keyMap.insert(std::make_pair(key, std::make_pair(blocks, pairs)));
+std::shared_ptr<const CompactPairs> CacheIdx::get(const int perm,
+        const uint64_t key) {
+#ifdef MT
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+    auto itr = entries.find(getID(perm, key));
+    if (itr == entries.end()) {
+        misses++;
+        return std::shared_ptr<const CompactPairs>();
     }
+    hits++;
+    //Move it in front
+    lru.splice(lru.begin(), lru, itr->second);
+    return itr->second->pairs;
 }
 
-CacheIdx::~CacheIdx() {
-    for (KeyMap::iterator itr = keyMap.begin(); itr != keyMap.end(); ++itr) {
-        delete itr->second.first;
-        delete itr->second.second;
+void CacheIdx::put(const int perm, const uint64_t key,
+        std::shared_ptr<const CompactPairs> pairs) {
+    //Include the overhead of the list and the map
+    const size_t size = pairs->getMemoryUsage() + 64;
+    if (size > maxBytes) {
+        return;
+    }
+#ifdef MT
+    std::lock_guard<std::mutex> lock(mutex);
+#endif
+    const uint64_t id = getID(perm, key);
+    if (entries.count(id)) {
+        //Another querier added it in the meantime
+        return;
+    }
+    while (bytes + size > maxBytes) {
+        //The iterators that still read an evicted table keep it alive
+        Entry &last = lru.back();
+        bytes -= last.bytes;
+        entries.erase(last.id);
+        lru.pop_back();
+        evictions++;
     }
+    Entry e;
+    e.id = id;
+    e.pairs = pairs;
+    e.bytes = size;
+    lru.push_front(e);
+    entries.insert(std::make_pair(id, lru.begin()));
+    bytes += size;
 }
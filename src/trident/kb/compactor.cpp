@@ -0,0 +1,405 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#include <trident/kb/compactor.h>
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/querierpool.h>
+#include <trident/iterators/difftermitr.h>
+#include <trident/kb/inserter.h>
+#include <trident/tree/root.h>
+#include <trident/tree/treeitr.h>
+#include <trident/binarytables/tableshandler.h>
+#include <trident/utils/ratelimiter.h>
+#include <trident/loader.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+//The permutation that has the same first term. If a table is skipped in
+//one, its rows are rebuilt from the other
+static const int _samefirst[] = { IDX_SOP, IDX_OSP, IDX_PSO, IDX_SPO, IDX_OPS,
+    IDX_POS };
+
+//Items of a diff that are no longer read once it is folded in a base. The
+//dictionary is kept
+static const char *_foldedItems[] = { "s", "p", "o", "raw", "values",
+    "newps", "newos", "newsp", "newop", "newso", "newpo" };
+
+bool KBCompactor::run() {
+    failed = false;
+    try {
+        compact();
+    } catch (int e) {
+        LOG(ERRORL) << "The compaction of " << kb.path << " failed";
+        failed = true;
+    }
+    return !failed;
+}
+
+bool KBCompactor::start() {
+    if (running.exchange(true)) {
+        return false;
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+    cancelled = false;
+    thread = std::thread([this]() {
+            run();
+            running = false;
+            });
+    return true;
+}
+
+bool KBCompactor::wait() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+    return !failed;
+}
+
+KBCompactor::~KBCompactor() {
+    cancel();
+    wait();
+}
+
+void KBCompactor::compact() {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    const string path = kb.path;
+    //A merge would replace the diffs that are folded
+    std::lock_guard<std::mutex> lock(kb.compactionMutex);
+#ifndef MT
+    //Without MT the diffs cannot be read while a query reads them, so the
+    //queries wait until the compaction ends
+    QuerierPool::Handle session = kb.querierPool->acquire();
+#endif
+    //The triples updated in memory are folded as well
+    kb.flushMemTable();
+    std::shared_ptr<const KBSnapshot> snapshot = kb.getSnapshot();
+    if (snapshot->diffIndices.empty()) {
+        LOG(INFOL) << "There are no updates to compact";
+        return;
+    }
+    KBBase &base = *snapshot->base;
+    if (kb.nindices != 6 || kb.aggrIndices || Utils::exists(base.getDir() +
+                DIR_SEP + "tree" + DIR_SEP + "flat")) {
+        LOG(ERRORL) << "Compaction is supported only on KBs with six non-aggregated indices and without a flat tree";
+        throw 10;
+    }
+
+    const int64_t generation = base.generation + 1;
+    const string dir = getBaseDir(path, generation);
+    if (Utils::exists(dir)) {
+        Utils::remove_all(dir);
+    }
+    Utils::create_directories(dir);
+
+    int64_t ntables[N_PARTITIONS];
+    int64_t nFirstTables[N_PARTITIONS];
+    int64_t totalTriples = 0;
+    RateLimiter limiter(maxBytesPerSecond);
+    try {
+        //1- Collect the keys touched by the updates
+        std::vector<int64_t> keys[N_PARTITIONS];
+        for (auto &diff : snapshot->diffIndices) {
+            for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+                DiffTermItr itr;
+                diff->getTermListItr(perm, &itr);
+                while (itr.hasNext()) {
+                    itr.next();
+                    keys[perm].push_back(itr.getKey());
+                }
+            }
+        }
+        for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+            std::sort(keys[perm].begin(), keys[perm].end());
+            auto last = std::unique(keys[perm].begin(), keys[perm].end());
+            keys[perm].erase(last, keys[perm].end());
+        }
+
+        //2- Rewrite all the tables in the new base. The querier returns
+        //their content with the diffs of the snapshot applied. It has its
+        //own tree and tables, so it does not share their caches with the
+        //queries that are running
+        Stats stats;
+        std::unique_ptr<Root> oldTree(kb.getRootTree(base));
+        std::unique_ptr<TableStorage> oldFiles[N_PARTITIONS];
+        TableStorage *oldStorage[N_PARTITIONS];
+        for (int i = 0; i < N_PARTITIONS; ++i) {
+            const string p = base.getDir() + DIR_SEP + "p" + to_string(i);
+            if (!Utils::isEmpty(p)) {
+                oldFiles[i] = std::unique_ptr<TableStorage>(new TableStorage(
+                            true, p, kb.config.getParamLong(STORAGE_MAX_FILE_SIZE),
+                            kb.config.getParamInt(STORAGE_MAX_N_FILES),
+                            NULL, stats, i));
+            }
+            oldStorage[i] = oldFiles[i].get();
+        }
+        std::unique_ptr<Querier> q(new Querier(oldTree.get(), kb.dictManager,
+                    oldStorage, snapshot->totalNumberTriples, kb.getNTerms(),
+                    kb.nindices, base.ntables, base.nFirstTables, NULL,
+                    snapshot));
+
+        std::unique_ptr<MemoryManager<FileDescriptor>> trackers[N_PARTITIONS];
+        TableStorage *storage[N_PARTITIONS];
+        for (int i = 0; i < N_PARTITIONS; ++i) {
+            ntables[i] = nFirstTables[i] = 0;
+            trackers[i] = std::unique_ptr<MemoryManager<FileDescriptor>>(
+                    new MemoryManager<FileDescriptor>(
+                        kb.config.getParamLong(STORAGE_CACHE_SIZE)));
+            storage[i] = new TableStorage(false,
+                    dir + DIR_SEP + "p" + to_string(i),
+                    kb.config.getParamLong(STORAGE_MAX_FILE_SIZE),
+                    kb.config.getParamInt(STORAGE_MAX_N_FILES),
+                    trackers[i].get(), stats, i);
+        }
+        Inserter ins(NULL, storage, std::max((int64_t) kb.getNTerms(),
+                    kb.getNextID()), kb.config.getParamBool(USEFIXEDSTRAT),
+                (char) kb.config.getParamInt(FIXEDSTRAT),
+                kb.config.getParamInt(THRESHOLD_SKIP_TABLE),
+                ntables, nFirstTables);
+
+        //The coordinates of the new tables, sorted by key
+        string coordinates[N_PARTITIONS];
+        for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+            coordinates[perm] = dir + DIR_SEP + "tmpTree" + to_string(perm);
+            TreeWriter writer(coordinates[perm]);
+
+            //The keys of the base and the ones touched by the updates, in
+            //order
+            std::unique_ptr<TreeItr> itr(oldTree->itr());
+            TermCoordinates coord;
+            auto nextBaseKey = [&]() -> int64_t {
+                while (itr->hasNext()) {
+                    const int64_t key = itr->next(&coord);
+                    if (coord.exists(perm) || coord.exists(_samefirst[perm])) {
+                        return key;
+                    }
+                }
+                return -1;
+            };
+            int64_t baseKey = nextBaseKey();
+            size_t posKeys = 0;
+            while (baseKey != -1 || posKeys < keys[perm].size()) {
+                int64_t key;
+                if (posKeys == keys[perm].size() || (baseKey != -1 &&
+                            baseKey < keys[perm][posKeys])) {
+                    key = baseKey;
+                    baseKey = nextBaseKey();
+                } else {
+                    key = keys[perm][posKeys++];
+                    if (key == baseKey) {
+                        baseKey = nextBaseKey();
+                    }
+                }
+                if (cancelled) {
+                    LOG(INFOL) << "The compaction was cancelled";
+                    throw 10;
+                }
+
+                PairItr *pitr = q->getPermuted(perm, key, -1, -1, true);
+                int64_t n = 0;
+                while (pitr->hasNext()) {
+                    pitr->next();
+                    ins.insert(perm, key, pitr->getValue1(), pitr->getValue2(),
+                            0, NULL, &writer, false, false);
+                    n++;
+                }
+                q->releaseItr(pitr);
+                if (perm == IDX_SPO) {
+                    totalTriples += n;
+                }
+                //A row is read and written as a pair of 8-byte values
+                limiter.consume(n * 32);
+            }
+            ins.flush(perm, NULL, &writer, false, false);
+            ins.stopInserts(perm);
+            writer.finish();
+            delete storage[perm];
+            storage[perm] = NULL;
+            LOG(DEBUGL) << "Permutation " << perm << ": " << ntables[perm] <<
+                " tables";
+        }
+        q.reset();
+
+        //3- Build the new tree
+        {
+            const string treeDir = dir + DIR_SEP + "tree";
+            Utils::create_directories(treeDir);
+            std::unique_ptr<Root> tree(kb.newTree(treeDir + DIR_SEP, false));
+            std::vector<TermCoordinatesSource*> sources;
+            sources.push_back(new CoordinatesMerger(coordinates,
+                        N_PARTITIONS));
+            tree->bulkLoad(sources);
+            delete sources[0];
+        }
+        for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+            Utils::remove(coordinates[perm]);
+        }
+
+        //4- The diffs folded in the new base keep only their dictionary.
+        //The list is applied again if the KB is opened before it is done
+        {
+            std::ofstream fos(dir + DIR_SEP + "FOLDED");
+            for (const auto &diffDir : snapshot->diffDirs) {
+                fos << Utils::filename(diffDir) << std::endl;
+            }
+        }
+
+        //5- Point the statistics to the new base. The rename is the commit
+        //point: after a crash the KB is opened with the new base
+        const string statsFile = path + DIR_SEP + "kbstats";
+        std::vector<char> content(Utils::fileSize(statsFile));
+        std::ifstream fis(statsFile, std::ios_base::binary);
+        fis.read(content.data(), content.size());
+        fis.close();
+        //See KB::storeStats() for the layout of the file
+        content.resize(148);
+        Utils::encode_long(content.data(), 16, totalTriples);
+        for (int i = 0; i < N_PARTITIONS; ++i) {
+            Utils::encode_long(content.data(), 39 + i * 16, ntables[i]);
+            Utils::encode_long(content.data(), 47 + i * 16, nFirstTables[i]);
+        }
+        Utils::encode_long(content.data(), 140, generation);
+        std::ofstream fos(statsFile + ".new", std::ios_base::binary);
+        fos.write(content.data(), content.size());
+        fos.close();
+        if (std::rename((statsFile + ".new").c_str(), statsFile.c_str()) != 0) {
+            LOG(ERRORL) << "Error renaming " << statsFile << ".new";
+            throw 10;
+        }
+    } catch (int e) {
+        //Nothing refers to the new base yet
+        Utils::remove_all(dir);
+        throw;
+    }
+
+    //6- Publish the new base. The diffs stored in the meantime stay on top
+    //of it. The old base is deleted with its last reader
+    std::shared_ptr<KBBase> newBase = kb.openBase(generation);
+    for (int i = 0; i < N_PARTITIONS; ++i) {
+        newBase->ntables[i] = ntables[i];
+        newBase->nFirstTables[i] = nFirstTables[i];
+    }
+    {
+        std::lock_guard<std::mutex> lock(kb.updatesMutex);
+        std::shared_ptr<const KBSnapshot> current = kb.getSnapshot();
+        std::shared_ptr<KBSnapshot> next(new KBSnapshot(*current));
+        next->base = newBase;
+        next->diffIndices.clear();
+        next->diffDirs.clear();
+        for (size_t i = 0; i < current->diffIndices.size(); ++i) {
+            if (std::find(snapshot->diffIndices.begin(),
+                        snapshot->diffIndices.end(),
+                        current->diffIndices[i]) ==
+                    snapshot->diffIndices.end()) {
+                next->diffIndices.push_back(current->diffIndices[i]);
+                next->diffDirs.push_back(current->diffDirs[i]);
+            }
+        }
+        current->base->obsolete = true;
+        kb.totalNumberTriples = totalTriples;
+        kb.publishSnapshot(next);
+    }
+    for (const auto &diffDir : snapshot->diffDirs) {
+        std::ofstream flag(diffDir + DIR_SEP + "DICT");
+    }
+    //The idle queriers of the pool read the old base
+    kb.querierPool->clear();
+
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Compaction finished in " << sec.count() * 1000 <<
+        " ms. Rewritten " << limiter.getConsumedBytes() / 32 <<
+        " rows in the base " << generation;
+}
+
+std::string KBCompactor::getBaseDir(std::string path, int64_t generation) {
+    if (generation == 0) {
+        //The loader writes the first base in the directory of the KB
+        return path;
+    }
+    return path + DIR_SEP + "_compact" + DIR_SEP + to_string(generation);
+}
+
+void KBCompactor::removeBase(std::string path, int64_t generation) {
+    LOG(DEBUGL) << "Removing the base " << generation << " of " << path;
+    if (generation == 0) {
+        if (Utils::exists(path + DIR_SEP + "tree")) {
+            Utils::remove_all(path + DIR_SEP + "tree");
+        }
+        for (int i = 0; i < N_PARTITIONS; ++i) {
+            const string dir = path + DIR_SEP + "p" + to_string(i);
+            if (Utils::exists(dir)) {
+                Utils::remove_all(dir);
+            }
+        }
+    } else if (Utils::exists(getBaseDir(path, generation))) {
+        Utils::remove_all(getBaseDir(path, generation));
+    }
+}
+
+void KBCompactor::recover(std::string path, int64_t generation) {
+    const string workDir = path + DIR_SEP + "_compact";
+    if (!Utils::exists(workDir)) {
+        return;
+    }
+    //The old bases were still read when the KB was closed, the newer ones
+    //were not completed
+    for (const auto &dir : Utils::getSubdirs(workDir)) {
+        if (Utils::filename(dir) != to_string(generation)) {
+            LOG(INFOL) << "Removing the unused base " << dir;
+            Utils::remove_all(dir);
+        }
+    }
+    if (generation == 0) {
+        return;
+    }
+    if (Utils::exists(path + DIR_SEP + "tree")) {
+        removeBase(path, 0);
+    }
+
+    const string folded = getBaseDir(path, generation) + DIR_SEP + "FOLDED";
+    if (!Utils::exists(folded)) {
+        return;
+    }
+    std::ifstream fis(folded);
+    string name;
+    while (std::getline(fis, name)) {
+        const string diffDir = path + DIR_SEP + "_diff" + DIR_SEP + name;
+        if (name.empty() || !Utils::exists(diffDir)) {
+            continue;
+        }
+        for (auto item : _foldedItems) {
+            const string file = diffDir + DIR_SEP + item;
+            if (Utils::exists(file)) {
+                Utils::remove_all(file);
+            }
+        }
+        std::ofstream flag(diffDir + DIR_SEP + "DICT");
+    }
+}
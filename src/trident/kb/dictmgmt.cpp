@@ -50,6 +50,7 @@ DictMgmt::DictMgmt(Dict mainDict, string dirToStoreGUD, bool hash, string e2r,
 
         gud_modified = false;
         gud_largestID = 0;
+        gudSize = 0;
         gudLocation = dirToStoreGUD;
         gud_idtext.set_empty_key(UINT64_MAX);
         gud_idtext.set_deleted_key(UINT64_MAX - 1);
@@ -59,17 +60,19 @@ DictMgmt::DictMgmt(Dict mainDict, string dirToStoreGUD, bool hash, string e2r,
             ifstream ifs;
             ifs.open(dirToStoreGUD + DIR_SEP + "gud");
             ifs >> gud_largestID;
-            while (!ifs.eof()) {
-                uint64_t id;
+            uint64_t id;
+            while (ifs >> id) {
+                //Literals can contain spaces
                 string term;
-                ifs >> id;
-                ifs >> term;
+                ifs.get();
+                std::getline(ifs, term);
                 if (term.size() > 0) {
                     gud_idtext.insert(make_pair(id, term));
                     gud_textid.insert(make_pair(term, id));
                 }
             }
             ifs.close();
+            gudSize = gud_idtext.size();
             std::chrono::duration<double> sec = std::chrono::system_clock::now()
                 - start;
             LOG(DEBUGL) << "Time loading GUD " << sec.count() * 1000;
@@ -127,11 +130,13 @@ StringBuffer *DictMgmt::getStringBuffer() {
 void DictMgmt::putInUpdateDict(const uint64_t id,
         const char *term,
         const size_t len) {
+    std::lock_guard<std::mutex> lock(gudMutex);
     gud_idtext.insert(make_pair(id, string(term, len)));
     gud_textid.insert(make_pair(string(term, len), id));
     gud_modified = true;
     if (id > gud_largestID)
         gud_largestID = id;
+    gudSize = gud_idtext.size();
 }
 
 bool DictMgmt::getTextRel(nTerm key, char *value, int &size) {
@@ -155,13 +160,17 @@ bool DictMgmt::getText(nTerm key, char *value) {
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        int size = 0;
-        dictionaries[idx].sb->get(coordinates, value, size);
-        value[size] = '\0';
-        return true;
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        if (dictionaries[idx].invdict->get(key, coordinates)) {
+            int size = 0;
+            dictionaries[idx].sb->get(coordinates, value, size);
+            value[size] = '\0';
+            return true;
+        }
     }
-    if (!gud_idtext.empty()) {
+    if (gudSize > 0) {
+        std::lock_guard<std::mutex> lock(gudMutex);
         auto it = gud_idtext.find(key);
         if (it != gud_idtext.end()) {
             const size_t size = it->second.size();
@@ -179,13 +188,18 @@ bool DictMgmt::getText(nTerm key, std::string &value) {
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        int size = 0;
-        char *rawvalue = dictionaries[idx].sb->get(coordinates, size);
-        value = std::string(rawvalue, size);
-        return true;
+    {
+        //The text is in a buffer of the string buffer until the next lookup
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        if (dictionaries[idx].invdict->get(key, coordinates)) {
+            int size = 0;
+            char *rawvalue = dictionaries[idx].sb->get(coordinates, size);
+            value = std::string(rawvalue, size);
+            return true;
+        }
     }
-    if (!gud_idtext.empty()) {
+    if (gudSize > 0) {
+        std::lock_guard<std::mutex> lock(gudMutex);
         auto it = gud_idtext.find(key);
         if (it != gud_idtext.end()) {
             value = it->second;
@@ -202,11 +216,15 @@ bool DictMgmt::getText(nTerm key, char *value, int &size) {
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        dictionaries[idx].sb->get(coordinates, value, size);
-        return true;
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        if (dictionaries[idx].invdict->get(key, coordinates)) {
+            dictionaries[idx].sb->get(coordinates, value, size);
+            return true;
+        }
     }
-    if (!gud_idtext.empty()) {
+    if (gudSize > 0) {
+        std::lock_guard<std::mutex> lock(gudMutex);
         auto it = gud_idtext.find(key);
         if (it != gud_idtext.end()) {
             size = it->second.size();
@@ -219,21 +237,26 @@ bool DictMgmt::getText(nTerm key, char *value, int &size) {
 
 void DictMgmt::getTextFromCoordinates(int64_t coordinates, char *output,
         int &sizeOutput) {
+    std::lock_guard<std::mutex> lock(lookupMutex);
     dictionaries[0].sb->get(coordinates, output, sizeOutput);
     output[sizeOutput] = '\0';
 }
 
 bool DictMgmt::getNumber(const char *key, const int sizeKey, nTerm *value) {
-    int i = 0;
-    while (i < dictionaries.size()) {
-        if (!dictionaries[i].dict->get((tTerm*) key, sizeKey, value)) {
-            i++;
-        } else {
-            return true;
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        int i = 0;
+        while (i < dictionaries.size()) {
+            if (!dictionaries[i].dict->get((tTerm*) key, sizeKey, value)) {
+                i++;
+            } else {
+                return true;
+            }
         }
     }
 
-    if (!gud_textid.empty()) {
+    if (gudSize > 0) {
+        std::lock_guard<std::mutex> lock(gudMutex);
         auto it = gud_textid.find(string(key, sizeKey));
         if (it != gud_textid.end()) {
             *value = it->second;
@@ -322,8 +345,8 @@ void DictMgmt::addUpdates(std::vector<Dict> &updates) {
     }
 }
 
-DictMgmt::~DictMgmt() {
-    delete[] insertedNewTerms;
+void DictMgmt::storeGUD() {
+    std::lock_guard<std::mutex> lock(gudMutex);
     if (gud_modified && !gud_idtext.empty()) {
         //Write down the new version
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
@@ -334,8 +357,14 @@ DictMgmt::~DictMgmt() {
             os << it->first << '\t' << it->second << endl;
         }
         os.close();
+        gud_modified = false;
         std::chrono::duration<double> sec = std::chrono::system_clock::now()
             - start;
         LOG(DEBUGL) << "Time writing GUD " << sec.count() * 1000;
     }
 }
+
+DictMgmt::~DictMgmt() {
+    delete[] insertedNewTerms;
+    storeGUD();
+}
@@ -72,8 +72,8 @@ DiffIndex1::DiffIndex1(string dir, DiffIndex::TypeUpdate type) : DiffIndex(type,
 
 extern EmptyItr emptyItr;
 PairItr *DiffIndex1::getIterator(int idx, int64_t first, int64_t second, int64_t third,
-        int64_t &nfirstterms) {
-    assert(factory != NULL);
+        int64_t &nfirstterms, Querier *q) {
+    Factory<Diff1Itr> *factory = q->getDiff1Factory();
     //nfirstterms = 0;
     int64_t permutedTriple[3];
     permutedTriple[0] = permutedTriple[1] = permutedTriple[2] = 0;
@@ -267,10 +267,6 @@ void DiffIndex1::getTermListItr(int idx, DiffTermItr *itr) {
     }
 }
 
-void DiffIndex1::setFactoryIterators(Factory<Diff1Itr> *f) {
-    this->factory = f;
-}
-
 bool DiffIndex1::valueInArray(const int64_t v) const {
     const char *s = values->getBuffer();
     const char *e = values->getBuffer() + (size * nbytes);
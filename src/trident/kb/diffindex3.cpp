@@ -32,10 +32,14 @@
 #include <kognac/lz4io.h>
 
 #include <cstdlib>
+#include <future>
 
 using namespace std;
 
-DiffIndex3::DiffIndex3(std::string dir, const char **globalbuffers,
+//Above this size, the p and o indices are built in parallel with the s ones
+#define THRESHOLD_PARALLEL 100000
+
+DiffIndex3::DiffIndex3(std::string dir, std::shared_ptr<ROMappedFile> *globalfiles,
                        KBConfig &config, TypeUpdate type) :
     DiffIndex(type, DiffIndex::DIFF3), dir(dir) {
     std::chrono::system_clock::time_point startDiff = std::chrono::system_clock::now();
@@ -68,15 +72,37 @@ DiffIndex3::DiffIndex3(std::string dir, const char **globalbuffers,
     roots[IDX_SPO] = roots[IDX_SOP] = s.get();
     roots[IDX_POS] = roots[IDX_PSO] = p.get();
     roots[IDX_OPS] = roots[IDX_OSP] = o.get();
-    strat = NULL;
+    //Diffs created by older versions have no filters and are always read
+    filters[0].load(dir + "/s/filter");
+    filters[1].load(dir + "/p/filter");
+    filters[2].load(dir + "/o/filter");
+    keyFilters[IDX_SPO] = keyFilters[IDX_SOP] = &filters[0];
+    keyFilters[IDX_POS] = keyFilters[IDX_PSO] = &filters[1];
+    keyFilters[IDX_OPS] = keyFilters[IDX_OSP] = &filters[2];
+    //The sample is only read by the updater
+    hasStats = stats.load(dir + "/diffstats", false);
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - startDiff;
     LOG(DEBUGL) << "Load diff tree: " << sec.count() * 1000 << "ms.";
 
+    //The files are mapped here and not when they are first read, because
+    //the index can be used by several threads
     if (Utils::exists(dir + "/s/p0")) { //The update has its data locally stored
-        memset(buffers, 0, sizeof(const char*) * 6);
+        static const int perms[] = { IDX_SPO, IDX_SOP, IDX_POS, IDX_PSO,
+                                     IDX_OPS, IDX_OSP };
+        static const char *names[] = { "/s/p0", "/s/p1", "/p/p0", "/p/p1",
+                                       "/o/p0", "/o/p1" };
+        for (int i = 0; i < 6; ++i) {
+            if (Utils::exists(dir + names[i])) {
+                files[perms[i]] = std::shared_ptr<ROMappedFile>(
+                                      new ROMappedFile(dir + names[i]));
+            }
+        }
     } else {
         for (int i = 0; i < 6; ++i)
-            buffers[i] = globalbuffers[i];
+            files[i] = globalfiles[i];
+    }
+    for (int i = 0; i < 6; ++i) {
+        buffers[i] = files[i] ? files[i]->getBuffer() : NULL;
     }
 
     ifstream f;
@@ -129,36 +155,8 @@ PairItr *DiffIndex3::getScan(int idx, DiffScanItr *itr) {
     return itr;
 }
 
-PairItr *DiffIndex3::getIterator(int idx, int64_t key, TermCoordinates &coord) {
-
-    if (!buffers[idx]) {
-        switch (idx) {
-        case IDX_SPO:
-            spo_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p0"));
-            buffers[idx] = spo_f->getBuffer();
-            break;
-        case IDX_SOP:
-            sop_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p1"));
-            buffers[idx] = sop_f->getBuffer();
-            break;
-        case IDX_POS:
-            pos_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p0"));
-            buffers[idx] = pos_f->getBuffer();
-            break;
-        case IDX_PSO:
-            pso_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p1"));
-            buffers[idx] = pso_f->getBuffer();
-            break;
-        case IDX_OPS:
-            ops_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p0"));
-            buffers[idx] = ops_f->getBuffer();
-            break;
-        case IDX_OSP:
-            osp_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p1"));
-            buffers[idx] = osp_f->getBuffer();
-            break;
-        }
-    }
+PairItr *DiffIndex3::getIterator(int idx, int64_t key, TermCoordinates &coord,
+                                 StorageStrat *strat) {
 
     int64_t nelements = coord.getNElements(idx);
     size_t idxArray = (coord.getFileIdx(idx) << 16) + coord.getMark(idx);
@@ -185,46 +183,22 @@ PairItr *DiffIndex3::getIterator(int idx,
                                  int64_t first,
                                  int64_t second,
                                  int64_t third,
-                                 int64_t &nfirstterms) {
+                                 int64_t &nfirstterms,
+                                 Querier *q) {
     if (first < 0) {
         LOG(ERRORL) << "This method should not be called for full scans";
         throw 10;
     }
+    if (!keyFilters[idx]->mayContain(first)) {
+        return &_diEmpty;
+    }
 
     TermCoordinates coordinates;
     if (roots[idx]->get(first, &coordinates)) {
-        if (!buffers[idx]) {
-            switch (idx) {
-            case IDX_SPO:
-                spo_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p0"));
-                buffers[idx] = spo_f->getBuffer();
-                break;
-            case IDX_SOP:
-                sop_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p1"));
-                buffers[idx] = sop_f->getBuffer();
-                break;
-            case IDX_POS:
-                pos_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p0"));
-                buffers[idx] = pos_f->getBuffer();
-                break;
-            case IDX_PSO:
-                pso_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p1"));
-                buffers[idx] = pso_f->getBuffer();
-                break;
-            case IDX_OPS:
-                ops_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p0"));
-                buffers[idx] = ops_f->getBuffer();
-                break;
-            case IDX_OSP:
-                osp_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p1"));
-                buffers[idx] = osp_f->getBuffer();
-                break;
-            }
-        }
         int64_t nelements = coordinates.getNElements(idx);
         size_t idxArray = (coordinates.getFileIdx(idx) << 16) + coordinates.getMark(idx);
         char strategy = coordinates.getStrategy(idx);
-        PairItr *itr = strat->getBinaryTable(strategy);
+        PairItr *itr = q->getStorageStrat()->getBinaryTable(strategy);
         AbsNewTable *newitr = (AbsNewTable*) itr;
         const char *begin = buffers[idx] + idxArray;
         const char *end;
@@ -410,7 +384,8 @@ void DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate update,
                                  std::vector<uint64_t> &all_o,
                                  bool dumpRawFormat,
                                  Querier * q,
-                                 bool shouldSort) {
+                                 bool shouldSort,
+                                 size_t samplesize) {
     /**** Create indices ****/
     std::vector <uint32_t> idx1;
     idx1.resize(all_s.size());
@@ -463,9 +438,115 @@ void DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate update,
     map.setInt(NODE_KEYS_PREALL_FACTORY_SIZE,
                config->getParamInt(TREE_NODE_KEYS_PREALL_FACTORY_SIZE));
 
+    /**** The three pairs of permutations only share the input columns.
+     * With MT, large updates build them in parallel, each with its own
+     * querier. Otherwise the orderings by p and o are sorted in the
+     * background while the s indices are built ****/
+    const bool presort = idx1.size() > THRESHOLD_PARALLEL;
+#ifdef MT
+    const bool parallel = presort && q != NULL;
+#else
+    const bool parallel = false;
+#endif
+    std::unique_ptr<Querier> qp;
+    std::unique_ptr<Querier> qo;
+    if (parallel) {
+        qp = std::unique_ptr<Querier>(q->copy());
+        qo = std::unique_ptr<Querier>(q->copy());
+    }
+    std::vector<uint32_t> idxP;
+    std::vector<uint32_t> idxO;
+    std::future<void> sortP;
+    std::future<void> sortO;
+    if (presort) {
+        idxP = idx1;
+        idxO = idx1;
+        if (!parallel) {
+            sortP = std::async(std::launch::async, [&idxP, &all_p]() {
+                std::sort(idxP.begin(), idxP.end(), _Sorter(all_p));
+            });
+            sortO = std::async(std::launch::async, [&idxO, &all_o]() {
+                std::sort(idxO.begin(), idxO.end(), _Sorter(all_o));
+            });
+        }
+    }
+    Utils::create_directories(outputdir);
+
+    /**** Sort by POS,PSO ****/
+    std::unique_ptr<UpdateStats> ufp;
+    auto buildP = [&]() {
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        Querier *qx = parallel ? qp.get() : q;
+        string p_outputdir = outputdir + "/p";
+        if (Utils::exists(p_outputdir)) {
+            Utils::remove_all(p_outputdir);
+        }
+        Utils::create_directories(p_outputdir);
+
+        if (update == TypeUpdate::ADDITION_df) {
+            ufp = std::unique_ptr<UpdateStats>(new UpdateStats_add(qx, IDX_POS, IDX_PSO, true, true));
+        } else {
+            ufp = std::unique_ptr<UpdateStats>(new UpdateStats_rm(qx, IDX_POS, IDX_PSO, true, true));
+        }
+        string p_diffdir = diffdir + "/p";
+        Utils::create_directories(p_diffdir);
+        if (presort) {
+            if (!parallel) {
+                sortP.wait();
+            }
+            DiffIndex3::sortIndex(p_outputdir, p_diffdir, IDX_POS, IDX_PSO,
+                                  idxP, all_p, all_o, all_s, map, qx, ufp.get(), parallel);
+        } else {
+            DiffIndex3::sortIndex(p_outputdir, p_diffdir, IDX_POS, IDX_PSO,
+                                  idx1, all_p, all_o, all_s, map, qx, ufp.get(), true);
+        }
+
+        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+        LOG(DEBUGL) << "Runtime sort and create p* indices = " << sec.count() * 1000;
+    };
+
+    /**** Sort by OPS,OSP ****/
+    std::unique_ptr<UpdateStats> ufo;
+    auto buildO = [&]() {
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        Querier *qx = parallel ? qo.get() : q;
+        string o_outputdir = outputdir + "/o";
+        if (Utils::exists(o_outputdir)) {
+            Utils::remove_all(o_outputdir);
+        }
+        Utils::create_directories(o_outputdir);
+
+        if (update == TypeUpdate::ADDITION_df) {
+            ufo = std::unique_ptr<UpdateStats>(new UpdateStats_add(qx, IDX_OPS, IDX_OSP, false, true));
+        } else {
+            ufo = std::unique_ptr<UpdateStats>(new UpdateStats_rm(qx, IDX_OPS, IDX_OSP, false, true));
+        }
+        string o_diffdir = diffdir + "/o";
+        Utils::create_directories(o_diffdir);
+        if (presort) {
+            if (!parallel) {
+                sortO.wait();
+            }
+            DiffIndex3::sortIndex(o_outputdir, o_diffdir, IDX_OPS, IDX_OSP,
+                                  idxO, all_o, all_p, all_s, map, qx, ufo.get(), parallel);
+        } else {
+            DiffIndex3::sortIndex(o_outputdir, o_diffdir, IDX_OPS, IDX_OSP,
+                                  idx1, all_o, all_p, all_s, map, qx, ufo.get(), true);
+        }
+
+        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+        LOG(DEBUGL) << "Runtime sort and create o* indices = " << sec.count() * 1000;
+    };
+
+    std::future<void> builtP;
+    std::future<void> builtO;
+    if (parallel) {
+        builtP = std::async(std::launch::async, buildP);
+        builtO = std::async(std::launch::async, buildO);
+    }
+
     /**** Sort by SPO,SOP ****/
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-    Utils::create_directories(outputdir);
     string s_outputdir = outputdir + "/s";
     if (Utils::exists(s_outputdir)) {
         Utils::remove_all(s_outputdir);
@@ -491,52 +572,14 @@ void DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate update,
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(DEBUGL) << "Runtime sort and create s* indices = " << sec.count() * 1000;
 
-    /**** Sort by POS,PSO ****/
-    start = std::chrono::system_clock::now();
-    string p_outputdir = outputdir + "/p";
-    if (Utils::exists(p_outputdir)) {
-        Utils::remove_all(p_outputdir);
-    }
-    Utils::create_directories(p_outputdir);
-    std::unique_ptr<UpdateStats> ufp;
-
-    if (update == TypeUpdate::ADDITION_df) {
-        ufp = std::unique_ptr<UpdateStats>(new UpdateStats_add(q, IDX_POS, IDX_PSO, true, true));
-    } else {
-        ufp = std::unique_ptr<UpdateStats>(new UpdateStats_rm(q, IDX_POS, IDX_PSO, true, true));
-    }
-    string p_diffdir = diffdir + "/p";
-    Utils::create_directories(p_diffdir);
-    // sec = std::chrono::system_clock::now() - start;
-    // LOG(DEBUGL) << "After create directories: " << sec.count() * 1000;
-    DiffIndex3::sortIndex(p_outputdir, p_diffdir, IDX_POS, IDX_PSO,
-                          idx1, all_p, all_o, all_s, map, q, ufp.get(), true);
-
-    sec = std::chrono::system_clock::now() - start;
-    LOG(DEBUGL) << "Runtime sort and create p* indices = " << sec.count() * 1000;
-
-    /**** Sort by OPS,OSP ****/
-    start = std::chrono::system_clock::now();
-    string o_outputdir = outputdir + "/o";
-    if (Utils::exists(o_outputdir)) {
-        Utils::remove_all(o_outputdir);
-    }
-    Utils::create_directories(o_outputdir);
-    std::unique_ptr<UpdateStats> ufo;
-
-    if (update == TypeUpdate::ADDITION_df) {
-        ufo = std::unique_ptr<UpdateStats>(new UpdateStats_add(q, IDX_OPS, IDX_OSP, false, true));
+    if (parallel) {
+        //Rethrows the errors of the threads
+        builtP.get();
+        builtO.get();
     } else {
-        ufo = std::unique_ptr<UpdateStats>(new UpdateStats_rm(q, IDX_OPS, IDX_OSP, false, true));
+        buildP();
+        buildO();
     }
-    string o_diffdir = diffdir + "/o";
-    Utils::create_directories(o_diffdir);
-    DiffIndex3::sortIndex(o_outputdir, o_diffdir, IDX_OPS, IDX_OSP,
-                          idx1, all_o, all_p, all_s, map, q, ufo.get(), true);
-
-
-    sec = std::chrono::system_clock::now() - start;
-    LOG(DEBUGL) << "Runtime sort and create o* indices = " << sec.count() * 1000;
 
     /**** Sort the inverted pairs ****/
     start = std::chrono::system_clock::now();
@@ -695,6 +738,36 @@ void DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate update,
     sec = std::chrono::system_clock::now() - start;
     LOG(DEBUGL) << "Runtime to write the B+Trees on disk = " << sec.count() * 1000;
 
+    //Filters on the keys, used by the querier to skip the diff
+    start = std::chrono::system_clock::now();
+    {
+        const std::vector<UpdateStats::KeyInfo> *allkeys[3] = { &keysS, &keysP, &keysO };
+        const string names[3] = { "/s", "/p", "/o" };
+        for (int i = 0; i < 3; ++i) {
+            KeyFilter filter;
+            filter.init(allkeys[i]->size());
+            for (const auto &k : *allkeys[i]) {
+                filter.add(k.key);
+            }
+            filter.store(outputdir + names[i] + "/filter");
+        }
+    }
+    sec = std::chrono::system_clock::now() - start;
+    LOG(DEBUGL) << "Runtime to write the key filters = " << sec.count() * 1000;
+
+    //Statistics for the planner: per-predicate counts and a sample
+    {
+        DiffStats stats;
+        for (const auto &k : keysP) {
+            //In POS the first terms are the objects, in PSO the subjects
+            stats.addPredicate(k.key, k.nelements, k.nfirsts2, k.nfirsts1);
+        }
+        if (samplesize > 0) {
+            stats.setSample(all_s, all_p, all_o, samplesize);
+        }
+        stats.store(outputdir + "/diffstats");
+    }
+
     //Write some general statistics for the S* indices
     char buffer[8];
     ofstream f;
@@ -1375,9 +1448,9 @@ size_t DiffIndex3::sortIndex(string outputdir,
                              PropertyMap & map,
                              Querier * q,
                              UpdateStats *statsFirstTerms,
-                             const bool sort) {
+                             const bool sortFirstColumn) {
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-    if (sort) {
+    if (sortFirstColumn) {
         std::sort(idx1.begin(), idx1.end(), _Sorter(firstcolumn));
     }
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
@@ -1433,7 +1506,7 @@ size_t DiffIndex3::sortIndex(string outputdir,
 
         if (first != prevkey) {
             //Sort the previous group
-            if (sort && tmp1.size() > 1) {
+            if (tmp1.size() > 1) {
                 if (tmp1.size() == 2) {
                     if (tmp1[0] > tmp1[1]) {
                         uint64_t box = tmp1[0];
@@ -1473,7 +1546,7 @@ size_t DiffIndex3::sortIndex(string outputdir,
         i++;
     }
     if (!tmp1.empty()) {
-        if (sort) {
+        if (tmp1.size() > 1) {
             std::sort(tmp1.begin(), tmp1.end());
             std::sort(tmp2.begin(), tmp2.end());
             nsorts++;
@@ -1508,6 +1581,9 @@ int64_t DiffIndex3::getSize() const {
 }
 
 int64_t DiffIndex3::getCard(int idx, int64_t first) const {
+    if (!keyFilters[idx]->mayContain(first)) {
+        return 0;
+    }
     TermCoordinates coord;
     if (idx == IDX_SPO || idx == IDX_SOP) {
         if (s->get(first, &coord)) {
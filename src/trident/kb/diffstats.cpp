@@ -0,0 +1,142 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/diffstats.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <random>
+#include <algorithm>
+
+void DiffStats::addPredicate(uint64_t p, uint64_t ntriples,
+        uint64_t nsubjects, uint64_t nobjects) {
+    if (!predicates.empty() && predicates.back().p >= p) {
+        LOG(ERRORL) << "The predicates must be added in increasing order";
+        throw 10;
+    }
+    PredicateStats stats;
+    stats.p = p;
+    stats.ntriples = ntriples;
+    stats.nsubjects = nsubjects;
+    stats.nobjects = nobjects;
+    predicates.push_back(stats);
+}
+
+const DiffStats::PredicateStats *DiffStats::getPredicate(uint64_t p) const {
+    auto itr = std::lower_bound(predicates.begin(), predicates.end(), p,
+            [](const PredicateStats &s, uint64_t p) { return s.p < p; });
+    if (itr != predicates.end() && itr->p == p) {
+        return &(*itr);
+    }
+    return NULL;
+}
+
+void DiffStats::setSample(const std::vector<uint64_t> &all_s,
+        const std::vector<uint64_t> &all_p,
+        const std::vector<uint64_t> &all_o,
+        size_t samplesize) {
+    sample.clear();
+    const size_t n = all_s.size();
+    if (samplesize > n) {
+        samplesize = n;
+    }
+    //Algorithm R. The seed is fixed so that the same update gives the
+    //same sample
+    std::vector<size_t> reservoir(samplesize);
+    std::mt19937_64 gen(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i < samplesize) {
+            reservoir[i] = i;
+        } else {
+            std::uniform_int_distribution<size_t> dist(0, i);
+            const size_t j = dist(gen);
+            if (j < samplesize) {
+                reservoir[j] = i;
+            }
+        }
+    }
+    std::sort(reservoir.begin(), reservoir.end());
+    sample.reserve(samplesize * 3);
+    for (auto i : reservoir) {
+        sample.push_back(all_s[i]);
+        sample.push_back(all_p[i]);
+        sample.push_back(all_o[i]);
+    }
+}
+
+void DiffStats::store(std::string file) const {
+    std::ofstream f(file, std::ios_base::binary);
+    char buffer[8];
+    Utils::encode_long(buffer, predicates.size());
+    f.write(buffer, 8);
+    for (auto &s : predicates) {
+        Utils::encode_long(buffer, s.p);
+        f.write(buffer, 8);
+        Utils::encode_long(buffer, s.ntriples);
+        f.write(buffer, 8);
+        Utils::encode_long(buffer, s.nsubjects);
+        f.write(buffer, 8);
+        Utils::encode_long(buffer, s.nobjects);
+        f.write(buffer, 8);
+    }
+    Utils::encode_long(buffer, sample.size());
+    f.write(buffer, 8);
+    for (auto v : sample) {
+        Utils::encode_long(buffer, v);
+        f.write(buffer, 8);
+    }
+}
+
+bool DiffStats::load(std::string file, bool withSample) {
+    predicates.clear();
+    sample.clear();
+    if (!Utils::exists(file)) {
+        return false;
+    }
+    std::ifstream f(file, std::ios_base::binary);
+    char buffer[32];
+    f.read(buffer, 8);
+    const uint64_t npredicates = Utils::decode_long(buffer);
+    predicates.resize(npredicates);
+    for (uint64_t i = 0; i < npredicates; ++i) {
+        f.read(buffer, 32);
+        predicates[i].p = Utils::decode_long(buffer);
+        predicates[i].ntriples = Utils::decode_long(buffer + 8);
+        predicates[i].nsubjects = Utils::decode_long(buffer + 16);
+        predicates[i].nobjects = Utils::decode_long(buffer + 24);
+    }
+    f.read(buffer, 8);
+    const uint64_t nsample = withSample ? Utils::decode_long(buffer) : 0;
+    sample.resize(nsample);
+    for (uint64_t i = 0; i < nsample; ++i) {
+        f.read(buffer, 8);
+        sample[i] = Utils::decode_long(buffer);
+    }
+    if (!f) {
+        LOG(ERRORL) << "The file " << file << " is truncated";
+        throw 10;
+    }
+    return true;
+}
@@ -120,6 +120,17 @@ std::string Inserter::getPathPermutationStorage(const int perm) {
     return files[perm]->getPath();
 }
 
+int64_t Inserter::getNTriplesInserted(const int permutation) {
+    return files[permutation]->getNTriplesInserted();
+}
+
+void Inserter::restoreCounters(const int permutation, const int64_t ntables,
+        const int64_t nFirstTables, const int64_t nTriples) {
+    this->ntables[permutation] = ntables;
+    nFirstElsNTables[permutation] = nFirstTables;
+    files[permutation]->setNTriplesInserted(nTriples);
+}
+
 int64_t Inserter::getCoordinatesForPOS(const int p) {
     int64_t coordinates = ((int64_t) (strategies[p] & 0xFF) << 48) + ((int64_t) fileIdx[p] << 32)
         + startPositions[p];
@@ -130,6 +141,10 @@ void Inserter::insert(nTerm key, TermCoordinates *value) {
     tree->put(key, value);
 }
 
+void Inserter::bulkInsert(std::vector<TermCoordinatesSource*> &sources) {
+    tree->bulkLoad(sources);
+}
+
 void Inserter::writeCurrentEntryIntoTree(int permutation,
         TripleWriter *posArray, TreeInserter *treeInserter,
         const bool aggregated,
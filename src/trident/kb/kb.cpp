@@ -24,6 +24,8 @@
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 #include <trident/kb/inserter.h>
+#include <trident/kb/compactor.h>
+#include <trident/kb/updater.h>
 #include <trident/kb/consts.h>
 #include <trident/kb/kbconfig.h>
 #include <trident/tree/root.h>
@@ -37,6 +39,7 @@
 #include <stdlib.h>
 #include <cmath>
 #include <chrono>
+#include <thread>
 
 using namespace std;
 
@@ -52,18 +55,16 @@ KB::KB(const char *path,
         bool dictEnabled,
         KBConfig &config,
         std::vector<string> locationUpdates) :
-    path(path), readOnly(readOnly), isClosed(false), ntables(), nFirstTables(),
-    dictEnabled(dictEnabled), config(config) {
-
-        if (readOnly && !Utils::exists(string(path) + DIR_SEP + "tree")) {
-            LOG(ERRORL) << "The input path does not seem to be a valid KB";
-            throw 10;
-        }
+    path(path), readOnly(readOnly), isClosed(false), dictManager(NULL),
+    statsVersion(0), dictEnabled(dictEnabled), config(config) {
 
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
         //Get statistics and configuration
         string fileConf = path + DIR_SEP + string("kbstats");
+        int64_t ntables[N_PARTITIONS];
+        int64_t nFirstTables[N_PARTITIONS];
+        int64_t generation = 0;
         if (Utils::exists(fileConf)) {
             std::ifstream fis;
             fis.open(fileConf);
@@ -104,8 +105,17 @@ KB::KB(const char *path,
             fis.read(data, 1);
             relsIDsSep = data[0];
 
+            //The generation of the base. The KBs that were never compacted
+            //may not have it
+            if (fis.read(data, 8)) {
+                generation = Utils::decode_long(data, 0);
+            }
+
             fis.close();
         } else {
+            for (int i = 0; i < N_PARTITIONS; ++i) {
+                ntables[i] = nFirstTables[i] = 0;
+            }
             dictPartitions = config.getParamInt(DICTPARTITIONS);
             dictHash = config.getParamBool(DICTHASH);
             totalNumberTerms = 0;
@@ -128,39 +138,19 @@ KB::KB(const char *path,
             MemoryOptimizer::optimizeForReading(dictPartitions, config);
         }
 
-        //Initialize the tree
-        string fileTree = path + DIR_SEP + string("tree") + DIR_SEP;
-        string flatTree = fileTree + string("flat");
-        if (readOnly && Utils::exists(flatTree)) {
-            tree = new FlatRoot(flatTree, graphType != GraphType::DEFAULT, graphType == GraphType::UNDIRECTED);
-        } else {
-            PropertyMap map;
-            map.setBool(TEXT_KEYS, false);
-            map.setBool(TEXT_VALUES, false);
-            map.setBool(COMPRESSED_NODES, false);
-            map.setInt(LEAF_SIZE_PREALL_FACTORY,
-                    config.getParamInt(TREE_MAXPREALLLEAVESCACHE));
-            map.setInt(LEAF_SIZE_FACTORY, config.getParamInt(TREE_MAXLEAVESCACHE));
-            map.setInt(MAX_NODES_IN_CACHE, config.getParamInt(TREE_MAXNODESINCACHE));
-            map.setInt(NODE_MIN_BYTES, config.getParamInt(TREE_NODEMINBYTES));
-            map.setLong(CACHE_MAX_SIZE, config.getParamLong(TREE_MAXSIZECACHETREE));
-            map.setInt(FILE_MAX_SIZE, config.getParamInt(TREE_MAXFILESIZE));
-            map.setInt(MAX_N_OPENED_FILES, config.getParamInt(TREE_MAXNFILES));
-            map.setInt(MAX_EL_PER_NODE, config.getParamInt(TREE_MAXELEMENTSNODE));
-
-            map.setInt(LEAF_MAX_PREALL_INTERNAL_LINES,
-                    config.getParamInt(TREE_MAXPREALLINTERNALLINES));
-            map.setInt(LEAF_MAX_INTERNAL_LINES,
-                    config.getParamInt(TREE_MAXINTERNALLINES));
-            map.setInt(LEAF_ARRAYS_FACTORY_SIZE, config.getParamInt(TREE_FACTORYSIZE));
-            map.setInt(LEAF_ARRAYS_PREALL_FACTORY_SIZE,
-                    config.getParamInt(TREE_ALLOCATEDELEMENTS));
-
-            map.setInt(NODE_KEYS_FACTORY_SIZE,
-                    config.getParamInt(TREE_NODE_KEYS_FACTORY_SIZE));
-            map.setInt(NODE_KEYS_PREALL_FACTORY_SIZE,
-                    config.getParamInt(TREE_NODE_KEYS_PREALL_FACTORY_SIZE));
-            tree = new Root(fileTree, NULL, readOnly, map);
+        //Remove what a compaction left behind
+        KBCompactor::recover(path, generation);
+        if (readOnly && !Utils::exists(KBCompactor::getBaseDir(path,
+                        generation) + DIR_SEP + "tree")) {
+            LOG(ERRORL) << "The input path does not seem to be a valid KB";
+            throw 10;
+        }
+
+        //Initialize the tree and the storage partitions
+        std::shared_ptr<KBBase> base = openBase(generation);
+        for (int i = 0; i < N_PARTITIONS; ++i) {
+            base->ntables[i] = ntables[i];
+            base->nFirstTables[i] = nFirstTables[i];
         }
 
         std::chrono::duration<double> sec = std::chrono::system_clock::now()
@@ -178,48 +168,6 @@ KB::KB(const char *path,
                     dictHash, string(path) + DIR_SEP + "e2r", string(path) + DIR_SEP + "e2s");
         }
 
-        //Initialize the memory tracker for the storage partitions
-        bytesTracker[0] = new MemoryManager<FileDescriptor>(
-                config.getParamLong(STORAGE_CACHE_SIZE));
-        for (int i = 1; i < nindices; ++i) {
-            if (!readOnly) {
-                bytesTracker[i] = new MemoryManager<FileDescriptor>(
-                        config.getParamLong(STORAGE_CACHE_SIZE));
-            } else {
-                bytesTracker[i] = NULL;
-            }
-        }
-
-        if (nindices == 3) {
-            pso = new CacheIdx();
-            osp = new CacheIdx();
-        } else {
-            pso = NULL;
-            osp = NULL;
-        }
-
-        //Initialize the storage partitions
-        for (int i = 0; i < nindices; ++i) {
-            stringstream is;
-            is << path << DIR_SEP << "p" << i;
-            if (readOnly) {
-                //Check if there are actually files in the directory
-                if  (!Utils::isEmpty(is.str())) {
-                    files[i] = new TableStorage(readOnly, is.str(),
-                            config.getParamLong(STORAGE_MAX_FILE_SIZE),
-                            config.getParamInt(STORAGE_MAX_N_FILES),
-                            NULL, stats, i);
-                } else {
-                    files[i] = NULL;
-                }
-            } else {
-                files[i] = new TableStorage(readOnly, is.str(),
-                        config.getParamLong(STORAGE_MAX_FILE_SIZE),
-                        config.getParamInt(STORAGE_MAX_N_FILES),
-                        bytesTracker[i], stats, i);
-            }
-        }
-
         //Is there some sample data available?
         string sampleDir = path + DIR_SEP + string("_sample");
         if (Utils::exists(sampleDir)) {
@@ -232,7 +180,11 @@ KB::KB(const char *path,
         }
 
         string defaultDiffDir = path + DIR_SEP + string("_diff");
+        std::shared_ptr<KBSnapshot> first(new KBSnapshot());
+        first->base = base;
         if (Utils::exists(defaultDiffDir)) {
+            //Complete or discard a merge interrupted by a crash
+            applyMerge(defaultDiffDir);
             std::vector<string> files = Utils::getSubdirs(defaultDiffDir);
             std::vector<string> childrenupdates;
             for (int i = 0; i < files.size(); ++i) {
@@ -247,70 +199,160 @@ KB::KB(const char *path,
             }
 
             if (!childrenupdates.empty()) {
-                std::vector<const char *> globalbuffers;
-                globalbuffers.resize(6);
-                //Instantiate the buffers
-                for (int i = 0; i < 6; ++i)
-                    globalbuffers[0] = NULL;
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p0")) {
-                    spo_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_SPO] = spo_f->getBuffer();
-                }
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p1")) {
-                    sop_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_SOP] = sop_f->getBuffer();
-                }
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p0")) {
-                    pos_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_POS] = pos_f->getBuffer();
-                }
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p1")) {
-                    pso_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_PSO] = pso_f->getBuffer();
-                }
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p0")) {
-                    ops_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_OPS] = ops_f->getBuffer();
-                }
-                if (Utils::exists(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p1")) {
-                    osp_f = std::unique_ptr<ROMappedFile>(
-                            new ROMappedFile(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_OSP] = osp_f->getBuffer();
-                }
+                std::shared_ptr<ROMappedFile> globalfiles[6];
+                mapGlobalDiffFiles(globalfiles);
 
                 //Sort them by numeric value
                 sort(childrenupdates.begin(), childrenupdates.end(), _sort_by_number);
                 for (int i = 0; i < childrenupdates.size(); ++i) {
                     std::chrono::system_clock::time_point startDiff = std::chrono::system_clock::now();
-                    addDiffIndex(childrenupdates[i], &globalbuffers[0], NULL);
+                    addDiffIndex(childrenupdates[i], globalfiles, *first);
                     sec = std::chrono::system_clock::now() - startDiff;
                     LOG(DEBUGL) << "Time loading diff index " << sec.count() * 1000 << "ms.";
                 }
             }
-            if (!dictUpdates.empty()) {
+            std::vector<DictMgmt::Dict> &dictUpdates = first->dictUpdates;
+            if (!dictUpdates.empty() && dictManager) {
                 dictManager->addUpdates(dictUpdates);
                 //update total number of terms and nextID fields
                 for (auto itr = dictUpdates.begin(); itr != dictUpdates.end(); ++itr) {
                     totalNumberTerms += itr->size;
-                    nextID = max(nextID, itr->nextid);
+                    nextID = max(nextID.load(), itr->nextid);
                 }
             }
             //check also the global dictionary container in dictmanager
-            totalNumberTerms += dictManager->getGUDSize();
-            nextID = max(nextID, (int64_t) dictManager->getLargestGUDTerm() + 1);
+            //(the sample KB has no dictionary)
+            if (dictManager) {
+                totalNumberTerms += dictManager->getGUDSize();
+                nextID = max(nextID.load(),
+                        (int64_t) dictManager->getLargestGUDTerm() + 1);
+            }
         }
 
+        first->memtable = std::shared_ptr<MemTable>(new MemTable(
+                    defaultDiffDir + DIR_SEP + "wal"));
+        publishSnapshot(first);
+
+        //Re-apply the single-triple updates that were not flushed
+        if (dictEnabled && Utils::exists(defaultDiffDir + DIR_SEP + "wal")) {
+            std::shared_ptr<KBSnapshot> next(new KBSnapshot(*getSnapshot()));
+            int64_t nextid = nextID;
+            int64_t nterms = totalNumberTerms;
+            next->memtable->replay(dictManager, nextid, nterms,
+                    getUpdatesQuerier());
+            nextID = nextid;
+            totalNumberTerms = nterms;
+            //Publish the new number of terms
+            publishSnapshot(next);
+        }
+
+        unsigned nthreads = std::thread::hardware_concurrency();
+        querierPool = std::unique_ptr<QuerierPool>(new QuerierPool(this,
+                    nthreads > 0 ? 2 * nthreads : 16));
+
         sec = std::chrono::system_clock::now() - start;
         LOG(DEBUGL) << "Time init KB = " << sec.count() * 1000 << " ms and " << Utils::get_max_mem() << " MB occupied";
     }
 
+std::shared_ptr<KBBase> KB::openBase(int64_t generation) {
+    std::shared_ptr<KBBase> base(new KBBase(path, generation));
+    const string dir = base->getDir();
+
+    string fileTree = dir + DIR_SEP + string("tree") + DIR_SEP;
+    string flatTree = fileTree + string("flat");
+    if (readOnly && Utils::exists(flatTree)) {
+        base->tree = new FlatRoot(flatTree, graphType != GraphType::DEFAULT,
+                graphType == GraphType::UNDIRECTED);
+    } else {
+        base->tree = newTree(fileTree, readOnly);
+    }
+
+    //Initialize the memory tracker for the storage partitions
+    base->bytesTracker[0] = new MemoryManager<FileDescriptor>(
+            config.getParamLong(STORAGE_CACHE_SIZE));
+    for (int i = 1; i < nindices; ++i) {
+        if (!readOnly) {
+            base->bytesTracker[i] = new MemoryManager<FileDescriptor>(
+                    config.getParamLong(STORAGE_CACHE_SIZE));
+        } else {
+            base->bytesTracker[i] = NULL;
+        }
+    }
+
+    //Tables of the permutations that are rebuilt from the reverse ones
+    const int64_t reverseCacheSize = config.getParamLong(REVERSE_CACHE_SIZE);
+    if (reverseCacheSize > 0) {
+        base->reverseCache = new CacheIdx(reverseCacheSize);
+    }
+
+    //Initialize the storage partitions
+    for (int i = 0; i < nindices; ++i) {
+        stringstream is;
+        is << dir << DIR_SEP << "p" << i;
+        if (readOnly) {
+            //Check if there are actually files in the directory
+            if  (!Utils::isEmpty(is.str())) {
+                base->files[i] = new TableStorage(readOnly, is.str(),
+                        config.getParamLong(STORAGE_MAX_FILE_SIZE),
+                        config.getParamInt(STORAGE_MAX_N_FILES),
+                        NULL, stats, i);
+            }
+        } else {
+            base->files[i] = new TableStorage(readOnly, is.str(),
+                    config.getParamLong(STORAGE_MAX_FILE_SIZE),
+                    config.getParamInt(STORAGE_MAX_N_FILES),
+                    base->bytesTracker[i], stats, i);
+        }
+    }
+    return base;
+}
+
+std::string KBBase::getDir() const {
+    return KBCompactor::getBaseDir(path, generation);
+}
+
+KBBase::~KBBase() {
+    if (tree != NULL) {
+        delete tree;
+    }
+    for (int i = 0; i < N_PARTITIONS; ++i) {
+        if (files[i] != NULL) {
+            delete files[i];
+        }
+    }
+    // Delete bytesTrackers after deleting all files, because
+    // in read-only case, all files share the same bytesTracker. --Ceriel
+    for (int i = 0; i < N_PARTITIONS; ++i) {
+        if (bytesTracker[i] != NULL) {
+            delete bytesTracker[i];
+        }
+    }
+    if (reverseCache != NULL) {
+        LOG(DEBUGL) << "Reverse cache: " << reverseCache->getHits() << " hits, "
+            << reverseCache->getMisses() << " misses, "
+            << reverseCache->getEvictions() << " evictions, "
+            << reverseCache->getMemoryUsage() << " bytes";
+        delete reverseCache;
+    }
+    //No snapshot refers to it anymore
+    if (obsolete) {
+        KBCompactor::removeBase(path, generation);
+    }
+}
+
 Root *KB::getRootTree() {
-    string fileTree = path + DIR_SEP + string("tree") + DIR_SEP;
+    return getRootTree(*getSnapshot()->base);
+}
+
+Root *KB::getRootTree(const KBBase &base) {
+    return newTree(base.getDir() + DIR_SEP + string("tree") + DIR_SEP, true);
+}
+
+Root *KB::getSampleRootTree() {
+    return sampleKB ? sampleKB->getRootTree() : NULL;
+}
+
+Root *KB::newTree(string fileTree, bool readOnly) {
     PropertyMap map;
     map.setBool(TEXT_KEYS, false);
     map.setBool(TEXT_VALUES, false);
@@ -337,7 +379,7 @@ Root *KB::getRootTree() {
             config.getParamInt(TREE_NODE_KEYS_FACTORY_SIZE));
     map.setInt(NODE_KEYS_PREALL_FACTORY_SIZE,
             config.getParamInt(TREE_NODE_KEYS_PREALL_FACTORY_SIZE));
-    return new Root(fileTree, NULL, true, map);
+    return new Root(fileTree, NULL, readOnly, map);
 }
 
 void KB::loadDict(KBConfig *config) {
@@ -394,9 +436,238 @@ void KB::loadDict(KBConfig *config) {
 }
 
 Querier *KB::query() {
-    return new Querier(tree, dictManager, files, totalNumberTriples,
-            totalNumberTerms, nindices, ntables, nFirstTables,
-            sampleKB, diffIndices);
+    std::shared_ptr<const KBSnapshot> s = getSnapshot();
+    return query(s, s->base->tree, NULL);
+}
+
+Querier *KB::query(std::shared_ptr<const KBSnapshot> s, Root *tree,
+        Root *sampleTree) {
+    KBBase &base = *s->base;
+    //The terms added by single-triple updates are counted in place, without
+    //a new snapshot
+    Querier *q = new Querier(tree, dictManager, base.files,
+            s->totalNumberTriples, totalNumberTerms, nindices, base.ntables,
+            base.nFirstTables, sampleTree ? NULL : sampleKB, s);
+    if (sampleTree) {
+        q->setSampler(sampleKB->query(sampleKB->getSnapshot(), sampleTree,
+                    NULL));
+    }
+    q->setMemTable(s->memtable.get());
+    q->setReverseCache(base.reverseCache);
+    return q;
+}
+
+Querier *KB::getUpdatesQuerier() {
+    //It does not read the memtable
+    if (!updatesQuerier) {
+        std::shared_ptr<const KBSnapshot> s = getSnapshot();
+        KBBase &base = *s->base;
+        updatesQuerier = std::unique_ptr<Querier>(new Querier(base.tree,
+                    dictManager, base.files, s->totalNumberTriples,
+                    s->totalNumberTerms, nindices, base.ntables,
+                    base.nFirstTables, sampleKB, s));
+        updatesQuerier->setReverseCache(base.reverseCache);
+    }
+    return updatesQuerier.get();
+}
+
+void KB::publishSnapshot(std::shared_ptr<KBSnapshot> next) {
+    std::shared_ptr<const KBSnapshot> current = getSnapshot();
+    next->version = current ? current->version + 1 : 0;
+    next->totalNumberTriples = totalNumberTriples;
+    next->totalNumberTerms = totalNumberTerms;
+    next->nextID = nextID;
+    std::atomic_store(&snapshot, std::shared_ptr<const KBSnapshot>(next));
+    statsVersion++;
+    //It must see the new diffs. The snapshots are published only when the
+    //diffs or the memtable are replaced
+    updatesQuerier = NULL;
+    LOG(DEBUGL) << "Published the snapshot " << next->version << " with " <<
+        next->diffIndices.size() << " diffs";
+}
+
+void KB::mapGlobalDiffFiles(std::shared_ptr<ROMappedFile> *globalfiles) {
+    static const int perms[] = { IDX_SPO, IDX_SOP, IDX_POS, IDX_PSO, IDX_OPS,
+        IDX_OSP };
+    static const char *dirs[] = { "s", "s", "p", "p", "o", "o" };
+    static const char *names[] = { "p0", "p1", "p0", "p1", "p0", "p1" };
+
+    //The diffs loaded before keep their own mapping, which is released with
+    //them
+    const string diffDir = path + DIR_SEP + string("_diff");
+    for (int i = 0; i < 6; ++i) {
+        globalfiles[perms[i]] = NULL;
+        const string file = diffDir + DIR_SEP + dirs[i] + DIR_SEP + names[i];
+        if (Utils::exists(file)) {
+            globalfiles[perms[i]] = std::shared_ptr<ROMappedFile>(
+                    new ROMappedFile(file));
+        }
+    }
+}
+
+bool KB::updateTriple(DiffIndex::TypeUpdate type, const std::string &s,
+        const std::string &p, const std::string &o) {
+    if (!dictEnabled || relsIDsSep) {
+        LOG(ERRORL) << "Single-triple updates require the dictionary and do not support relations with their own IDs";
+        throw 10;
+    }
+    const std::string *terms[3] = { &s, &p, &o };
+    for (int i = 0; i < 3; ++i) {
+        if (terms[i]->size() > MAX_TERM_SIZE) {
+            LOG(ERRORL) << "The terms of an update cannot be longer than " <<
+                MAX_TERM_SIZE << " bytes";
+            throw 10;
+        }
+    }
+    std::lock_guard<std::mutex> lock(updatesMutex);
+    MemTable *memtable = getSnapshot()->memtable.get();
+    int64_t ids[3];
+    bool newTerms = false;
+    for (int i = 0; i < 3; ++i) {
+        nTerm id;
+        if (dictManager->getNumber(terms[i]->c_str(), terms[i]->size(), &id)) {
+            ids[i] = id;
+        } else if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+            ids[i] = nextID++;
+            totalNumberTerms++;
+            newTerms = true;
+            memtable->logTerm(ids[i], terms[i]->c_str(), terms[i]->size());
+            dictManager->putInUpdateDict(ids[i], terms[i]->c_str(),
+                    terms[i]->size());
+        } else {
+            //The triple does not exist
+            return false;
+        }
+    }
+    //The new terms do not change the diffs, so they do not publish a new
+    //snapshot: the updates querier and the pooled queriers stay valid. The
+    //counts of the memtable are in the statistics of the planner, so the
+    //cached plans do not
+    const bool changed = memtable->update(type, ids[0], ids[1], ids[2],
+            getUpdatesQuerier());
+    if (changed || newTerms) {
+        statsVersion++;
+    }
+    if (memtable->getSize() >=
+            (uint64_t) config.getParamLong(MEMTABLE_MAX_TRIPLES)) {
+        storeMemTable();
+    }
+    return changed;
+}
+
+void KB::flushMemTable() {
+    std::lock_guard<std::mutex> lock(updatesMutex);
+    storeMemTable();
+}
+
+void KB::storeMemTable() {
+    std::shared_ptr<const KBSnapshot> current = getSnapshot();
+    MemTable *memtable = current->memtable.get();
+    if (memtable->isEmpty()) {
+        return;
+    }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    Querier *q = getUpdatesQuerier();
+    const string diffDir = path + DIR_SEP + string("_diff");
+    Utils::create_directories(diffDir);
+    //The diffs can refer to the terms introduced by the updates
+    dictManager->storeGUD();
+
+    const DiffIndex::TypeUpdate types[] = { DiffIndex::TypeUpdate::DELETE_df,
+        DiffIndex::TypeUpdate::ADDITION_df };
+    std::vector<string> dirs;
+    for (auto type : types) {
+        std::vector<uint64_t> all_s, all_p, all_o;
+        memtable->getTriples(type, all_s, all_p, all_o);
+        if (all_s.empty()) {
+            continue;
+        }
+        string dir = Updater::getPathForUpdate(path);
+        DiffIndex3::createDiffIndex(type, dir, diffDir, all_s, all_p, all_o,
+                true, q, true);
+        ofstream flag(dir + DIR_SEP + (type ==
+                    DiffIndex::TypeUpdate::ADDITION_df ? "ADD" : "DEL"));
+        flag.close();
+        dirs.push_back(dir);
+
+        //The removed triples leave the sample. The added ones enter it at
+        //the rate of the sample
+        if (sampleKB != NULL) {
+            std::vector<uint64_t> sample_s, sample_p, sample_o;
+            for (size_t i = 0; i < all_s.size(); ++i) {
+                if (type == DiffIndex::TypeUpdate::DELETE_df ||
+                        (all_s[i] * 31 + all_p[i] * 17 + all_o[i]) % 10000 <
+                        sampleRate * 10000) {
+                    sample_s.push_back(all_s[i]);
+                    sample_p.push_back(all_p[i]);
+                    sample_o.push_back(all_o[i]);
+                }
+            }
+            updateSample(type, sample_s, sample_p, sample_o);
+        }
+    }
+
+    //The new diffs and an empty memtable replace the current memtable in a
+    //single step. The queriers created before keep reading the old one
+    std::shared_ptr<KBSnapshot> next(new KBSnapshot(*current));
+    std::shared_ptr<ROMappedFile> globalfiles[6];
+    mapGlobalDiffFiles(globalfiles);
+    for (const auto &dir : dirs) {
+        addDiffIndex(dir, globalfiles, *next);
+    }
+    next->memtable = std::shared_ptr<MemTable>(new MemTable(
+                diffDir + DIR_SEP + "wal"));
+    publishSnapshot(next);
+    //If the process crashes before this point, the triples that are already
+    //in the diffs are filtered out when the log is replayed
+    memtable->truncateLog();
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(DEBUGL) << "Time flushing the memtable " << sec.count() * 1000 << " ms.";
+}
+
+void KB::updateSample(DiffIndex::TypeUpdate type,
+        std::vector<uint64_t> &all_s, std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    if (sampleKB == NULL || all_s.empty()) {
+        return;
+    }
+    sampleKB->storeUpdate(type, all_s, all_p, all_o);
+}
+
+void KB::storeUpdate(DiffIndex::TypeUpdate type,
+        std::vector<uint64_t> &all_s, std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    std::lock_guard<std::mutex> lock(updatesMutex);
+    //Additions must be new and removals must refer to existing triples
+    Querier *q = getUpdatesQuerier();
+    std::vector<uint64_t> valid_s, valid_p, valid_o;
+    for (size_t i = 0; i < all_s.size(); ++i) {
+        if (q->exists(all_s[i], all_p[i], all_o[i]) ==
+                (type == DiffIndex::TypeUpdate::DELETE_df)) {
+            valid_s.push_back(all_s[i]);
+            valid_p.push_back(all_p[i]);
+            valid_o.push_back(all_o[i]);
+        }
+    }
+    if (valid_s.empty()) {
+        return;
+    }
+    const string diffDir = path + DIR_SEP + string("_diff");
+    Utils::create_directories(diffDir);
+    string dir = Updater::getPathForUpdate(path);
+    DiffIndex3::createDiffIndex(type, dir, diffDir, valid_s, valid_p, valid_o,
+            false, q, true);
+    ofstream flag(dir + DIR_SEP + (type ==
+                DiffIndex::TypeUpdate::ADDITION_df ? "ADD" : "DEL"));
+    flag.close();
+
+    std::shared_ptr<KBSnapshot> next(new KBSnapshot(*getSnapshot()));
+    std::shared_ptr<ROMappedFile> globalfiles[6];
+    mapGlobalDiffFiles(globalfiles);
+    addDiffIndex(dir, globalfiles, *next);
+    publishSnapshot(next);
+    LOG(DEBUGL) << "Stored an update of " << valid_s.size() << " triples in " <<
+        path;
 }
 
 Inserter *KB::insert() {
@@ -404,14 +675,15 @@ Inserter *KB::insert() {
         LOG(ERRORL) << "Insert() is not available if the knowledge base is opened in read_only mode.";
     }
 
-    return new Inserter(tree,
-            files,
+    KBBase &base = *getSnapshot()->base;
+    return new Inserter(base.tree,
+            base.files,
             totalNumberTerms + (dictEnabled ? dictManager->getNTermsInserted() : 0),
             useFixedStrategy,
             storageFixedStrategy,
             thresholdSkipTable,
-            ntables,
-            nFirstTables);
+            base.ntables,
+            base.nFirstTables);
 }
 
 void KB::closeMainDict() {
@@ -426,7 +698,7 @@ string KB::getDictPath(int i) {
 }
 
 TreeItr *KB::getItrTerms() {
-    return tree->itr();
+    return getSnapshot()->base->tree->itr();
 }
 
 Stats KB::getStats() {
@@ -441,23 +713,26 @@ void KB::close() {
     if (isClosed)
         return;
 
+    updatesQuerier = NULL;
+    if (querierPool) {
+        querierPool->clear();
+    }
+
     //Update stats about the KB
+    std::shared_ptr<const KBSnapshot> s = getSnapshot();
     if (!readOnly) {
         if (dictEnabled) {
             totalNumberTerms += dictManager->getNTermsInserted();
             nextID = dictManager->getLargestIDInserted() + 1;
         }
         if (this->graphType != GraphType::DEFAULT) {
-            totalNumberTriples += files[IDX_SOP]->getNTriplesInserted();
+            totalNumberTriples += s->base->files[IDX_SOP]->getNTriplesInserted();
         } else {
-            totalNumberTriples += files[IDX_SPO]->getNTriplesInserted();
+            totalNumberTriples += s->base->files[IDX_SPO]->getNTriplesInserted();
         }
+        storeStats(*s->base);
     }
 
-    if (tree != NULL) {
-        delete tree;
-        tree = NULL;
-    }
     if (dictEnabled) {
         if (dictManager != NULL) {
             dictManager->clean();
@@ -465,33 +740,10 @@ void KB::close() {
             dictManager = NULL;
         }
     }
-    for (int i = 0; i < nindices; ++i) {
-        if (files[i] != NULL) {
-            delete files[i];
-            files[i] = NULL;
-        }
-    }
 
-    // Delete bytesTrackers after deleting all files, because
-    // in read-only case, all files share the same bytesTracker. --Ceriel
-    for (int i = 0; i < nindices; ++i) {
-        if (bytesTracker[i] != NULL) {
-            delete bytesTracker[i];
-            bytesTracker[i] = NULL;
-        }
-    }
-
-    if (pso != NULL) {
-        delete pso;
-        pso = NULL;
-    }
-
-    if (osp != NULL) {
-        delete osp;
-        osp = NULL;
-    }
-
-    diffIndices.clear();
+    //The base is deleted with the last snapshot that refers to it
+    s = NULL;
+    std::atomic_store(&snapshot, std::shared_ptr<const KBSnapshot>());
     isClosed = true;
 }
 
@@ -502,66 +754,72 @@ KB::~KB() {
         delete sampleKB;
         sampleKB = NULL;
     }
+}
 
-    if (!readOnly) {
-        //Write a file with some statistics
-        std::ofstream fos;
-        fos.open(this->path + DIR_SEP + string("kbstats"));
-        char data[8];
-        //Write the number of dictionaries
-        Utils::encode_long(data, 0, dictPartitions);
-        fos.write(data, 8);
+void KB::storeStats(const KBBase &base) {
+    //Write a file with some statistics
+    std::ofstream fos;
+    fos.open(this->path + DIR_SEP + string("kbstats"));
+    char data[8];
+    //Write the number of dictionaries
+    Utils::encode_long(data, 0, dictPartitions);
+    fos.write(data, 8);
 
-        //Write the total number of terms
-        Utils::encode_long(data, 0, totalNumberTerms);
-        fos.write(data, 8);
+    //Write the total number of terms
+    Utils::encode_long(data, 0, totalNumberTerms);
+    fos.write(data, 8);
 
-        //Write the total number of triples
-        Utils::encode_long(data, 0, totalNumberTriples);
-        fos.write(data, 8);
+    //Write the total number of triples
+    Utils::encode_long(data, 0, totalNumberTriples);
+    fos.write(data, 8);
 
-        //Write the highest ID in the KB
-        Utils::encode_long(data, 0, nextID);
-        fos.write(data, 8);
+    //Write the highest ID in the KB
+    Utils::encode_long(data, 0, nextID);
+    fos.write(data, 8);
 
-        //Write number indices
-        Utils::encode_int(data, 0, nindices);
-        fos.write(data, 4);
+    //Write number indices
+    Utils::encode_int(data, 0, nindices);
+    fos.write(data, 4);
 
-        //Write aggregated indices
-        data[0] = aggrIndices ? 1 : 0;
-        fos.write(data, 1);
+    //Write aggregated indices
+    data[0] = aggrIndices ? 1 : 0;
+    fos.write(data, 1);
 
-        //Write whether the indices are complete or not
-        fos.put(incompleteIndices);
+    //Write whether the indices are complete or not
+    fos.put(incompleteIndices);
 
-        //Dict is hash based?
-        fos.put(dictHash);
+    //Dict is hash based?
+    fos.put(dictHash);
 
-        //Write the number of virtual tables per partition
-        for (int i = 0; i < N_PARTITIONS; ++i) {
-            Utils::encode_long(data, 0, ntables[i]);
-            fos.write(data, 8);
-            Utils::encode_long(data, 0, nFirstTables[i]);
-            fos.write(data, 8);
-        }
+    //Write the number of virtual tables per partition
+    for (int i = 0; i < N_PARTITIONS; ++i) {
+        Utils::encode_long(data, 0, base.ntables[i]);
+        fos.write(data, 8);
+        Utils::encode_long(data, 0, base.nFirstTables[i]);
+        fos.write(data, 8);
+    }
 
-        //Write down the type of the graph
-        Utils::encode_int(data, 0, (int)graphType);
-        fos.write(data, 4);
+    //Write down the type of the graph
+    Utils::encode_int(data, 0, (int)graphType);
+    fos.write(data, 4);
 
-        //Write down whether separate IDs were used for the relations
-        if (relsIDsSep) {
-            data[0] = 1;
-        } else {
-            data[0] = 0;
-        }
-        fos.write(data, 1);
-        fos.close();
+    //Write down whether separate IDs were used for the relations
+    if (relsIDsSep) {
+        data[0] = 1;
+    } else {
+        data[0] = 0;
     }
+    fos.write(data, 1);
+
+    //Write the generation of the base
+    Utils::encode_long(data, 0, base.generation);
+    fos.write(data, 8);
+    fos.close();
 }
 
-void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
+void KB::addDiffIndex(string inputdir,
+        std::shared_ptr<ROMappedFile> *globalfiles,
+        KBSnapshot &next) {
     DiffIndex::TypeUpdate type;
     if (Utils::exists(inputdir + DIR_SEP + "ADD")) {
         type = DiffIndex::TypeUpdate::ADDITION_df;
@@ -569,13 +827,19 @@ void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
         type = DiffIndex::TypeUpdate::DELETE_df;
     }
 
-    if (Utils::exists(inputdir + DIR_SEP + "type1")) {
-        diffIndices.push_back(std::unique_ptr<DiffIndex>(
+    //A compaction keeps only the dictionary of the updates it folds
+    const bool onlyDict = Utils::exists(inputdir + DIR_SEP + "DICT");
+    if (onlyDict) {
+        LOG(DEBUGL) << "Loading only the dictionary of " << inputdir;
+    } else if (Utils::exists(inputdir + DIR_SEP + "type1")) {
+        next.diffIndices.push_back(std::shared_ptr<DiffIndex>(
                     new DiffIndex1(inputdir, type)));
+        next.diffDirs.push_back(inputdir);
     } else {
-        diffIndices.push_back(std::unique_ptr<DiffIndex>(
-                    new DiffIndex3(inputdir, globalbuffers,
+        next.diffIndices.push_back(std::shared_ptr<DiffIndex>(
+                    new DiffIndex3(inputdir, globalfiles,
                         config, type)));
+        next.diffDirs.push_back(inputdir);
     }
 
     if (Utils::exists(inputdir + DIR_SEP + "dict")) {
@@ -598,16 +862,12 @@ void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
         fis.read(data, 8);
         ud.nextid = Utils::decode_long(data);
 
-        dictUpdates.push_back(ud);
-    }
-
-    if (q) {
-        q->initDiffIndex(diffIndices.back().get());
+        next.dictUpdates.push_back(ud);
     }
 }
 
 std::vector<const char*> KB::openAllFiles(int perm) {
-    return files[perm]->loadAllFiles();
+    return getSnapshot()->base->files[perm]->loadAllFiles();
 }
 
 void KB::createSingleUpdate(DiffIndex::TypeUpdate type, PairItr *itr, std::string dir, std::string diffDir, Querier *q) {
@@ -722,14 +982,20 @@ void KB::mergeUpdates() {
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
-    std::string diffDir = path + DIR_SEP + std::string("_newdiff");
-    std::string oldDiffDir = path + DIR_SEP + std::string("_diff");
+    //The diffs stored during the merge would be ordered before the merged
+    //ones when the KB is opened again, so the updates wait for the merge.
+    //The readers keep using the current snapshot
+    std::lock_guard<std::mutex> clock(compactionMutex);
+    std::lock_guard<std::mutex> lock(updatesMutex);
+    const std::string diffDir = path + DIR_SEP + std::string("_diff");
+
+    std::shared_ptr<const KBSnapshot> current = getSnapshot();
 
     // Count number of ADDITIONs and DELETEs.
     int addCount = 0;
     int rmCount = 0;
-    for (size_t i = 0; i < diffIndices.size(); ++i) {
-        if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
+    for (size_t i = 0; i < current->diffIndices.size(); ++i) {
+        if (current->diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
             addCount++;
         } else {
             rmCount++;
@@ -741,108 +1007,120 @@ void KB::mergeUpdates() {
         return;
     }
 
-    Querier *q = query();
+    //It does not read the memtable, which stays on top of the merged diffs
+    Querier *q = getUpdatesQuerier();
     // Create the single updates with respect to a querier that does not have the diffIndices.
     // Create querier with empty diffs
-    std::vector<std::unique_ptr<DiffIndex>> diffs;
-
-    Querier *q1 = new Querier(tree, dictManager, files, totalNumberTriples,
-        totalNumberTerms, nindices, ntables, nFirstTables,
-        sampleKB, diffs);
-
-    if (addCount >= 1) {
-        PairItr *addItr = q->summaryAddDiff();
-
-        createSingleUpdate(DiffIndex::TypeUpdate::ADDITION_df, addItr, diffDir + DIR_SEP + "0", diffDir, q1);
+    std::shared_ptr<KBSnapshot> nodiffs(new KBSnapshot());
+    nodiffs->base = current->base;
+    KBBase &base = *current->base;
+    Querier *q1 = new Querier(base.tree, dictManager, base.files,
+        totalNumberTriples, totalNumberTerms, nindices, base.ntables,
+        base.nFirstTables, sampleKB, nodiffs);
+
+    //The merged diffs are written in directories that are not loaded with
+    //the KB
+    const std::string tmpDirs[] = { diffDir + DIR_SEP + "merge-add",
+        diffDir + DIR_SEP + "merge-rm" };
+    for (const auto &dir : tmpDirs) {
+        if (Utils::exists(dir)) {
+            Utils::remove_all(dir);
+        }
+    }
+    PairItr *addItr = q->summaryAddDiff();
+    if (addItr != NULL) {
+        createSingleUpdate(DiffIndex::TypeUpdate::ADDITION_df, addItr,
+                tmpDirs[0], diffDir, q1);
         q->releaseItr(addItr);
     }
-    if (rmCount >= 1) {
-        PairItr *rmItr = q->summaryRmDiff();
-        createSingleUpdate(DiffIndex::TypeUpdate::DELETE_df, rmItr, diffDir + DIR_SEP + (addCount != 0 ? "1" : "0"), diffDir, q1);
+    PairItr *rmItr = q->summaryRmDiff();
+    if (rmItr != NULL) {
+        createSingleUpdate(DiffIndex::TypeUpdate::DELETE_df, rmItr,
+                tmpDirs[1], diffDir, q1);
         q->releaseItr(rmItr);
     }
-
     delete q1;
-    delete q;
 
-    if (dictUpdates.size() != 0) {
-        createNewDict(diffDir + DIR_SEP + "0");
+    //The journal of the merge: the diffs that keep only their dictionary
+    //and the new names of the merged diffs. Once it is renamed, the merge
+    //is completed even after a crash
+    int64_t next = 0;
+    for (const auto &dir : Utils::getSubdirs(diffDir)) {
+        const string fn = Utils::filename(dir);
+        if (!fn.empty() && std::find_if(fn.begin(), fn.end(), [](char c) {
+                    return !isdigit(c);
+                    }) == fn.end()) {
+            next = std::max(next, (int64_t) atoll(fn.c_str()) + 1);
+        }
     }
-
-    std::string old = oldDiffDir + std::string(".old");
-
-    if (Utils::exists(old)) {
-        Utils::remove_all(old);
+    std::vector<string> dirs;
+    {
+        std::ofstream journal(diffDir + DIR_SEP + "MERGE.tmp");
+        for (const auto &dir : current->diffDirs) {
+            journal << "old " << Utils::filename(dir) << std::endl;
+        }
+        for (const auto &dir : tmpDirs) {
+            if (Utils::exists(dir)) {
+                dirs.push_back(diffDir + DIR_SEP + to_string(next));
+                journal << "new " << Utils::filename(dir) << " " << next++ <<
+                    std::endl;
+            }
+        }
     }
-
-    if (std::rename(oldDiffDir.c_str(), old.c_str()) != 0) {
-        LOG(ERRORL) << "Error renaming " << oldDiffDir;
+    if (std::rename((diffDir + DIR_SEP + "MERGE.tmp").c_str(),
+                (diffDir + DIR_SEP + "MERGE").c_str()) != 0) {
+        LOG(ERRORL) << "Error renaming " << diffDir << DIR_SEP << "MERGE.tmp";
         throw 10;
     }
-    if (std::rename(diffDir.c_str(), oldDiffDir.c_str()) != 0) {
-        LOG(ERRORL) << "Error renaming " << diffDir;
-        // Try to rename the old one back
-        std::rename(old.c_str(), oldDiffDir.c_str());
-        // Utils::remove_all(diffDir);
-        throw 10;
+    applyMerge(diffDir);
+
+    //The old diffs are released with the last snapshot that reads them
+    std::shared_ptr<KBSnapshot> merged(new KBSnapshot(*current));
+    merged->diffIndices.clear();
+    merged->diffDirs.clear();
+    std::shared_ptr<ROMappedFile> globalfiles[6];
+    mapGlobalDiffFiles(globalfiles);
+    for (const auto &dir : dirs) {
+        addDiffIndex(dir, globalfiles, *merged);
     }
-    // Utils::remove_all(old);
+    publishSnapshot(merged);
+
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(INFOL) << "Total merge time = " << sec.count() * 1000 << " ms.";
 }
 
-void KB::createNewDict(std::string dir) {
-    std::string dictdir = dir + DIR_SEP + std::string("dict");
-    Utils::create_directories(dictdir);
-
-    // Init data structures
-    Stats stats;
-    std::unique_ptr<StringBuffer> sb = std::unique_ptr<StringBuffer>(
-                                           new StringBuffer(dictdir, false, 10, 4096*SB_BLOCK_SIZE,
-                                                   &stats));
-    PropertyMap conf;
-    conf.setBool(TEXT_KEYS, true);
-    conf.setBool(TEXT_VALUES, false);
-    string t2idir = dictdir + "/t2id";
-    Utils::create_directories(t2idir);
-    std::unique_ptr<Root> dict = std::unique_ptr<Root>(new Root(t2idir, sb.get(),
-                                 false, conf));
-    string i2tdir = dictdir + "/id2t";
-    Utils::create_directories(i2tdir);
-    conf.setBool(TEXT_KEYS, false);
-    conf.setBool(TEXT_VALUES, true);
-    std::unique_ptr<Root> invdict = std::unique_ptr<Root>(new Root(i2tdir,
-                                    sb.get(), false, conf));
-
-    uint64_t maxid = 0;
-    uint64_t count = 0;
-    LOG(DEBUGL) << "dictUpdates count = " << dictUpdates.size();
-    for (int i = 0; i < dictUpdates.size(); ++i) {
-        TreeItr *itr = dictUpdates[i].invdict->itr();
-        while (itr->hasNext()) {
-            int64_t coord;
-            nTerm key = itr->next(coord);
-            int size;
-            char value[MAX_TERM_SIZE+1];
-            dictUpdates[i].sb->get(coord, value, size);
-            value[size] = 0;
-            coord = sb->getSize();
-            dict->put((tTerm*) value, size, key);
-            LOG(TRACEL) << "Adding " << value << " to dict";
-            invdict->put(key, coord);
-            if (key > maxid) {
-                maxid = key;
+void KB::applyMerge(std::string diffDir) {
+    const string journal = diffDir + DIR_SEP + "MERGE";
+    if (Utils::exists(journal)) {
+        std::ifstream fis(journal);
+        string op;
+        while (fis >> op) {
+            if (op == "old") {
+                string name;
+                fis >> name;
+                if (Utils::exists(diffDir + DIR_SEP + name)) {
+                    std::ofstream flag(diffDir + DIR_SEP + name + DIR_SEP +
+                            "DICT");
+                }
+            } else {
+                string name, target;
+                fis >> name >> target;
+                const string dir = diffDir + DIR_SEP + name;
+                if (Utils::exists(dir) && std::rename(dir.c_str(),
+                            (diffDir + DIR_SEP + target).c_str()) != 0) {
+                    LOG(ERRORL) << "Error renaming " << dir;
+                    throw 10;
+                }
             }
-            count++;
+        }
+        fis.close();
+        Utils::remove(journal);
+    }
+    //What is left of a merge that was interrupted before the journal
+    const string leftovers[] = { "MERGE.tmp", "merge-add", "merge-rm" };
+    for (const auto &item : leftovers) {
+        if (Utils::exists(diffDir + DIR_SEP + item)) {
+            Utils::remove_all(diffDir + DIR_SEP + item);
         }
     }
-
-    ofstream ofs;
-    ofs.open(dictdir + "/stats");
-    char data[8];
-    Utils::encode_long(data, count);
-    ofs.write(data, 8);
-    Utils::encode_long(data, maxid + 1);
-    ofs.write(data, 8);
-    ofs.close();
 }
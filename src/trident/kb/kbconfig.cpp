@@ -89,11 +89,15 @@ KBConfig::KBConfig() {
     internalMap.setLong(STORAGE_CACHE_SIZE, INT64_C(5000000000));
     internalMap.setLong(STORAGE_MAX_FILE_SIZE, INT64_C(20) * 1024 * 1024 * 1024);
     internalMap.setInt(STORAGE_MAX_N_FILES, MAX_N_FILES);
+    internalMap.setLong(REVERSE_CACHE_SIZE, INT64_C(512) * 1024 * 1024); //512MB
 
     //String buffer
     internalMap.setBool(SB_COMPRESSDOMAINS, false);
     internalMap.setInt(SB_PREALLBUFFERS, 1000);
     internalMap.setLong(SB_CACHESIZE, INT64_C(128) * 1024 * 1024); //128MB
+
+    //Updates
+    internalMap.setLong(MEMTABLE_MAX_TRIPLES, 100000);
 }
 
 void KBConfig::setParam(KBParam key, string value) {
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/loadcheckpoint.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#include <sys/stat.h>
+
+LoadCheckpoint::LoadCheckpoint(std::string dir, std::string signature) :
+    dir(dir), file(dir + DIR_SEP + "checkpoint"), signature(signature) {
+        read();
+    }
+
+void LoadCheckpoint::listFiles(std::string path,
+        std::vector<std::string> &out) {
+    if (!Utils::exists(path)) {
+        return;
+    }
+    if (!Utils::isDirectory(path)) {
+        out.push_back(path);
+        return;
+    }
+    for (auto f : Utils::getFiles(path)) {
+        out.push_back(f);
+    }
+    for (auto d : Utils::getSubdirs(path)) {
+        listFiles(d, out);
+    }
+}
+
+std::string LoadCheckpoint::getInputSignature(std::string path) {
+    std::vector<std::string> files;
+    listFiles(path, files);
+    std::sort(files.begin(), files.end());
+    std::string s;
+    for (auto &f : files) {
+        struct stat st;
+        int64_t mtime = 0;
+        if (stat(f.c_str(), &st) == 0) {
+            mtime = st.st_mtime;
+        }
+        s += f + ":" + std::to_string(Utils::fileSize(f)) + ":" +
+            std::to_string(mtime) + ";";
+    }
+    //The input can have many files. Only their hash goes in the signature
+    return std::to_string(files.size()) + ":" +
+        std::to_string(std::hash<std::string>()(s));
+}
+
+void LoadCheckpoint::read() {
+    if (!Utils::exists(file)) {
+        return;
+    }
+    std::ifstream in(file);
+    std::string line;
+    if (!std::getline(in, line) || line != "signature " + signature) {
+        LOG(WARNL) << "The checkpoint in " << dir <<
+            " was created with different parameters. It is ignored";
+        return;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string type, key;
+        ss >> type >> key;
+        if (type == "param") {
+            std::string value;
+            std::getline(ss, value);
+            params[key] = value.empty() ? value : value.substr(1);
+        } else if (type == "phase") {
+            phases[key];
+        } else if (type == "file") {
+            int64_t size;
+            std::string path;
+            ss >> size;
+            std::getline(ss, path);
+            phases[key].push_back(std::make_pair(path.substr(1), size));
+        }
+    }
+}
+
+void LoadCheckpoint::write() {
+    //Write a new file and replace the old one, so that a crash does not
+    //leave a truncated checkpoint
+    std::string tmpFile = file + ".new";
+    {
+        std::ofstream out(tmpFile);
+        out << "signature " << signature << std::endl;
+        for (auto &p : params) {
+            out << "param " << p.first << " " << p.second << std::endl;
+        }
+        for (auto &phase : phases) {
+            out << "phase " << phase.first << std::endl;
+            for (auto &f : phase.second) {
+                out << "file " << phase.first << " " << f.second << " " <<
+                    f.first << std::endl;
+            }
+        }
+        out.close();
+    }
+    Utils::rename(tmpFile, file);
+}
+
+bool LoadCheckpoint::isCompleted(std::string phase) {
+    if (!phases.count(phase)) {
+        return false;
+    }
+    for (auto &f : phases[phase]) {
+        if (!Utils::exists(f.first) || Utils::fileSize(f.first) != f.second) {
+            LOG(WARNL) << "The output " << f.first << " of the phase " <<
+                phase << " is missing or changed";
+            return false;
+        }
+    }
+    return true;
+}
+
+void LoadCheckpoint::markCompleted(std::string phase,
+        std::vector<std::string> outputs) {
+    std::vector<std::string> files;
+    for (auto o : outputs) {
+        listFiles(o, files);
+    }
+    auto &entries = phases[phase];
+    entries.clear();
+    for (auto f : files) {
+        entries.push_back(std::make_pair(f, (int64_t)Utils::fileSize(f)));
+    }
+    write();
+    LOG(INFOL) << "Checkpoint: phase " << phase << " is completed (" <<
+        entries.size() << " files)";
+}
+
+void LoadCheckpoint::restore(std::vector<std::string> phasesToKeep,
+        std::vector<std::string> loaderPaths) {
+    std::set<std::string> keepPhases(phasesToKeep.begin(), phasesToKeep.end());
+    std::set<std::string> keep;
+    for (auto phase : phasesToKeep) {
+        for (auto &f : phases[phase]) {
+            keep.insert(f.first);
+        }
+    }
+    //Forget the phases that will be executed again
+    for (auto itr = phases.begin(); itr != phases.end();) {
+        if (!keepPhases.count(itr->first)) {
+            itr = phases.erase(itr);
+        } else {
+            itr++;
+        }
+    }
+    write();
+
+    std::vector<std::string> files;
+    for (auto &path : loaderPaths) {
+        listFiles(path, files);
+    }
+    for (auto f : files) {
+        if (f != file && !keep.count(f)) {
+            Utils::remove(f);
+        }
+    }
+}
+
+void LoadCheckpoint::setParam(std::string key, std::string value) {
+    params[key] = value;
+}
+
+std::string LoadCheckpoint::getParam(std::string key) {
+    if (!params.count(key)) {
+        LOG(ERRORL) << "Parameter " << key << " is not in the checkpoint";
+        throw 10;
+    }
+    return params[key];
+}
+
+void LoadCheckpoint::clear() {
+    params.clear();
+    phases.clear();
+    if (Utils::exists(file)) {
+        Utils::remove(file);
+    }
+}
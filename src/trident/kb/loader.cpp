@@ -29,6 +29,7 @@
 #include <trident/tree/flatroot.h>
 #include <trident/utils/tridentutils.h>
 #include <trident/utils/parallel.h>
+#include <trident/utils/losertree.h>
 
 #include <kognac/lz4io.h>
 #include <kognac/utils.h>
@@ -53,6 +54,14 @@
 #include <unordered_map>
 #include <cstdlib>
 
+//Names of the permutations, used to label the phases of the loading
+static const char *_permNames[] = { "spo", "ops", "pos", "sop", "osp", "pso" };
+
+//The phase of the checkpoint that records the index of a permutation
+static string getIndexPhase(int permutation) {
+    return string("index-") + _permNames[permutation];
+}
+
 bool _sorter_spo(const Triple &a, const Triple &b) {
     if (a.s < b.s) {
         return true;
@@ -955,20 +964,41 @@ for(auto inputFile : unsortedFiles)
 
 void Loader::mergeDiskFragments(ParamsMergeDiskFragments params) {
     string inputDir = params.inputDir;
+    //Every opened run costs about one read buffer. If there is a budget, I
+    //merge as many runs as fit in it. Otherwise, I keep the default fan-in.
+    int maxFilesToMerge = LOADER_DEFAULT_MERGE_FANIN;
+    if (params.maxMemory > 0) {
+        maxFilesToMerge = max((int64_t)2,
+                min((int64_t)LOADER_MAX_MERGE_FANIN,
+                    params.maxMemory / LOADER_MERGE_BYTES_PER_RUN));
+    }
     //Do the merge-sort from the files on disk
-    LOG(DEBUGL) << "Starting merging of disk segments ...";
+    LOG(DEBUGL) << "Starting merging of disk segments (fan-in " <<
+        maxFilesToMerge << ") ...";
     int globalCounter = 0;
     do {
         std::vector<string> sortedFiles = Utils::getFiles(inputDir, true);
-        if (sortedFiles.size() <= 2) {
+        //The last merge is done while inserting, so there is no need to
+        //rewrite the runs if they can be merged in one go
+        if (sortedFiles.size() <= maxFilesToMerge) {
             break;
         }
-        //Pick up to four files and merge them together
+        //If a single merge is enough to reduce the runs to maxFilesToMerge,
+        //then I rewrite only the runs needed for it
+        int filesToProcess = sortedFiles.size();
+        if (filesToProcess - maxFilesToMerge + 1 <= maxFilesToMerge) {
+            filesToProcess = filesToProcess - maxFilesToMerge + 1;
+        }
+        //Pick up to maxFilesToMerge files and merge them together
         int i = 0;
-        while (i < sortedFiles.size()) {
-            int nfilesToMerge = 4;
-            if (i + nfilesToMerge > sortedFiles.size()) {
-                nfilesToMerge = sortedFiles.size() - i;
+        while (i < filesToProcess) {
+            int nfilesToMerge = maxFilesToMerge;
+            if (i + nfilesToMerge > filesToProcess) {
+                nfilesToMerge = filesToProcess - i;
+            }
+            if (nfilesToMerge == 1) {
+                //No need to copy it
+                break;
             }
             //Do the merge
             std::vector<string> filesToMerge;
@@ -978,30 +1008,9 @@ void Loader::mergeDiskFragments(ParamsMergeDiskFragments params) {
             std::string outputFile = inputDir + "/merged-" + to_string(globalCounter++) + ".0";
             LZ4Writer writer(outputFile);
             LOG(DEBUGL) << "Merging " << nfilesToMerge << " into " << outputFile;
-            if (nfilesToMerge == 1) {
-                FastFileMerger<1, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
-            } else if (nfilesToMerge == 2) {
-                FastFileMerger<2, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
-            } else if (nfilesToMerge == 3) {
-                FastFileMerger<3, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
-            } else {
-                if (nfilesToMerge > 4) {
-                    LOG(ERRORL) << "This should not have happened " << nfilesToMerge;
-                    throw 10;
-                }
-                FastFileMerger<4, Triple> merger(filesToMerge, true, true);
+            {
+                LoserTreeFileMerger<Triple> merger(filesToMerge,
+                        &Triple::sorter, true);
                 while (!merger.isEmpty()) {
                     Triple t = merger.get();
                     t.writeTo(&writer);
@@ -1016,6 +1025,8 @@ void Loader::mergeDiskFragments(ParamsMergeDiskFragments params) {
 
 void Loader::insert(ParamInsert params) {
     int permutation = params.permutation;
+    LoadPhase phase(params.profiler, string("index-") +
+            _permNames[permutation], params.parallelProcesses);
     int parallelProcesses = params.parallelProcesses;
     string inputDir = params.inputDir;
     string *POSoutputDir = params.POSoutputDir;
@@ -1029,6 +1040,8 @@ void Loader::insert(ParamInsert params) {
     bool printstats = params.printstats;
     bool removeInput = params.removeInput;
     bool deletePreviousExt = params.deletePreviousExt;
+    int64_t maxMemory = params.maxMemory;
+    bool keepSortedRuns = params.keepSortedRuns;
 
     SimpleTripleWriter *posWriter = NULL;
     if (POSoutputDir != NULL) {
@@ -1045,7 +1058,7 @@ void Loader::insert(ParamInsert params) {
     assert(sampleWriter == NULL || randThreshold > 0);
 
     auto inputmerge = Utils::getFiles(inputDir, true);
-    FileMerger<Triple> merger(inputmerge, true, deletePreviousExt);
+    FileMerger<Triple> merger(inputmerge, !keepSortedRuns, deletePreviousExt);
     LZ4Writer *plainWriter = NULL;
     if (storeRaw) {
         std::string file = ins->getPathPermutationStorage(permutation) +
@@ -1065,7 +1078,15 @@ void Loader::insert(ParamInsert params) {
         std::list<std::pair<int64_t*, int>> exchangeBuffers;
 
         // this is 3 * 16M * 8 = 384M of buffer, for each index.
-        const int sizebuffer = 4 * 1000000 * 4;
+        // If there is a memory budget, the three buffers take at most 1/8
+        // of it.
+        int sizebuffer = 4 * 1000000 * 4;
+        if (maxMemory > 0) {
+            int64_t maxElements = maxMemory / 8 / 3 / sizeof(int64_t);
+            maxElements -= maxElements % 4; //Each triple takes 4 slots
+            sizebuffer = (int) max((int64_t)4 * 1024,
+                    min((int64_t)sizebuffer, maxElements));
+        }
         for (int i = 0; i < 3; ++i) { //Create three buffers
             buffers.push_back(new int64_t[sizebuffer]);
         }
@@ -1223,9 +1244,34 @@ void Loader::insert(ParamInsert params) {
     LOG(DEBUGL) << "...completed. Added " << count << " triples out of " << countInput;
 }
 
+std::vector<string> Loader::sortPairsInRuns(string inputFile,
+        int64_t maxElements) {
+    std::vector<string> runs;
+    std::vector<PairLong> buffer;
+    LZ4Reader reader(inputFile);
+    while (!reader.isEof()) {
+        PairLong p;
+        p.readFrom(&reader);
+        buffer.push_back(p);
+        if (buffer.size() >= maxElements || reader.isEof()) {
+            std::sort(buffer.begin(), buffer.end(), &PairLong::less);
+            string run = inputFile + "-run" + to_string(runs.size());
+            LZ4Writer writer(run);
+            for (auto &el : buffer) {
+                el.writeTo(&writer);
+            }
+            runs.push_back(run);
+            buffer.clear();
+        }
+    }
+    return runs;
+}
+
 void Loader::insertDictionary(const int part, DictMgmt *dict, string
         dictFileInput, bool insertDictionary, bool insertInverseDictionary,
-        bool storeNumbersCoordinates, nTerm *maxValueCounter) {
+        bool storeNumbersCoordinates, nTerm *maxValueCounter,
+        int64_t maxMemory,
+        bool keepInput) {
     LZ4Writer *tmpWriter = NULL;
     if (storeNumbersCoordinates) {
         tmpWriter = new LZ4Writer(dictFileInput + ".tmp");
@@ -1333,16 +1379,30 @@ void Loader::insertDictionary(const int part, DictMgmt *dict, string
         //Sort the files
         vector<string> inputFiles;
         inputFiles.push_back(dictFileInput + ".tmp");
-        vector<string> files = Sorter::sortFiles<PairLong>(inputFiles,
-                dictFileInput + ".tmp");
+        vector<string> files;
+        if (maxMemory > 0) {
+            //The vector can double its size while growing
+            int64_t maxElements = max((int64_t)1,
+                    (int64_t)(maxMemory / 4 / sizeof(PairLong)));
+            files = sortPairsInRuns(dictFileInput + ".tmp", maxElements);
+        } else {
+            files = Sorter::sortFiles<PairLong>(inputFiles,
+                    dictFileInput + ".tmp");
+        }
 
-        if (files.size() > 1) {
+        if (files.size() > 1 && maxMemory > 0) {
+            LoserTreeFileMerger<PairLong> merger(files, &PairLong::less, false);
+            while (!merger.isEmpty()) {
+                PairLong el = merger.get();
+                dict->putInvDict(el.n1, el.n2);
+            }
+        } else if (files.size() > 1) {
             FileMerger<PairLong> merger(files);
             while (!merger.isEmpty()) {
                 PairLong el = merger.get();
                 dict->putInvDict(el.n1, el.n2);
             }
-        } else {
+        } else if (files.size() == 1) {
             LZ4Reader reader(files[0]);
             while (!reader.isEof()) {
                 PairLong p;
@@ -1361,10 +1421,12 @@ void Loader::insertDictionary(const int part, DictMgmt *dict, string
         Utils::remove(dictFileInput + ".tmp");
     }
 
-    for (auto f = alldictfiles.begin(); f != alldictfiles.end(); ++f) {
-        Utils::remove(*f);
+    if (!keepInput) {
+        for (auto f = alldictfiles.begin(); f != alldictfiles.end(); ++f) {
+            Utils::remove(*f);
+        }
+        Utils::remove(dictFileInput);
     }
-    Utils::remove(dictFileInput);
 }
 
 void Loader::exportFiles(string tripleDir, string* dictFiles,
@@ -1428,6 +1490,32 @@ void Loader::addSchemaTerms(const int dictPartitions, nTerm highestNumber, DictM
     }
 }
 
+//Owns the profiler of a load. It writes the report and resets the pointer
+//of the loader when the load returns or throws
+class LoadReportGuard {
+    private:
+        std::unique_ptr<LoadProfiler> profiler;
+        LoadProfiler *&current;
+        const string file;
+        ParamsLoad &p;
+
+    public:
+        LoadReportGuard(LoadProfiler *&current, string file,
+                ParamsLoad &p) : profiler(new LoadProfiler()),
+        current(current), file(file), p(p) {
+            current = profiler.get();
+        }
+
+        ~LoadReportGuard() {
+            current = NULL;
+            try {
+                profiler->writeReport(file, p.tostring());
+            } catch (...) {
+                LOG(WARNL) << "Cannot write the loading report in " << file;
+            }
+        }
+};
+
 void Loader::load(ParamsLoad p) {
     LOG(DEBUGL) << "Params: " << p.tostring();
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
@@ -1445,18 +1533,17 @@ void Loader::load(ParamsLoad p) {
 #endif
     }
 
-    //Check if kbDir exists
-    if (Utils::exists(p.kbDir)) {
-        Utils::remove_all(p.kbDir);
+    if (p.resume && p.tmpDir == p.kbDir) {
+        LOG(WARNL) << "Resuming requires a temporary directory different from the KB directory. The loading starts from scratch";
+        p.resume = false;
     }
-    Utils::create_directories(p.kbDir);
 
-    if (p.tmpDir != p.kbDir) {
-        if (Utils::exists(p.tmpDir)) {
-            Utils::remove_all(p.tmpDir);
-        }
-        Utils::create_directories(p.tmpDir);
+    //Check if kbDir exists. If the load is resumed, the indices that were
+    //completed are kept and the checkpoint removes the rest
+    if (!p.resume && Utils::exists(p.kbDir)) {
+        Utils::remove_all(p.kbDir);
     }
+    Utils::create_directories(p.kbDir);
 
     //How many to use dictionaries?
     int ncores = Utils::getNumberPhysicalCores();
@@ -1477,6 +1564,90 @@ void Loader::load(ParamsLoad p) {
 
     LOG(DEBUGL) << "Set number of dictionaries to " << p.dictionaries << " parallel threads=" << p.parallelThreads << " readingThreads=" << p.maxReadingThreads;
 
+    //Record the resources used by every phase. The report is stored in the
+    //KB directory
+    LoadReportGuard report(profiler, p.kbDir + DIR_SEP + "loadprofile.json",
+            p);
+    LoadPhase phaseLoad(profiler, "load", p.parallelThreads);
+
+    //Check whether some phases of a previous load can be reused
+    std::unique_ptr<LoadCheckpoint> cp;
+    bool isCompressed = false;
+    if (p.resume) {
+        string signature = p.inputformat + ";" + p.triplesInputDir + ";" +
+            to_string(p.inputCompressed) + ";" + p.dictDir + ";" +
+            p.dictDir_rel + ";" + p.dictMethod + ";" +
+            to_string(p.dictionaries) + ";" + to_string(p.nindices) + ";" +
+            to_string(p.aggrIndices) + ";" +
+            to_string(p.createIndicesInBlocks) + ";" +
+            p.graphTransformation + ";" + to_string(p.relsOwnIDs) + ";" +
+            to_string(p.storeDicts) + ";" + to_string(p.canSkipTables) + ";" +
+            to_string(p.enableFixedStrat) + ";" + to_string(p.fixedStrat) +
+            ";" + to_string(p.storePlainList) + ";" + to_string(p.sample) +
+            ";" + to_string(p.sampleRate) + ";" +
+            to_string(p.thresholdSkipTable) + ";" +
+            LoadCheckpoint::getInputSignature(p.triplesInputDir);
+        if (p.dictDir != "") {
+            signature += ";" + LoadCheckpoint::getInputSignature(p.dictDir);
+        }
+        cp = std::unique_ptr<LoadCheckpoint>(new LoadCheckpoint(p.tmpDir,
+                    signature));
+
+        //The files and directories that the loader writes. Only these are
+        //removed when the load is resumed
+        std::vector<string> loaderPaths;
+        loaderPaths.push_back(p.kbDir);
+        for (int i = 0; i < 6; ++i) {
+            loaderPaths.push_back(p.tmpDir + DIR_SEP + "permtmp-" + to_string(i));
+            loaderPaths.push_back(p.tmpDir + DIR_SEP + "tmpTree" + to_string(i));
+        }
+        for (int i = 0; i < p.dictionaries; ++i) {
+            string dictFile = p.tmpDir + DIR_SEP + "dict-" + to_string(i);
+            loaderPaths.push_back(dictFile);
+            if (Utils::exists(dictFile)) {
+                std::vector<string> moreDictFiles =
+                    Compressor::getAllDictFiles(dictFile);
+                loaderPaths.insert(loaderPaths.end(), moreDictFiles.begin(),
+                        moreDictFiles.end());
+            }
+        }
+        loaderPaths.push_back(p.tmpDir + DIR_SEP + "aggr1");
+        loaderPaths.push_back(p.tmpDir + DIR_SEP + "aggr2");
+        loaderPaths.push_back(p.tmpDir + DIR_SEP + "sampledir");
+
+        if (cp->isValid() && cp->isCompleted("dictpartitions")) {
+            if (cp->isCompleted("sorted")) {
+                LOG(INFOL) << "Resuming from the sorted permutations";
+                std::vector<string> phases = { "dictpartitions", "sorted" };
+                for (int i = 0; i < 6; ++i) {
+                    if (cp->isCompleted(getIndexPhase(i))) {
+                        LOG(INFOL) << "Resuming the index " << _permNames[i];
+                        phases.push_back(getIndexPhase(i));
+                    }
+                }
+                cp->restore(phases, loaderPaths);
+                isCompressed = true;
+            } else if (cp->isCompleted("compressed")) {
+                LOG(INFOL) << "Resuming from the compressed triples";
+                cp->restore({ "dictpartitions", "compressed" }, loaderPaths);
+                isCompressed = true;
+            }
+        }
+        if (!isCompressed) {
+            LOG(INFOL) << "No phase can be resumed. The loading starts from scratch";
+            cp->clear();
+            Utils::remove_all(p.kbDir);
+            Utils::create_directories(p.kbDir);
+        }
+    }
+    if (p.tmpDir != p.kbDir && !isCompressed) {
+        if (Utils::exists(p.tmpDir)) {
+            Utils::remove_all(p.tmpDir);
+        }
+        Utils::create_directories(p.tmpDir);
+    }
+    checkpoint = cp.get();
+
     //Create data structures to compress the input
     int nperms = 1;
     int signaturePerm = 0;
@@ -1532,10 +1703,17 @@ void Loader::load(ParamsLoad p) {
         fileNameDictionaries[i] = p.tmpDir + DIR_SEP + string("dict-") + to_string(i);
     }
 
-    if (p.inputformat == "snap") { /*** LOAD SNAP FILES ***/
+    if (isCompressed) {
+        //Restore the parameters that were changed while parsing the input
+        totalCount = std::stoll(cp->getParam("totalCount"));
+        p.graphTransformation = cp->getParam("graphTransformation");
+        p.relsOwnIDs = cp->getParam("relsOwnIDs") == "1";
+        p.storeDicts = cp->getParam("storeDicts") == "1";
+    } else if (p.inputformat == "snap") { /*** LOAD SNAP FILES ***/
         if (p.graphTransformation == "") {
             p.graphTransformation = "undirected";
         }
+        LoadPhase phase(profiler, "parse", p.parallelThreads);
         totalCount = parseSnapFile(p.triplesInputDir,
                 p.dictDir,
                 permDirs + 3, //Store the output in the SOP directory
@@ -1550,7 +1728,9 @@ void Loader::load(ParamsLoad p) {
                 throw 10;
             }
             Compressor comp(p.triplesInputDir, p.tmpDir);
-            //Parse the input
+            //Parse the input. The decompression of the input files is
+            //interleaved with the parsing
+            LoadPhase phaseParse(profiler, "parse", p.parallelThreads);
             comp.parse(p.dictionaries, p.sampleMethod, p.sampleArg, (int)(p.sampleRate * 100),
                     p.parallelThreads, p.maxReadingThreads, false, NULL, false,
                     p.graphTransformation != "");
@@ -1558,11 +1738,14 @@ void Loader::load(ParamsLoad p) {
             LOG(DEBUGL) << "For now I create only one permutation";
             int tmpsig = 0;
             Compressor::addPermutation(IDX_SPO, tmpsig);
+            phaseParse.end();
+            LoadPhase phaseCompress(profiler, "dictionary", p.parallelThreads);
             comp.compress(p.graphTransformation != "" ? permDirs + 3 : permDirs,
                     1, tmpsig, fileNameDictionaries,
                     p.dictionaries, p.parallelThreads, p.maxReadingThreads,
                     p.graphTransformation != "");
             totalCount = comp.getTotalCount();
+            phaseCompress.end();
             LOG(INFOL) << "Compression is finished. Starting the loading ...";
             if (p.onlyCompress) {
                 //Convert the triple files and the dictionary files in gzipped files
@@ -1589,6 +1772,7 @@ void Loader::load(ParamsLoad p) {
                 LOG(INFOL) << "I force the parameter relsOwnIDs to true since the path to a dictionary for the relations is not null";
                 p.relsOwnIDs = true;
             }
+            LoadPhase phase(profiler, "parse", p.parallelThreads);
             totalCount = createPermsAndDictsFromFiles(p.triplesInputDir,
                     p.relsOwnIDs,
                     p.dictDir,
@@ -1606,6 +1790,24 @@ void Loader::load(ParamsLoad p) {
         }
     }
 
+    if (checkpoint != NULL && !isCompressed) {
+        cp->setParam("totalCount", to_string(totalCount));
+        cp->setParam("graphTransformation", p.graphTransformation);
+        cp->setParam("relsOwnIDs", to_string(p.relsOwnIDs));
+        cp->setParam("storeDicts", to_string(p.storeDicts));
+        std::vector<string> dictFiles;
+        for (int i = 0; i < p.dictionaries; ++i) {
+            dictFiles.push_back(fileNameDictionaries[i]);
+            std::vector<string> moreDictFiles =
+                Compressor::getAllDictFiles(fileNameDictionaries[i]);
+            dictFiles.insert(dictFiles.end(), moreDictFiles.begin(),
+                    moreDictFiles.end());
+        }
+        cp->markCompleted("dictpartitions", dictFiles);
+        cp->markCompleted("compressed",
+                std::vector<string>(permDirs, permDirs + nperms));
+    }
+
     KBConfig config;
     config.setParamInt(DICTPARTITIONS, p.dictionaries);
     config.setParamInt(NINDICES, p.nindices);
@@ -1615,7 +1817,7 @@ void Loader::load(ParamsLoad p) {
     config.setParamInt(THRESHOLD_SKIP_TABLE, p.thresholdSkipTable);
     config.setParamBool(RELSOWNIDS, p.relsOwnIDs);
     LOG(DEBUGL) << "Optimizing memory management for " << totalCount << " triples";
-    MemoryOptimizer::optimizeForWriting(totalCount, config);
+    MemoryOptimizer::optimizeForWriting(totalCount, config, p.maxMemory);
     if (p.dictMethod == DICT_HASH) {
         config.setParamBool(DICTHASH, true);
     }
@@ -1633,6 +1835,7 @@ void Loader::load(ParamsLoad p) {
     /*** CLEANUP ***/
     delete[] permDirs;
     delete[] fileNameDictionaries;
+    checkpoint = NULL;
     if (p.tmpDir != p.kbDir) {
         Utils::remove_all(p.tmpDir);
     }
@@ -1643,8 +1846,13 @@ void Loader::load(ParamsLoad p) {
     if (monitor.joinable()) {
         monitor.join();
     }
+    phaseLoad.end();
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(INFOL) << "Loading is finished: Time (sec) " << sec.count();
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
+    LOG(INFOL) << "Peak memory usage (RSS) during loading: " <<
+        TridentUtils::getPeakRSS() / 1024 << " MB";
+#endif
 }
 
 void Loader::rewriteKG(string inputdir, std::unordered_map<int64_t,int64_t> &map) {
@@ -1680,7 +1888,8 @@ void Loader::rewriteKG(string inputdir, std::unordered_map<int64_t,int64_t> &map
 void Loader::loadKB_storeDicts(KB &kb,
         int dictionaries,
         string dictMethod,
-        string *fileNameDictionaries) {
+        string *fileNameDictionaries,
+        int64_t maxMemory) {
     std::thread *threads;
     LOG(DEBUGL) << "Insert the dictionary in the trees";
     threads = new std::thread[dictionaries - 1];
@@ -1688,13 +1897,14 @@ void Loader::loadKB_storeDicts(KB &kb,
     if (dictMethod != DICT_SMART) {
         if (dictionaries > 1) throw 10;
         insertDictionary(0, kb.getDictMgmt(), fileNameDictionaries[0],
-                dictMethod != DICT_HASH, true, false, maxValues);
+                dictMethod != DICT_HASH, true, false, maxValues, maxMemory,
+                checkpoint != NULL);
         for (int i = 1; i < dictionaries; ++i) {
             threads[i - 1].join();
         }
     } else {
         insertDictionary(0, kb.getDictMgmt(), fileNameDictionaries[0], true,
-                true, true, maxValues);
+                true, true, maxValues, maxMemory, checkpoint != NULL);
     }
 #ifdef REASONING
     addSchemaTerms(dictionaries, maxValues[0], kb.getDictMgmt());
@@ -1826,7 +2036,8 @@ void Loader::loadKB_createSamples(string kbDir,
     config.setParamBool(AGGRINDICES, false);
     config.setParamBool(USEFIXEDSTRAT, false);
     printStats = false;
-    MemoryOptimizer::optimizeForWriting((int64_t)(totalCount * sampleRate), config);
+    MemoryOptimizer::optimizeForWriting((int64_t)(totalCount * sampleRate), config,
+            p.maxMemory);
     KB kb(sampleKB.c_str(), false, false, false, config);
 
     ParamsLoad samplep = p;
@@ -1836,6 +2047,11 @@ void Loader::loadKB_createSamples(string kbDir,
     samplep.limitSpace = 0;
     samplep.remoteLocation = "";
     samplep.sample = false;
+    //The sample KB is recorded as a single phase
+    LoadCheckpoint *loadCheckpoint = checkpoint;
+    LoadProfiler *loadProfiler = profiler;
+    checkpoint = NULL;
+    profiler = NULL;
     loadKB(kb,
             samplep,
             totalCount * p.sampleRate,
@@ -1845,51 +2061,70 @@ void Loader::loadKB_createSamples(string kbDir,
             NULL,
             false,
             false);
+    checkpoint = loadCheckpoint;
+    profiler = loadProfiler;
 
     delete[] samplePermDirs;
 }
 
+static nTerm _getLargestKeyTreeWriter(string file) {
+    //The last record of the file contains the largest key
+    if (!Utils::exists(file) || Utils::fileSize(file) < 23) {
+        return -1;
+    }
+    ifstream in(file, ios_base::binary);
+    in.seekg(Utils::fileSize(file) - 23);
+    char buffer[8];
+    in.read(buffer, 8);
+    return Utils::decode_long(buffer, 0);
+}
+
 void Loader::loadKB_createTree(KB &kb,
         string *sTreeWriters,
         TreeWriter **treeWriters,
         bool storeDicts,
         string graphTransformation,
         Inserter *ins,
-        int nindices) {
+        int nindices,
+        int parallelThreads) {
 
     std::thread *threads;
-    threads = new std::thread[2];
+    threads = new std::thread[1];
     LOG(DEBUGL) << "Compress the dictionary nodes...";
     if (storeDicts) {
-        threads[1] = std::thread(
+        threads[0] = std::thread(
                 std::bind(&NodeManager::compressSpace,
                     kb.getDictPath(0)));
     }
 
     LOG(DEBUGL) << "Start creating the tree...";
-    std::unique_ptr<SharedStructs> structs = std::unique_ptr<SharedStructs>(
-            new SharedStructs());
-    structs->bufferToFill = structs->bufferToReturn = &structs->buffer1;
-    structs->isFinished = false;
-    structs->buffersReady = 0;
-
-    ParamsMergeCoordinates params;
-    params.coordinates = sTreeWriters;
-    params.ncoordinates = graphTransformation != "" ? 2 : 6;
-
-    params.bufferToFill = structs->bufferToFill;
-    params.isFinished = &structs->isFinished;
-    params.buffersReady = &structs->buffersReady;
-    params.buffer1 = &structs->buffer1;
-    params.buffer2 = &structs->buffer2;
-    params.cond = &structs->cond;
-    params.mut = &structs->mut;
-    threads[0] = std::thread(
-            std::bind(&Loader::mergeTermCoordinates, params));
-    processTermCoordinates(ins, structs.get());
-    threads[0].join();
+    //The coordinates are sorted by key. Split the key space in ranges that
+    //can be merged and turned into leaves independently
+    nTerm maxKey = -1;
+    for (int i = 0; i < nindices; ++i) {
+        maxKey = std::max(maxKey, _getLargestKeyTreeWriter(sTreeWriters[i]));
+    }
+    int nparts = std::max(1, parallelThreads);
+    if ((maxKey + 1) / nparts < 65536) {
+        nparts = (int) (maxKey / 65536) + 1;
+    }
+    LOG(DEBUGL) << "Building the tree from " << nparts << " key ranges";
+
+    std::vector<TermCoordinatesSource*> mergers;
+    for (int i = 0; i < nparts; ++i) {
+        const nTerm startKey = (maxKey + 1) * i / nparts;
+        const nTerm endKey = (i == nparts - 1) ?
+            std::numeric_limits<nTerm>::max() : (maxKey + 1) * (i + 1) / nparts;
+        mergers.push_back(new CoordinatesMerger(sTreeWriters,
+                    graphTransformation != "" ? 2 : 6, startKey, endKey));
+    }
+    ins->bulkInsert(mergers);
+    for (auto merger : mergers) {
+        delete merger;
+    }
+
     if (storeDicts) {
-        threads[1].join();
+        threads[0].join();
     }
     for (int i = 0; i < nindices; ++i) {
         Utils::remove(sTreeWriters[i]);
@@ -1928,11 +2163,14 @@ void Loader::loadKB(KB &kb,
     int maxReadingThreads = p.maxReadingThreads;
     string graphTransformation = p.graphTransformation;
     bool flatTree = p.flatTree;
+    int64_t maxMemory = p.maxMemory;
     //End init params
 
     if (storeDicts) {
-        loadKB_storeDicts(kb, dictionaries, dictMethod, fileNameDictionaries);
-    } else {
+        LoadPhase phase(profiler, "storeDicts", dictionaries);
+        loadKB_storeDicts(kb, dictionaries, dictMethod, fileNameDictionaries,
+                maxMemory);
+    } else if (checkpoint == NULL) {
         if (fileNameDictionaries && Utils::exists(fileNameDictionaries[0])) {
             std::vector<string> alldictfiles =
                 Compressor::getAllDictFiles(fileNameDictionaries[0]);
@@ -1948,7 +2186,9 @@ void Loader::loadKB(KB &kb,
     TreeWriter **treeWriters = new TreeWriter*[nindices];
     for (int i = 0; i < nindices; ++i) {
         sTreeWriters[i] = tmpDir + DIR_SEP + string("tmpTree" ) + to_string(i);
-        treeWriters[i] = new TreeWriter(sTreeWriters[i]);
+        //The entries of the indices that are resumed are kept
+        treeWriters[i] = new TreeWriter(sTreeWriters[i], checkpoint != NULL &&
+                checkpoint->isCompleted(getIndexPhase(i)));
     }
 
     //Use aggregated indices
@@ -1965,7 +2205,11 @@ void Loader::loadKB(KB &kb,
     SimpleTripleWriter *sampleWriter = NULL;
     if (sample) {
         Utils::create_directories(sampleDir);
-        sampleWriter = new SimpleTripleWriter(sampleDir, "input", false);
+        //The sample is written with the first index
+        if (checkpoint == NULL ||
+                !checkpoint->isCompleted(getIndexPhase(IDX_SPO))) {
+            sampleWriter = new SimpleTripleWriter(sampleDir, "input", false);
+        }
     }
 
     //Create n threads where the triples are sorted and inserted in the knowledge base
@@ -1982,18 +2226,31 @@ void Loader::loadKB(KB &kb,
         outputDirs[i] = kbDir + DIR_SEP + "p" + to_string(i);
     }
 
-    loadKB_handleGraphTransformations(kb, graphTransformation, permDirs,
-            nindices, ins, relsOwnIDs, kbDir, storeDicts);
+    if (graphTransformation != "" || relsOwnIDs) {
+        LoadPhase phase(profiler, "graphTransformations", 1);
+        loadKB_handleGraphTransformations(kb, graphTransformation, permDirs,
+                nindices, ins, relsOwnIDs, kbDir, storeDicts);
+    }
 
+    //The transformations rewrite the input in place and the incremental
+    //creation derives the permutations one at the time, so in these cases
+    //the sorted permutations cannot be reused
+    LoadCheckpoint *loadCheckpoint = checkpoint;
+    if (graphTransformation != "" || relsOwnIDs || createIndicesInBlocks) {
+        checkpoint = NULL;
+    }
     createIndices(parallelProcesses, maxReadingThreads,
             ins, createIndicesInBlocks,
             aggrIndices,canSkipTables, storePlainList,
             permDirs, outputDirs, aggr1Dir, aggr2Dir, treeWriters, sampleWriter,
+            sampleDir,
             sampleRate,
             remoteLocation,
             limitSpace,
             totalCount,
-            nindices);
+            nindices,
+            maxMemory);
+    checkpoint = loadCheckpoint;
 
     if (nindices != 6)
         nindices = 6; //restore
@@ -2002,12 +2259,15 @@ void Loader::loadKB(KB &kb,
         treeWriters[i]->finish();
     }
 
+    LoadPhase phaseTree(profiler, "tree", p.parallelThreads);
     loadKB_createTree(kb, sTreeWriters, treeWriters, storeDicts,
-            graphTransformation, ins, nindices);
+            graphTransformation, ins, nindices, p.parallelThreads);
     delete ins;
+    phaseTree.end();
 
     if (flatTree || graphTransformation != "") {
         LOG(DEBUGL) << "Load flat representation ...";
+        LoadPhase phase(profiler, "flatTree", 5);
         kb.close();
         string flatfile = kbDir + DIR_SEP + "tree" + DIR_SEP + "flat";
         //Create a tree itr to go through the tree
@@ -2025,6 +2285,7 @@ void Loader::loadKB(KB &kb,
 
     if (sample) {
         delete sampleWriter;
+        LoadPhase phase(profiler, "sample", parallelProcesses);
         loadKB_createSamples(kbDir, sampleDir, parallelProcesses,
                 maxReadingThreads, nperms, sampleRate,
                 nindices, p, totalCount, signaturePerms);
@@ -2446,12 +2707,14 @@ void Loader::createIndices(
         string aggr1Dir,
         string aggr2Dir,
         TreeWriter **treeWriters,
-        SimpleTripleWriter *sampleWriter,
+        SimpleTripleWriter *&sampleWriter,
+        string sampleDir,
         double sampleRate,
         string remotePath,
         int64_t limitSpace,
         int64_t estimatedSize,
-        int nindices) {
+        int nindices,
+        int64_t maxMemory) {
 
     LOG(DEBUGL) << "start createIndices";
     std::vector<std::pair<string, char>> permutations;
@@ -2472,13 +2735,42 @@ void Loader::createIndices(
     } else {
         permutations.push_back(std::make_pair(permDirs[0], IDX_SPO));
     }
-    PermSorter::sortChunks2(permutations, maxReadingThreads,
-            parallelProcesses,
-            estimatedSize,
-            false);
-    for(auto &p : permutations) {
-        mergeDiskFragments(ParamsMergeDiskFragments(p.first));
+    if (checkpoint != NULL && checkpoint->isCompleted("sorted")) {
+        LOG(INFOL) << "The permutations are already sorted";
+    } else {
+        LoadPhase phase(profiler, "sort", parallelProcesses);
+        PermSorter::sortChunks2(permutations, maxReadingThreads,
+                parallelProcesses,
+                estimatedSize,
+                false,
+                maxMemory);
+        //The runs of the different permutations are stored in different
+        //directories. Merge them concurrently, splitting the budget among them
+        std::vector<std::thread> mergeThreads;
+        const int64_t mergeMemory = maxMemory / (int64_t)permutations.size();
+        for(int i = 1; i < permutations.size(); ++i) {
+            mergeThreads.push_back(std::thread(&Loader::mergeDiskFragments,
+                        ParamsMergeDiskFragments(permutations[i].first,
+                            mergeMemory)));
+        }
+        mergeDiskFragments(ParamsMergeDiskFragments(permutations[0].first,
+                    mergeMemory));
+        for(auto &t : mergeThreads) {
+            t.join();
+        }
+        if (checkpoint != NULL && !createIndicesInBlocks) {
+            std::vector<string> sortedDirs;
+            for (auto &perm : permutations) {
+                sortedDirs.push_back(perm.first);
+            }
+            checkpoint->markCompleted("sorted", sortedDirs);
+        }
     }
+    //The indices are checkpointed one at the time if they stay in the KB
+    //directory and do not depend on each other (the aggregated indices are
+    //built from the output of the others)
+    const bool checkpointIndices = checkpoint != NULL && !aggrIndices &&
+        remotePath == "";
 
     ParamInsert params;
     params.parallelProcesses = parallelProcesses;
@@ -2495,22 +2787,38 @@ void Loader::createIndices(
     params.printstats = printStats;
     params.removeInput = false;
     params.deletePreviousExt = false;
+    params.maxMemory = maxMemory;
 
-    insert(params);
+    params.keepSortedRuns = checkpoint != NULL;
+    params.profiler = profiler;
+
+    if (!restoreIndex(0, ins)) {
+        insert(params);
+    }
 
     string lastInput = permDirs[0];
     if (createIndicesInBlocks) {
+        LoadPhase phase(profiler, "sort-ops", parallelProcesses);
         generateNewPermutation(permDirs[1], lastInput, 2, 1, 0, parallelProcesses,
                 maxReadingThreads);
         PermSorter::sortChunks2(permDirs[1], IDX_OPS, maxReadingThreads,
                 parallelProcesses,
                 estimatedSize,
-                false);
-        mergeDiskFragments(ParamsMergeDiskFragments(permDirs[1]));
+                false,
+                maxMemory);
+        mergeDiskFragments(ParamsMergeDiskFragments(permDirs[1], maxMemory));
+    }
+    if (checkpoint == NULL) {
+        Utils::remove_all(lastInput);
     }
-    Utils::remove_all(lastInput);
     ins->stopInserts(0);
     moveData(remotePath, outputDirs[0], limitSpace);
+    if (checkpointIndices) {
+        //The sample is written with the first index
+        delete sampleWriter;
+        sampleWriter = NULL;
+        checkpointIndex(0, ins, treeWriters[0], { outputDirs[0], sampleDir });
+    }
     LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
 
     params.permutation = 1;
@@ -2526,10 +2834,16 @@ void Loader::createIndices(
     params.printstats = printStats;
     params.removeInput = false;
 
-    insert(params);
+    params.keepSortedRuns = checkpoint != NULL;
+    params.profiler = profiler;
+
+    if (!restoreIndex(1, ins)) {
+        insert(params);
+    }
 
     lastInput = permDirs[1];
     if (createIndicesInBlocks) {
+        LoadPhase phase(profiler, "sort-sop", parallelProcesses);
         generateNewPermutation(aggrIndices ? permDirs[2] : permDirs[3],
                 lastInput, 2, 0, 1, parallelProcesses,
                 maxReadingThreads);
@@ -2537,14 +2851,20 @@ void Loader::createIndices(
                 IDX_SOP, maxReadingThreads,
                 parallelProcesses,
                 estimatedSize,
-                false);
+                false,
+                maxMemory);
         mergeDiskFragments(
                 ParamsMergeDiskFragments(
-                    aggrIndices ? permDirs[2] : permDirs[3]));
+                    aggrIndices ? permDirs[2] : permDirs[3], maxMemory));
+    }
+    if (checkpoint == NULL) {
+        Utils::remove_all(lastInput);
     }
-    Utils::remove_all(lastInput);
     ins->stopInserts(1);
     moveData(remotePath, outputDirs[1], limitSpace);
+    if (checkpointIndices) {
+        checkpointIndex(1, ins, treeWriters[1], { outputDirs[1] });
+    }
     LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
 
     params.permutation = 3;
@@ -2560,10 +2880,16 @@ void Loader::createIndices(
     params.printstats = printStats;
     params.removeInput = false;
 
-    insert(params);
+    params.keepSortedRuns = checkpoint != NULL;
+    params.profiler = profiler;
+
+    if (!restoreIndex(3, ins)) {
+        insert(params);
+    }
 
     lastInput = aggrIndices ? permDirs[2] : permDirs[3];
     if (createIndicesInBlocks) {
+        LoadPhase phase(profiler, "sort-osp", parallelProcesses);
         generateNewPermutation(aggrIndices ? permDirs[3] : permDirs[4],
                 lastInput, 1, 0, 2, parallelProcesses,
                 maxReadingThreads);
@@ -2571,14 +2897,20 @@ void Loader::createIndices(
                 IDX_OSP, maxReadingThreads,
                 parallelProcesses,
                 estimatedSize,
-                false);
+                false,
+                maxMemory);
         mergeDiskFragments(
                 ParamsMergeDiskFragments(
-                    aggrIndices ? permDirs[3] : permDirs[4]));
+                    aggrIndices ? permDirs[3] : permDirs[4], maxMemory));
+    }
+    if (checkpoint == NULL) {
+        Utils::remove_all(lastInput);
     }
-    Utils::remove_all(lastInput);
     ins->stopInserts(3);
     moveData(remotePath, outputDirs[3], limitSpace);
+    if (checkpointIndices) {
+        checkpointIndex(3, ins, treeWriters[3], { outputDirs[3] });
+    }
     LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
 
     params.permutation = 4;
@@ -2594,16 +2926,25 @@ void Loader::createIndices(
     params.printstats = printStats;
     params.removeInput = false;
 
-    insert(params);
+    params.keepSortedRuns = checkpoint != NULL;
+    params.profiler = profiler;
+
+    if (!restoreIndex(4, ins)) {
+        insert(params);
+    }
 
     ins->stopInserts(4);
     moveData(remotePath, outputDirs[4], limitSpace);
+    if (checkpointIndices) {
+        checkpointIndex(4, ins, treeWriters[4], { outputDirs[4] });
+    }
     LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
 
     lastInput = aggrIndices ? permDirs[3] : permDirs[4];
 
     if (!aggrIndices) {
         if (createIndicesInBlocks) {
+            LoadPhase phase(profiler, "sort-pos", parallelProcesses);
             generateNewPermutation(permDirs[2],
                     lastInput, 2, 0, 1, parallelProcesses,
                     maxReadingThreads);
@@ -2611,9 +2952,10 @@ void Loader::createIndices(
                     IDX_POS, maxReadingThreads,
                     parallelProcesses,
                     estimatedSize,
-                    false);
+                    false,
+                    maxMemory);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(permDirs[2]));
+                    ParamsMergeDiskFragments(permDirs[2], maxMemory));
         }
 
         ParamInsert params;
@@ -2631,8 +2973,18 @@ void Loader::createIndices(
         params.printstats = printStats;
         params.removeInput = false;
         params.deletePreviousExt = false;
+        params.maxMemory = maxMemory;
 
-        insert(params);
+        params.keepSortedRuns = checkpoint != NULL;
+        params.profiler = profiler;
+
+        if (!restoreIndex(2, ins)) {
+            insert(params);
+        }
+        if (checkpointIndices) {
+            ins->stopInserts(2);
+            checkpointIndex(2, ins, treeWriters[2], { outputDirs[2] });
+        }
         LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
     } else {
         ParamInsert params;
@@ -2650,23 +3002,33 @@ void Loader::createIndices(
         params.printstats = printStats;
         params.removeInput = true;
         params.deletePreviousExt = false;
+        params.maxMemory = maxMemory;
 
+        LoadPhase phase(profiler, "sort-pos", parallelProcesses);
         PermSorter::sortChunks2(aggr1Dir,
                 IDX_POS, maxReadingThreads,
                 parallelProcesses,
                 estimatedSize,
-                true);
+                true,
+                maxMemory);
         mergeDiskFragments(
-                ParamsMergeDiskFragments(aggr1Dir));
+                ParamsMergeDiskFragments(aggr1Dir, maxMemory));
+        phase.end();
+
+        params.keepSortedRuns = checkpoint != NULL;
+        params.profiler = profiler;
 
         insert(params);
         LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
     }
-    Utils::remove_all(lastInput);
+    if (checkpoint == NULL) {
+        Utils::remove_all(lastInput);
+    }
 
     if (!aggrIndices) {
         lastInput = permDirs[2];
         if (createIndicesInBlocks) {
+            LoadPhase phase(profiler, "sort-pso", parallelProcesses);
             generateNewPermutation(permDirs[5],
                     lastInput, 0, 2, 1, parallelProcesses,
                     maxReadingThreads);
@@ -2674,11 +3036,14 @@ void Loader::createIndices(
                     IDX_PSO, maxReadingThreads,
                     parallelProcesses,
                     estimatedSize,
-                    false);
+                    false,
+                    maxMemory);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(permDirs[5]));
+                    ParamsMergeDiskFragments(permDirs[5], maxMemory));
+        }
+        if (checkpoint == NULL) {
+            Utils::remove_all(lastInput);
         }
-        Utils::remove_all(lastInput);
 
         ParamInsert params;
         params.parallelProcesses = parallelProcesses;
@@ -2695,12 +3060,24 @@ void Loader::createIndices(
         params.printstats = printStats;
         params.removeInput = false;
         params.deletePreviousExt = false;
+        params.maxMemory = maxMemory;
 
-        insert(params);
+        params.keepSortedRuns = checkpoint != NULL;
+        params.profiler = profiler;
+
+        if (!restoreIndex(5, ins)) {
+            insert(params);
+        }
+        if (checkpointIndices) {
+            ins->stopInserts(5);
+            checkpointIndex(5, ins, treeWriters[5], { outputDirs[5] });
+        }
         LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
 
         lastInput = permDirs[5];
-        Utils::remove_all(lastInput);
+        if (checkpoint == NULL) {
+            Utils::remove_all(lastInput);
+        }
     } else {
         ParamInsert params;
         params.parallelProcesses = parallelProcesses;
@@ -2717,20 +3094,55 @@ void Loader::createIndices(
         params.printstats = printStats;
         params.removeInput = true;
         params.deletePreviousExt = false;
+        params.maxMemory = maxMemory;
 
+        LoadPhase phase(profiler, "sort-pso", parallelProcesses);
         PermSorter::sortChunks2(aggr2Dir,
                 IDX_PSO, maxReadingThreads,
                 parallelProcesses,
                 estimatedSize,
-                true);
+                true,
+                maxMemory);
         mergeDiskFragments(
-                ParamsMergeDiskFragments(aggr2Dir));
+                ParamsMergeDiskFragments(aggr2Dir, maxMemory));
+        phase.end();
+
+        params.keepSortedRuns = checkpoint != NULL;
+        params.profiler = profiler;
 
         insert(params);
         LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
     }
 }
 
+bool Loader::restoreIndex(int permutation, Inserter *ins) {
+    const string phase = getIndexPhase(permutation);
+    if (checkpoint == NULL || !checkpoint->isCompleted(phase)) {
+        return false;
+    }
+    LOG(INFOL) << "The index " << _permNames[permutation] <<
+        " was created by the previous load";
+    ins->restoreCounters(permutation,
+            std::stoll(checkpoint->getParam(phase + "-ntables")),
+            std::stoll(checkpoint->getParam(phase + "-nfirsttables")),
+            std::stoll(checkpoint->getParam(phase + "-ntriples")));
+    return true;
+}
+
+void Loader::checkpointIndex(int permutation, Inserter *ins,
+        TreeWriter *treeWriter, std::vector<string> outputs) {
+    const string phase = getIndexPhase(permutation);
+    treeWriter->flush();
+    outputs.push_back(treeWriter->getPath());
+    checkpoint->setParam(phase + "-ntables",
+            to_string(ins->getNTablesPerPartition(permutation)));
+    checkpoint->setParam(phase + "-nfirsttables",
+            to_string(ins->getNFirstTablesPerPartition(permutation)));
+    checkpoint->setParam(phase + "-ntriples",
+            to_string(ins->getNTriplesInserted(permutation)));
+    checkpoint->markCompleted(phase, outputs);
+}
+
 void Loader::createPermutations(string inputDir, int nperms, int signaturePerms,
         string *outputPermFiles, int parallelProcesses, int maxReadingThreads) {
     MultiDiskLZ4Writer ***permWriters = new MultiDiskLZ4Writer**[nperms];
@@ -2827,117 +3239,16 @@ void Loader::createPermutations(string inputDir, int nperms, int signaturePerms,
     delete[] permWriters;
 }
 
-void Loader::processTermCoordinates(Inserter *ins,
-        SharedStructs *structs) {
-    BufferCoordinates *buffer;
-    while ((buffer = getBunchTermCoordinates(structs)) != NULL) {
-        nTerm key;
-        while (!buffer->isEmpty()) {
-            TermCoordinates *value = buffer->getNext(key);
-            ins->insert(key, value);
-        }
-        releaseBunchTermCoordinates(buffer, structs);
-    }
-}
-
-void Loader::mergeTermCoordinates(ParamsMergeCoordinates params) {
-    auto coordinates = params.coordinates;
-    auto ncoordinates = params.ncoordinates;
-    auto bufferToFill = params.bufferToFill;
-    auto isFinished = params.isFinished;
-    auto buffersReady = params.buffersReady;
-    auto buffer1 = params.buffer1;
-    auto buffer2 = params.buffer2;
-    auto cond = params.cond;
-    auto mut = params.mut;
-
-    CoordinatesMerger merger(coordinates, ncoordinates);
-    nTerm key;
-    TermCoordinates *value = NULL;
-    while ((value = merger.get(key)) != NULL) {
-        if (bufferToFill->isFull()) {
-            std::unique_lock<std::mutex> lock(*mut);
-            (*buffersReady)++;
-            if (*buffersReady > 0) {
-                cond->notify_one();
-            }
-
-            while (*buffersReady == 2) {
-                cond->wait(lock);
-            }
-
-            //Take next buffer
-            bufferToFill = (bufferToFill == buffer1) ? buffer2 : buffer1;
-        }
-        bufferToFill->add(key, value);
-    }
-    std::unique_lock<std::mutex> lock(*mut);
-    if (!bufferToFill->isEmpty()) {
-        (*buffersReady)++;
-    }
-    *isFinished = true;
-    cond->notify_one();
-    lock.unlock();
-}
-
-BufferCoordinates *Loader::getBunchTermCoordinates(SharedStructs *structs) {
-    std::unique_lock<std::mutex> lock(structs->mut);
-    while (structs->buffersReady == 0) {
-        if (structs->isFinished) {
-            lock.unlock();
-            return NULL;
-        }
-        structs->cond.wait(lock);
-    }
-    lock.unlock();
-
-    BufferCoordinates *tmpBuffer = structs->bufferToReturn;
-    structs->bufferToReturn = (structs->bufferToReturn == &structs->buffer1) ?
-        &structs->buffer2 : &structs->buffer1;
-    return tmpBuffer;
-
-}
-
-void Loader::releaseBunchTermCoordinates(BufferCoordinates *cord,
-        SharedStructs *structs) {
-    cord->clear();
-    std::unique_lock<std::mutex> lock(structs->mut);
-    if (structs->buffersReady == 2) {
-        structs->cond.notify_one();
-    }
-    structs->buffersReady--;
-    lock.unlock();
-}
-
 void Loader::testLoadingTree(string tmpDir, Inserter *ins, int nindices) {
     string *sTreeWriters = new string[nindices];
-    std::thread *threads = new std::thread[1];
     for (int i = 0; i < nindices; ++i) {
         sTreeWriters[i] = tmpDir + DIR_SEP + string("tmpTree" ) + to_string(i);
     }
-
-    SharedStructs structs;
-    structs.bufferToFill = structs.bufferToReturn = &structs.buffer1;
-    structs.isFinished = false;
-    structs.buffersReady = 0;
-
-    ParamsMergeCoordinates params;
-    params.coordinates = sTreeWriters;
-    params.ncoordinates = 6;
-
-    params.bufferToFill = structs.bufferToFill;
-    params.isFinished = &structs.isFinished;
-    params.buffersReady = &structs.buffersReady;
-    params.buffer1 = &structs.buffer1;
-    params.buffer2 = &structs.buffer2;
-    params.cond = &structs.cond;
-    params.mut = &structs.mut;
-    threads[0] = std::thread(
-            std::bind(&Loader::mergeTermCoordinates, params));
-    processTermCoordinates(ins, &structs);
-    threads[0].join();
+    std::vector<TermCoordinatesSource*> mergers;
+    mergers.push_back(new CoordinatesMerger(sTreeWriters, nindices));
+    ins->bulkInsert(mergers);
+    delete mergers[0];
     delete[] sTreeWriters;
-    delete[] threads;
 }
 
 TermCoordinates *CoordinatesMerger::get(nTerm &key) {
@@ -3043,11 +3354,32 @@ bool CoordinatesMerger::getFirst(TreeEl *el, ifstream *buffer) {
         el->nElements = Utils::decode_long(supportBuffer, 8);
         el->pos = Utils::decode_int(supportBuffer, 18);
         el->strat = supportBuffer[22];
-        return true;
+        return el->key < endKey;
     }
     return false;
 }
 
+void CoordinatesMerger::seek(ifstream *buffer, nTerm startKey) {
+    if (startKey == 0 || !buffer->good()) {
+        return;
+    }
+    //The records have a fixed size and are sorted by key
+    buffer->seekg(0, ios_base::end);
+    int64_t low = 0;
+    int64_t high = (int64_t)buffer->tellg() / 23;
+    while (low < high) {
+        const int64_t mid = (low + high) >> 1;
+        buffer->seekg(mid * 23);
+        buffer->read(supportBuffer, 8);
+        if (Utils::decode_long(supportBuffer, 0) < startKey) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    buffer->seekg(low * 23);
+}
+
 /*bool L_Triple::sLess_sop(const L_Triple &t1, const L_Triple &t2) {
   if (t1.first < t2.first) {
   return true;
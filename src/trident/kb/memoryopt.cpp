@@ -46,7 +46,8 @@ int MemoryOptimizer::calculateBytesPerDictPair(int64_t nTerms, int leafSize) {
     return (1 + nbytesKey + nbytesValue) * leafSize;
 }
 
-void MemoryOptimizer::optimizeForWriting(int64_t inputTriples, KBConfig &config) {
+void MemoryOptimizer::optimizeForWriting(int64_t inputTriples, KBConfig &config,
+        int64_t maxMemory) {
     //int64_t totalMemory = (int64_t) (Utils::getSystemMemory() * 0.8);
     int64_t nTerms = inputTriples / 4;
     //int dictionaries = config.getParamInt(DICTPARTITIONS);
@@ -113,6 +114,24 @@ void MemoryOptimizer::optimizeForWriting(int64_t inputTriples, KBConfig &config)
     //config.setParamLong(STORAGE_CACHE_SIZE,
     //                     config.getParamInt(STORAGE_MAX_FILE_SIZE) * 4);
     config.setParamLong(STORAGE_MAX_N_FILES, 4);
+
+    if (maxMemory > 0) {
+        //The caches of the trees and of the string buffer may use at most a
+        //quarter of the budget. The rest is left to the sorting and merging
+        int64_t cacheBudget = maxMemory / 16;
+        config.setParamLong(TREE_MAXSIZECACHETREE,
+                            std::min(config.getParamLong(TREE_MAXSIZECACHETREE),
+                                     cacheBudget));
+        config.setParamLong(DICT_MAXSIZECACHETREE,
+                            std::min(config.getParamLong(DICT_MAXSIZECACHETREE),
+                                     cacheBudget));
+        config.setParamLong(INVDICT_MAXSIZECACHETREE,
+                            std::min(config.getParamLong(INVDICT_MAXSIZECACHETREE),
+                                     cacheBudget));
+        config.setParamLong(SB_CACHESIZE,
+                            std::min(config.getParamLong(SB_CACHESIZE),
+                                     cacheBudget));
+    }
 }
 
 void MemoryOptimizer::optimizeForReasoning(int ndicts, KBConfig &config) {
@@ -0,0 +1,324 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+
+#include <trident/kb/memtable.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/dictmgmt.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//Position of the key and of the two values in the triple, by permutation
+static const int _memPerms[N_PARTITIONS][3] = {
+    { 0, 1, 2 }, //SPO
+    { 2, 1, 0 }, //OPS
+    { 1, 2, 0 }, //POS
+    { 0, 2, 1 }, //SOP
+    { 2, 0, 1 }, //OSP
+    { 1, 0, 2 }, //PSO
+};
+
+static MemRow _permute(const int perm, const int64_t *triple) {
+    MemRow r;
+    r.key = triple[_memPerms[perm][0]];
+    r.v1 = triple[_memPerms[perm][1]];
+    r.v2 = triple[_memPerms[perm][2]];
+    return r;
+}
+
+static int _memIdx(DiffIndex::TypeUpdate type) {
+    return type == DiffIndex::TypeUpdate::ADDITION_df ? 0 : 1;
+}
+
+//Records of the log. A term is stored as its id, its length in 4 bytes and
+//its text
+#define WAL_ADD 'A'
+#define WAL_RM 'R'
+#define WAL_TERM 'T'
+
+MemTable::MemTable(std::string walFile) : walFile(walFile), wal(-1),
+    nrows(0) {
+}
+
+MemTable::~MemTable() {
+    closeLog();
+}
+
+bool MemTable::apply(DiffIndex::TypeUpdate type, int64_t s, int64_t p,
+        int64_t o, Querier *q) {
+    const int64_t triple[3] = { s, p, o };
+    const MemRow spo = _permute(IDX_SPO, triple);
+    const int t = _memIdx(type);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rows[1 - t][IDX_SPO].count(spo)) {
+        //The update cancels a previous one
+        for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+            rows[1 - t][perm].erase(_permute(perm, triple));
+            snapshots[1 - t][perm] = NULL;
+        }
+        nrows--;
+        return true;
+    }
+    if (rows[t][IDX_SPO].count(spo)) {
+        return false;
+    }
+    //Additions must be new and removals must refer to existing triples
+    if (q->exists(s, p, o) == (type == DiffIndex::TypeUpdate::ADDITION_df)) {
+        return false;
+    }
+    for (int perm = 0; perm < N_PARTITIONS; ++perm) {
+        rows[t][perm].insert(_permute(perm, triple));
+        snapshots[t][perm] = NULL;
+    }
+    nrows++;
+    return true;
+}
+
+void MemTable::log(const char *record, size_t size, bool sync) {
+    if (wal == -1) {
+        Utils::create_directories(Utils::parentDir(walFile));
+#if defined(_WIN32)
+        wal = _open(walFile.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND |
+                _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        wal = open(walFile.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+        if (wal == -1) {
+            LOG(ERRORL) << "Cannot open the log " << walFile;
+            throw 10;
+        }
+    }
+    while (size > 0) {
+#if defined(_WIN32)
+        int written = _write(wal, record, size);
+#else
+        ssize_t written = write(wal, record, size);
+#endif
+        if (written < 0) {
+            LOG(ERRORL) << "Error writing the log " << walFile;
+            throw 10;
+        }
+        record += written;
+        size -= written;
+    }
+    //Survive a crash of the machine, not only of the process
+    if (sync) {
+#if defined(_WIN32)
+        int ret = _commit(wal);
+#else
+        int ret = fsync(wal);
+#endif
+        if (ret != 0) {
+            LOG(ERRORL) << "Error syncing the log " << walFile;
+            throw 10;
+        }
+    }
+}
+
+void MemTable::closeLog() {
+    if (wal != -1) {
+#if defined(_WIN32)
+        _close(wal);
+#else
+        close(wal);
+#endif
+        wal = -1;
+    }
+}
+
+bool MemTable::update(DiffIndex::TypeUpdate type, int64_t s, int64_t p,
+        int64_t o, Querier *q) {
+    if (!apply(type, s, p, o, q)) {
+        return false;
+    }
+    char record[25];
+    record[0] = type == DiffIndex::TypeUpdate::ADDITION_df ? WAL_ADD : WAL_RM;
+    Utils::encode_long(record, 1, s);
+    Utils::encode_long(record, 9, p);
+    Utils::encode_long(record, 17, o);
+    //The terms logged before are synced with the triple
+    log(record, 25, true);
+    return true;
+}
+
+void MemTable::logTerm(int64_t id, const char *term, size_t len) {
+    std::unique_ptr<char[]> record(new char[13 + len]);
+    record[0] = WAL_TERM;
+    Utils::encode_long(record.get(), 1, id);
+    Utils::encode_int(record.get(), 9, len);
+    memcpy(record.get() + 13, term, len);
+    log(record.get(), 13 + len, false);
+}
+
+void MemTable::replay(DictMgmt *dict, int64_t &nextID, int64_t &nTerms,
+        Querier *q) {
+    if (!Utils::exists(walFile)) {
+        return;
+    }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    const int64_t size = Utils::fileSize(walFile);
+    std::ifstream ifs(walFile, std::ios_base::binary);
+    char record[25];
+    int64_t pos = 0;
+    int64_t nrecords = 0;
+    while (pos < size) {
+        ifs.read(record, 1);
+        if (record[0] == WAL_TERM) {
+            if (pos + 13 > size) {
+                break;
+            }
+            ifs.read(record + 1, 12);
+            const int64_t id = Utils::decode_long(record, 1);
+            const int len = Utils::decode_int(record, 9);
+            if (len < 0 || len > MAX_TERM_SIZE) {
+                LOG(ERRORL) << "The log " << walFile << " is corrupted at " << pos;
+                throw 10;
+            }
+            if (pos + 13 + len > size) {
+                break;
+            }
+            std::string term(len, 0);
+            ifs.read(&term[0], len);
+            nTerm existing;
+            if (!dict->getNumber(term.c_str(), len, &existing)) {
+                dict->putInUpdateDict(id, term.c_str(), len);
+                nTerms++;
+            }
+            nextID = std::max(nextID, id + 1);
+            pos += 13 + len;
+        } else if (record[0] == WAL_ADD || record[0] == WAL_RM) {
+            if (pos + 25 > size) {
+                break;
+            }
+            ifs.read(record + 1, 24);
+            //The triples flushed before a crash are filtered out by apply
+            apply(record[0] == WAL_ADD ? DiffIndex::TypeUpdate::ADDITION_df :
+                    DiffIndex::TypeUpdate::DELETE_df,
+                    Utils::decode_long(record, 1),
+                    Utils::decode_long(record, 9),
+                    Utils::decode_long(record, 17), q);
+            pos += 25;
+        } else {
+            LOG(ERRORL) << "The log " << walFile << " is corrupted at " << pos;
+            throw 10;
+        }
+        nrecords++;
+    }
+    ifs.close();
+    if (pos < size) {
+        //The last record was only partially written
+        LOG(WARNL) << "Discarding an incomplete record at the end of " << walFile;
+        Utils::resizeFile(walFile, pos);
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Replayed " << nrecords << " updates from the log in " <<
+        sec.count() * 1000 << " ms. " << nrows << " triples are in memory";
+}
+
+uint64_t MemTable::getSize(DiffIndex::TypeUpdate type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rows[_memIdx(type)][IDX_SPO].size();
+}
+
+std::shared_ptr<const MemRows> MemTable::getRows(DiffIndex::TypeUpdate type,
+        int perm) {
+    const int t = _memIdx(type);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (snapshots[t][perm] == NULL) {
+        snapshots[t][perm] = std::shared_ptr<const MemRows>(
+                new MemRows(rows[t][perm].begin(), rows[t][perm].end()));
+    }
+    return snapshots[t][perm];
+}
+
+static int64_t _countKey(const MemRows &rows, int64_t key) {
+    auto b = std::lower_bound(rows.begin(), rows.end(), key,
+            [](const MemRow &r, const int64_t k) { return r.key < k; });
+    auto e = std::upper_bound(b, rows.end(), key,
+            [](const int64_t k, const MemRow &r) { return k < r.key; });
+    return e - b;
+}
+
+int64_t MemTable::getCard(int perm, int64_t key) {
+    if (isEmpty()) {
+        return 0;
+    }
+    return _countKey(*getRows(DiffIndex::TypeUpdate::ADDITION_df, perm), key) -
+        _countKey(*getRows(DiffIndex::TypeUpdate::DELETE_df, perm), key);
+}
+
+static int64_t _countDistinct(const MemRows &rows, int64_t key) {
+    auto b = std::lower_bound(rows.begin(), rows.end(), key,
+            [](const MemRow &r, const int64_t k) { return r.key < k; });
+    int64_t n = 0;
+    for (auto itr = b; itr != rows.end() && itr->key == key; ++itr) {
+        if (itr == b || itr->v1 != (itr - 1)->v1) {
+            n++;
+        }
+    }
+    return n;
+}
+
+int64_t MemTable::getNDistinct(int perm, int64_t key) {
+    if (isEmpty()) {
+        return 0;
+    }
+    return _countDistinct(*getRows(DiffIndex::TypeUpdate::ADDITION_df, perm),
+            key) - _countDistinct(*getRows(DiffIndex::TypeUpdate::DELETE_df,
+                    perm), key);
+}
+
+void MemTable::getTriples(DiffIndex::TypeUpdate type,
+        std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &r : rows[_memIdx(type)][IDX_SPO]) {
+        all_s.push_back(r.key);
+        all_p.push_back(r.v1);
+        all_o.push_back(r.v2);
+    }
+}
+
+void MemTable::truncateLog() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closeLog();
+    //The table is not updated anymore. The next one appends to the same log
+    if (Utils::exists(walFile)) {
+        std::ofstream truncated(walFile, std::ios_base::binary |
+                std::ios_base::trunc);
+    }
+}
@@ -25,6 +25,7 @@
 #include <kognac/utils.h>
 #include <kognac/compressor.h>
 
+#include <cstring>
 #include <thread>
 #include <functional>
 #include <array>
@@ -701,12 +702,81 @@ void PermSorter::sortChunks2_permute(
     }
 }
 
+bool PermSorter::sameFirstColumn(int currentPerm, int nextPerm) {
+    return (currentPerm == IDX_SPO && nextPerm == IDX_SOP) ||
+        (currentPerm == IDX_OSP && nextPerm == IDX_OPS) ||
+        (currentPerm == IDX_POS && nextPerm == IDX_PSO);
+}
+
+void PermSorter::sortGroups_seq(char *start, char *end,
+        const size_t sizeTriple,
+        bool includeCount) {
+    while (start < end) {
+        char *next = start + sizeTriple;
+        while (next < end && memcmp(start, next, 5) == 0) {
+            next += sizeTriple;
+        }
+        if (next - start > sizeTriple) {
+            if (includeCount) {
+                std::sort((__PermSorter_tripleCount*) start,
+                        (__PermSorter_tripleCount*) next,
+                        &__PermSorter_tripleCount_sorter);
+            } else {
+                std::sort((__PermSorter_triple*) start,
+                        (__PermSorter_triple*) next,
+                        &__PermSorter_triple_sorter);
+            }
+        }
+        start = next;
+    }
+}
+
+void PermSorter::sortGroups(char *start, char *end,
+        const size_t sizeTriple,
+        int nthreads,
+        bool includeCount) {
+    std::chrono::system_clock::time_point starttime = std::chrono::system_clock::now();
+    //Split the array in ranges that do not break any group
+    const size_t ntriples = (end - start) / sizeTriple;
+    const size_t chunkSize = max((size_t)1, ntriples / max(1, nthreads));
+    std::vector<char*> boundaries;
+    boundaries.push_back(start);
+    for (int i = 1; i < nthreads; ++i) {
+        char *b = start + i * chunkSize * sizeTriple;
+        if (b <= boundaries.back()) {
+            continue;
+        }
+        while (b < end && memcmp(b - sizeTriple, b, 5) == 0) {
+            b += sizeTriple;
+        }
+        if (b >= end) {
+            break;
+        }
+        boundaries.push_back(b);
+    }
+    boundaries.push_back(end);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < boundaries.size() - 1; ++i) {
+        threads.push_back(std::thread(PermSorter::sortGroups_seq,
+                    boundaries[i], boundaries[i + 1], sizeTriple,
+                    includeCount));
+    }
+    sortGroups_seq(boundaries[0], boundaries[1], sizeTriple, includeCount);
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> duration = std::chrono::system_clock::now() - starttime;
+    LOG(DEBUGL) << "Time sorting the groups: " << duration.count() << "s.";
+}
+
 void PermSorter::sortChunks2(
         std::vector<std::pair<string, char>> &permutations,
         int ionthreads,
         int nthreads,
         int64_t estimatedSize,
-        bool includeCount) {
+        bool includeCount,
+        int64_t maxMemory) {
     std::string inputdir = permutations[0].first;
     std::vector<string> unsortedFiles = Utils::getFiles(inputdir, false);
     const size_t threadsToUse = min((int)unsortedFiles.size(), (int) nthreads);
@@ -714,7 +784,13 @@ void PermSorter::sortChunks2(
     const size_t sizeTriple = includeCount ? 23 : 15;
 
     LOG(DEBUGL) << "Start sortChunks2";
-    const int64_t mem = Utils::getSystemMemory() * 0.6;
+    int64_t mem = Utils::getSystemMemory() * 0.6;
+    if (maxMemory > 0) {
+        //The parallel merge sort can allocate a temporary buffer as large as
+        //the array to sort. Therefore, I can use only half of the budget
+        mem = min(mem, maxMemory / 2);
+        LOG(DEBUGL) << "Memory budget for sorting is " << mem << " bytes";
+    }
     const size_t max_nelements = mem / sizeTriple;
 
     size_t nelements = max((size_t)threadsToUse,
@@ -859,9 +935,17 @@ void PermSorter::sortChunks2(
 
             //Sort it
             LOG(DEBUGL) << "Start sorting the inmemory array. perm=" << permID;
-            PermSorter::sortPermutation(rawTriples.get(),
-                    rawTriples.get() + nloadedtriples * sizeTriple, threadsToUse,
-                    includeCount);
+            if (PermSorter::sameFirstColumn(currentPerm, permID)) {
+                //The array is already sorted by the first column. It is
+                //enough to sort each group
+                PermSorter::sortGroups(rawTriples.get(),
+                        rawTriples.get() + nloadedtriples * sizeTriple,
+                        sizeTriple, threadsToUse, includeCount);
+            } else {
+                PermSorter::sortPermutation(rawTriples.get(),
+                        rawTriples.get() + nloadedtriples * sizeTriple,
+                        threadsToUse, includeCount);
+            }
             LOG(DEBUGL) << "Stop sorting the inmemory array";
 
             //Dump it
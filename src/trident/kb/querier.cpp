@@ -54,11 +54,12 @@ Querier::Querier(Root* tree, DictMgmt *dict, TableStorage** files,
         const int64_t inputSize, const int64_t nTerms, const int nindices,
         const int64_t *nTablesPerPartition,
         const int64_t *nFirstTablesPerPartition, KB *sampleKB,
-        std::vector<std::unique_ptr<DiffIndex>> &diffIndices)
+        std::shared_ptr<const KBSnapshot> snapshot)
     : inputSize(inputSize), nTerms(nTerms),
     nTablesPerPartition(nTablesPerPartition),
     nFirstTablesPerPartition(nFirstTablesPerPartition), nindices(nindices),
-    diffIndices(diffIndices) {
+    snapshot(snapshot), diffIndices(snapshot->diffIndices), memtable(NULL),
+    reverseCache(NULL) {
         this->tree = tree;
         this->dict = dict;
         this->files = files;
@@ -80,20 +81,14 @@ Querier::Querier(Root* tree, DictMgmt *dict, TableStorage** files,
         if (sampleKB != NULL) {
             sampler = std::unique_ptr<Querier>(sampleKB->query());
         }
-        for (int i = 0; i < diffIndices.size(); ++i) {
-            DiffIndex *diff = diffIndices[i].get();
-            initDiffIndex(diff);
-        }
-    }
-
-void Querier::initDiffIndex(DiffIndex *diff) {
-    if (diff->getClass() == DiffIndex::DIFF3) {
-        ((DiffIndex3*)diff)->setStorageStrat(&strat);
-    } else {
-        assert(diff->getClass() == DiffIndex::DIFF1);
-        ((DiffIndex1*)diff)->setFactoryIterators(&factory13);
     }
 
+Querier *Querier::copy() {
+    Querier *q = new Querier(tree, dict, files, inputSize, nTerms, nindices,
+            nTablesPerPartition, nFirstTablesPerPartition, NULL, snapshot);
+    q->setMemTable(memtable);
+    q->setReverseCache(reverseCache);
+    return q;
 }
 
 char Querier::getStrategy(const int idx, const int64_t v) {
@@ -157,13 +152,7 @@ uint64_t Querier::getCardOnIndex(const int idx, const int64_t first, const int64
                     nElements += currentValue.getNElements(idx2);
                 }
 
-                for (size_t i = 0; i < diffIndices.size(); ++i) {
-                    if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
-                        nElements += diffIndices[i]->getCard(idx2, lastKeyQueried);
-                    } else {
-                        nElements -= diffIndices[i]->getCard(idx2, lastKeyQueried);
-                    }
-                }
+                nElements += getDiffCard(idx2, lastKeyQueried);
                 return nElements;
             }
         } else if (countUnbound == 1) {
@@ -230,6 +219,12 @@ int64_t Querier::getCard(const int64_t s, const int64_t p, const int64_t o, uint
                     idx2 = IDX_OPS;
                 }
             }
+            if (p >= 0 && !diffIndices.empty() && hasDiffStats()) {
+                //Count the base and correct it with the statistics of
+                //the diffs
+                releaseItr(itr);
+                return getNDistinct(idx2, p);
+            }
             if (idx != idx2) {
                 releaseItr(itr);
                 itr = get(idx2, s, p, o);
@@ -249,6 +244,69 @@ int64_t Querier::getCard(const int64_t s, const int64_t p, const int64_t o, uint
     }
 }
 
+int64_t Querier::getDiffCard(const int perm, const int64_t key) {
+    int64_t nElements = 0;
+    for (size_t i = 0; i < diffIndices.size(); ++i) {
+        int64_t card;
+        const DiffStats *stats = diffIndices[i]->getStats();
+        if (stats && (perm == IDX_POS || perm == IDX_PSO)) {
+            const DiffStats::PredicateStats *ps = stats->getPredicate(key);
+            card = ps ? ps->ntriples : 0;
+        } else {
+            card = diffIndices[i]->getCard(perm, key);
+        }
+        if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
+            nElements += card;
+        } else {
+            nElements -= card;
+        }
+    }
+    if (memtable) {
+        nElements += memtable->getCard(perm, key);
+    }
+    return nElements;
+}
+
+bool Querier::hasDiffStats() const {
+    for (size_t i = 0; i < diffIndices.size(); ++i) {
+        if (diffIndices[i]->getStats() == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t Querier::getNDistinct(const int perm, const int64_t p) {
+    int64_t nElements = 0;
+    if (lastKeyQueried != p) {
+        lastKeyFound = tree->get(p, &currentValue);
+        lastKeyQueried = p;
+    }
+    if (lastKeyFound) {
+        PairItr *itr = get(perm, currentValue, p, -1, -1, true);
+        if (itr->getTypeItr() != EMPTY_ITR) {
+            itr->ignoreSecondColumn();
+            nElements = itr->getCardinality();
+            releaseItr(itr);
+        }
+    }
+    for (size_t i = 0; i < diffIndices.size(); ++i) {
+        const DiffStats::PredicateStats *ps = diffIndices[i]->getStats()->getPredicate(p);
+        if (ps) {
+            const int64_t n = perm == IDX_PSO ? ps->nsubjects : ps->nobjects;
+            if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
+                nElements += n;
+            } else {
+                nElements -= n;
+            }
+        }
+    }
+    if (memtable) {
+        nElements += memtable->getNDistinct(perm, p);
+    }
+    return std::max(nElements, (int64_t) 0);
+}
+
 uint64_t Querier::isAggregated(const int idx, const int64_t first, const int64_t second,
         const int64_t third) {
     if (idx != IDX_POS && idx != IDX_PSO)
@@ -387,9 +445,7 @@ uint64_t Querier::estCardOnIndex(const int idx, const int64_t first, const int64
         if (currentValue.exists(perm)) {
             nElements += currentValue.getNElements(perm);
         }
-        for (size_t i = 0; i < diffIndices.size(); ++i) {
-            nElements += diffIndices[i]->getCard(perm, key1);
-        }
+        nElements += getDiffCard(perm, key1);
         return nElements;
     }
 }
@@ -434,9 +490,7 @@ int64_t Querier::estCard(const int64_t s, const int64_t p, const int64_t o) {
         if (currentValue.exists(perm)) {
             nElements += currentValue.getNElements(perm);
         }
-        for (size_t i = 0; i < diffIndices.size(); ++i) {
-            nElements += diffIndices[i]->getCard(perm, key);
-        }
+        nElements += getDiffCard(perm, key);
         return nElements;
     }
     throw 10;
@@ -470,9 +524,7 @@ int64_t Querier::getCard(const int64_t s, const int64_t p, const int64_t o) {
         if (lastKeyFound && currentValue.exists(idx)) {
             nElements += currentValue.getNElements(idx);
         }
-        for (size_t i = 0; i < diffIndices.size(); ++i) {
-            nElements += diffIndices[i]->getCard(idx, key);
-        }
+        nElements += getDiffCard(idx, key);
         return nElements;
     }
 
@@ -521,6 +573,9 @@ bool Querier::isEmpty(const int64_t s, const int64_t p, const int64_t o) {
                 }
             }
         }
+        if (memtable && memtable->getSize(DiffIndex::TypeUpdate::ADDITION_df) > 0) {
+            return false;
+        }
         return true;
     }
 
@@ -826,6 +881,9 @@ PairItr *Querier::get(const int idx, TermCoordinates &value,
             return itr;
         }
     } else if (idx - 3 >= 0 && value.exists(idx - 3)) {
+        if (reverseCache) {
+            return getReverseFromCache(idx, value, key, v1, v2, cons);
+        }
         PairItr *itr = get(idx - 3, value, key, -1, -1, cons);
         PairItr *itr2 = newItrOnReverse(itr, v1, v2);
         itr2->setKey(key);
@@ -963,12 +1021,16 @@ PairItr *Querier::get(const int idx, const int64_t s, const int64_t p, const int
         std::vector<PairItr*> iterators;
         int64_t nfirstterms = 0;
         for (int i = 0; i < diffIndices.size(); ++i) {
+            if (first >= 0 && !diffIndices[i]->mayContain(idx, first)) {
+                //The filter excludes that the diff contains the key
+                continue;
+            }
             PairItr *diffItr = NULL;
             if (diffIndices[i]->getType() == DiffIndex::TypeUpdate::DELETE_df) {
                 int64_t delnfirstterms = 0;
                 if (first >= 0) {
                     diffItr = diffIndices[i]->getIterator(idx, first, second,
-                            third, delnfirstterms);
+                            third, delnfirstterms, this);
                 } else {
                     DiffScanItr *newitr = factory11.get();
                     newitr->setQuerier(this);
@@ -1013,7 +1075,7 @@ PairItr *Querier::get(const int idx, const int64_t s, const int64_t p, const int
             } else {
                 if (first >= 0) {
                     diffItr = diffIndices[i]->getIterator(idx, first, second,
-                            third, nfirstterms);
+                            third, nfirstterms, this);
                     if (second >= 0) {
                         //I must change nfirstterms, which can be either 1 or 0
                         //(depending if the second term is already existing on the KB).
@@ -1037,7 +1099,7 @@ PairItr *Querier::get(const int idx, const int64_t s, const int64_t p, const int
                         diffItr = ((DiffIndex3*)diffIndices[i].get())->getScan(idx, newitr);
                     } else {
                         //Diff1 update getIterator() method can handle scans
-                        diffItr = diffIndices[i]->getIterator(idx, first, second, third, nfirstterms);
+                        diffItr = diffIndices[i]->getIterator(idx, first, second, third, nfirstterms, this);
                     }
                 }
                 if (diffItr->hasNext()) {
@@ -1059,7 +1121,7 @@ PairItr *Querier::get(const int idx, const int64_t s, const int64_t p, const int
                     CompositeItr *itr = factory8.get();
                     itr->init(iterators, nfirstterms, out);
                     itr->setKey(first);
-                    return itr;
+                    out = itr;
                 } else {
                     CompositeScanItr *itr = factory12.get();
                     itr->init(idx);
@@ -1067,17 +1129,74 @@ PairItr *Querier::get(const int idx, const int64_t s, const int64_t p, const int
                     for (int i = 0; i < iterators.size(); ++i) {
                         itr->addChild(iterators[i]);
                     }
-                    return itr;
+                    out = itr;
                 }
             } else {
-                return iterators[0];
+                out = iterators[0];
             }
         }
     }
 
+    if (memtable && !memtable->isEmpty()) {
+        out = addMemTable(idx, first, second, third, out);
+    }
     return out;
 }
 
+PairItr *Querier::addMemTable(const int idx, const int64_t first,
+        const int64_t second, const int64_t third, PairItr *out) {
+    //Filter out the triples removed in memory
+    MemItr *rm = factory16.get();
+    rm->init(memtable->getRows(DiffIndex::TypeUpdate::DELETE_df, idx),
+            first, second, third);
+    if (rm->hasNext() && out->hasNext()) {
+        RmItr *rmitr = factory14.get();
+        rmitr->init(out, rm, 0);
+        out = rmitr;
+    } else {
+        releaseItr(rm);
+    }
+
+    //Merge the triples added in memory
+    std::shared_ptr<const MemRows> added = memtable->getRows(
+            DiffIndex::TypeUpdate::ADDITION_df, idx);
+    MemItr *add = factory16.get();
+    add->init(added, first, second, third);
+    if (!add->hasNext()) {
+        releaseItr(add);
+        return out;
+    }
+    if (!out->hasNext()) {
+        releaseItr(out);
+        return add;
+    }
+    std::vector<PairItr*> iterators;
+    iterators.push_back(add);
+    iterators.push_back(out);
+    if (first >= 0) {
+        //Upper bound of the new first terms, as for the diffs
+        int64_t nfirstterms = 0;
+        if (second < 0) {
+            MemItr counter;
+            counter.init(added, first, second, third);
+            counter.ignoreSecondColumn();
+            nfirstterms = counter.getCardinality();
+        }
+        CompositeItr *itr = factory8.get();
+        itr->init(iterators, nfirstterms, out);
+        itr->setKey(first);
+        return itr;
+    } else {
+        CompositeScanItr *itr = factory12.get();
+        itr->init(idx);
+        itr->setQuerier(this);
+        for (int i = 0; i < iterators.size(); ++i) {
+            itr->addChild(iterators[i]);
+        }
+        return itr;
+    }
+}
+
 PairItr *Querier::newItrOnReverse(PairItr * oldItr, const int64_t v1, const int64_t v2) {
     std::shared_ptr<Pairs> tmpVector = std::shared_ptr<Pairs>(new Pairs());
     while (oldItr->hasNext()) {
@@ -1099,6 +1218,33 @@ PairItr *Querier::newItrOnReverse(PairItr * oldItr, const int64_t v1, const int6
     }
 }
 
+PairItr *Querier::getReverseFromCache(const int idx, TermCoordinates &value,
+        const int64_t key, const int64_t v1, const int64_t v2,
+        const bool cons) {
+    cacheIndices++;
+    std::shared_ptr<const CompactPairs> pairs = reverseCache->get(idx, key);
+    if (!pairs) {
+        PairItr *itr = get(idx - 3, value, key, -1, -1, cons);
+        Pairs tmpVector;
+        while (itr->hasNext()) {
+            itr->next();
+            tmpVector.push_back(std::make_pair(itr->getValue2(),
+                        itr->getValue1()));
+        }
+        releaseItr(itr);
+        if (tmpVector.empty()) {
+            return &emptyItr;
+        }
+        std::sort(tmpVector.begin(), tmpVector.end());
+        pairs = std::shared_ptr<const CompactPairs>(new CompactPairs(tmpVector));
+        reverseCache->put(idx, key, pairs);
+    }
+    CacheItr *itr = factory5.get();
+    itr->init(pairs, v1, v2);
+    itr->setKey(key);
+    return itr;
+}
+
 int *Querier::getOrder(int idx) {
     switch (idx) {
         case IDX_SPO:
@@ -1185,6 +1331,10 @@ void Querier::releaseItr(PairItr * itr) {
             citr->clear();
             factory4.release(citr);
             break;
+        case MEM_ITR:
+            itr->clear();
+            factory16.release((MemItr*)itr);
+            break;
         case RM_ITR:
             releaseItr(((RmItr*)itr)->getMainItr());
             releaseItr(((RmItr*)itr)->getRmItr());
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/querierpool.h>
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <trident/tree/root.h>
+
+#include <kognac/logs.h>
+
+QuerierPool::Entry::~Entry() {
+}
+
+QuerierPool::QuerierPool(KB *kb, size_t maxIdle) : kb(kb),
+    maxIdle(maxIdle) {
+#ifndef MT
+    LOG(DEBUGL) << "The library is compiled without MT: the queriers of the pool are used one at a time";
+#endif
+}
+
+QuerierPool::Handle QuerierPool::acquire() {
+    std::unique_lock<std::mutex> session(sessionMutex, std::defer_lock);
+#ifndef MT
+    session.lock();
+#endif
+    std::unique_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            entry = std::move(idle.back());
+            idle.pop_back();
+        }
+    }
+    std::shared_ptr<const KBSnapshot> s = kb->getSnapshot();
+    if (!entry) {
+        entry = std::unique_ptr<Entry>(new Entry());
+        entry->sampleTree = std::unique_ptr<Root>(kb->getSampleRootTree());
+    }
+    //A compaction replaced the tree
+    if (entry->base != s->base) {
+        entry->q = NULL;
+        entry->tree = std::unique_ptr<Root>(kb->getRootTree(*s->base));
+        entry->base = s->base;
+    }
+    //A querier created before the last update must see the new diffs
+    if (!entry->q || entry->q->getSnapshotVersion() != s->version) {
+        entry->q = NULL;
+        entry->q = std::unique_ptr<Querier>(kb->query(s, entry->tree.get(),
+                    entry->sampleTree.get()));
+    } else {
+        //And the terms added since it was created
+        entry->q->setNTerms(kb->getNTerms());
+    }
+    return Handle(this, std::move(entry), std::move(session));
+}
+
+void QuerierPool::release(std::unique_ptr<Entry> entry) {
+    const bool current = entry->base == kb->getSnapshot()->base;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (current && idle.size() < maxIdle) {
+        idle.push_back(std::move(entry));
+    }
+}
+
+void QuerierPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.clear();
+}
@@ -25,16 +25,29 @@
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 #include <trident/kb/dictmgmt.h>
+#include <trident/kb/diffstats.h>
 #include <trident/tree/stringbuffer.h>
 #include <trident/tree/root.h>
+#include <trident/utils/parallel.h>
 
 #include <kognac/filereader.h>
 
 #include <string>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+//The files larger than this are split among the threads
+#define UPDATE_CHUNK_SIZE (64 * 1024 * 1024)
+
+Updater::Chunk::Chunk() : arena(new StringCollection(8 * 1024 * 1024)),
+    invalid(0) {
+    terms.set_empty_key(EMPTY_KEY);
+    terms.set_deleted_key(DELETED_KEY);
+}
 
 void Updater::parseUpdate(std::string update,
-                          StringCollection &support,
-                          std::vector<TextualTriple> &output) {
+                          std::vector<std::unique_ptr<Chunk>> &chunks) {
     std::vector<std::string> filesToParse;
     if (Utils::isDirectory(update)) {
         //Read files. Ignore hidden ones.
@@ -44,9 +57,8 @@ void Updater::parseUpdate(std::string update,
         filesToParse.push_back(update);
     }
 
-    //Parse all files. Populate the output of arrays
-    int64_t invalidtriples = 0;
-    int64_t validtriples = 0;
+    //Split the files in pieces. Compressed files cannot be split
+    std::vector<FileInfo> pieces;
     for (auto file : filesToParse) {
         FileInfo filei;
         filei.path = file;
@@ -58,28 +70,110 @@ void Updater::parseUpdate(std::string update,
         } else {
             filei.splittable = true;
         }
+        if (filei.splittable && nthreads > 1 && filei.size > UPDATE_CHUNK_SIZE) {
+            const int64_t filesize = filei.size;
+            for (int64_t start = 0; start < filesize; start += UPDATE_CHUNK_SIZE) {
+                filei.start = start;
+                filei.size = std::min((int64_t) UPDATE_CHUNK_SIZE, filesize - start);
+                pieces.push_back(filei);
+            }
+        } else {
+            pieces.push_back(filei);
+        }
+    }
+
+    //Assign the pieces to the threads
+    const int nchunks = std::max(1, std::min(nthreads, (int) pieces.size()));
+    for (int i = 0; i < nchunks; ++i) {
+        chunks.push_back(std::unique_ptr<Chunk>(new Chunk()));
+    }
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        chunks[i % nchunks]->files.push_back(pieces[i]);
+    }
+
+    //Parse the pieces
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nchunks; ++i) {
+        threads.push_back(std::thread(Updater::parseChunk, chunks[i].get()));
+    }
+    parseChunk(chunks[0].get());
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    int64_t invalidtriples = 0;
+    int64_t validtriples = 0;
+    for (auto &chunk : chunks) {
+        validtriples += chunk->triples.size();
+        invalidtriples += chunk->invalid;
+    }
+    LOG(DEBUGL) << "Parsed " << validtriples << " invalid " << invalidtriples;
+}
+
+void Updater::parseChunk(Chunk *chunk) {
+    std::unique_ptr<char[]> supportbuffer(new char[MAX_TERM_SIZE + 2]);
+    //Copy the term in the arena only if the chunk has not seen it yet
+    auto getTerm = [&](const char *term, int length) {
+        Utils::encode_short(supportbuffer.get(), length);
+        memcpy(supportbuffer.get() + 2, term, length);
+        auto itr = chunk->terms.find(supportbuffer.get());
+        if (itr != chunk->terms.end()) {
+            return itr->first;
+        }
+        const char *newterm = chunk->arena->addNew(supportbuffer.get(),
+                length + 2);
+        chunk->terms.insert(std::make_pair(newterm, 0));
+        return newterm;
+    };
+
+    for (auto &filei : chunk->files) {
         FileReader reader(filei);
         while (reader.parseTriple()) {
             if (reader.isTripleValid()) {
+                int lens, lenp, leno;
+                const char *s = reader.getCurrentS(lens);
+                const char *p = reader.getCurrentP(lenp);
+                const char *o = reader.getCurrentO(leno);
+                if (lens > MAX_TERM_SIZE || lenp > MAX_TERM_SIZE ||
+                        leno > MAX_TERM_SIZE) {
+                    chunk->invalid++;
+                    continue;
+                }
                 TextualTriple t;
-                int length;
-                const char *s = reader.getCurrentS(length);
-                t.s = support.addNew(s, length);
-                t.lens = length;
-                const char *p = reader.getCurrentP(length);
-                t.p = support.addNew(p, length);
-                t.lenp = length;
-                const char *o = reader.getCurrentO(length);
-                t.o = support.addNew(o, length);
-                t.leno = length;
-                output.push_back(t);
-                validtriples++;
+                t.s = getTerm(s, lens);
+                t.p = getTerm(p, lenp);
+                t.o = getTerm(o, leno);
+                chunk->triples.push_back(t);
             } else {
-                invalidtriples++;
+                chunk->invalid++;
             }
         }
     }
-    LOG(DEBUGL) << "Parsed " << validtriples << " invalid " << invalidtriples;
+}
+
+void Updater::encodeChunk(Chunk *chunk,
+                          const std::vector<const char*> &terms,
+                          const std::vector<int64_t> &ids) {
+    for (auto itr = chunk->terms.begin(); itr != chunk->terms.end(); ++itr) {
+        auto pos = std::lower_bound(terms.begin(), terms.end(), itr->first,
+                                    Updater::lessThan);
+        itr->second = ids[pos - terms.begin()];
+    }
+    chunk->encoded.reserve(chunk->triples.size());
+    for (auto &t : chunk->triples) {
+        const int64_t s = chunk->terms.find(t.s)->second;
+        const int64_t p = chunk->terms.find(t.p)->second;
+        const int64_t o = chunk->terms.find(t.o)->second;
+        //Terms that are unknown in a removal are -1
+        if (s >= 0 && p >= 0 && o >= 0) {
+            Triple triple;
+            triple.s = s;
+            triple.p = p;
+            triple.o = o;
+            chunk->encoded.push_back(triple);
+        }
+    }
+    std::vector<TextualTriple>().swap(chunk->triples);
 }
 
 void Updater::writeDict(DictMgmt *dictmgmt,
@@ -154,154 +248,83 @@ void Updater::compressUpdate(DiffIndex::TypeUpdate type,
                              Querier *q,
                              ByteArrayToNumberMap &tmpdict,
                              StringCollection &tmpdictsupport) {
-    std::unique_ptr<char[]> supportbuffer(new char[MAX_TERM_SIZE + 2]);
-    Utils::encode_short(supportbuffer.get(), 0);
-    int64_t supportlen = 0;
-
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     std::vector<Triple> parsedtriples;
     {
         //Read the update and parse the strings
-        std::vector<TextualTriple> triples;
-        StringCollection col(64 * 1024 * 1024);
-        parseUpdate(updatedir, col, triples);
-
-        //Load the existing dictionary
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        parseUpdate(updatedir, chunks);
+
+        //Collect the distinct terms of all chunks
+        std::vector<const char*> terms;
+        size_t nterms = 0;
+        for (auto &chunk : chunks) {
+            nterms += chunk->terms.size();
+        }
+        terms.reserve(nterms);
+        for (auto &chunk : chunks) {
+            for (auto itr = chunk->terms.begin(); itr != chunk->terms.end();
+                    ++itr) {
+                terms.push_back(itr->first);
+            }
+        }
+        ParallelTasks::sort_int(terms.begin(), terms.end(), &Updater::lessThan,
+                                nthreads);
+        auto newend = std::unique(terms.begin(), terms.end(),
+        [](const char *t1, const char *t2) {
+            return !lessThan(t1, t2) && !lessThan(t2, t1);
+        });
+        terms.resize(std::distance(terms.begin(), newend));
+        LOG(DEBUGL) << "Distinct terms in the update " << terms.size();
+
+        //Look up the terms in the dictionary. The tree is not thread-safe,
+        //but since the terms are sorted consecutive lookups hit the same
+        //nodes
         DictMgmt *dict = kb->getDictMgmt();
         int64_t nextID = kb->getNextID();
-        int64_t previd = -1;
-
-        //Sort the update by s
-        std::sort(triples.begin(), triples.end(), sortByS);
-
-        //Convert all s into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->lens &&
-                    memcmp(itr->s, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->nums = previd;
+        std::vector<int64_t> ids(terms.size());
+        for (size_t i = 0; i < terms.size(); ++i) {
+            const char *term = terms[i];
+            const int len = Utils::decode_short(term);
+            nTerm id;
+            if (dict->getNumber(term + 2, len, &id)) {
+                ids[i] = id;
+            } else if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+                //Add a new entry in the temporary dictionary
+                ids[i] = nextID;
+                const char *newentry = tmpdictsupport.addNew(term, len + 2);
+                tmpdict.insert(std::make_pair(newentry, nextID));
+                nextID++;
             } else {
-                memcpy(supportbuffer.get() + 2, itr->s, itr->lens);
-                Utils::encode_short(supportbuffer.get(), itr->lens);
-                supportlen = itr->lens;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->s, itr->lens, &id);
-                if (resp) {
-                    itr->nums = id;
-                } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Add a new entry in the temporary dictionary
-                        itr->nums = nextID;
-                        const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                               itr->lens + 2);
-                        tmpdict.insert(std::make_pair(newentry, nextID));
-                        nextID++;
-                    } else {
-                        itr->nums = UINT64_MAX;
-                        continue;
-                    }
-                }
-                previd = itr->nums;
+                ids[i] = -1;
             }
         }
 
-        //Sort the update by p
-        std::sort(triples.begin(), triples.end(), sortByP);
-        supportlen = 0;
-        Utils::encode_short(supportbuffer.get(), 0);
-
-        //Convert all p into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->lenp &&
-                    memcmp(itr->p, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->nump = previd;
-            } else {
-                memcpy(supportbuffer.get() + 2, itr->p, itr->lenp);
-                Utils::encode_short(supportbuffer.get(), itr->lenp);
-                supportlen = itr->lenp;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->p, itr->lenp, &id);
-                if (resp) {
-                    itr->nump = id;
-                } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Is it existing in the tmp dict already?
-                        if (tmpdict.count(supportbuffer.get())) {
-                            auto itr2 = tmpdict.find(supportbuffer.get());
-                            itr->nump = itr2->second;
-                        } else {
-                            //Add a new entry in the temporary dictionary
-                            itr->nump = nextID;
-                            const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                                   itr->lenp + 2);
-                            tmpdict.insert(std::make_pair(newentry, nextID));
-                            nextID++;
-                        }
-                    } else {
-                        itr->nump = UINT64_MAX;
-                        continue;
-                    }
-                }
-                previd = itr->nump;
-            }
+        //Convert the triples into numbers
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < chunks.size(); ++i) {
+            threads.push_back(std::thread(Updater::encodeChunk, chunks[i].get(),
+                                          std::cref(terms), std::cref(ids)));
         }
-
-        //Sort the update by o
-        std::sort(triples.begin(), triples.end(), sortByO);
-        supportlen = 0;
-        Utils::encode_short(supportbuffer.get(), 0);
-
-        //Convert all o into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->leno &&
-                    memcmp(itr->o, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->numo = previd;
-            } else {
-                memcpy(supportbuffer.get() + 2, itr->o, itr->leno);
-                Utils::encode_short(supportbuffer.get(), itr->leno);
-                supportlen = itr->leno;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->o, itr->leno, &id);
-                if (resp) {
-                    itr->numo = id;
-                } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Is it existing in the tmp dict already?
-                        if (tmpdict.count(supportbuffer.get())) {
-                            auto itr2 = tmpdict.find(supportbuffer.get());
-                            itr->numo = itr2->second;
-                        } else {
-                            //Add a new entry in the temporary dictionary
-                            itr->numo = nextID;
-                            const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                                   itr->leno + 2);
-                            tmpdict.insert(std::make_pair(newentry, nextID));
-                            nextID++;
-                        }
-                    } else {
-                        itr->numo = UINT64_MAX;
-                        continue;
-                    }
-                }
-                previd = itr->numo;
-            }
+        encodeChunk(chunks[0].get(), terms, ids);
+        for (auto &t : threads) {
+            t.join();
         }
 
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (~itr->nums && ~itr->nump && ~itr->numo) {
-                Triple t;
-                t.s = itr->nums;
-                t.p = itr->nump;
-                t.o = itr->numo;
-                parsedtriples.push_back(t);
-            }
+        size_t ntriples = 0;
+        for (auto &chunk : chunks) {
+            ntriples += chunk->encoded.size();
+        }
+        parsedtriples.reserve(ntriples);
+        for (auto &chunk : chunks) {
+            parsedtriples.insert(parsedtriples.end(), chunk->encoded.begin(),
+                                 chunk->encoded.end());
         }
     }
 
     //Re-sort the numeric triples.
-    std::sort(parsedtriples.begin(), parsedtriples.end(), Triple::sorter);
+    ParallelTasks::sort_int(parsedtriples.begin(), parsedtriples.end(),
+                            &Triple::sorter, nthreads);
 
     //Remove duplicates...
     auto newend = std::unique(parsedtriples.begin(), parsedtriples.end(),
@@ -340,9 +363,15 @@ void Updater::creatediffupdate(DiffIndex::TypeUpdate type, std::string kbdir,
         //Get the location to store the update
         string locationupdate = getPathForUpdate(kbdir);
 
+        //The additions keep a sample at the rate of the sample KB
+        size_t samplesize = 0;
+        if (type == DiffIndex::TypeUpdate::ADDITION_df && kb.getSampleRate() > 0) {
+            samplesize = (size_t) std::ceil(all_s.size() * kb.getSampleRate());
+        }
+
         //Launch the procedure that is creating the index
         DiffIndex3::createDiffIndex(type, locationupdate, kbdir + "/_diff", all_s, all_p, all_o,
-                                    true, q, true);
+                                    true, q, true, samplesize);
 
         //Write the type of file
         string flagup;
@@ -356,6 +385,25 @@ void Updater::creatediffupdate(DiffIndex::TypeUpdate type, std::string kbdir,
         ofstream ofs(flagup);
         ofs.close();
 
+        //Keep the sample used by the planner in line with the KB
+        if (kb.getSampleRate() > 0) {
+            if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+                DiffStats stats;
+                stats.load(locationupdate + "/diffstats");
+                const std::vector<uint64_t> &sample = stats.getSample();
+                std::vector<uint64_t> sample_s, sample_p, sample_o;
+                for (size_t i = 0; i < sample.size(); i += 3) {
+                    sample_s.push_back(sample[i]);
+                    sample_p.push_back(sample[i + 1]);
+                    sample_o.push_back(sample[i + 2]);
+                }
+                kb.updateSample(type, sample_s, sample_p, sample_o);
+            } else {
+                //All the removed triples must leave the sample
+                kb.updateSample(type, all_s, all_p, all_o);
+            }
+        }
+
 
         std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
         LOG(DEBUGL) << "Runtime creating the diff index from the update = " << sec.count() * 1000;
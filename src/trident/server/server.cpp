@@ -20,20 +20,30 @@
 #include <chrono>
 #include <thread>
 #include <regex>
+#include <algorithm>
 
 TridentServer::TridentServer(KB &kb, string htmlfiles, int nthreads) :
     kb(kb),
     dirhtmlfiles(htmlfiles),
-    isActive(false), nthreads(nthreads) {
+    isActive(false), nthreads(nthreads), queryTimeout(0),
+    queryMemoryLimit(0), compactor(new KBCompactor(kb, 0)) {
 
     }
 
+std::unique_ptr<TridentLayer> TridentServer::createSession() {
+    return std::unique_ptr<TridentLayer>(new TridentLayer(kb,
+                kb.getQuerierPool().acquire()));
+}
+
 void TridentServer::startThread(int port) {
     this->webport = port;
     server->start();
 }
 
 void TridentServer::start(int port) {
+#ifndef MT
+    LOG(WARNL) << "Trident is compiled without MT: the queries are executed one at a time";
+#endif
     auto f = std::bind(&TridentServer::processRequest, this,
             std::placeholders::_1,
             std::placeholders::_2);
@@ -44,9 +54,19 @@ void TridentServer::start(int port) {
 
 void TridentServer::stop() {
     LOG(INFOL) << "Stopping server ...";
+    {
+        //Do not wait for the queries that are still running
+        std::lock_guard<std::mutex> lock(queriesMutex);
+        for (auto context : runningQueries) {
+            context->cancel();
+        }
+    }
     while (isActive) {
         std::this_thread::sleep_for(chrono::milliseconds(100));
     }
+    //The KB is left as it was before the compaction
+    compactor->cancel();
+    compactor->wait();
     server->stop();
     LOG(INFOL) << "Done";
 }
@@ -66,6 +86,67 @@ string _getValueParam(string req, string param) {
     }
 }
 
+//Returns the (decoded) values of a parameter in the body of a form, in the
+//order of the form. A parameter can be repeated
+static vector<string> _getFormParams(const string &req, const string &param) {
+    vector<string> values;
+    size_t pos = req.find("\r\n\r\n");
+    if (pos == string::npos) {
+        return values;
+    }
+    pos += 4;
+    while (pos < req.size()) {
+        size_t end = req.find("&", pos);
+        if (end == string::npos) {
+            end = req.size();
+        }
+        if (req.compare(pos, param.size() + 1, param + "=") == 0) {
+            string value = req.substr(pos + param.size() + 1,
+                    end - pos - param.size() - 1);
+            std::replace(value.begin(), value.end(), '+', ' ');
+            values.push_back(HttpClient::unescape(value));
+        }
+        pos = end + 1;
+    }
+    return values;
+}
+
+//Returns the (decoded) value of a parameter in the body of a form
+static string _getFormParam(const string &req, const string &param) {
+    vector<string> values = _getFormParams(req, param);
+    return values.empty() ? "" : values[0];
+}
+
+//Reads a limit of the query from the form. The limit of the server is used
+//if the request does not set one or asks for more
+static bool _getLimitParam(const string &req, const string &param,
+        uint64_t unit, uint64_t max, uint64_t &value) {
+    string s = _getFormParam(req, param);
+    value = 0;
+    if (s != "") {
+        if (s.find_first_not_of("0123456789") != string::npos ||
+                s.size() > 12) {
+            return false;
+        }
+        value = stoull(s) * unit;
+    }
+    if (max && (value == 0 || value > max)) {
+        value = max;
+    }
+    return true;
+}
+
+//Reads the id of a prepared query from the form
+static bool _getIdParam(const string &req, uint64_t &id) {
+    string s = _getFormParam(req, "id");
+    if (s == "" || s.find_first_not_of("0123456789") != string::npos ||
+            s.size() > 18) {
+        return false;
+    }
+    id = stoull(s);
+    return true;
+}
+
 string TridentServer::lookup(string sId, TridentLayer &db) {
     const char *start;
     const char *end;
@@ -76,6 +157,63 @@ string TridentServer::lookup(string sId, TridentLayer &db) {
     return string(start, end - start);
 }
 
+void TridentServer::runQuery(const string &req, const string &sparqlquery,
+        bool jsonoutput, JSON &pt) {
+    //The limits of the query: 'timeout' in milliseconds and
+    //'memory' in MB
+    uint64_t timeout, memoryLimit;
+    if (!_getLimitParam(req, "timeout", 1, queryTimeout, timeout)) {
+        pt.put("error", "The parameter 'timeout' must be a number of milliseconds");
+    } else if (!_getLimitParam(req, "memory", 1024 * 1024,
+                queryMemoryLimit, memoryLimit)) {
+        pt.put("error", "The parameter 'memory' must be a number of MB");
+    } else {
+        QueryContext context;
+        context.setTimeout(timeout);
+        context.setMemoryLimit(memoryLimit);
+        {
+            std::lock_guard<std::mutex> lock(queriesMutex);
+            runningQueries.insert(&context);
+        }
+
+        //Execute the SPARQL query. Every request reads the KB with its own
+        //querier, taken from the pool of the KB. Without MT, the pool runs
+        //the requests one at a time
+        std::unique_ptr<TridentLayer> db = createSession();
+        JSON vars;
+        JSON bindings;
+        JSON stats;
+        SPARQLUtils::execSPARQLQuery(sparqlquery,
+                false,
+                db->getNTerms(),
+                *db,
+                false,
+                jsonoutput,
+                &vars,
+                &bindings,
+                &stats,
+                &context,
+                &plancache);
+        {
+            std::lock_guard<std::mutex> lock(queriesMutex);
+            runningQueries.erase(&context);
+        }
+        if (context.getReason() != QueryContext::None) {
+            //The results are incomplete, only the error is returned
+            pt.put("error", "The query was stopped: " +
+                    context.getMessage());
+        } else {
+            JSON head;
+            head.add_child("vars", vars);
+            pt.add_child("head", head);
+            JSON results;
+            results.add_child("bindings", bindings);
+            pt.add_child("results", results);
+        }
+        pt.add_child("stats", stats);
+    }
+}
+
 void TridentServer::processRequest(std::string req, std::string &res) {
     setActive();
     //Get the page
@@ -104,44 +242,114 @@ void TridentServer::processRequest(std::string req, std::string &res) {
                     sparqlquery.begin(), sparqlquery.end(), e2, "$1\n");
             sparqlquery = replacedString;
 
-            //Execute the SPARQL query
             JSON pt;
-            JSON vars;
-            JSON bindings;
-            JSON stats;
-            bool jsonoutput = printresults != string("false");
-            SPARQLUtils::execSPARQLQuery(sparqlquery,
-                    false,
-                    kb.getNTerms(),
-                    kb,
-                    false,
-                    jsonoutput,
-                    &vars,
-                    &bindings,
-                    &stats);
-            JSON head;
-            head.add_child("vars", vars);
-            pt.add_child("head", head);
-            JSON results;
-            results.add_child("bindings", bindings);
-            pt.add_child("results", results);
-            pt.add_child("stats", stats);
-
+            runQuery(req, sparqlquery, printresults != string("false"), pt);
+            std::ostringstream buf;
+            JSON::write(buf, pt);
+            page = buf.str();
+            isjson = true;
+        } else if (path == "/prepare") {
+            //Prepare a query, the constants of its triple patterns become
+            //parameters. Returns the id of the query
+            JSON pt;
+            try {
+                uint64_t id = plancache.prepare(_getFormParam(req, "query"));
+                pt.put("id", to_string(id));
+                pt.put("parameters", to_string(
+                            plancache.getPrepared(id)->getNParameters()));
+            } catch (const SPARQLParser::ParserException &e) {
+                pt.put("error", "parse error: " + e.message);
+            }
             std::ostringstream buf;
             JSON::write(buf, pt);
             page = buf.str();
             isjson = true;
+        } else if (path == "/execute") {
+            //Execute a prepared query. The parameters 'param' are its
+            //constants, in order
+            JSON pt;
+            uint64_t id;
+            std::shared_ptr<const PreparedQuery> prepared;
+            if (_getIdParam(req, id)) {
+                prepared = plancache.getPrepared(id);
+            }
+            string sparqlquery;
+            if (!prepared) {
+                pt.put("error", "Unknown prepared query '" +
+                        _getFormParam(req, "id") + "'");
+            } else if (!prepared->bind(_getFormParams(req, "param"),
+                        sparqlquery)) {
+                pt.put("error", "The query has " + to_string(
+                            prepared->getNParameters()) +
+                        " parameters and each must be a single term");
+            } else {
+                runQuery(req, sparqlquery,
+                        _getFormParam(req, "print") != string("false"), pt);
+            }
+            std::ostringstream buf;
+            JSON::write(buf, pt);
+            page = buf.str();
+            isjson = true;
+        } else if (path == "/unprepare") {
+            uint64_t id;
+            if (_getIdParam(req, id)) {
+                plancache.unprepare(id);
+            }
+            page = "{}";
+            isjson = true;
         } else if (path == "/lookup") {
             string form = req.substr(req.find("application/x-www-form-urlencoded"));
             string id = _getValueParam(form, "id");
             //Lookup the value
-            string value = lookup(id, kb);
+            std::unique_ptr<TridentLayer> db = createSession();
+            string value = lookup(id, *db);
             JSON pt;
             pt.put("value", value);
             std::ostringstream buf;
             JSON::write(buf, pt);
             page = buf.str();
             isjson = true;
+        } else if (path == "/update") {
+            //Add or remove a single triple. The terms are in N-Triples syntax
+            string op = _getFormParam(req, "op");
+            JSON pt;
+            if (op != "add" && op != "rm") {
+                pt.put("error", "The parameter 'op' must be either 'add' or 'rm'");
+            } else {
+                try {
+#ifndef MT
+                    //Without MT the update cannot read the KB while a
+                    //query does
+                    QuerierPool::Handle session = kb.getQuerierPool().acquire();
+#endif
+                    bool changed = kb.updateTriple(op == "add" ?
+                            DiffIndex::TypeUpdate::ADDITION_df :
+                            DiffIndex::TypeUpdate::DELETE_df,
+                            _getFormParam(req, "s"),
+                            _getFormParam(req, "p"),
+                            _getFormParam(req, "o"));
+                    pt.put("changed", changed ? "true" : "false");
+                } catch (int e) {
+                    pt.put("error", "The update failed");
+                }
+            }
+            std::ostringstream buf;
+            JSON::write(buf, pt);
+            page = buf.str();
+            isjson = true;
+        } else if (path == "/compact") {
+            //Fold the updates in the indices. The queries keep reading the
+            //current indices until the new ones are ready
+            JSON pt;
+            if (compactor->start()) {
+                pt.put("started", "true");
+            } else {
+                pt.put("error", "A compaction is already running");
+            }
+            std::ostringstream buf;
+            JSON::write(buf, pt);
+            page = buf.str();
+            isjson = true;
         } else {
             page = "Error!";
         }
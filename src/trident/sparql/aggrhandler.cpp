@@ -9,11 +9,19 @@
 
 unsigned AggregateHandler::getNewOrExistingVar(AggregateHandler::FUNC funID,
         std::vector<unsigned> &signature) {
-    if (signature.size() != 1) {
+    unsigned v;
+    if (signature.empty() && funID == COUNT) {
+        //COUNT(*)
+        if (starVar == ~0u) {
+            starVar = varcount++;
+        }
+        v = starVar;
+    } else if (signature.size() != 1) {
         LOG(ERRORL) << "For now, I only support aggregates with one variable in input";
         throw 10;
+    } else {
+        v = signature[0];
     }
-    unsigned v = signature[0];
     if (!assignments.count(funID)) {
         assignments[funID] = std::map<unsigned, unsigned>();
     }
@@ -32,6 +40,9 @@ void AggregateHandler::startUpdate() {
 void AggregateHandler::prepare() {
     executions.clear();
     varvalues.resize(64); //Max number of vars
+    //The outputs of the functions count once
+    for (auto &value : varvalues)
+        value.count = 1;
     for(auto &el : assignments) {
         FUNC id = el.first;
         for(auto &assignment : el.second) {
@@ -67,28 +78,28 @@ void AggregateHandler::reset() {
 
 void AggregateHandler::updateVarInt(unsigned var,
         int64_t value, uint64_t count) {
-    //For the moment I ignore "count" but later it might be taken into account
     assert(var <= 63);
     varvalues[var].v_int = value;
     varvalues[var].type = VarValue::TYPE::INT;
+    varvalues[var].count = count;
     inputmask |= (uint64_t)1 << var;
 }
 
 void AggregateHandler::updateVarDec(unsigned var,
         double value, uint64_t count) {
-    //For the moment I ignore "count" but later it might be taken into account
     assert(var <= 63);
     varvalues[var].v_dec = value;
     varvalues[var].type = VarValue::TYPE::DEC;
+    varvalues[var].count = count;
     inputmask |= (uint64_t)1 << var;
 }
 
 void AggregateHandler::updateVarSymbol(unsigned var,
         uint64_t value, uint64_t count) {
-    //For the moment I ignore "count" but later it might be taken into account
     assert(var <= 63);
     varvalues[var].v_int = value;
     varvalues[var].type = VarValue::TYPE::SYMBOL;
+    varvalues[var].count = count;
     inputmask |= (uint64_t)1 << var;
 }
 
@@ -161,7 +172,7 @@ bool AggregateHandler::execCount(FunctCall &call) {
         varvalues[call.outputvar].type = VarValue::TYPE::INT;
         return true;
     } else {
-        call.arg1_int++;
+        call.arg1_int += varvalues[call.inputvar].count;
         return false;
     }
 }
@@ -179,13 +190,15 @@ bool AggregateHandler::execSum(FunctCall &call) {
         }
 	return true;
     } else {
+        //The value counts once per row of the input
+        const int64_t count = varvalues[call.inputvar].count;
         //Need to get the numerical value of the input
         if (varvalues[call.inputvar].type  == VarValue::TYPE::INT) {
             //Check the internal value
             if (call.arg1_bool) {
-                call.arg1_int += varvalues[call.inputvar].v_int;
+                call.arg1_int += varvalues[call.inputvar].v_int * count;
             } else {
-                call.arg1_dec += varvalues[call.inputvar].v_int;
+                call.arg1_dec += (double) varvalues[call.inputvar].v_int * count;
             }
         } else { //Dec
             if (call.arg1_bool) {
@@ -193,7 +206,7 @@ bool AggregateHandler::execSum(FunctCall &call) {
                 call.arg1_dec = call.arg1_int;
                 call.arg1_bool = false;
             }
-            call.arg1_dec += varvalues[call.inputvar].v_dec;
+            call.arg1_dec += varvalues[call.inputvar].v_dec * count;
         }
 	return false;
     }
@@ -216,14 +229,16 @@ bool AggregateHandler::execAvg(FunctCall &call) {
 	}
 	return true;
     } else {
-	call.arg2_int++;
+        //The value counts once per row of the input
+        const int64_t count = varvalues[call.inputvar].count;
+	call.arg2_int += count;
         //Need to get the numerical value of the input
         if (varvalues[call.inputvar].type  == VarValue::TYPE::INT) {
             //Check the internal value
             if (call.arg1_bool) {
-                call.arg1_int += varvalues[call.inputvar].v_int;
+                call.arg1_int += varvalues[call.inputvar].v_int * count;
             } else {
-                call.arg1_dec += varvalues[call.inputvar].v_int;
+                call.arg1_dec += (double) varvalues[call.inputvar].v_int * count;
             }
         } else { //Dec
             if (call.arg1_bool) {
@@ -231,7 +246,7 @@ bool AggregateHandler::execAvg(FunctCall &call) {
                 call.arg1_dec = call.arg1_int;
                 call.arg1_bool = false;
             }
-            call.arg1_dec += varvalues[call.inputvar].v_dec;
+            call.arg1_dec += varvalues[call.inputvar].v_dec * count;
         }
 	return false;
     }
@@ -375,7 +390,7 @@ std::pair<std::vector<unsigned>,
         }
         std::pair<std::vector<unsigned>,std::vector<unsigned>> out;
         for(auto &v : inputvars) {
-            if (!outputvars.count(v)) {
+            if (!outputvars.count(v) && v != starVar) {
                 out.first.push_back(v);
             }
         }
@@ -386,3 +401,15 @@ std::pair<std::vector<unsigned>,
         }
         return out;
     }
+
+std::vector<std::tuple<AggregateHandler::FUNC, unsigned, unsigned>>
+AggregateHandler::getFunctions() const {
+    std::vector<std::tuple<FUNC, unsigned, unsigned>> out;
+    for(auto &assignment : assignments) {
+        for(auto &entry : assignment.second) {
+            out.push_back(std::make_tuple(assignment.first, entry.first,
+                        entry.second));
+        }
+    }
+    return out;
+}
@@ -22,43 +22,13 @@
 
 #include <trident/sparql/sparqloperators.h>
 
-#include <sparsehash/dense_hash_map>
+#include <trident/utils/parallel.h>
 
 #include <stdint.h>
 
-struct JoinSorter {
-    const std::vector<uint64_t> *vector;
-    const size_t idxColumn;
-
-    JoinSorter(const std::vector<uint64_t> *vector, const size_t idxColumn) : vector(vector),
-        idxColumn(idxColumn) {}
-
-    bool operator() (const size_t i, const size_t j) {
-        return vector->at(i + idxColumn) < vector->at(j + idxColumn);
-    }
-};
-
-struct DoubleJoinSorter {
-    const std::vector<uint64_t> *vector;
-    const size_t idxColumn1;
-    const size_t idxColumn2;
-
-    DoubleJoinSorter(const std::vector<uint64_t> *vector, const size_t idxColumn1, const size_t idxColumn2) : vector(vector),
-        idxColumn1(idxColumn1), idxColumn2(idxColumn2) {}
-
-    bool operator() (const size_t i, const size_t j) {
-        if (vector->at(i + idxColumn1) == vector->at(j + idxColumn1)) {
-            return vector->at(i + idxColumn2) < vector->at(j + idxColumn2);
-        } else {
-            return vector->at(i + idxColumn1) < vector->at(j + idxColumn1);
-        }
-    }
-};
-
 void HashJoinItr::fillNextMap(const int i, std::vector<uint64_t> &currentMapValues,
                               int &currentMapRowSize,
-                              std::unique_ptr<HashJoinMap> &currentMap1,
-                              std::unique_ptr<DoubleHashJoinMap> &currentMap2,
+                              RadixJoinTable &currentMap,
                               std::vector<uint64_t> &tmpContainer,
                               const int tmpContainerRowSize,
                               std::vector<size_t> &idxRows) {
@@ -69,80 +39,18 @@ void HashJoinItr::fillNextMap(const int i, std::vector<uint64_t> &currentMapValu
     const int joinField2 = njoins == 2 ? joins[1].posRow : 0;
     assert(njoins > 0 && njoins < 3);
 
-    currentMapValues.clear();
-    currentMapRowSize = tmpContainerRowSize;
-    if (njoins == 1) {
-        JoinSorter sorter(&tmpContainer, joinField1);
-        std::sort(idxRows.begin(), idxRows.end(), std::ref(sorter));
-        currentMap1 = std::unique_ptr<HashJoinMap>(new HashJoinMap());
-        currentMap1->set_empty_key(UINT64_MAX);
-        currentMap2 = NULL;
-    } else if (njoins == 2) {
-        DoubleJoinSorter sorter(&tmpContainer, joinField1, joinField2);
-        std::sort(idxRows.begin(), idxRows.end(), std::ref(sorter));
-        currentMap2 = std::unique_ptr<DoubleHashJoinMap>(new DoubleHashJoinMap());
-        std::pair<uint64_t, uint64_t> emptyKey;
-        emptyKey.first = UINT64_MAX;
-        emptyKey.second = UINT64_MAX;
-        currentMap2->set_empty_key(emptyKey);
-        currentMap1 = NULL;
-    }
-
-    uint64_t prevValue1 = 0;
-    uint64_t prevValue2 = 0;
-    size_t beginIdx = 0;
-
-    // LOG(DEBUGL) << "fillNextMap: idxRows.size() = " << idxRows.size();
-    for (size_t i = 0; i < idxRows.size(); ++i) {
-        size_t beginRow = idxRows[i];
-        // LOG(DEBUGL) << "fillNextMap: idxRows[" << i << "] = " << beginRow;
-        if (i == 0) {
-            prevValue1 = tmpContainer[beginRow + joinField1];
-            if (njoins == 2)
-                prevValue2 = tmpContainer[beginRow + joinField2];
-            currentMapValues.push_back(1);
-        } else if (tmpContainer[beginRow + joinField1] != prevValue1
-                   || (njoins == 2 && tmpContainer[beginRow + joinField2] != prevValue2)) {
-
-            if (njoins == 1) {
-                currentMap1->insert(std::make_pair(prevValue1, beginIdx));
-            } else {
-                std::pair<uint64_t, uint64_t> key;
-                key.first = prevValue1;
-                key.second = prevValue2;
-                currentMap2->insert(std::make_pair(key, beginIdx));
-            }
-
-            int64_t nValuesPerKey = (currentMapValues.size() - beginIdx - 1) / tmpContainerRowSize;
-            if (nValuesPerKey > 1) {
-                currentMapValues[beginIdx] = nValuesPerKey;
-            }
-            prevValue1 = tmpContainer[beginRow + joinField1];
-            if (njoins == 2)
-                prevValue2 = tmpContainer[beginRow + joinField2];
-            beginIdx = currentMapValues.size();
-            currentMapValues.push_back(1);
-        }
-        for (int i = 0; i < tmpContainerRowSize; ++i) {
-            currentMapValues.push_back(tmpContainer[beginRow + i]);
-        }
-    }
-
-    if (njoins == 1) {
-        // LOG(DEBUGL) << "CurrentMap1.insert(" << prevValue1 << ", "
-        //     << beginIdx << ")";
-        currentMap1->insert(std::make_pair(prevValue1, beginIdx));
-    } else {
-        std::pair<uint64_t, uint64_t> key;
-        key.first = prevValue1;
-        key.second = prevValue2;
-        currentMap2->insert(std::make_pair(key, beginIdx));
-    }
-
-    int64_t nValuesPerKey = (currentMapValues.size() - beginIdx - 1) / tmpContainerRowSize;
-    if (nValuesPerKey > 1) {
-        currentMapValues[beginIdx] = nValuesPerKey;
+    //The map points to the rows of the container, which becomes the
+    //new set of values
+    std::vector<RadixJoinTable::Tuple> tuples(idxRows.size());
+    for (size_t j = 0; j < idxRows.size(); ++j) {
+        const size_t beginRow = idxRows[j];
+        tuples[j].key1 = tmpContainer[beginRow + joinField1];
+        tuples[j].key2 = njoins == 2 ? tmpContainer[beginRow + joinField2] : 0;
+        tuples[j].payload = beginRow;
     }
+    currentMap.build(tuples, ParallelTasks::getNThreads());
+    currentMapValues.swap(tmpContainer);
+    currentMapRowSize = tmpContainerRowSize;
 }
 
 void sortPairElements(std::vector<uint64_t> &vector) {
@@ -165,8 +73,7 @@ void sortPairElements(std::vector<uint64_t> &vector) {
 void HashJoinItr::execJoin() {
     //Current map
     std::vector<uint64_t> currentMapValues;
-    std::unique_ptr<HashJoinMap> currentMap1;
-    std::unique_ptr<DoubleHashJoinMap> currentMap2;
+    RadixJoinTable currentMap;
 
     int currentMapRowSize = 0;
 
@@ -192,26 +99,26 @@ void HashJoinItr::execJoin() {
 
             std::vector<uint8_t> posJoins;
             std::vector<uint64_t> allvalues;
+            //The tuples with the same key are next to each other
+            const std::vector<RadixJoinTable::Tuple> &tuples =
+                currentMap.getTuples();
+            for (size_t j = 0; j < tuples.size(); ++j) {
+                if (j > 0 && tuples[j].key1 == tuples[j - 1].key1 &&
+                        tuples[j].key2 == tuples[j - 1].key2)
+                    continue;
+                allvalues.push_back(tuples[j].key1);
+                if (njoins == 2)
+                    allvalues.push_back(tuples[j].key2);
+            }
             if (njoins == 1) {
                 posJoins.push_back((uint8_t) joins[0].posPattern);
                 // LOG(DEBUGL) << "posJoin[0] = " << (int) joins[0].posPattern;
-                for (HashJoinMap::iterator itr = currentMap1->begin();
-                        itr != currentMap1->end();
-                        ++itr) {
-                    allvalues.push_back(itr->first);
-                }
                 sort(allvalues.begin(), allvalues.end());
             } else { //joins = 2
                 // LOG(DEBUGL) << "posJoin[0] = " << (int) joins[0].posPattern;
                 // LOG(DEBUGL) << "posJoin[1] = " << (int) joins[1].posPattern;
                 posJoins.push_back((uint8_t) joins[0].posPattern);
                 posJoins.push_back((uint8_t) joins[1].posPattern);
-                for (DoubleHashJoinMap::iterator itr = currentMap2->begin();
-                        itr != currentMap2->end();
-                        ++itr) {
-                    allvalues.push_back(itr->first.first);
-                    allvalues.push_back(itr->first.second);
-                }
                 sortPairElements(allvalues);
             }
             LOG(DEBUGL) << "Possible bindings passed to the reasoner " << allvalues.size() / posJoins.size();
@@ -242,8 +149,7 @@ void HashJoinItr::execJoin() {
                 const JoinPoint *joins = &(plan->joins[i][0]);
 
 #if DEBUG
-                if (currentMap1 != NULL)
-                    LOG(DEBUGL) << "Size bindings " << currentMap1->size();
+                LOG(DEBUGL) << "Size bindings " << currentMap.getNKeys();
 #endif
 
                 int64_t nTuples = 0;
@@ -251,42 +157,23 @@ void HashJoinItr::execJoin() {
                     nTuples++;
                     itr->next();
                     //Join against the current map
-                    bool found = false;
-                    size_t beginRow;
-
-                    if (njoins == 1) {
-                        HashJoinMap::iterator mapItr =
-                            currentMap1->find(itr->getElementAt(joins[0].posPattern));
-                        if (mapItr != currentMap1->end()) {
-                            beginRow = mapItr->second;
-                            found = true;
-                        }
-                    } else if (njoins == 2) {
-                        std::pair<uint64_t, uint64_t> key;
-                        key.first = itr->getElementAt(joins[0].posPattern);
-                        key.second = itr->getElementAt(joins[1].posPattern);
-                        DoubleHashJoinMap::iterator mapItr = currentMap2->find(key);
-                        if (mapItr != currentMap2->end()) {
-                            beginRow = mapItr->second;
-                            found = true;
+                    uint64_t nRows;
+                    const RadixJoinTable::Tuple *matches = currentMap.find(
+                            itr->getElementAt(joins[0].posPattern),
+                            njoins == 2 ? itr->getElementAt(joins[1].posPattern) : 0,
+                            nRows);
+
+                    //Add values in the next map
+                    for (uint64_t i = 0; i < nRows; ++i) {
+                        const size_t beginRow = matches[i].payload;
+                        idxRows.push_back(tmpContainer.size());
+                        //Copy1
+                        for (int i = 0; i < currentMapRowSize; ++i) {
+                            tmpContainer.push_back(currentMapValues[beginRow + i]);
                         }
-                    }
-
-                    if (found) {
-                        //Add values in the next map
-                        const int64_t nRows = currentMapValues[beginRow++];
-                        assert(nRows > 0);
-                        for (int64_t i = 0; i < nRows; ++i) {
-                            idxRows.push_back(tmpContainer.size());
-                            //Copy1
-                            for (int i = 0; i < currentMapRowSize; ++i) {
-                                tmpContainer.push_back(currentMapValues[beginRow + i]);
-                            }
-                            //Copy2
-                            for (int i = 0; i < nvarstocopy; ++i) {
-                                tmpContainer.push_back(itr->getElementAt(varsToCopy[i]));
-                            }
-                            beginRow += currentMapRowSize;
+                        //Copy2
+                        for (int i = 0; i < nvarstocopy; ++i) {
+                            tmpContainer.push_back(itr->getElementAt(varsToCopy[i]));
                         }
                     }
                 }
@@ -296,8 +183,8 @@ void HashJoinItr::execJoin() {
             }
 
             if (idxRows.size() > 0) {
-                fillNextMap(i, currentMapValues, currentMapRowSize, currentMap1,
-                            currentMap2, tmpContainer, tmpContainerRowSize, idxRows);
+                fillNextMap(i, currentMapValues, currentMapRowSize, currentMap,
+                            tmpContainer, tmpContainerRowSize, idxRows);
                 LOG(DEBUGL) << "Finished loading the map";
             } else {
                 scan->releaseIterator(itr);
@@ -320,41 +207,22 @@ void HashJoinItr::execJoin() {
 
             while (itr->hasNext()) {
                 itr->next();
-                bool found = false;
-                size_t beginRow;
-
-                if (njoins == 1) {
-                    int64_t key = itr->getElementAt(joins[0].posPattern);
-                    // LOG(DEBUGL) << "Join: key = " << key;
-                    HashJoinMap::iterator mapItr = currentMap1->find(key);
-                    if (mapItr != currentMap1->end()) {
-                        found = true;
-                        beginRow = mapItr->second;
-                    }
-                } else if (njoins == 2) {
-                    std::pair<uint64_t, uint64_t> key;
-                    key.first = itr->getElementAt(joins[0].posPattern);
-                    key.second = itr->getElementAt(joins[1].posPattern);
-                    DoubleHashJoinMap::iterator mapItr = currentMap2->find(key);
-                    if (mapItr != currentMap2->end()) {
-                        found = true;
-                        beginRow = mapItr->second;
-                    }
-                }
-
-                if (found) {
-                    const int64_t nRows = currentMapValues[beginRow++];
-                    for (int64_t i = 0; i < nRows; ++i) {
-                        for (int j = 0; j < nValuesToCopy; ++j) {
-                            int index = valuesToCopy[j];
-                            if (index < currentMapRowSize) {
-                                output->addValue(currentMapValues[beginRow + index]);
-                            } else {
-                                index -= currentMapRowSize;
-                                output->addValue(itr->getElementAt(valuesToCopy2[index]));
-                            }
+                uint64_t nRows;
+                const RadixJoinTable::Tuple *matches = currentMap.find(
+                        itr->getElementAt(joins[0].posPattern),
+                        njoins == 2 ? itr->getElementAt(joins[1].posPattern) : 0,
+                        nRows);
+
+                for (uint64_t i = 0; i < nRows; ++i) {
+                    const size_t beginRow = matches[i].payload;
+                    for (int j = 0; j < nValuesToCopy; ++j) {
+                        int index = valuesToCopy[j];
+                        if (index < currentMapRowSize) {
+                            output->addValue(currentMapValues[beginRow + index]);
+                        } else {
+                            index -= currentMapRowSize;
+                            output->addValue(itr->getElementAt(valuesToCopy2[index]));
                         }
-                        beginRow += currentMapRowSize;
                     }
                 }
             }
@@ -59,6 +59,15 @@ int64_t NestedMergeJoinItr::executePlan() {
     }
 
     while (true) {
+        //Stop if the query exceeded its limits. The iterators are released
+        //first, the caller only deletes this object
+        if (context && context->shouldStop()) {
+            cleanup();
+            outputTuples = 0;
+            currentItr = NULL;
+            context->raise();
+        }
+
         /* Get the next value of the current iterator. If the current
          * iterator does not have values anymore, then we move one level below.
          */
@@ -0,0 +1,355 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/sparql/plancache.h>
+
+#include <cts/parser/SPARQLLexer.hpp>
+#include <cts/parser/SPARQLParser.hpp>
+
+#include <kognac/logs.h>
+
+PreparedQuery::PreparedQuery(const std::string &query) {
+    SPARQLLexer lexer(query);
+    SPARQLParser parser(lexer);
+    parser.parse(false, true);
+
+    //The constants are cut out of the text. Their ranges start with the
+    //whitespace before them, which is replaced by a space when they are bound
+    size_t pos = 0;
+    for (auto &constant : parser.getConstants()) {
+        parts.push_back(query.substr(pos, constant.first - pos));
+        pos = constant.second;
+    }
+    parts.push_back(query.substr(pos));
+}
+
+bool PreparedQuery::isTerm(const std::string &term) {
+    SPARQLLexer lexer(term);
+    SPARQLLexer::Token token = lexer.getNext();
+    if (token == SPARQLLexer::IRI) {
+        //<iri>
+    } else if (token == SPARQLLexer::String) {
+        //"literal", "literal"@lang or "literal"^^type
+        token = lexer.getNext();
+        if (token == SPARQLLexer::At) {
+            if (lexer.getNext() != SPARQLLexer::Identifier)
+                return false;
+        } else if (token == SPARQLLexer::Type) {
+            token = lexer.getNext();
+            if (token == SPARQLLexer::Identifier) {
+                if (lexer.getNext() != SPARQLLexer::Colon ||
+                        lexer.getNext() != SPARQLLexer::Identifier)
+                    return false;
+            } else if (token != SPARQLLexer::IRI) {
+                return false;
+            }
+        } else {
+            lexer.unget(token);
+        }
+    } else if (token == SPARQLLexer::Identifier) {
+        //prefix:name or the keyword 'a'
+        if (lexer.getTokenValue() != "a" &&
+                (lexer.getNext() != SPARQLLexer::Colon ||
+                 lexer.getNext() != SPARQLLexer::Identifier))
+            return false;
+    } else if (token == SPARQLLexer::Colon) {
+        //:name
+        if (lexer.getNext() != SPARQLLexer::Identifier)
+            return false;
+    } else if (token == SPARQLLexer::Integer ||
+            token == SPARQLLexer::Decimal || token == SPARQLLexer::Double) {
+        //A number, e.g., 42, 4.2 or 4.2e1
+    } else {
+        return false;
+    }
+    return lexer.getNext() == SPARQLLexer::Eof;
+}
+
+bool PreparedQuery::bind(const std::vector<std::string> &parameters,
+        std::string &query) const {
+    if (parameters.size() != getNParameters()) {
+        LOG(WARNL) << "The query has " << getNParameters() <<
+            " parameters, not " << parameters.size();
+        return false;
+    }
+    query = parts[0];
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        if (!isTerm(parameters[i])) {
+            LOG(WARNL) << "The parameter " << parameters[i] <<
+                " is not a single term";
+            return false;
+        }
+        query += " " + parameters[i] + parts[i + 1];
+    }
+    return true;
+}
+
+PlanCache::PlanCache(size_t maxEntries) : maxEntries(maxEntries), version(0),
+    hits(0), misses(0), nextPreparedId(0) {
+    }
+
+std::string PlanCache::getKey(const std::string &query,
+        const std::vector<std::pair<size_t, size_t>> &constants) {
+    //The tokens of the query, so that the whitespace and the comments do
+    //not matter. The tokens of a constant are replaced by a single '$'
+    SPARQLLexer lexer(query);
+    std::string key;
+    auto constant = constants.begin();
+    while (true) {
+        size_t offset = lexer.getReaderOffset();
+        SPARQLLexer::Token token = lexer.getNext();
+        if (token == SPARQLLexer::Eof || token == SPARQLLexer::Error) {
+            break;
+        }
+        while (constant != constants.end() && constant->second <= offset) {
+            constant++;
+        }
+        if (constant != constants.end() && constant->first <= offset) {
+            if (constant->first == offset) {
+                key += '$';
+            }
+            continue;
+        }
+        key += (char)('A' + token);
+        switch (token) {
+            case SPARQLLexer::IRI: case SPARQLLexer::String:
+            case SPARQLLexer::Variable: case SPARQLLexer::Identifier:
+            case SPARQLLexer::Integer: case SPARQLLexer::Decimal:
+            case SPARQLLexer::Double: {
+                //The length of the value keeps apart, e.g., two strings
+                //from one string with a quote
+                std::string value = lexer.getTokenValue();
+                key += std::to_string(value.size()) + ":" + value;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return key;
+}
+
+static bool copyConstants(const QueryGraph::SubQuery &from,
+        QueryGraph::SubQuery &to);
+
+static bool copyConstants(const QueryGraph::Node &from, QueryGraph::Node &to) {
+    if (from.constSubject != to.constSubject ||
+            from.constPredicate != to.constPredicate ||
+            from.constObject != to.constObject) {
+        return false;
+    }
+    //The variables must be the same
+    if ((!from.constSubject && from.subject != to.subject) ||
+            (!from.constPredicate && from.predicate != to.predicate) ||
+            (!from.constObject && from.object != to.object)) {
+        return false;
+    }
+    to.subject = from.subject;
+    to.predicate = from.predicate;
+    to.object = from.object;
+    return true;
+}
+
+static bool copyConstants(const QueryGraph::Filter *from,
+        QueryGraph::Filter *to) {
+    if (from == NULL || to == NULL) {
+        return from == to;
+    }
+    if (from->type != to->type) {
+        return false;
+    }
+    if (!copyConstants(from->arg1, to->arg1) ||
+            !copyConstants(from->arg2, to->arg2) ||
+            !copyConstants(from->arg3, to->arg3) ||
+            !copyConstants(from->arg4, to->arg4)) {
+        return false;
+    }
+    //NOT EXISTS
+    if ((from->subquery == NULL) != (to->subquery == NULL) ||
+            (from->subpattern == NULL) != (to->subpattern == NULL)) {
+        return false;
+    }
+    if (from->subquery && !PlanCache::copyConstants(*from->subquery,
+                *to->subquery)) {
+        return false;
+    }
+    if (from->subpattern && !copyConstants(*from->subpattern,
+                *to->subpattern)) {
+        return false;
+    }
+    return true;
+}
+
+static bool copyConstants(const std::vector<std::shared_ptr<QueryGraph>> &from,
+        std::vector<std::shared_ptr<QueryGraph>> &to) {
+    if (from.size() != to.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < from.size(); ++i) {
+        if (!PlanCache::copyConstants(*from[i], *to[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool copyConstants(const QueryGraph::SubQuery &from,
+        QueryGraph::SubQuery &to) {
+    //Parts of the query are dropped if a constant is not found, so that
+    //the shape of the graph can change
+    if (from.nodes.size() != to.nodes.size() ||
+            from.filters.size() != to.filters.size() ||
+            from.optional.size() != to.optional.size() ||
+            from.unions.size() != to.unions.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < from.nodes.size(); ++i) {
+        if (!copyConstants(from.nodes[i], to.nodes[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < from.filters.size(); ++i) {
+        if (!copyConstants(&from.filters[i], &to.filters[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < from.optional.size(); ++i) {
+        if (!copyConstants(from.optional[i], to.optional[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < from.unions.size(); ++i) {
+        if (from.unions[i].size() != to.unions[i].size()) {
+            return false;
+        }
+        for (size_t j = 0; j < from.unions[i].size(); ++j) {
+            if (!copyConstants(from.unions[i][j], to.unions[i][j])) {
+                return false;
+            }
+        }
+    }
+    return copyConstants(from.subqueries, to.subqueries) &&
+        copyConstants(from.minuses, to.minuses);
+}
+
+bool PlanCache::copyConstants(const QueryGraph &from, QueryGraph &to) {
+    if (from.knownEmpty() != to.knownEmpty()) {
+        return false;
+    }
+    return ::copyConstants(from.getQuery(), to.getQuery());
+}
+
+bool PlanCache::checkVersion(uint64_t version) {
+    //A query that started before the last update must not bring back the
+    //plans of its version
+    if (version < this->version) {
+        return false;
+    }
+    if (version > this->version) {
+        if (!entries.empty()) {
+            LOG(DEBUGL) << "The KB changed, dropping " << entries.size() <<
+                " plans";
+        }
+        entries.clear();
+        lru.clear();
+        this->version = version;
+    }
+    return true;
+}
+
+std::shared_ptr<PlanCache::Entry> PlanCache::get(const std::string &key,
+        uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto itr = checkVersion(version) ? entries.find(key) : entries.end();
+    if (itr == entries.end()) {
+        misses++;
+        return NULL;
+    }
+    hits++;
+    lru.splice(lru.begin(), lru, itr->second.second);
+    return itr->second.first;
+}
+
+void PlanCache::put(const std::string &key, uint64_t version,
+        std::shared_ptr<Entry> entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!checkVersion(version)) {
+        return;
+    }
+    auto itr = entries.find(key);
+    if (itr != entries.end()) {
+        //Another thread planned the same query
+        itr->second.first = entry;
+        lru.splice(lru.begin(), lru, itr->second.second);
+        return;
+    }
+    if (entries.size() >= maxEntries) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+    lru.push_front(key);
+    entries[key] = std::make_pair(entry, lru.begin());
+}
+
+void PlanCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+}
+
+size_t PlanCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+uint64_t PlanCache::getHits() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+uint64_t PlanCache::getMisses() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+uint64_t PlanCache::prepare(const std::string &query) {
+    std::shared_ptr<const PreparedQuery> q(new PreparedQuery(query));
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = nextPreparedId++;
+    prepared[id] = q;
+    return id;
+}
+
+std::shared_ptr<const PreparedQuery> PlanCache::getPrepared(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto itr = prepared.find(id);
+    if (itr == prepared.end()) {
+        return NULL;
+    }
+    return itr->second;
+}
+
+void PlanCache::unprepare(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    prepared.erase(id);
+}
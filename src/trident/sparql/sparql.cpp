@@ -52,7 +52,9 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         bool jsonoutput,
         JSON *jsonvars,
         JSON *jsonresults,
-        JSON *jsonstats) {
+        JSON *jsonstats,
+        QueryContext *context,
+        PlanCache *cache) {
     std::unique_ptr<QueryDict> queryDict = std::unique_ptr<QueryDict>(
             new QueryDict(nterms));
     std::unique_ptr<QueryGraph> queryGraph;
@@ -83,61 +85,127 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         }
     }
 
-    // Run the optimizer
-    PlanGen *plangen = new PlanGen();
-    Plan* plan = plangen->translate(db, *queryGraph.get(), false);
-    // delete plangen;  Commented out, because this also deletes all plans!
-    // In particular, it corrupts the current plan.
-    // --Ceriel
-    if (!plan) {
-        cerr << "internal error plan generation failed" << endl;
-        delete plangen;
-        return;
+    // Run the optimizer, unless the cache has the plan of the same query with
+    // other constants in its triple patterns
+    std::shared_ptr<PlanCache::Entry> entry;
+    std::unique_lock<std::mutex> entryLock;
+    bool planCached = false;
+    bool shapeChanged = false;
+    string key;
+    uint64_t version = 0;
+    if (cache && !explain) {
+        key = PlanCache::getKey(sparqlquery, parser->getConstants());
+        //Also the updates that do not publish a snapshot change the statistics
+        version = db.getKB()->getStatsVersion();
+        entry = cache->get(key, version);
+        if (entry) {
+            //The constants of the entry belong to this query until its
+            //operators are built
+            entryLock = std::unique_lock<std::mutex>(entry->mutex);
+            planCached = PlanCache::copyConstants(*queryGraph.get(),
+                    *entry->queryGraph.get());
+            if (!planCached) {
+                entryLock.unlock();
+                entry = NULL;
+                shapeChanged = true;
+            }
+        }
+    }
+    if (!planCached) {
+        // The entry keeps the plans, deleting the PlanGen also deletes them
+        entry = std::shared_ptr<PlanCache::Entry>(new PlanCache::Entry());
+        entry->plangen = std::unique_ptr<PlanGen>(new PlanGen());
+        entry->plangen->setMultiwayJoins(db.useMultiwayJoins());
+        entry->plan = entry->plangen->translate(db, *queryGraph.get(), false);
+        if (!entry->plan) {
+            cerr << "internal error plan generation failed" << endl;
+            return;
+        }
+        entry->queryGraph = std::move(queryGraph);
+        //A query whose constants dropped a part of it is not cached
+        if (cache && !explain && !shapeChanged) {
+            entryLock = std::unique_lock<std::mutex>(entry->mutex);
+            cache->put(key, version, entry);
+        }
     }
+    Plan *plan = entry->plan;
     if (explain)
         plan->print(0);
 
-    // Build a physical plan
+    // Build a physical plan. The operators and the scans are taken from the
+    // arena of the layer, which is reset once the tree is deleted. If another
+    // query is using the arena, they are taken from the heap
+    QueryArena::Lease arenaLease(db.getArena());
+    QueryArena *arena = arenaLease.get();
+    QueryArena::Scope arenaScope(arena);
+    const uint64_t startHeapAllocations = QueryArena::getHeapAllocations();
     Runtime runtime(db, NULL, queryDict.get());
-    Operator* operatorTree = CodeGen().translate(runtime, *queryGraph.get(), plan, false);
+    runtime.setSortMemoryBudget(db.getSortMemoryBudget());
+    runtime.setHashMemoryBudget(db.getHashMemoryBudget());
+    runtime.setParallelism(db.getParallelism());
+    runtime.setQueryContext(context);
+    //Deleted before the arena is reset
+    std::unique_ptr<Operator> operatorTree(CodeGen().translate(runtime,
+            *entry->queryGraph.get(), plan, false));
+    if (entryLock.owns_lock())
+        entryLock.unlock();
+    LOG(DEBUGL) << "Plan " << (planCached ? "from the cache" : "generated");
 
     // Execute it
     if (explain) {
         DebugPlanPrinter out(runtime, false);
         operatorTree->print(out);
-        delete operatorTree;
     } else {
 #if DEBUG
         DebugPlanPrinter out(runtime, false);
         operatorTree->print(out);
 #endif
         //set up output options for the last operators
-        ResultsPrinter *p = (ResultsPrinter*) operatorTree;
+        ResultsPrinter *p = (ResultsPrinter*) operatorTree.get();
         p->setSilent(!printstdout);
         if (jsonoutput) {
             p->setJSONOutput(jsonresults, jsonnamevars);
         }
 
+        //The query stops with an exception if it exceeds the limits of the
+        //context. The results printed so far are incomplete
         std::chrono::system_clock::time_point startQ = std::chrono::system_clock::now();
-        if (operatorTree->first()) {
-            while (operatorTree->next());
+        string error;
+        try {
+            if (operatorTree->first()) {
+                while (operatorTree->next());
+            }
+        } catch (const QueryContext::Exception &e) {
+            LOG(WARNL) << "The query was stopped: " << e.message;
+            error = e.message;
         }
         std::chrono::duration<double> durationQ = std::chrono::system_clock::now() - startQ;
         std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
         LOG(INFOL) << "Runtime query: " << durationQ.count() * 1000 << "ms.";
         LOG(INFOL) << "Runtime total: " << duration.count() * 1000 << "ms.";
         if (jsonstats) {
+            if (!error.empty())
+                jsonstats->put("error", error);
+            if (context)
+                jsonstats->put("memorypeak", to_string(context->getMemoryPeak()));
+            jsonstats->put("plancached", planCached ? "true" : "false");
             jsonstats->put("runtime", to_string(durationQ.count()));
             jsonstats->put("nresults", to_string(p->getPrintedRows()));
-
+            jsonstats->put("arenaallocations", to_string(arena ?
+                        arena->getNAllocations() : 0));
+            jsonstats->put("heapallocations", to_string(
+                        QueryArena::getHeapAllocations() - startHeapAllocations));
         }
+        LOG(DEBUGL) << "Query objects: " << (arena ? arena->getNAllocations() : 0)
+            << " from the arena (" << (arena ? arena->getNBytes() : 0)
+            << " bytes), "
+            << QueryArena::getHeapAllocations() - startHeapAllocations
+            << " from the heap";
         if (printstdout) {
             uint64_t nElements = p->getPrintedRows();
             LOG(INFOL) << "# rows = " << nElements;
         }
-        delete operatorTree;
     }
-    delete plangen;
 }
 
 
@@ -55,6 +55,7 @@ Join::Join(std::vector<std::shared_ptr<SPARQLOperator>> children,
 NestedMergeJoin::NestedMergeJoin(Querier *q,
                                  std::vector<std::shared_ptr<SPARQLOperator>> children) : Join(children) {
     this->q = q;
+    this->context = NULL;
     //The original plan is not considered in this case. We use an optimized version
     std::vector<Filter *> filters;
     filters.resize(children.size());
@@ -73,6 +74,7 @@ NestedMergeJoin::NestedMergeJoin(Querier *q,
                                  std::vector<string> &projections)
     : Join(children) {
     this->q = q;
+    this->context = NULL;
     //The original plan is not considered in this case. We use an optimized version
     std::vector<Filter *> filters;
     filters.resize(children.size());
@@ -90,6 +92,7 @@ NestedMergeJoin::NestedMergeJoin(NestedMergeJoin &existing,
                                  std::vector<string> &projections) : Join(existing.getChildren(),
                                              projections) {
     this->q = existing.q;
+    this->context = existing.context;
     //This procedure can be optimized by reusing the existing plan. However, the cost of this op
     //is quite small
     std::vector<Filter *> filters;
@@ -116,7 +119,7 @@ void NestedMergeJoin::print(int indent) {
 }
 
 TupleIterator *NestedMergeJoin::getIterator() {
-    return new NestedMergeJoinItr(q, nestedPlan);
+    return new NestedMergeJoinItr(q, nestedPlan, context);
 }
 
 void NestedMergeJoin::releaseIterator(TupleIterator *itr) {
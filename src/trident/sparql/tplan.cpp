@@ -48,7 +48,9 @@ void TridentQueryPlan::create(Query &query, int typePlanning) {
 
             //Create joins
             std::vector<string> projections = query.getProjections();
-            root = std::unique_ptr<SPARQLOperator>(new NestedMergeJoin(q, listScans, projections));
+            NestedMergeJoin *join = new NestedMergeJoin(q, listScans, projections);
+            join->setQueryContext(context);
+            root = std::unique_ptr<SPARQLOperator>(join);
         } else { //No query optimization
             std::vector<std::shared_ptr<SPARQLOperator>> patterns;
             for (int i = 0; i < query.npatterns(); ++i) {
@@ -58,7 +60,9 @@ void TridentQueryPlan::create(Query &query, int typePlanning) {
 
             //Create joins
             std::vector<string> projections = query.getProjections();
-            root = std::unique_ptr<SPARQLOperator>(new NestedMergeJoin(q, patterns, projections));
+            NestedMergeJoin *join = new NestedMergeJoin(q, patterns, projections);
+            join->setQueryContext(context);
+            root = std::unique_ptr<SPARQLOperator>(join);
         }
     }
 }
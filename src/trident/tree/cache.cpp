@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include <lz4.h>
 
 using namespace std;
@@ -75,18 +76,8 @@ void Cache::flushNode(Node *node, const bool registerNode) {
         //Serialize the node
         int sizeBuffer = node->serialize(supportBuffer, 0);
         if (compressedNodes) {
-#if LZ4_VERSION_MAJOR > 1 || LZ4_VERSION_MINOR > 2 || (LZ4_VERSION_MINOR == 2 && LZ4_VERSION_RELEASE >= 9)
-            // LZ4_compress_default does not exist before lz4 version 129.
-            int sizeCompressedBuffer = LZ4_compress_default(supportBuffer,
-                    supportBuffer2, sizeBuffer, SIZE_SUPPORT_BUFFER);
-#else
-            int sizeCompressedBuffer = LZ4_compress(supportBuffer,
-                    supportBuffer2, sizeBuffer);
-#endif
-            if (sizeCompressedBuffer == 0 || sizeCompressedBuffer > SIZE_SUPPORT_BUFFER) {
-                LOG(ERRORL) << "Failed compressing buffer (size=0)";
-                throw 10;
-            }
+            int sizeCompressedBuffer = compressNode(supportBuffer,
+                    sizeBuffer, supportBuffer2);
             manager->put(node, supportBuffer2, sizeCompressedBuffer);
         } else {
             //Write the new node on disk
@@ -105,6 +96,27 @@ void Cache::flushNode(Node *node, const bool registerNode) {
     }
 }
 
+int Cache::compressNode(char *input, int sizeInput, char *output) {
+#if LZ4_VERSION_MAJOR > 1 || LZ4_VERSION_MINOR > 2 || (LZ4_VERSION_MINOR == 2 && LZ4_VERSION_RELEASE >= 9)
+    // LZ4_compress_default does not exist before lz4 version 129.
+    int sizeCompressedBuffer = LZ4_compress_default(input,
+            output, sizeInput, SIZE_SUPPORT_BUFFER);
+#else
+    int sizeCompressedBuffer = LZ4_compress(input,
+            output, sizeInput);
+#endif
+    if (sizeCompressedBuffer == 0 || sizeCompressedBuffer > SIZE_SUPPORT_BUFFER) {
+        LOG(ERRORL) << "Failed compressing buffer (size=0)";
+        throw 10;
+    }
+    return sizeCompressedBuffer;
+}
+
+void Cache::storeSerializedNode(int64_t id, bool children, char *buffer,
+        int sizeBuffer) {
+    manager->put(id, children, buffer, sizeBuffer);
+}
+
 void Cache::registerNode(Node *node) {
     if (node->canHaveChildren()) {
         return;
@@ -121,6 +133,13 @@ void Cache::registerNode(Node *node) {
     registeredNodes.push_back(node);
 }
 
+void Cache::unregisterNode(Node *node) {
+    auto itr = std::find(registeredNodes.begin(), registeredNodes.end(), node);
+    if (itr != registeredNodes.end()) {
+        registeredNodes.erase(itr);
+    }
+}
+
 void Cache::flushAllCache() {
     while (!registeredNodes.empty()) {
         Node *n = registeredNodes.front();
@@ -2,6 +2,10 @@
 #include <trident/tree/flattreeitr.h>
 #include <trident/binarytables/storagestrat.h>
 
+#include <thread>
+#include <functional>
+#include <vector>
+
 FlatRoot::FlatRoot(string path, bool unlabeled, bool undirected) :
     unlabeled(unlabeled), undirected(undirected) {
         file = std::unique_ptr<MemoryMappedFile>(new MemoryMappedFile(path, true));
@@ -406,11 +410,18 @@ void FlatRoot::loadFlatTree(string sop,
         }
         //if undirected do nothing nothing
     } else {
-        writeOtherPerm(osp, flatfile, 23, 83, unlabeled);
-        writeOtherPerm(spo, flatfile, 36, 83, unlabeled);
-        writeOtherPerm(ops, flatfile, 49, 83, unlabeled);
-        writeOtherPerm(pos, flatfile, 62, 83, unlabeled);
-        writeOtherPerm(pso, flatfile, 75, 83, unlabeled);
+        //Every permutation fills a different part of the blocks, so they
+        //can be written in parallel
+        string perms[5] = { osp, spo, ops, pos, pso };
+        int offsets[5] = { 23, 36, 49, 62, 75 };
+        std::vector<std::thread> threads(5);
+        for (int i = 0; i < 5; ++i) {
+            threads[i] = std::thread(std::bind(&FlatRoot::writeOtherPerm,
+                        perms[i], flatfile, offsets[i], 83, unlabeled));
+        }
+        for (int i = 0; i < 5; ++i) {
+            threads[i].join();
+        }
     }
 }
 
@@ -55,6 +55,23 @@ IntermediateNode::IntermediateNode(TreeContext *context, Node *child1,
         setState(STATE_MODIFIED);
     }
 
+void IntermediateNode::setStoredChildren(const int64_t *idChildren,
+        const int64_t *keys, const int nChildren) {
+    if (children == NULL) {
+        children = new Node*[getContext()->getMaxElementsPerNode() + 1];
+        this->idChildren = new int64_t[getContext()->getMaxElementsPerNode() + 1];
+    }
+    for (int i = 0; i < nChildren - 1; ++i) {
+        putkeyAt(keys[i], i);
+    }
+    for (int i = 0; i < nChildren; ++i) {
+        children[i] = NULL;
+        this->idChildren[i] = idChildren[i];
+    }
+    lastUpdatedChild = -1;
+    setState(STATE_MODIFIED);
+}
+
 int IntermediateNode::unserialize(char *bytes, int pos) {
     pos = Node::unserialize(bytes, pos);
 
@@ -146,8 +146,13 @@ CachedNode *NodeManager::getCachedNode(int64_t id) {
 }
 
 void NodeManager::put(Node *node, char *buffer, int sizeBuffer) {
+    put(node->getId(), node->canHaveChildren(), buffer, sizeBuffer);
+}
+
+void NodeManager::put(int64_t id, bool children, char *buffer,
+        int sizeBuffer) {
     //First check if there is already a cachedNode existing
-    CachedNode *cn = getCachedNode(node->getId());
+    CachedNode *cn = getCachedNode(id);
     if (cn != NULL) {
         if (sizeBuffer > cn->availableSize) {
             LOG(DEBUGL) << "Node " << cn->id << " is " << (sizeBuffer - cn->availableSize) << "  bytes larger. Current size is " << cn->availableSize << " Must increase file " << cn->fileIndex;
@@ -172,8 +177,8 @@ void NodeManager::put(Node *node, char *buffer, int sizeBuffer) {
     } else {
         CachedNode *c = new CachedNode;
         //Fill all the fields
-        c->id = node->getId();
-        c->children = node->canHaveChildren();
+        c->id = id;
+        c->children = children;
         c->nodeSize = sizeBuffer;
         c->availableSize = std::max(nodeMinSize, sizeBuffer);
 
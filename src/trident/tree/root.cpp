@@ -34,6 +34,9 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <thread>
+#include <memory>
+#include <functional>
 
 using namespace std;
 
@@ -236,6 +239,162 @@ bool Root::insertIfNotExists(tTerm *key, int sizeKey, nTerm &value) {
     return insertResult;
 }
 
+void Root::bulkLoadLeaves(TermCoordinatesSource *source, string file,
+        int maxElementsPerNode, bool compressedNodes,
+        std::vector<int64_t> *smallestKeys,
+        std::vector<int64_t> *largestKeys) {
+    //The leaves are built in a private context since the factories of the
+    //tree are not thread-safe. The context has no cache because the leaves
+    //are never split.
+    PreallocatedArraysFactory<int64_t> keysFactory(maxElementsPerNode, 10, 10);
+    PreallocatedFactory<Coordinates> coordFactory(10, 10);
+    PreallocatedArraysFactory<Coordinates*> coordBufferFactory(
+            maxElementsPerNode / 2, 10, 10);
+    TreeContext context(NULL, NULL, false, maxElementsPerNode, false, false,
+            &coordFactory, &coordBufferFactory, &keysFactory);
+
+    std::unique_ptr<char[]> buffer(new char[SIZE_SUPPORT_BUFFER]);
+    std::unique_ptr<char[]> compressedBuffer;
+    if (compressedNodes) {
+        compressedBuffer = std::unique_ptr<char[]>(new char[SIZE_SUPPORT_BUFFER]);
+    }
+    ofstream out(file, ios_base::binary);
+    char header[4];
+
+    nTerm key;
+    TermCoordinates *value = source->get(key);
+    while (value != NULL) {
+        //Leaves are filled up to the minimum size, as they would be after
+        //a sequence of ordered insertions
+        Leaf leaf(&context);
+        smallestKeys->push_back(key);
+        nTerm lastKey = key;
+        while (value != NULL &&
+                leaf.getCurrentSize() < context.getMinElementsPerNode()) {
+            leaf.append(key, value);
+            lastKey = key;
+            value = source->get(key);
+        }
+        largestKeys->push_back(lastKey);
+
+        int size = leaf.serialize(buffer.get(), 0);
+        char *b = buffer.get();
+        if (compressedNodes) {
+            size = Cache::compressNode(buffer.get(), size,
+                    compressedBuffer.get());
+            b = compressedBuffer.get();
+        }
+        leaf.free();
+
+        Utils::encode_int(header, 0, size);
+        out.write(header, 4);
+        out.write(b, size);
+    }
+    out.close();
+}
+
+void Root::bulkLoad(std::vector<TermCoordinatesSource*> &sources) {
+    if (readOnly || rootNode->canHaveChildren()
+            || rootNode->getCurrentSize() > 0) {
+        LOG(ERRORL) << "Bulk loading is possible only on a new tree";
+        throw 10;
+    }
+
+    //1- Create the leaves of every partition in parallel
+    const int nparts = sources.size();
+    std::vector<string> files(nparts);
+    std::vector<std::vector<int64_t>> smallestKeys(nparts);
+    std::vector<std::vector<int64_t>> largestKeys(nparts);
+    std::vector<std::thread> threads(nparts);
+    for (int i = 0; i < nparts; ++i) {
+        files[i] = path + DIR_SEP + "bulk-" + to_string(i) + ".tmp";
+        threads[i] = std::thread(std::bind(&Root::bulkLoadLeaves,
+                    sources[i], files[i], context->getMaxElementsPerNode(),
+                    cache->areNodesCompressed(), &smallestKeys[i],
+                    &largestKeys[i]));
+    }
+    for (int i = 0; i < nparts; ++i) {
+        threads[i].join();
+    }
+
+    //2- Write the leaves sequentially. The ids of the nodes must be
+    //consecutive, so the first leaf takes the id of the empty root
+    std::vector<int64_t> ids;
+    std::vector<int64_t> smallest;
+    std::vector<int64_t> largest;
+    std::unique_ptr<char[]> buffer(new char[SIZE_SUPPORT_BUFFER]);
+    char header[4];
+    for (int i = 0; i < nparts; ++i) {
+        ifstream in(files[i], ios_base::binary);
+        for (size_t j = 0; j < smallestKeys[i].size(); ++j) {
+            in.read(header, 4);
+            const int size = Utils::decode_int(header, 0);
+            in.read(buffer.get(), size);
+            const int64_t id = ids.empty() ? rootNode->getId() :
+                context->getNewNodeID();
+            cache->storeSerializedNode(id, false, buffer.get(), size);
+            ids.push_back(id);
+        }
+        in.close();
+        Utils::remove(files[i]);
+        smallest.insert(smallest.end(), smallestKeys[i].begin(),
+                smallestKeys[i].end());
+        largest.insert(largest.end(), largestKeys[i].begin(),
+                largestKeys[i].end());
+    }
+    LOG(DEBUGL) << "Bulk loading: created " << ids.size() << " leaves";
+
+    if (ids.empty()) {
+        //Nothing was added. Keep the empty root
+        return;
+    }
+    //The empty root is replaced by the new nodes. It is dropped without
+    //being written, since its id now belongs to the first leaf
+    cache->unregisterNode(rootNode);
+    cache->releaseLeaf(rootNode);
+    rootNode = NULL;
+
+    if (ids.size() == 1) {
+        rootNode = cache->getNodeFromCache(ids[0]);
+        return;
+    }
+
+    //3- Build the upper levels. The intermediate nodes are full
+    const size_t maxChildren = context->getMaxElementsPerNode() + 1;
+    std::vector<int64_t> keys(maxChildren);
+    while (ids.size() > 1) {
+        const size_t nchildren = ids.size();
+        const size_t nnodes = (nchildren + maxChildren - 1) / maxChildren;
+        std::vector<int64_t> parentIds;
+        std::vector<int64_t> parentSmallest;
+        std::vector<int64_t> parentLargest;
+        size_t start = 0;
+        for (size_t i = 0; i < nnodes; ++i) {
+            const size_t end = nchildren * (i + 1) / nnodes;
+            for (size_t j = start + 1; j < end; ++j) {
+                keys[j - start - 1] = (largest[j - 1] + smallest[j]) / 2;
+            }
+            IntermediateNode *node = cache->newIntermediateNode();
+            node->setId(context->getNewNodeID());
+            node->setParent(NULL);
+            node->setStoredChildren(&ids[start], &keys[0], end - start);
+            parentIds.push_back(node->getId());
+            parentSmallest.push_back(smallest[start]);
+            parentLargest.push_back(largest[end - 1]);
+            if (nnodes == 1) {
+                //It will be written when the tree is closed
+                rootNode = node;
+            } else {
+                cache->flushNode(node, false);
+            }
+            start = end;
+        }
+        ids.swap(parentIds);
+        smallest.swap(parentSmallest);
+        largest.swap(parentLargest);
+    }
+}
+
 tTerm _smallest_text[] = "";
 tTerm *SMALLEST_TEXT = _smallest_text;
 
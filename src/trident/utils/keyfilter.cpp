@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/utils/keyfilter.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <limits>
+#include <algorithm>
+
+KeyFilter::KeyFilter() : nbits(0), nhashes(0),
+    minKey(std::numeric_limits<int64_t>::max()),
+    maxKey(std::numeric_limits<int64_t>::min()), enabled(false) {
+}
+
+uint64_t KeyFilter::hash(int64_t key, uint64_t seed) {
+    //splitmix64 finalizer
+    uint64_t x = (uint64_t) key + seed + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+void KeyFilter::init(uint64_t nkeys, int bitsPerKey) {
+    nbits = std::max((uint64_t) 64, nkeys * bitsPerKey);
+    nbits = (nbits + 63) & ~(uint64_t)63;
+    bits.clear();
+    bits.resize(nbits >> 6, 0);
+    //~0.7 * bits per key minimizes the false positive rate
+    nhashes = (uint8_t) std::max(1, std::min(16, bitsPerKey * 7 / 10));
+    minKey = std::numeric_limits<int64_t>::max();
+    maxKey = std::numeric_limits<int64_t>::min();
+    enabled = true;
+}
+
+void KeyFilter::add(int64_t key) {
+    if (key < minKey)
+        minKey = key;
+    if (key > maxKey)
+        maxKey = key;
+    const uint64_t h1 = hash(key, 0);
+    const uint64_t h2 = hash(key, h1) | 1;
+    for (uint8_t i = 0; i < nhashes; ++i) {
+        const uint64_t bit = (h1 + i * h2) % nbits;
+        bits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    }
+}
+
+void KeyFilter::store(std::string file) const {
+    std::ofstream f(file, std::ios_base::binary);
+    char buffer[8];
+    Utils::encode_long(buffer, minKey);
+    f.write(buffer, 8);
+    Utils::encode_long(buffer, maxKey);
+    f.write(buffer, 8);
+    Utils::encode_long(buffer, nbits);
+    f.write(buffer, 8);
+    f.put((char) nhashes);
+    for (auto w : bits) {
+        Utils::encode_long(buffer, w);
+        f.write(buffer, 8);
+    }
+    if (!f.good()) {
+        LOG(ERRORL) << "Error writing the key filter " << file;
+        throw 10;
+    }
+}
+
+bool KeyFilter::load(std::string file) {
+    enabled = false;
+    if (!Utils::exists(file)) {
+        return false;
+    }
+    std::ifstream f(file, std::ios_base::binary);
+    char buffer[25];
+    f.read(buffer, 25);
+    if (!f.good()) {
+        LOG(WARNL) << "The key filter " << file << " is truncated. Ignored.";
+        return false;
+    }
+    minKey = Utils::decode_long(buffer);
+    maxKey = Utils::decode_long(buffer + 8);
+    nbits = Utils::decode_long(buffer + 16);
+    nhashes = (uint8_t) buffer[24];
+    if (nbits == 0 || (nbits & 63) != 0) {
+        LOG(WARNL) << "The key filter " << file << " is invalid. Ignored.";
+        return false;
+    }
+    bits.resize(nbits >> 6);
+    for (size_t i = 0; i < bits.size(); ++i) {
+        f.read(buffer, 8);
+        bits[i] = Utils::decode_long(buffer);
+    }
+    if (!f.good()) {
+        LOG(WARNL) << "The key filter " << file << " is truncated. Ignored.";
+        return false;
+    }
+    enabled = true;
+    return true;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#include <trident/utils/loadprofiler.h>
+#include <trident/utils/tridentutils.h>
+#include <trident/utils/json.h>
+
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__unix) || defined(unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/resource.h>
+#endif
+
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
+#define PROFILER_PROCFS
+#endif
+
+//Reads the current RSS (KB) and number of threads of the process
+static void _readStatus(int64_t &rss, int64_t &threads) {
+    rss = -1;
+    threads = -1;
+#ifdef PROFILER_PROCFS
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == NULL) {
+        return;
+    }
+    char line[128];
+    while (fgets(line, 128, file) != NULL) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            rss = strtoll(line + 6, NULL, 10);
+        } else if (strncmp(line, "Threads:", 8) == 0) {
+            threads = strtoll(line + 8, NULL, 10);
+        }
+    }
+    fclose(file);
+#endif
+}
+
+static void _readIO(int64_t &read, int64_t &write,
+        int64_t &phyread, int64_t &phywrite) {
+#ifdef PROFILER_PROCFS
+    read = TridentUtils::diskread();
+    write = TridentUtils::diskwrite();
+    phyread = TridentUtils::phy_diskread();
+    phywrite = TridentUtils::phy_diskwrite();
+#else
+    read = write = phyread = phywrite = 0;
+#endif
+}
+
+double LoadProfiler::getCPUTime() {
+#if defined(__unix__) || defined(__unix) || defined(unix) || (defined(__APPLE__) && defined(__MACH__))
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#else
+    return 0;
+#endif
+}
+
+LoadProfiler::LoadProfiler(int samplingMs) : openPhases(0),
+    owner(std::this_thread::get_id()), samplingMs(samplingMs),
+    isFinished(false) {
+    start = std::chrono::steady_clock::now();
+    sampler = std::thread(&LoadProfiler::sample, this);
+}
+
+void LoadProfiler::sample() {
+    std::unique_lock<std::mutex> lck(mtx);
+    while (!isFinished) {
+        cv.wait_for(lck, std::chrono::milliseconds(samplingMs));
+        if (isFinished)
+            break;
+        if (openPhases > 0) {
+            int64_t rss, threads;
+            _readStatus(rss, threads);
+            updatePeaks(rss, threads);
+        }
+    }
+}
+
+void LoadProfiler::updatePeaks(int64_t rss, int64_t threads) {
+    for (auto &phase : phases) {
+        if (!phase.finished) {
+            phase.peakRSS = std::max(phase.peakRSS, rss);
+            phase.maxThreads = std::max(phase.maxThreads, threads);
+        }
+    }
+}
+
+size_t LoadProfiler::startPhase(std::string name, int threads) {
+    Phase phase;
+    phase.name = name;
+    phase.threads = threads;
+    phase.finished = false;
+    phase.wallTime = phase.cpuTime = 0;
+    phase.bytesRead = phase.bytesWritten = 0;
+    phase.phyBytesRead = phase.phyBytesWritten = 0;
+    _readStatus(phase.peakRSS, phase.maxThreads);
+    _readIO(phase.startRead, phase.startWrite, phase.startPhyRead,
+            phase.startPhyWrite);
+    phase.startCPU = getCPUTime();
+    phase.startWall = std::chrono::steady_clock::now();
+
+    phase.thread = std::this_thread::get_id();
+
+    std::lock_guard<std::mutex> lck(mtx);
+    std::vector<size_t> &open = openPerThread[phase.thread];
+    if (!open.empty()) {
+        phase.level = phases[open.back()].level + 1;
+    } else if (!openPerThread[owner].empty()) {
+        //Started by a worker of the innermost phase of the main thread
+        phase.level = phases[openPerThread[owner].back()].level + 1;
+    } else {
+        phase.level = 0;
+    }
+    openPhases++;
+    phases.push_back(phase);
+    open.push_back(phases.size() - 1);
+    return phases.size() - 1;
+}
+
+void LoadProfiler::endPhase(size_t id) {
+    auto endWall = std::chrono::steady_clock::now();
+    double endCPU = getCPUTime();
+    int64_t read, write, phyread, phywrite;
+    _readIO(read, write, phyread, phywrite);
+    int64_t rss, threads;
+    _readStatus(rss, threads);
+
+    std::lock_guard<std::mutex> lck(mtx);
+    updatePeaks(rss, threads);
+    Phase &phase = phases[id];
+    std::chrono::duration<double> sec = endWall - phase.startWall;
+    phase.wallTime = sec.count();
+    phase.cpuTime = endCPU - phase.startCPU;
+    phase.bytesRead = read - phase.startRead;
+    phase.bytesWritten = write - phase.startWrite;
+    phase.phyBytesRead = phyread - phase.startPhyRead;
+    phase.phyBytesWritten = phywrite - phase.startPhyWrite;
+    phase.finished = true;
+    openPhases--;
+    std::vector<size_t> &open = openPerThread[phase.thread];
+    open.erase(std::find(open.begin(), open.end(), id));
+    if (open.empty()) {
+        openPerThread.erase(phase.thread);
+    }
+}
+
+void LoadProfiler::writeReport(std::string file, std::string params) {
+    JSON report;
+    report.put("params", params);
+    std::chrono::duration<double> sec = std::chrono::steady_clock::now() -
+        start;
+    report.put("wallTime_sec", sec.count());
+    report.put("cpuTime_sec", getCPUTime());
+#ifdef PROFILER_PROCFS
+    report.put("peakRSS_KB", TridentUtils::getPeakRSS());
+#endif
+    report.put("hardwareThreads", std::thread::hardware_concurrency());
+
+    JSON list;
+    std::lock_guard<std::mutex> lck(mtx);
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase &phase = phases[i];
+        if (!phase.finished) {
+            continue;
+        }
+        JSON p;
+        p.put("order", (int) i);
+        p.put("name", phase.name);
+        p.put("level", phase.level);
+        p.put("threads", phase.threads);
+        p.put("maxThreads", phase.maxThreads);
+        p.put("wallTime_sec", phase.wallTime);
+        p.put("cpuTime_sec", phase.cpuTime);
+        p.put("bytesRead", phase.bytesRead);
+        p.put("bytesWritten", phase.bytesWritten);
+        p.put("phyBytesRead", phase.phyBytesRead);
+        p.put("phyBytesWritten", phase.phyBytesWritten);
+        p.put("peakRSS_KB", phase.peakRSS);
+        list.push_back(p);
+    }
+    report.add_child("phases", list);
+
+    std::ofstream out(file);
+    if (!out.good()) {
+        LOG(WARNL) << "Cannot write the loading report in " << file;
+        return;
+    }
+    JSON::write(out, report);
+    out << std::endl;
+    LOG(INFOL) << "The loading report is stored in " << file;
+}
+
+LoadProfiler::~LoadProfiler() {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        isFinished = true;
+    }
+    cv.notify_all();
+    sampler.join();
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/utils/queryarena.h>
+
+#include <kognac/logs.h>
+
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+thread_local QueryArena *QueryArena::current = NULL;
+std::atomic<uint64_t> QueryArena::heapAllocations(0);
+
+QueryArena::QueryArena(size_t blockSize) : blockSize(blockSize),
+    currentBlock(0), pos(0), nallocations(0), nbytes(0), busy(false) {
+}
+
+void *QueryArena::allocate(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    while (currentBlock < blocks.size()) {
+        if (pos + size <= blocks[currentBlock].size) {
+            break;
+        }
+        currentBlock++;
+        pos = 0;
+    }
+    if (currentBlock == blocks.size()) {
+        //Large objects get a block of their own
+        Block b;
+        b.size = std::max(blockSize, size);
+        b.data = std::unique_ptr<char[]>(new char[b.size + ALIGNMENT]);
+        blocks.push_back(std::move(b));
+        pos = 0;
+    }
+    char *start = blocks[currentBlock].data.get();
+    //new char[] is only aligned to the fundamental alignment
+    start += (ALIGNMENT - ((size_t) start % ALIGNMENT)) % ALIGNMENT;
+    void *out = start + pos;
+    pos += size;
+    nallocations++;
+    nbytes += size;
+    return out;
+}
+
+void QueryArena::reset() {
+    if (blocks.size() > MAX_RETAINED_BLOCKS) {
+        //Keep the blocks of normal size, which can be reused
+        std::vector<Block> retained;
+        for (auto &b : blocks) {
+            if (b.size == blockSize && retained.size() < MAX_RETAINED_BLOCKS) {
+                retained.push_back(std::move(b));
+            }
+        }
+        blocks.swap(retained);
+    }
+    LOG(TRACEL) << "Reset arena: " << nallocations << " allocations, "
+        << nbytes << " bytes";
+    currentBlock = 0;
+    pos = 0;
+    nallocations = 0;
+    nbytes = 0;
+}
+
+size_t QueryArena::getCapacity() const {
+    size_t capacity = 0;
+    for (const auto &b : blocks) {
+        capacity += b.size;
+    }
+    return capacity;
+}
+
+//Every object is preceded by a header with the arena it was taken from, or
+//NULL if it was allocated on the heap
+void *ArenaObject::operator new(size_t size) {
+    QueryArena *arena = QueryArena::current;
+    char *mem;
+    if (arena) {
+        mem = (char*) arena->allocate(size + QueryArena::ALIGNMENT);
+    } else {
+        mem = (char*) malloc(size + QueryArena::ALIGNMENT);
+        if (mem == NULL) {
+            throw std::bad_alloc();
+        }
+        QueryArena::heapAllocations++;
+    }
+    *((QueryArena**) mem) = arena;
+    return mem + QueryArena::ALIGNMENT;
+}
+
+void ArenaObject::operator delete(void *p) {
+    if (p == NULL) {
+        return;
+    }
+    char *mem = (char*) p - QueryArena::ALIGNMENT;
+    if (*((QueryArena**) mem) == NULL) {
+        free(mem);
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/utils/radixjoin.h>
+#include <trident/utils/parallel.h>
+
+#include <algorithm>
+
+//Inputs smaller than this are built by a single thread
+#define RADIX_PARALLEL_MIN 100000
+#define RADIX_MAX_BITS 12
+
+static bool lessKey(const RadixJoinTable::Tuple &a,
+        const RadixJoinTable::Tuple &b) {
+    return a.key1 < b.key1 || (a.key1 == b.key1 && a.key2 < b.key2);
+}
+
+RadixJoinTable::RadixJoinTable() : radixBits(0), nkeys(0) {
+    clear();
+}
+
+void RadixJoinTable::clear() {
+    tuples.clear();
+    slots.clear();
+    //An empty table has a single partition with a single empty slot
+    slots.resize(1);
+    partitions.clear();
+    partitions.resize(1);
+    radixBits = 0;
+    nkeys = 0;
+}
+
+void RadixJoinTable::build(std::vector<Tuple> &input, int nthreads) {
+    clear();
+    const uint64_t n = input.size();
+    if (n < RADIX_PARALLEL_MIN)
+        nthreads = 1;
+    nthreads = std::max(nthreads, 1);
+
+    //Choose the number of partitions
+    while (radixBits < RADIX_MAX_BITS &&
+            (n >> radixBits) > PARTITION_SIZE)
+        radixBits++;
+    const uint64_t npartitions = (uint64_t)1 << radixBits;
+
+    //Count the tuples of every partition in each chunk of the input
+    const uint64_t chunkSize = (n + nthreads - 1) / nthreads;
+    const uint64_t nchunks = chunkSize ? (n + chunkSize - 1) / chunkSize : 0;
+    std::vector<uint64_t> offsets(nchunks * npartitions);
+    ParallelTasks::parallel_for(0, nchunks, 1, [&](const ParallelRange &r) {
+            for (size_t c = r.begin(); c < r.end(); ++c) {
+                uint64_t *histogram = offsets.data() + c * npartitions;
+                const uint64_t end = std::min(n, (c + 1) * chunkSize);
+                for (uint64_t i = c * chunkSize; i < end; ++i)
+                    histogram[getPartition(hash(input[i].key1,
+                                input[i].key2))]++;
+            }
+        }, nthreads);
+
+    //Each chunk writes its tuples of a partition after the ones of the
+    //previous chunks
+    std::vector<uint64_t> bounds(npartitions + 1);
+    uint64_t sum = 0;
+    for (uint64_t p = 0; p < npartitions; ++p) {
+        bounds[p] = sum;
+        for (uint64_t c = 0; c < nchunks; ++c) {
+            const uint64_t count = offsets[c * npartitions + p];
+            offsets[c * npartitions + p] = sum;
+            sum += count;
+        }
+    }
+    bounds[npartitions] = sum;
+    tuples.resize(n);
+    ParallelTasks::parallel_for(0, nchunks, 1, [&](const ParallelRange &r) {
+            for (size_t c = r.begin(); c < r.end(); ++c) {
+                uint64_t *offset = offsets.data() + c * npartitions;
+                const uint64_t end = std::min(n, (c + 1) * chunkSize);
+                for (uint64_t i = c * chunkSize; i < end; ++i) {
+                    const uint64_t p = getPartition(hash(input[i].key1,
+                                input[i].key2));
+                    tuples[offset[p]++] = input[i];
+                }
+            }
+        }, nthreads);
+    std::vector<Tuple>().swap(input);
+
+    //Sort the partitions, so that the tuples with the same key are
+    //next to each other, and count their keys
+    std::vector<uint64_t> nkeysPartition(npartitions);
+    ParallelTasks::parallel_for(0, npartitions, 1, [&](const ParallelRange &r) {
+            for (size_t p = r.begin(); p < r.end(); ++p) {
+                Tuple *begin = tuples.data() + bounds[p];
+                Tuple *end = tuples.data() + bounds[p + 1];
+                std::sort(begin, end, lessKey);
+                uint64_t count = 0;
+                for (Tuple *t = begin; t < end; ++t)
+                    if (t == begin || t->key1 != t[-1].key1 ||
+                            t->key2 != t[-1].key2)
+                        count++;
+                nkeysPartition[p] = count;
+            }
+        }, nthreads);
+
+    //The tables are at most half full
+    partitions.resize(npartitions);
+    uint64_t nslots = 0;
+    for (uint64_t p = 0; p < npartitions; ++p) {
+        uint64_t size = 1;
+        while (size < 2 * nkeysPartition[p])
+            size <<= 1;
+        partitions[p].firstSlot = nslots;
+        partitions[p].mask = size - 1;
+        nslots += size;
+        nkeys += nkeysPartition[p];
+    }
+    slots.clear();
+    slots.resize(nslots);
+
+    //Fill the tables
+    ParallelTasks::parallel_for(0, npartitions, 1, [&](const ParallelRange &r) {
+            for (size_t p = r.begin(); p < r.end(); ++p) {
+                Slot *table = slots.data() + partitions[p].firstSlot;
+                const uint64_t mask = partitions[p].mask;
+                uint64_t i = bounds[p];
+                while (i < bounds[p + 1]) {
+                    const uint64_t begin = i;
+                    const Tuple &t = tuples[i];
+                    while (i < bounds[p + 1] && tuples[i].key1 == t.key1 &&
+                            tuples[i].key2 == t.key2)
+                        i++;
+                    uint64_t pos = hash(t.key1, t.key2) & mask;
+                    while (table[pos].count)
+                        pos = (pos + 1) & mask;
+                    table[pos].key1 = t.key1;
+                    table[pos].key2 = t.key2;
+                    table[pos].begin = begin;
+                    table[pos].count = i - begin;
+                }
+            }
+        }, nthreads);
+}
@@ -65,6 +65,59 @@ int64_t TridentUtils::getVmRSS() {
     return result;
 }
 
+int64_t TridentUtils::getPeakRSS() {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == NULL) {
+        return -1;
+    }
+    int64_t result = -1;
+    char line[128];
+
+    while (fgets(line, 128, file) != NULL){
+        if (strncmp(line, "VmHWM:", 6) == 0){
+            result = parseLine(line, 3);
+            break;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+int64_t TridentUtils::parseMemorySize(std::string size) {
+    if (size.empty()) {
+        return 0;
+    }
+    int64_t multiplier = 1;
+    char unit = size.back();
+    switch (unit) {
+        case 'k':
+        case 'K':
+            multiplier = (int64_t)1 << 10;
+            break;
+        case 'm':
+        case 'M':
+            multiplier = (int64_t)1 << 20;
+            break;
+        case 'g':
+        case 'G':
+            multiplier = (int64_t)1 << 30;
+            break;
+        case 't':
+        case 'T':
+            multiplier = (int64_t)1 << 40;
+            break;
+        default:
+            if (unit < '0' || unit > '9') {
+                LOG(ERRORL) << "Unit of the memory size " << size << " is not recognized";
+                throw 10;
+            }
+    }
+    if (multiplier != 1) {
+        size = size.substr(0, size.size() - 1);
+    }
+    return (int64_t)(TridentUtils::lexical_cast<double>(size) * multiplier);
+}
+
 static uint64_t lastTotalUser = 0, lastTotalUserLow = 0, lastTotalSys = 0, lastTotalIdle = 0;
 double TridentUtils::getCPUUsage() {
     double percent;
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <layers/TridentLayer.hpp>
+#include <rts/runtime/Runtime.hpp>
+#include <rts/operator/Batch.hpp>
+#include <rts/operator/Filter.hpp>
+#include <rts/operator/HashJoin.hpp>
+#include <rts/operator/Selection.hpp>
+#include <rts/operator/ValuesScan.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Runs a few operator trees over the first <nrows> triples of a KB one tuple
+//at the time and in batches, and checks that the two give the same rows.
+//The runtimes of the two modes are printed as a benchmark.
+//Usage: testBatch <kbdir> <nrows>
+typedef std::vector<uint64_t> TupleRow;
+
+//Builds a new tree, since the scans cannot be restarted
+typedef std::function<Operator*()> TreeBuilder;
+
+static std::vector<TupleRow> runTuples(Operator *op,
+        const std::vector<Register*> &regs) {
+    std::vector<TupleRow> rows;
+    for (uint64_t count = op->first(); count; count = op->next()) {
+        TupleRow row;
+        for (auto reg : regs)
+            row.push_back(reg->value);
+        row.push_back(count);
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+static std::vector<TupleRow> runBatches(Operator *op,
+        const std::vector<Register*> &regs) {
+    std::vector<TupleRow> rows;
+    Batch batch(regs);
+    for (unsigned size = op->firstBatch(batch); size;
+            size = op->nextBatch(batch)) {
+        for (unsigned index = 0; index < size; ++index) {
+            TupleRow row;
+            uint64_t count = batch.load(index);
+            for (auto reg : regs)
+                row.push_back(reg->value);
+            row.push_back(count);
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+static int compare(string name, TreeBuilder build,
+        const std::vector<Register*> &regs) {
+    std::unique_ptr<Operator> tuples(build());
+    auto start = std::chrono::system_clock::now();
+    std::vector<TupleRow> expected = runTuples(tuples.get(), regs);
+    std::chrono::duration<double> tupleTime =
+        std::chrono::system_clock::now() - start;
+
+    std::unique_ptr<Operator> batches(build());
+    start = std::chrono::system_clock::now();
+    std::vector<TupleRow> rows = runBatches(batches.get(), regs);
+    std::chrono::duration<double> batchTime =
+        std::chrono::system_clock::now() - start;
+
+    cout << name << ": " << expected.size() << " rows, tuples " <<
+        tupleTime.count() * 1000 << "ms, batches " <<
+        batchTime.count() * 1000 << "ms" << endl;
+
+    //The order of the rows is the same, but the batches can split the
+    //duplicates differently, so compare the sorted rows
+    std::sort(expected.begin(), expected.end());
+    std::sort(rows.begin(), rows.end());
+    if (rows != expected) {
+        cerr << name << ": the batches return " << rows.size() <<
+            " rows instead of " << expected.size() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nrows>" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    uint64_t nrows = atoll(argv[2]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer layer(kb);
+    Runtime runtime(layer);
+    runtime.allocateRegisters(5);
+    Register *s = runtime.getRegister(0);
+    Register *p = runtime.getRegister(1);
+    Register *o = runtime.getRegister(2);
+    Register *s2 = runtime.getRegister(3);
+    Register *o2 = runtime.getRegister(4);
+
+    //Collect the triples, as rows (s, p, o) and (o, s)
+    std::vector<uint64_t> spo, os;
+    {
+        std::unique_ptr<Querier> q(kb.query());
+        PairItr *itr = q->get(IDX_SPO, -1, -1, -1);
+        for (uint64_t i = 0; i < nrows && itr->hasNext(); ++i) {
+            itr->next();
+            spo.push_back(itr->getKey());
+            spo.push_back(itr->getValue1());
+            spo.push_back(itr->getValue2());
+            os.push_back(itr->getValue2());
+            os.push_back(itr->getKey());
+        }
+        q->releaseItr(itr);
+    }
+    const uint64_t n = spo.size() / 3;
+    cout << "Rows: " << n << endl;
+    if (n == 0)
+        return 1;
+
+    std::vector<Register*> spoRegs = {s, p, o};
+    std::vector<Register*> osRegs = {o2, s2};
+
+    //Every other distinct object
+    std::vector<uint64_t> objects;
+    for (uint64_t i = 0; i < n; ++i)
+        objects.push_back(spo[i * 3 + 2]);
+    std::sort(objects.begin(), objects.end());
+    objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+    std::vector<uint64_t> filterValues;
+    for (size_t i = 0; i < objects.size(); i += 2)
+        filterValues.push_back(objects[i]);
+    const uint64_t median = objects[objects.size() / 2];
+    const uint64_t predicate = spo[1];
+
+    int errors = 0;
+    errors += compare("Filter", [&]() -> Operator* {
+            return new Filter(new ValuesScan(spoRegs, spo, n), o,
+                    filterValues, false, n / 2);
+            }, spoRegs);
+    errors += compare("Filter (exclude)", [&]() -> Operator* {
+            return new Filter(new ValuesScan(spoRegs, spo, n), o,
+                    filterValues, true, n / 2);
+            }, spoRegs);
+    //The comparisons with a constant are vectorized
+    errors += compare("Selection (=)", [&]() -> Operator* {
+            return new Selection(new ValuesScan(spoRegs, spo, n), runtime,
+                    new Selection::Equal(new Selection::Variable(p),
+                        new Selection::ConstantLiteral(predicate)), n / 2);
+            }, spoRegs);
+    errors += compare("Selection (<)", [&]() -> Operator* {
+            return new Selection(new ValuesScan(spoRegs, spo, n), runtime,
+                    new Selection::Less(new Selection::Variable(o),
+                        new Selection::ConstantLiteral(median)), n / 2);
+            }, spoRegs);
+    //The subjects that are also objects. The probe side is read in batches
+    std::vector<Register*> joinRegs = {s, p, o, s2};
+    errors += compare("HashJoin", [&]() -> Operator* {
+            return new HashJoin(new ValuesScan(spoRegs, spo, n), s,
+                    std::vector<Register*>({p, o}),
+                    new ValuesScan(osRegs, os, n), o2,
+                    std::vector<Register*>({s2}), 0, 0, n, false, false, 0);
+            }, joinRegs);
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include <trident/kb/kb.h>
+#include <trident/sparql/aggrhandler.h>
+#include <layers/TridentLayer.hpp>
+#include <rts/runtime/Runtime.hpp>
+#include <rts/operator/AggrFunctions.hpp>
+#include <rts/operator/GroupBy.hpp>
+#include <rts/operator/HashGroupify.hpp>
+#include <rts/operator/IndexScan.hpp>
+#include <rts/operator/ParallelPipeline.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Groups the triples of a predicate by subject and counts the objects, i.e.,
+//SELECT ?s (COUNT(?o) AS ?c) { ?s <predicate> ?o } GROUP BY ?s
+//with the GroupBy and AggrFunctions operators (sort on the subjects), and
+//with HashGroupify with one thread, with <nthreads> threads and with a
+//memory budget of <budget> MB, so that it writes the groups to disk, and
+//checks that all return the same groups. All read the same scan of SPO,
+//which the threads split on the subjects. Meant for predicates with tens
+//of millions of distinct subjects.
+//Usage: testGroupify <kbdir> <predicate IRI> <nthreads> <budget>
+typedef std::vector<std::pair<uint64_t, uint64_t>> Groups;
+
+static Operator *scanPredicate(Runtime &runtime, uint64_t predicate) {
+    Register *predicateReg = runtime.getRegister(1);
+    predicateReg->value = predicate;
+    return IndexScan::create(runtime.getDatabase(),
+            DBLayer::Order_Subject_Predicate_Object,
+            runtime.getRegister(0), false, predicateReg, true,
+            runtime.getRegister(2), false, 0);
+}
+
+//Returns the subject and the encoded count of every group
+static Groups run(const string &name, Operator *op, Register *subject,
+        Register *count) {
+    auto start = std::chrono::system_clock::now();
+    Groups groups;
+    for (uint64_t n = op->first(); n; n = op->next())
+        groups.push_back(std::make_pair(subject->value, count->value));
+    std::chrono::duration<double> duration =
+        std::chrono::system_clock::now() - start;
+    cout << name << ": " << duration.count() * 1000 << "ms (" <<
+        groups.size() << " groups)" << endl;
+    delete op;
+    std::sort(groups.begin(), groups.end());
+    return groups;
+}
+
+static int compare(const string &name, const Groups &groups,
+        const Groups &expected) {
+    if (groups == expected)
+        return 0;
+    size_t i = 0;
+    while (i < groups.size() && i < expected.size() && groups[i] == expected[i])
+        i++;
+    cerr << name << ": " << groups.size() << " groups instead of " <<
+        expected.size() << ", the first difference is at group " << i << endl;
+    return 1;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <predicate IRI> <nthreads> <budget>" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    unsigned nthreads = atoi(argv[3]);
+    uint64_t budget = (uint64_t)atoll(argv[4]) * 1024 * 1024;
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer layer(kb);
+    uint64_t predicate;
+    if (!layer.lookup(argv[2], ::Type::URI, 0, predicate)) {
+        cerr << "Predicate " << argv[2] << " not found" << endl;
+        return 1;
+    }
+
+    //Registers: 0 the subject, 1 the predicate, 2 the object, 3 the count
+    Runtime runtime(layer);
+    runtime.allocateRegisters(4);
+    Register *subject = runtime.getRegister(0);
+    Register *object = runtime.getRegister(2);
+    Register *count = runtime.getRegister(3);
+
+    //The subjects of SPO are sorted, count the objects of every subject
+    Groups expected;
+    {
+        AggregateHandler hdl(2);
+        std::vector<unsigned> signature(1, 1);
+        unsigned output = hdl.getNewOrExistingVar(AggregateHandler::COUNT,
+                signature);
+        std::map<unsigned, Register*> bindings;
+        bindings[0] = subject;
+        bindings[1] = object;
+        std::vector<unsigned> groupKeys(1, 0);
+        Operator *groupBy = new GroupBy(scanPredicate(runtime, predicate),
+                bindings, groupKeys, false, 0);
+        bindings[output] = count;
+        expected = run("GroupBy+AggrFunctions", new AggrFunctions(layer,
+                    groupBy, bindings, hdl, groupKeys, 0), subject, count);
+    }
+
+    std::vector<Register*> keys(1, subject);
+    std::vector<HashGroupify::Aggregate> aggregates(1);
+    aggregates[0].function = HashGroupify::Aggregate::Count;
+    aggregates[0].input = object;
+    aggregates[0].output = count;
+
+    //One thread
+    int errors = compare("HashGroupify", run("HashGroupify",
+                new HashGroupify(scanPredicate(runtime, predicate), keys,
+                    aggregates, layer, 0), subject, count), expected);
+
+    //Every thread scans a range of subjects of SPO and aggregates it in its
+    //own table
+    {
+        std::vector<ParallelPipeline::Worker> workers(nthreads);
+        for (auto &worker : workers) {
+            worker.db = layer.createWorker();
+            worker.runtime.reset(new Runtime(*worker.db));
+            worker.runtime->allocateRegisters(4);
+            worker.tree = scanPredicate(*worker.runtime, predicate);
+            worker.driver = worker.tree;
+            worker.output.push_back(worker.runtime->getRegister(0));
+            worker.output.push_back(worker.runtime->getRegister(2));
+        }
+        std::vector<Register*> output;
+        output.push_back(subject);
+        output.push_back(object);
+        Operator *pipeline = new ParallelPipeline(workers, output,
+                layer.getNextId(), 8 * nthreads, 0);
+        string name = "HashGroupify, " + to_string(nthreads) + " threads";
+        errors += compare(name, run(name, new HashGroupify(pipeline, keys,
+                        aggregates, layer, 0, nthreads), subject, count),
+                expected);
+    }
+
+    //The groups do not fit in memory
+    string name = "HashGroupify, " + to_string(budget >> 20) + "MB";
+    errors += compare(name, run(name, new HashGroupify(scanPredicate(runtime,
+                        predicate), keys, aggregates, layer, 0, 1, budget),
+                subject, count), expected);
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/dictmgmt.h>
+#include <trident/sparql/plancache.h>
+#include <layers/TridentLayer.hpp>
+#include <cts/parser/SPARQLLexer.hpp>
+#include <cts/parser/SPARQLParser.hpp>
+#include <cts/semana/SemanticAnalysis.hpp>
+#include <rts/runtime/QueryDict.hpp>
+#include <kognac/consts.h>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Checks the cache of the query plans: the keys of the queries, the copy of
+//the constants into a cached query graph, the binding of the parameters of
+//a prepared query, and the hits, misses, evictions and invalidations of the
+//cache. The constants are the first two subjects and the first predicate of
+//the KB.
+//Usage: testPlanCache <kbdir>
+static int errors = 0;
+
+static void check(bool condition, const string &what) {
+    if (!condition) {
+        cerr << "Failed: " << what << endl;
+        errors++;
+    }
+}
+
+static string getKey(const string &query) {
+    SPARQLLexer lexer(query);
+    SPARQLParser parser(lexer);
+    parser.parse(false, true);
+    return PlanCache::getKey(query, parser.getConstants());
+}
+
+static std::unique_ptr<QueryGraph> getQueryGraph(TridentLayer &layer,
+        const string &query) {
+    QueryDict queryDict(layer.getNextId());
+    SPARQLLexer lexer(query);
+    SPARQLParser parser(lexer);
+    parser.parse(false, true);
+    std::unique_ptr<QueryGraph> graph(new QueryGraph(parser.getVarCount()));
+    SemanticAnalysis semana(layer, queryDict);
+    semana.transform(parser, *graph.get());
+    return graph;
+}
+
+static void checkKeys(const string &s1, const string &s2, const string &p) {
+    //The whitespace, the comments and the constants do not matter
+    const string query = "SELECT ?o WHERE { " + s1 + " " + p + " ?o }";
+    check(getKey(query) == getKey("SELECT  ?o\nWHERE {" + s1 + " " + p +
+                " ?o } # all objects"),
+            "the whitespace and the comments change the key");
+    check(getKey(query) == getKey("SELECT ?o WHERE { " + s2 + " " + p +
+                " ?o }"), "the constants change the key");
+    //The variables, the shape and the constants outside of the triple
+    //patterns do
+    check(getKey(query) != getKey("SELECT ?x WHERE { " + s1 + " " + p +
+                " ?x }"), "the variables do not change the key");
+    check(getKey(query) != getKey("SELECT ?o WHERE { ?o " + p + " " + s1 +
+                " }"), "the position of the constants does not change the key");
+    check(getKey("SELECT ?o WHERE { ?s " + p + " ?o FILTER(?s = " + s1 +
+                ") }") != getKey("SELECT ?o WHERE { ?s " + p +
+                " ?o FILTER(?s = " + s2 + ") }"),
+            "the constants of the filters do not change the key");
+}
+
+static void checkCopyConstants(TridentLayer &layer, const string &s1,
+        const string &s2, const string &p) {
+    const string unknown = "<http://example.org/not/in/the/kb>";
+    std::unique_ptr<QueryGraph> cached = getQueryGraph(layer,
+            "SELECT ?o WHERE { " + s1 + " " + p + " ?o }");
+    std::unique_ptr<QueryGraph> other = getQueryGraph(layer,
+            "SELECT ?o WHERE { " + s2 + " " + p + " ?o }");
+    check(PlanCache::copyConstants(*other.get(), *cached.get()) &&
+            cached->getQuery().nodes[0].subject ==
+            other->getQuery().nodes[0].subject,
+            "the constants of the same shape are not copied");
+
+    //A constant that is not in the KB makes the query empty
+    std::unique_ptr<QueryGraph> empty = getQueryGraph(layer,
+            "SELECT ?o WHERE { " + unknown + " " + p + " ?o }");
+    check(!PlanCache::copyConstants(*empty.get(), *cached.get()),
+            "the constants of an empty query are copied");
+
+    //Or drops the optional part that contains it
+    std::unique_ptr<QueryGraph> optional = getQueryGraph(layer,
+            "SELECT ?o ?x WHERE { " + s1 + " " + p + " ?o OPTIONAL { ?o " +
+            p + " ?x } }");
+    std::unique_ptr<QueryGraph> dropped = getQueryGraph(layer,
+            "SELECT ?o ?x WHERE { " + s1 + " " + p + " ?o OPTIONAL { ?o " +
+            unknown + " ?x } }");
+    check(!PlanCache::copyConstants(*dropped.get(), *optional.get()),
+            "the constants are copied without the optional part");
+}
+
+static void checkBind(const string &s1, const string &p) {
+    PreparedQuery prepared("SELECT ?o WHERE { " + s1 + " " + p + " ?o }");
+    check(prepared.getNParameters() == 2, "the query has not 2 parameters");
+    string query;
+    check(prepared.bind({s1, p}, query) && getKey(query) ==
+            getKey("SELECT ?o WHERE { " + s1 + " " + p + " ?o }"),
+            "the bound query differs from the original");
+    check(prepared.bind({"ex:a", "a"}, query),
+            "the prefixed names are not terms");
+    check(!prepared.bind({s1}, query), "too few parameters are bound");
+    check(!prepared.bind({s1, p + " ?o . ?s"}, query),
+            "a parameter with a triple pattern is bound");
+
+    PreparedQuery literal("SELECT ?s WHERE { ?s " + p + " \"a\" }");
+    check(literal.bind({"\"b\"@en"}, query) &&
+            literal.bind({"\"b\"^^<http://www.w3.org/2001/XMLSchema#string>"},
+                query), "the literals are not terms");
+    check(literal.bind({"42"}, query) && literal.bind({"4.2"}, query) &&
+            literal.bind({"4.2e1"}, query), "the numbers are not terms");
+    check(!literal.bind({"?x"}, query), "a variable is a term");
+}
+
+static void checkCache() {
+    PlanCache cache(2);
+    std::shared_ptr<PlanCache::Entry> e1(new PlanCache::Entry());
+    std::shared_ptr<PlanCache::Entry> e2(new PlanCache::Entry());
+    std::shared_ptr<PlanCache::Entry> e3(new PlanCache::Entry());
+
+    check(cache.get("k1", 0) == NULL, "an empty cache has a plan");
+    cache.put("k1", 0, e1);
+    check(cache.get("k1", 0) == e1, "the plan is not cached");
+    check(cache.getHits() == 1 && cache.getMisses() == 1,
+            "the hits and misses are not counted");
+
+    //The least recently used plan is evicted
+    cache.put("k2", 0, e2);
+    cache.get("k1", 0);
+    cache.put("k3", 0, e3);
+    check(cache.size() == 2 && cache.get("k2", 0) == NULL &&
+            cache.get("k1", 0) == e1 && cache.get("k3", 0) == e3,
+            "the least recently used plan is not evicted");
+
+    //A new version of the KB drops the plans
+    check(cache.get("k1", 1) == NULL && cache.size() == 0,
+            "the plans of the old version are kept");
+    cache.put("k1", 1, e1);
+    check(cache.get("k1", 1) == e1, "the plan of the new version is not cached");
+
+    //A query planned on an older version does not drop the new plans
+    cache.put("k2", 0, e2);
+    check(cache.get("k2", 0) == NULL && cache.get("k2", 1) == NULL &&
+            cache.get("k1", 1) == e1,
+            "the plan of an old version replaces the new plans");
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <kbdir>" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+
+    KBConfig config;
+    //The constants are read from the dictionary
+    KB kb(argv[1], true, false, true, config);
+    TridentLayer layer(kb);
+
+    //Two subjects and a predicate of the KB
+    std::vector<string> subjects;
+    string predicate;
+    {
+        char buffer[MAX_TERM_SIZE];
+        DictMgmt *dict = kb.getDictMgmt();
+        std::unique_ptr<Querier> q(kb.query());
+        PairItr *itr = q->get(IDX_SPO, -1, -1, -1);
+        int64_t last = -1;
+        while (subjects.size() < 2 && itr->hasNext()) {
+            itr->next();
+            if (itr->getKey() == last)
+                continue;
+            last = itr->getKey();
+            dict->getText(last, buffer);
+            subjects.push_back(buffer);
+            if (predicate.empty()) {
+                dict->getText(itr->getValue1(), buffer);
+                predicate = buffer;
+            }
+        }
+        q->releaseItr(itr);
+    }
+    if (subjects.size() < 2) {
+        cerr << "The KB has less than two subjects" << endl;
+        return 1;
+    }
+
+    checkKeys(subjects[0], subjects[1], predicate);
+    checkCopyConstants(layer, subjects[0], subjects[1], predicate);
+    checkBind(subjects[0], predicate);
+    checkCache();
+    cout << errors << " errors" << endl;
+    return errors > 0 ? 1 : 0;
+}
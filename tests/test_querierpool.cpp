@@ -0,0 +1,99 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/querierpool.h>
+#include <trident/kb/dictmgmt.h>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Runs many concurrent get/getCard calls and dictionary lookups on one KB
+//through the querier pool and compares them with the results of a single
+//thread.
+//Usage: testQuerierPool <kbdir> <nthreads> <ncalls per thread>
+struct Expected {
+    int64_t key;
+    int64_t cards[3];
+    int64_t nrows;
+    string text;
+};
+
+static void compute(Querier *q, DictMgmt *dict, Expected &e) {
+    e.cards[0] = q->getCard(e.key, -1, -1);
+    e.cards[1] = q->getCard(-1, e.key, -1);
+    e.cards[2] = q->getCard(-1, -1, e.key);
+    e.nrows = 0;
+    PairItr *itr = q->get(IDX_SPO, e.key, -1, -1);
+    while (itr->hasNext()) {
+        itr->next();
+        e.nrows++;
+    }
+    q->releaseItr(itr);
+    if (dict && !dict->getText(e.key, e.text)) {
+        e.text.clear();
+    }
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nthreads> <ncalls>" << endl;
+        return 1;
+    }
+    int nthreads = atoi(argv[2]);
+    int64_t ncalls = atoll(argv[3]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, true, config);
+    DictMgmt *dict = kb.getDictMgmt();
+
+    //Reference results
+    std::vector<Expected> expected(1000);
+    std::mt19937_64 gen(42);
+    std::uniform_int_distribution<int64_t> keys(0, max((int64_t) 1, (int64_t) kb.getNTerms() - 1));
+    {
+        std::unique_ptr<Querier> q(kb.query());
+        for (auto &e : expected) {
+            e.key = keys(gen);
+            compute(q.get(), dict, e);
+        }
+    }
+
+    std::atomic<int64_t> errors(0);
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i) {
+        threads.push_back(std::thread([&, i]() {
+            std::mt19937_64 g(i);
+            std::uniform_int_distribution<size_t> pick(0, expected.size() - 1);
+            for (int64_t j = 0; j < ncalls;) {
+                //Acquire a handle every few calls to exercise the pool
+                QuerierPool::Handle q = kb.getQuerierPool().acquire();
+                for (int k = 0; k < 10 && j < ncalls; ++k, ++j) {
+                    Expected &e = expected[pick(g)];
+                    Expected r;
+                    r.key = e.key;
+                    compute(q.get(), dict, r);
+                    if (r.cards[0] != e.cards[0] || r.cards[1] != e.cards[1] ||
+                            r.cards[2] != e.cards[2] || r.nrows != e.nrows ||
+                            r.text != e.text) {
+                        errors++;
+                    }
+                }
+            }
+        }));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+
+    LOG(INFOL) << "Threads " << nthreads << " calls " << nthreads * ncalls <<
+        " runtime " << sec.count() * 1000 << " ms. errors " << errors;
+    return errors > 0 ? 1 : 0;
+}
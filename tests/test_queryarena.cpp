@@ -0,0 +1,80 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include <trident/kb/kb.h>
+#include <trident/sparql/sparql.h>
+#include <layers/TridentLayer.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Runs a set of SPARQL queries with and without the query arena and reports
+//how many heap allocations every execution does.
+//Usage: testQueryArena <kbdir> <nruns> <query file> [<query file> ...]
+static std::atomic<uint64_t> nmallocs(0);
+
+void *operator new(size_t size) {
+    nmallocs++;
+    void *p = malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+static void run(TridentLayer &layer, KB &kb, const string &query, int nruns,
+        uint64_t &mallocs, double &ms) {
+    //Warm up the caches of the querier
+    SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer, false,
+            false, NULL, NULL, NULL);
+    uint64_t start = nmallocs;
+    auto startTime = std::chrono::system_clock::now();
+    for (int i = 0; i < nruns; ++i) {
+        SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer,
+                false, false, NULL, NULL, NULL);
+    }
+    std::chrono::duration<double> duration =
+        std::chrono::system_clock::now() - startTime;
+    mallocs = (nmallocs - start) / nruns;
+    ms = duration.count() * 1000 / nruns;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nruns> <query file> ..." << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    int nruns = atoi(argv[2]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer withArena(kb);
+    TridentLayer withoutArena(kb);
+    withoutArena.disableArena();
+
+    cout << "query\tmallocs (heap)\tmallocs (arena)\tms (heap)\tms (arena)" << endl;
+    for (int i = 3; i < argc; ++i) {
+        std::ifstream f(argv[i]);
+        std::stringstream buffer;
+        buffer << f.rdbuf();
+        string query = buffer.str();
+
+        uint64_t mallocsHeap, mallocsArena;
+        double msHeap, msArena;
+        run(withoutArena, kb, query, nruns, mallocsHeap, msHeap);
+        run(withArena, kb, query, nruns, mallocsArena, msArena);
+        cout << argv[i] << "\t" << mallocsHeap << "\t" << mallocsArena << "\t"
+            << msHeap << "\t" << msArena << endl;
+    }
+    return 0;
+}
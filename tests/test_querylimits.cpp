@@ -0,0 +1,66 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include <trident/kb/kb.h>
+#include <trident/sparql/sparql.h>
+#include <layers/TridentLayer.hpp>
+#include <rts/runtime/QueryContext.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Checks that the limits of a query stop it: a cross product of all the
+//triples with a timeout of <timeout> ms, and the sort of all the triples
+//with a memory limit of 1 KB, which is less than a single run of the sort.
+//A query without limits must complete.
+//Usage: testQueryLimits <kbdir> [<timeout>]
+static QueryContext::Reason run(TridentLayer &layer, KB &kb,
+        const string &name, const string &query, uint64_t timeout,
+        uint64_t memoryLimit) {
+    QueryContext context;
+    context.setTimeout(timeout);
+    context.setMemoryLimit(memoryLimit);
+    auto start = std::chrono::system_clock::now();
+    SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer, false,
+            false, NULL, NULL, NULL, &context);
+    std::chrono::duration<double> duration =
+        std::chrono::system_clock::now() - start;
+    cout << name << ": " << duration.count() * 1000 << "ms, " <<
+        (context.getReason() == QueryContext::None ? "completed" :
+         context.getMessage()) << endl;
+    return context.getReason();
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <kbdir> [<timeout>]" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(ERRORL);
+    uint64_t timeout = argc > 2 ? atoll(argv[2]) : 100;
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer layer(kb);
+
+    int errors = 0;
+    if (run(layer, kb, "No limits", "SELECT ?s WHERE { ?s ?p ?o } LIMIT 10",
+                0, 0) != QueryContext::None) {
+        cerr << "The query without limits was stopped" << endl;
+        errors++;
+    }
+    if (run(layer, kb, "Timeout",
+                "SELECT * WHERE { ?a ?b ?c . ?d ?e ?f }", timeout, 0) !=
+            QueryContext::Timeout) {
+        cerr << "The cross product was not stopped by the timeout" << endl;
+        errors++;
+    }
+    if (run(layer, kb, "Memory limit",
+                "SELECT ?s ?o WHERE { ?s ?p ?o } ORDER BY ?o", 0, 1024) !=
+            QueryContext::MemoryLimit) {
+        cerr << "The sort was not stopped by the memory limit" << endl;
+        errors++;
+    }
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <random>
+
+#include <trident/utils/radixjoin.h>
+#include <rts/operator/HashJoin.hpp>
+#include <rts/operator/ValuesScan.hpp>
+#include <rts/runtime/Runtime.hpp>
+
+using namespace std;
+
+//Checks the hash table of the joins and the hash join of rdf3x. The table
+//is built with one and four threads over random keys, and every key is
+//looked up. The join is run in memory and with a tiny memory budget, so
+//that it spills and splits the partition of a skewed key, for inner, left-
+//and right-optional joins, and compared with a nested loop join.
+//Usage: testRadixJoin [<ntuples>]
+static const uint64_t NULLVALUE = ~0u;
+
+static int checkTable(uint64_t ntuples, int nthreads) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint64_t> keys(0, ntuples / 4);
+    std::vector<RadixJoinTable::Tuple> tuples;
+    std::map<std::pair<uint64_t, uint64_t>, std::vector<uint64_t>> expected;
+    for (uint64_t i = 0; i < ntuples; ++i) {
+        RadixJoinTable::Tuple t;
+        t.key1 = keys(gen);
+        t.key2 = t.key1 % 3;
+        t.payload = i;
+        tuples.push_back(t);
+        expected[std::make_pair(t.key1, t.key2)].push_back(i);
+    }
+
+    RadixJoinTable table;
+    table.build(tuples, nthreads);
+    int errors = 0;
+    if (table.getNKeys() != expected.size() ||
+            table.getTuples().size() != ntuples) {
+        cerr << "The table with " << nthreads << " threads has " <<
+            table.getNKeys() << " keys and " << table.getTuples().size() <<
+            " tuples instead of " << expected.size() << " and " <<
+            ntuples << endl;
+        errors++;
+    }
+    for (auto &entry : expected) {
+        uint64_t count;
+        const RadixJoinTable::Tuple *t = table.find(entry.first.first,
+                entry.first.second, count);
+        std::vector<uint64_t> payloads;
+        for (uint64_t i = 0; i < count; ++i)
+            payloads.push_back(t[i].payload);
+        std::sort(payloads.begin(), payloads.end());
+        if (payloads != entry.second) {
+            errors++;
+        }
+    }
+    //Keys that are not in the table
+    for (uint64_t key = ntuples; key < ntuples + 1000; ++key) {
+        uint64_t count;
+        table.find(key, key % 3, count);
+        if (count != 0)
+            errors++;
+    }
+    cout << "Table with " << nthreads << " threads: " << table.getNKeys() <<
+        " keys, " << errors << " errors" << endl;
+    return errors;
+}
+
+typedef std::vector<uint64_t> JoinRow;
+
+//Rows are the key, the left value, the right value and the count
+static std::vector<JoinRow> nestedLoopJoin(const std::vector<uint64_t> &left,
+        const std::vector<uint64_t> &right, bool leftOptional,
+        bool rightOptional) {
+    std::vector<JoinRow> rows;
+    std::vector<bool> leftJoined(left.size() / 2);
+    for (size_t r = 0; r < right.size(); r += 2) {
+        bool joined = false;
+        for (size_t l = 0; l < left.size(); l += 2) {
+            if (left[l] == right[r]) {
+                rows.push_back(JoinRow({right[r], left[l + 1], right[r + 1], 1}));
+                joined = true;
+                leftJoined[l / 2] = true;
+            }
+        }
+        if (!joined && leftOptional)
+            rows.push_back(JoinRow({right[r], NULLVALUE, right[r + 1], 1}));
+    }
+    if (rightOptional) {
+        for (size_t l = 0; l < left.size(); l += 2)
+            if (!leftJoined[l / 2])
+                rows.push_back(JoinRow({left[l], left[l + 1], NULLVALUE, 1}));
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+static std::vector<JoinRow> hashJoin(const std::vector<uint64_t> &left,
+        const std::vector<uint64_t> &right, bool leftOptional,
+        bool rightOptional, uint64_t memoryBudget) {
+    Register leftKey, leftValue, rightKey, rightValue;
+    leftKey.reset();
+    leftValue.reset();
+    rightKey.reset();
+    rightValue.reset();
+    std::vector<Register*> leftRegs = {&leftKey, &leftValue};
+    std::vector<Register*> rightRegs = {&rightKey, &rightValue};
+    HashJoin join(new ValuesScan(leftRegs, left, left.size() / 2), &leftKey,
+            std::vector<Register*>({&leftValue}),
+            new ValuesScan(rightRegs, right, right.size() / 2), &rightKey,
+            std::vector<Register*>({&rightValue}), 0, 0, right.size() / 2,
+            leftOptional, rightOptional, 0, 1, memoryBudget);
+    std::vector<JoinRow> rows;
+    for (uint64_t count = join.first(); count; count = join.next()) {
+        //The key of a tuple without a join partner is on its own side
+        uint64_t key = leftValue.value == NULLVALUE ? rightKey.value :
+            leftKey.value;
+        rows.push_back(JoinRow({key, leftValue.value, rightValue.value,
+                    count}));
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+static int checkJoin(uint64_t ntuples) {
+    //One key has a third of the left tuples, so that its partition does not
+    //fit in the budget
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint64_t> leftKeys(0, ntuples / 4);
+    std::uniform_int_distribution<uint64_t> rightKeys(ntuples / 8,
+            ntuples / 2);
+    std::vector<uint64_t> left, right;
+    for (uint64_t i = 0; i < ntuples; ++i) {
+        left.push_back(i % 3 == 0 ? ntuples / 5 : leftKeys(gen));
+        left.push_back(i);
+    }
+    for (uint64_t i = 0; i < ntuples; ++i) {
+        right.push_back(rightKeys(gen));
+        right.push_back(ntuples + i);
+    }
+
+    //The budget holds a few hundred tuples
+    const uint64_t budget = 300 * (2 * sizeof(uint64_t) +
+            RadixJoinTable::getBytesPerTuple());
+    int errors = 0;
+    const char *names[] = {"inner", "left optional", "right optional"};
+    for (int optional = 0; optional < 3; ++optional) {
+        std::vector<JoinRow> expected = nestedLoopJoin(left, right,
+                optional == 1, optional == 2);
+        std::vector<JoinRow> inMemory = hashJoin(left, right,
+                optional == 1, optional == 2, 0);
+        std::vector<JoinRow> spilled = hashJoin(left, right,
+                optional == 1, optional == 2, budget);
+        cout << "Join (" << names[optional] << "): " << expected.size() <<
+            " rows" << endl;
+        if (inMemory != expected) {
+            cerr << "The join (" << names[optional] << ") in memory returns "
+                << inMemory.size() << " rows instead of " <<
+                expected.size() << endl;
+            errors++;
+        }
+        if (spilled != expected) {
+            cerr << "The spilled join (" << names[optional] << ") returns "
+                << spilled.size() << " rows instead of " <<
+                expected.size() << endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, const char** argv) {
+    uint64_t ntuples = argc > 1 ? atoll(argv[1]) : 100000;
+    int errors = checkTable(ntuples, 1) + checkTable(ntuples, 4);
+    //The nested loop join is quadratic
+    errors += checkJoin(std::min(ntuples, (uint64_t) 5000));
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <layers/TridentLayer.hpp>
+#include <rts/runtime/Runtime.hpp>
+#include <rts/operator/HashJoin.hpp>
+#include <rts/operator/IndexScan.hpp>
+#include <rts/operator/ValuesScan.hpp>
+#include <infra/util/SemiJoinFilter.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Joins a set of subjects of a KB with scans of the KB, once with the keys
+//of the hash join pushed into the scan and once without, and checks that
+//the two give the same rows. The scans have the keys in the first and in
+//the second column, a bound prefix and a key range, and the joins are also
+//run with an optional side, which must not push the keys. The key sets are
+//small (sorted arrays) and, if the KB has enough subjects, large (Bloom
+//filters).
+//Usage: testSemiJoin <kbdir> <nrows>
+typedef std::vector<uint64_t> JoinRow;
+
+struct Registers {
+    Register *key, *s, *p, *o;
+};
+
+//Builds the scan of the right side
+typedef std::function<Operator*(Registers&)> ScanBuilder;
+
+static std::vector<JoinRow> join(Registers &regs,
+        const std::vector<uint64_t> &keys, ScanBuilder scan, int bitset,
+        bool leftOptional) {
+    std::vector<Register*> keyRegs = {regs.key};
+    std::vector<Register*> tail = {regs.p, regs.o};
+    HashJoin op(new ValuesScan(keyRegs, keys, keys.size()), regs.key,
+            std::vector<Register*>(), scan(regs), regs.s, tail, 0, 0,
+            keys.size(), leftOptional, false, bitset);
+    std::vector<JoinRow> rows;
+    for (uint64_t count = op.first(); count; count = op.next()) {
+        JoinRow row = {regs.s->value, regs.p->value, regs.o->value, count};
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+static int compare(string name, Registers &regs,
+        const std::vector<uint64_t> &keys, ScanBuilder scan) {
+    int errors = 0;
+    for (int optional = 0; optional < 2; ++optional) {
+        std::vector<JoinRow> expected = join(regs, keys, scan, 0, optional);
+        //The subject is the key
+        std::vector<JoinRow> rows = join(regs, keys, scan, 1, optional);
+        cout << name << (optional ? " (optional)" : "") << ", " <<
+            keys.size() << " keys: " << expected.size() << " rows" << endl;
+        if (rows != expected) {
+            cerr << name << (optional ? " (optional)" : "") <<
+                ": the join returns " << rows.size() << " rows with the keys"
+                " in the scan instead of " << expected.size() << endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nrows>" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    uint64_t nrows = atoll(argv[2]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer layer(kb);
+    Runtime runtime(layer);
+    runtime.allocateRegisters(4);
+    Registers regs;
+    regs.key = runtime.getRegister(0);
+    regs.s = runtime.getRegister(1);
+    regs.p = runtime.getRegister(2);
+    regs.o = runtime.getRegister(3);
+
+    //The distinct subjects of the first triples and the first predicate
+    std::vector<uint64_t> subjects;
+    uint64_t predicate = 0;
+    {
+        std::unique_ptr<Querier> q(kb.query());
+        PairItr *itr = q->get(IDX_SPO, -1, -1, -1);
+        for (uint64_t i = 0; i < nrows && itr->hasNext(); ++i) {
+            itr->next();
+            if (i == 0)
+                predicate = itr->getValue1();
+            if (subjects.empty() || subjects.back() != itr->getKey())
+                subjects.push_back(itr->getKey());
+        }
+        q->releaseItr(itr);
+    }
+    if (subjects.empty())
+        return 1;
+
+    //Every seventh subject is few enough for a sorted array, all of them
+    //need a Bloom filter if there are enough
+    std::vector<std::vector<uint64_t>> keySets(1);
+    for (size_t i = 0; i < subjects.size(); i += 7)
+        keySets[0].push_back(subjects[i]);
+    if (subjects.size() > SemiJoinFilter::maxSortedKeys)
+        keySets.push_back(subjects);
+    const uint64_t rangeFrom = subjects[subjects.size() / 4];
+    const uint64_t rangeTo = subjects[subjects.size() / 2];
+
+    int errors = 0;
+    for (auto &keys : keySets) {
+        //The keys are the first column
+        errors += compare("SPO", regs, keys, [&](Registers &r) -> Operator* {
+                return IndexScan::create(layer,
+                        DBLayer::Order_Subject_Predicate_Object,
+                        r.s, false, r.p, false, r.o, false, 0);
+                });
+        //The keys are the second column
+        errors += compare("PSO", regs, keys, [&](Registers &r) -> Operator* {
+                return IndexScan::create(layer,
+                        DBLayer::Order_Predicate_Subject_Object,
+                        r.s, false, r.p, false, r.o, false, 0);
+                });
+        //The keys are the second column, after a bound predicate
+        errors += compare("PSO with a bound predicate", regs, keys,
+                [&](Registers &r) -> Operator* {
+                r.p->value = predicate;
+                return IndexScan::create(layer,
+                        DBLayer::Order_Predicate_Subject_Object,
+                        r.s, false, r.p, true, r.o, false, 0);
+                });
+        //The keys are the first column of a morsel
+        errors += compare("SPO in a key range", regs, keys,
+                [&](Registers &r) -> Operator* {
+                IndexScan *scan = IndexScan::create(layer,
+                        DBLayer::Order_Subject_Predicate_Object,
+                        r.s, false, r.p, false, r.o, false, 0);
+                scan->setKeyRange(rangeFrom, rangeTo);
+                return scan;
+                });
+    }
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstring>
+
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/dictmgmt.h>
+#include <layers/TridentLayer.hpp>
+#include <rts/runtime/Runtime.hpp>
+#include <rts/operator/Sort.hpp>
+#include <rts/operator/ValuesScan.hpp>
+#include <kognac/consts.h>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Sorts the objects of the first <nrows> triples of a KB (ORDER BY ?o)
+//with a comparator that looks up both strings at every comparison, as the
+//Sort operator used to do, and with the Sort operator, and checks that the
+//two orders are the same, ascending and descending.
+//Usage: testSortKeys <kbdir> <nrows>
+struct LookupLess {
+    DBLayer &dict;
+    std::unique_ptr<char[]> buffer1, buffer2;
+    uint64_t nlookups;
+
+    LookupLess(DBLayer &dict) : dict(dict), buffer1(new char[MAX_TERM_SIZE]),
+    buffer2(new char[MAX_TERM_SIZE]), nlookups(0) {}
+
+    bool operator()(uint64_t v1, uint64_t v2) {
+        if (v1 == v2)
+            return false;
+        if (DictMgmt::isnumeric(v1) && DictMgmt::isnumeric(v2)) {
+            return DictMgmt::compare(DictMgmt::getType(v1), v1,
+                    DictMgmt::getType(v2), v2) < 0;
+        }
+        size_t len1, len2;
+        ::Type::ID type1, type2;
+        unsigned subType1, subType2;
+        nlookups += 2;
+        //The values that are not in the dictionary go last, ordered by id
+        bool found1 = dict.lookupById(v1, buffer1.get(), len1, type1, subType1);
+        bool found2 = dict.lookupById(v2, buffer2.get(), len2, type2, subType2);
+        if (found1 != found2)
+            return found1;
+        if (!found1)
+            return v1 < v2;
+        if (type1 != type2)
+            return type1 < type2;
+        if (::Type::hasSubType(type1) && subType1 != subType2)
+            return subType1 < subType2;
+        int c = memcmp(buffer1.get(), buffer2.get(), min(len1, len2));
+        if (c != 0)
+            return c < 0;
+        if (len1 != len2)
+            return len1 < len2;
+        return v1 < v2;
+    }
+};
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nrows>" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    uint64_t nrows = atoll(argv[2]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer layer(kb);
+
+    //Collect the objects
+    std::vector<uint64_t> objects;
+    {
+        std::unique_ptr<Querier> q(kb.query());
+        PairItr *itr = q->get(IDX_SPO, -1, -1, -1);
+        while (objects.size() < nrows && itr->hasNext()) {
+            itr->next();
+            objects.push_back(itr->getValue2());
+        }
+        q->releaseItr(itr);
+    }
+    cout << "Rows: " << objects.size() << endl;
+
+    //Compare the strings at every comparison
+    std::vector<uint64_t> expected = objects;
+    {
+        LookupLess less(layer);
+        auto start = std::chrono::system_clock::now();
+        std::sort(expected.begin(), expected.end(), std::ref(less));
+        std::chrono::duration<double> duration =
+            std::chrono::system_clock::now() - start;
+        cout << "Lookups in the comparator: " << duration.count() * 1000
+            << "ms (" << less.nlookups << " lookups)" << endl;
+    }
+
+    //Sort operator, on the ranks of the values
+    int errors = 0;
+    for (int descending = 0; descending < 2; ++descending) {
+        Register reg;
+        reg.reset();
+        std::vector<Register*> regs;
+        regs.push_back(&reg);
+        std::vector<std::pair<Register*, bool>> order;
+        order.push_back(std::make_pair(&reg, descending == 1));
+        Sort sort(layer, new ValuesScan(regs, objects, objects.size()), regs,
+                order, objects.size());
+        std::vector<uint64_t> sorted;
+        auto start = std::chrono::system_clock::now();
+        for (uint64_t count = sort.first(); count; count = sort.next())
+            sorted.insert(sorted.end(), count, reg.value);
+        std::chrono::duration<double> duration =
+            std::chrono::system_clock::now() - start;
+        cout << "Sort operator" << (descending ? " (descending): " : ": ")
+            << duration.count() * 1000 << "ms (" << sorted.size()
+            << " rows)" << endl;
+
+        //Equal values have the same id, so the ids must be in the same order
+        if (descending)
+            std::reverse(sorted.begin(), sorted.end());
+        if (sorted != expected) {
+            size_t i = 0;
+            while (i < sorted.size() && i < expected.size() &&
+                    sorted[i] == expected[i])
+                i++;
+            cerr << "The order of the Sort operator differs at row " << i
+                << (descending ? " (descending)" : "") << endl;
+            errors++;
+        }
+    }
+    return errors > 0 ? 1 : 0;
+}
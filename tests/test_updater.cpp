@@ -0,0 +1,123 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include <trident/kb/updater.h>
+#include <trident/kb/kb.h>
+#include <trident/kb/querier.h>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Measures the throughput of the creation of an update with one thread and
+//with nthreads, and checks that the two updates give the same KB. The
+//updates are applied to the KBs, so run it on two copies of the same KB.
+//Usage: testUpdater <kbcopy1> <kbcopy2> <ntriples> <nthreads>
+static double update(string kbdir, string updatefile, int nthreads) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    Updater up(nthreads);
+    up.creatediffupdate(DiffIndex::TypeUpdate::ADDITION_df, kbdir, updatefile);
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    return sec.count();
+}
+
+//Returns the number of rows that differ in the six permutations
+static int64_t compare(KB &kb1, KB &kb2) {
+    std::unique_ptr<Querier> q1(kb1.query());
+    std::unique_ptr<Querier> q2(kb2.query());
+    int64_t errors = 0;
+    for (int perm = 0; perm < 6; ++perm) {
+        PairItr *itr1 = q1->get(perm, -1, -1, -1);
+        PairItr *itr2 = q2->get(perm, -1, -1, -1);
+        int64_t n = 0;
+        while (itr1->hasNext()) {
+            itr1->next();
+            if (!itr2->hasNext()) {
+                errors++;
+                break;
+            }
+            itr2->next();
+            if (itr1->getKey() != itr2->getKey() ||
+                    itr1->getValue1() != itr2->getValue1() ||
+                    itr1->getValue2() != itr2->getValue2()) {
+                errors++;
+            }
+            n++;
+        }
+        if (itr2->hasNext()) {
+            errors++;
+        }
+        q1->releaseItr(itr1);
+        q2->releaseItr(itr2);
+        LOG(INFOL) << "Permutation " << perm << ": " << n << " rows";
+    }
+    return errors;
+}
+
+//Returns the number of triples of the update that are not in the KB
+static int64_t check(KB &kb, string updatefile) {
+    std::unique_ptr<Querier> q(kb.query());
+    DictMgmt *dict = kb.getDictMgmt();
+    ifstream ifs(updatefile);
+    string s, p, o, dot;
+    int64_t missing = 0;
+    while (ifs >> s >> p >> o >> dot) {
+        nTerm ids[3];
+        if (!dict->getNumber(s.c_str(), s.size(), &ids[0]) ||
+                !dict->getNumber(p.c_str(), p.size(), &ids[1]) ||
+                !dict->getNumber(o.c_str(), o.size(), &ids[2]) ||
+                !q->exists(ids[0], ids[1], ids[2])) {
+            missing++;
+        }
+    }
+    return missing;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <kbcopy1> <kbcopy2> <ntriples> <nthreads>" << endl;
+        return 1;
+    }
+    string kbdir1 = argv[1];
+    string kbdir2 = argv[2];
+    int64_t ntriples = atoll(argv[3]);
+    int nthreads = atoi(argv[4]);
+
+    //Generate the update. Few predicates and a skewed set of objects, so
+    //that the terms repeat like in real data
+    string updatefile = kbdir1 + "/../update_" + to_string(ntriples) + ".nt";
+    {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int64_t> subjects(0, ntriples / 4 + 1);
+        std::uniform_int_distribution<int> predicates(0, 100);
+        std::geometric_distribution<int64_t> objects(0.0001);
+        ofstream ofs(updatefile);
+        for (int64_t i = 0; i < ntriples; ++i) {
+            ofs << "<http://bench.org/s" << subjects(gen) << "> ";
+            ofs << "<http://bench.org/p" << predicates(gen) << "> ";
+            ofs << "<http://bench.org/o" << objects(gen) << "> .\n";
+        }
+    }
+
+    double serial = update(kbdir1, updatefile, 1);
+    LOG(INFOL) << "Threads 1 triples " << ntriples << " runtime " <<
+        serial * 1000 << " ms. (" << (int64_t)(ntriples / serial) <<
+        " triples/s)";
+    double parallel = update(kbdir2, updatefile, nthreads);
+    LOG(INFOL) << "Threads " << nthreads << " triples " << ntriples <<
+        " runtime " << parallel * 1000 << " ms. (" <<
+        (int64_t)(ntriples / parallel) << " triples/s) speedup " <<
+        serial / parallel;
+
+    KBConfig config;
+    KB kb1(kbdir1.c_str(), true, false, true, config);
+    KB kb2(kbdir2.c_str(), true, false, true, config);
+    int64_t errors = compare(kb1, kb2);
+    int64_t missing = check(kb2, updatefile);
+    LOG(INFOL) << "Rows that differ " << errors << ", triples missing " <<
+        missing;
+    return errors > 0 || missing > 0 ? 1 : 0;
+}
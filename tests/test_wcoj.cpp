@@ -0,0 +1,123 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include <trident/kb/kb.h>
+#include <trident/sparql/sparql.h>
+#include <trident/utils/json.h>
+#include <layers/TridentLayer.hpp>
+#include <kognac/logs.h>
+
+using namespace std;
+
+//Runs a set of SPARQL queries with the multiway join for the cyclic patterns
+//and with binary joins only, checks that the two plans return the same rows
+//and reports the average runtime. Without query files, it runs the cyclic
+//queries below on a LUBM or a WatDiv KB. The queries whose terms are not in
+//the KB return no rows.
+//Usage: testWCOJ <kbdir> <nruns> [<query file> ...]
+static const char *cyclicQueries[][2] = {
+    //LUBM Q2, the triangle student-department-university
+    {"lubm-q2", "PREFIX ub: <http://swat.cse.lehigh.edu/onto/univ-bench.owl#> "
+        "PREFIX rdf: <http://www.w3.org/1999/02/22-rdf-syntax-ns#> "
+        "SELECT ?x ?y ?z WHERE { ?x rdf:type ub:GraduateStudent . "
+        "?y rdf:type ub:University . ?z rdf:type ub:Department . "
+        "?x ub:memberOf ?z . ?z ub:subOrganizationOf ?y . "
+        "?x ub:undergraduateDegreeFrom ?y }"},
+    //LUBM Q9 without the types, the triangle student-advisor-course
+    {"lubm-q9", "PREFIX ub: <http://swat.cse.lehigh.edu/onto/univ-bench.owl#> "
+        "SELECT ?x ?y ?z WHERE { ?x ub:advisor ?y . ?y ub:teacherOf ?z . "
+        "?x ub:takesCourse ?z }"},
+    //WatDiv, a triangle of followers
+    {"watdiv-triangle", "PREFIX wsdbm: <http://db.uwaterloo.ca/~galuc/wsdbm/> "
+        "SELECT ?v0 ?v1 ?v2 WHERE { ?v0 wsdbm:follows ?v1 . "
+        "?v1 wsdbm:follows ?v2 . ?v2 wsdbm:follows ?v0 }"},
+    //WatDiv, a square: two friends that like the same product
+    {"watdiv-square", "PREFIX wsdbm: <http://db.uwaterloo.ca/~galuc/wsdbm/> "
+        "SELECT ?v0 ?v1 ?v2 ?v3 WHERE { ?v0 wsdbm:friendOf ?v1 . "
+        "?v0 wsdbm:likes ?v2 . ?v3 wsdbm:friendOf ?v1 . "
+        "?v3 wsdbm:likes ?v2 }"},
+};
+
+static double run(TridentLayer &layer, KB &kb, const string &query, int nruns) {
+    //Warm up the caches of the querier
+    SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer, false,
+            false, NULL, NULL, NULL);
+    auto startTime = std::chrono::system_clock::now();
+    for (int i = 0; i < nruns; ++i) {
+        SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer,
+                false, false, NULL, NULL, NULL);
+    }
+    std::chrono::duration<double> duration =
+        std::chrono::system_clock::now() - startTime;
+    return duration.count() * 1000 / nruns;
+}
+
+//Returns the rows of a query, sorted, since the two plans can return them
+//in a different order
+static vector<string> getRows(TridentLayer &layer, KB &kb,
+        const string &query) {
+    JSON vars;
+    JSON bindings;
+    SPARQLUtils::execSPARQLQuery(query, false, kb.getNTerms(), layer, false,
+            true, &vars, &bindings, NULL);
+    vector<string> rows;
+    for (auto row : bindings.getListChildren()) {
+        std::ostringstream buf;
+        JSON::write(buf, row);
+        rows.push_back(buf.str());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <kbdir> <nruns> [<query file> ...]" << endl;
+        return 1;
+    }
+    Logger::setMinLevel(WARNL);
+    int nruns = atoi(argv[2]);
+
+    KBConfig config;
+    KB kb(argv[1], true, false, false, config);
+    TridentLayer multiway(kb);
+    TridentLayer binary(kb);
+    binary.disableMultiwayJoins();
+
+    vector<pair<string, string>> queries;
+    for (int i = 3; i < argc; ++i) {
+        std::ifstream f(argv[i]);
+        std::stringstream buffer;
+        buffer << f.rdbuf();
+        queries.push_back(make_pair(string(argv[i]), buffer.str()));
+    }
+    if (queries.empty()) {
+        for (auto &q : cyclicQueries) {
+            queries.push_back(make_pair(string(q[0]), string(q[1])));
+        }
+    }
+
+    int errors = 0;
+    cout << "query\trows\tms (binary joins)\tms (multiway join)" << endl;
+    for (auto &q : queries) {
+        vector<string> rowsBinary = getRows(binary, kb, q.second);
+        vector<string> rowsMultiway = getRows(multiway, kb, q.second);
+        if (rowsBinary != rowsMultiway) {
+            cerr << q.first << ": the binary joins return " <<
+                rowsBinary.size() << " rows, the multiway join " <<
+                rowsMultiway.size() << " rows, or different values" << endl;
+            errors++;
+        }
+
+        double msBinary = run(binary, kb, q.second, nruns);
+        double msMultiway = run(multiway, kb, q.second, nruns);
+        cout << q.first << "\t" << rowsBinary.size() << "\t" << msBinary <<
+            "\t" << msMultiway << endl;
+    }
+    return errors > 0 ? 1 : 0;
+}